@@ -121,7 +121,8 @@ dump_core(const char *reason, uintptr_t cause, uintptr_t epc, uintptr_t regs[32]
                 i * 2 + 1, reg_usage[i * 2 + 1][0], regs[i * 2 + 1]);
         }
 
-        for(i = 0; i < 32 / 2; i++)
+        /* 浮点寄存器不在陷入现场里时fregs为NULL */
+        for(i = 0; fregs && i < 32 / 2; i++)
         {
             DUMP_PRINTF(
                 "freg[%02d](%s) = 0x%016lx(%f), freg[%02d](%s) = 0x%016lx(%f)\r\n",
@@ -1,3 +1,6 @@
+#include "autocfg.h"
+/* SPG 打开CFG_NEWLIB_GLUE时newlib的锁由aCoral内核用互斥量实现（kernel/newlib.c），这里的自旋锁不编译 */
+#if !CFG_NEWLIB_GLUE
 #include <stdlib.h>
 #include <sys/lock.h>
 #include "bsp.h"
@@ -272,3 +275,4 @@ void _lock_release_recursive(_lock_t *lock)
 {
     reculock_unlock(lock);
 }
+#endif
@@ -37,6 +37,7 @@
 #include "syslog.h"
 #include "util.h"
 #include "iomem.h"
+#include "autocfg.h"
 
 /**
  * @note       System call list
@@ -183,6 +184,11 @@ static size_t sys_brk(size_t pos)
 
     if(pos)
     {
+#if CFG_NEWLIB_GLUE
+        /* SPG _heap_start~_heap_end归aCoral的统一堆管理，malloc也在统一堆上，不能再用brk把它分出去 */
+        LOGE(TAG, "brk is not supported, the heap is managed by aCoral\r\n");
+        res = -ENOMEM;
+#else
         /* Call again */
         if((uintptr_t)pos > (uintptr_t)&_heap_end[0])
         {
@@ -206,6 +212,7 @@ static size_t sys_brk(size_t pos)
             /* Return current address. */
             res = (uintptr_t)_heap_cur;
         }
+#endif
     } else
     {
         /* First call, return initial address */
@@ -0,0 +1,31 @@
+/**
+ * @file main.c
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief Linux主机上运行aCoral内核基准测试的入口
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "core.h"
+#include "user.h"
+
+/**
+ * @brief 内核堆，链接时用--defsym把_heap_start、_heap_end指到这里。
+ *        可执行文件按-no-pie链接，地址在4GB以下，内核里按unsigned int保存地址不会截断
+ */
+char host_heap[HOST_HEAP_SIZE] __attribute__((aligned(4096)));
+
+void user_main()
+{
+    acoral_bench();
+    fflush(stdout);
+    exit(0);
+}
+
+int main()
+{
+    system_start();
+    return 0;
+}
@@ -21,53 +21,141 @@
  */
 
 /*如果需要新增SOC "XXX"，根据以下步骤：
- * 1. 在 acoralSOCEnum 中添加 SOC_XXX
+ * 1. 新增 #define SOC_XXX，取一个没用过的值（要在#if里比较，不能用枚举）
  * 2. #define CFG_SOC XXX
  * 3. 在hal文件夹中新增XXX文件夹
  * 4. 在XXX文件夹中实现hal层接口
  * 5. 在hal.h中新增头文件目录
  */
-typedef enum{
-  SOC_K210,
-  SOC_S3C2440
-}acoralSOCEnum;
-#define CFG_SOC SOC_K210
+#define SOC_K210    0
+#define SOC_S3C2440 1
+#define SOC_HOST    2 ///<Linux主机上的HAL替身，不需要开发板就能跑内核，用于基准测试
+
+#ifndef CFG_SOC
+#define CFG_SOC SOC_K210 ///<主机构建时由编译选项-DCFG_SOC=SOC_HOST指定
+#endif
 
 //K210
 #if CFG_SOC==SOC_K210
 #define CFG_SMP 
+#define CFG_MAX_CPU (2) ///<K210有两个hart，两个核都运行aCoral调度器
+#endif
+
+#ifndef CFG_MAX_CPU
+#define CFG_MAX_CPU (1)
 #endif
 
 
 /*
  ***************************** kernel configuration *****************************
  */
-///最大不超过1023
-#define CFG_MAX_RES_POOLS 40
+///对象缓存的slab也占用这里的资源池
+#define CFG_MAX_RES_POOLS 64
+
+///句柄表大小，即同时在用的资源（线程、事件、定时器等）总数上限，最大不超过4096
+#define CFG_MAX_HANDLES 512
+
+///伙伴系统基本内存块大小为(1<<CFG_MEM_BLOCK_SHIFT)字节，小块多的应用调小，大块多的调大可以少用状态字节
+#define CFG_MEM_BLOCK_SHIFT (7)
 
 ///任意大小内存分配系统是否启用
 #define CFG_MEM2 1 
 #define CFG_MEM2_SIZE (102400) ///<任意大小内存分配系统的大小，是从伙伴系统管理的堆内存中拿出一部分
+#define CFG_MEM2_ISR_MAX_SIZE (256) ///<中断中用acoral_malloc2_isr一次最多能分配的字节数
+
+#define CFG_HEAP_SMALL_MAX (1024) ///<统一堆（acoral_heap_*）中不超过这个大小的请求走任意大小分配系统，更大的直接向伙伴系统要整块
+
+#if CFG_SOC==SOC_K210
+#define CFG_NEWLIB_GLUE 1 ///<1：newlib的malloc系列和C++的new由统一堆提供，newlib的_lock_*用aCoral互斥量实现；主机构建用的是glibc，不接
+#define CFG_NEWLIB_LOCKS (32) ///<newlib锁表的大小，malloc、环境变量等全局锁和每个打开的FILE各占一项，满了的共用一个备用项
+#endif
+
+#define CFG_SLAB 1 ///<1：启用对象缓存（acoral_cache_*），运行时为应用的定长对象创建slab缓存
+#define CFG_SLAB_MAG_SIZE (8) ///<每个对象缓存在每个核上的弹匣容量，弹匣空了或满了时和slab层成批交换一半
+#define CFG_SLAB_OBJS_PER_SLAB (16) ///<每个slab至少放多少个对象，按伙伴系统取整后多出来的空间也用上，最多256个
+#define CFG_SLAB_MAX_SLABS (8) ///<每个对象缓存最多的slab数，每个slab占一个全局资源池，限住了应用的缓存就挤不掉线程、事件等内核资源池
 
 #define CFG_THRD_PERIOD 1
 
+#define CFG_THRD_EDF 1 ///<启用最早截止期优先（EDF）调度，依赖CFG_THRD_PERIOD
+#define CFG_EDF_UTIL_BOUND (1000) ///<EDF线程总利用率上限，千分比，超过则拒绝创建
+
+#if CFG_THRD_EDF && !CFG_THRD_PERIOD
+#error "CFG_THRD_EDF requires CFG_THRD_PERIOD"
+#endif
+
+#define CFG_THRD_RR 1 ///<启用时间片轮转调度
+#define CFG_RR_DEFAULT_SLICE_MS (10) ///<时间片轮转线程默认时间片，单位为毫秒
+
 #define CFG_THRD_DAG 1 ///<启用DAG调度
 #define CFG_DAG_SIZE 10 ///<全局DAG图节点数量上限
+#define CFG_DAG_PRIO_BASE (10) ///<DAG节点线程的最高优先级，关键路径最长的节点用它，其余依次往后排
+#define CFG_DAG_PIPELINE_DEPTH (2) ///<DAG流水线中同时未完成的最大帧数，1表示不做跨帧流水
+
+
+#define CFG_HARD_RT_PRIO_NUM (4) ///<硬实时任务的专属优先级个数，这一段优先级只能由acoral_create_hard_rt_thread带CPU预留创建，0表示不设硬实时段
+#define CFG_HARD_RT_UTIL_BOUND (690) ///<每个核上硬实时段线程预留的总利用率上限，千分比，取单调速率调度的可调度界ln2
 
+#define CFG_RESERVE 1 ///<1：启用CPU预留（按周期补充的预算，偶发服务器方式），预算用完的线程被降级或挂起到补充为止
+#define CFG_RESERVE_MAX_REPL (8) ///<每个预留最多同时挂着的补充次数，满了之后合并到最后一次
 
-#define CFG_HARD_RT_PRIO_NUM (0) ///<硬实时任务的专属优先级个数
+#if CFG_HARD_RT_PRIO_NUM && !CFG_RESERVE
+#error "CFG_HARD_RT_PRIO_NUM requires CFG_RESERVE"
+#endif
+
+#define CFG_MAX_THREAD (40) ///<最多40个线程，不超过256
 
-#define CFG_MAX_THREAD (40) ///<///最多40个线程
+#define CFG_MAX_PRIO_NUM (64) ///<系统优先级个数（0~63），与线程数解耦，不超过256
 
-#define CFG_MIN_STACK_SIZE (10240) ///<线程最小拥有10240字节的栈
+#if CFG_MAX_THREAD > 256 || CFG_MAX_PRIO_NUM > 256
+#error "CFG_MAX_THREAD and CFG_MAX_PRIO_NUM must not exceed 256"
+#endif
+
+#if CFG_SOC==SOC_HOST
+#define CFG_MIN_STACK_SIZE (65536) ///<主机上信号处理函数和glibc的printf都跑在线程栈上，要大一些
+#define CFG_DEFAULT_STACK_SIZE (65536)
+#else
+#define CFG_MIN_STACK_SIZE (1024) ///<线程栈的下限，中断在各核独立的中断栈上处理，线程栈上只有切换时保存的上下文
+#define CFG_DEFAULT_STACK_SIZE (10240) ///<创建线程时stack_size传0使用的栈大小
+#endif
+
+#define CFG_STACK_CACHE_CLASSES (5) ///<栈缓存的大小级别数，第i级为CFG_MIN_STACK_SIZE按伙伴系统取整后再乘2^i
+#define CFG_STACK_CACHE_DEPTH (4) ///<每级最多缓存的空闲栈个数，0表示不缓存，线程退出时直接释放栈
+
+#define CFG_STACK_PAINT 0 ///<1：创建线程时把整个栈填成ACORAL_STACK_PAINT，用来测量栈的高水位（stack命令）；每次创建都要写满整个栈，只在调栈大小时打开
+#define CFG_STACK_PROFILE 0 ///<1：线程退出时打印栈的高水位和建议的栈大小，依赖CFG_STACK_PAINT
+
+#if CFG_STACK_PROFILE && !CFG_STACK_PAINT
+#error "CFG_STACK_PROFILE requires CFG_STACK_PAINT"
+#endif
+
+#define CFG_THREAD_STATS 1 ///<1：按HAL_GET_CYCLES统计每个线程的运行时间、切换次数以及各核的中断、空闲时间，供top命令使用
 
 #define CFG_EVT_SEM 1
 #define CFG_EVT_MUTEX 1
 
+#define CFG_SRP 1 ///<1：acoral_mutex_pend2按栈资源策略（SRP）维护各核的系统天花板，并启用共享栈的运行到完成任务
+#define CFG_SRP_MAX_NEST (8) ///<每个核上同时占用的天花板互斥量个数上限
+#if CFG_SOC==SOC_HOST
+#define CFG_SRP_STACK_SIZE (65536)
+#else
+#define CFG_SRP_STACK_SIZE (2048) ///<每个抢占级别共享的任务栈大小，同一级别的所有任务轮流使用
+#endif
+
+#if CFG_SRP && !CFG_EVT_MUTEX
+#error "CFG_SRP requires CFG_EVT_MUTEX"
+#endif
+
 #define CFG_MSG 1 ///<1：启用消息队列 ，0：关闭消息队列
 
+#define CFG_WORKQUEUE 1 ///<1：启用工作队列（固定线程池），0：关闭
+
 #define CFG_TICKS_PER_SEC (100) ///<acoral每秒的ticks数
 
+#define CFG_TICKLESS 0 ///<1：idle时按最近的到期时间编程定时器并WFI睡眠（tickless），0：每个tick都唤醒
+#define CFG_TICKLESS_MIN_TICKS (2) ///<距离最近到期不足这么多tick时不值得重编程定时器，只WFI等下一个tick
+#define CFG_TICKLESS_MAX_TICKS (CFG_TICKS_PER_SEC*10) ///<一次tickless睡眠的最长tick数，队列都为空时也会按它醒来
+
 
 
 /*
@@ -81,6 +169,4 @@ typedef enum{
 #define CFG_BAUD_RATE (115200)
 #define CFG_DEBUG_INFO 1
 
-#undef ARCH_ACORAL_FPU /*//SPG中断保护现场那里*/
-
 #endif
\ No newline at end of file
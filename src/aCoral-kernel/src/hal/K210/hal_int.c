@@ -18,23 +18,49 @@
 #include <stdint.h>
 
 #include "sysctl.h"
+#include "clint.h"
+#include "plic.h"
+#ifdef CFG_SMP
+#include "atomic.h"
+#endif
 
-///中断嵌套数。大于0表示正在中断中。大于1表示中断层数不止一层，即中断嵌套。
-int acoral_intr_nesting = 0;
-unsigned long pre_mstatus_MIE; //SPG 多核的话要扩展成数组，因为每个核有自己的mstatus
+///中断嵌套数，每个核一个。大于0表示正在中断中。大于1表示中断层数不止一层，即中断嵌套。
+int acoral_intr_nestings[CFG_MAX_CPU];
+
+static int crit_nesting[CFG_MAX_CPU];			///<每个核的临界区嵌套层数
+static unsigned long crit_mie[CFG_MAX_CPU];	///<每个核进入最外层临界区之前的mstatus.MIE
+
+static void (*soft_intr_isr)(void);			///<软件中断服务程序
+static volatile int soft_intr_pending[CFG_MAX_CPU];	///<区分软件中断和其他核发来的调度核间中断
+
+#ifdef CFG_SMP
+static spinlock_t kernel_lock = SPINLOCK_INIT;	///<内核大锁，保护就绪队列、等待队列、资源池等全部内核数据
+static volatile int kernel_lock_owner = -1;		///<持有内核大锁的核，-1表示无人持有
+#endif
 
 void hal_intr_init(){
     plic_init();
 }
 
-void hal_intr_unmask(int vector)
+int hal_intr_attach(int vector, void (*isr)(int))
+{
+	plic_irq_register(vector, (plic_irq_callback_t)isr, NULL);
+	return 0;
+}
+
+void hal_intr_detach(int vector)
+{
+	plic_irq_deregister(vector);
+}
+
+int hal_intr_unmask(int vector)
 {
-	// TODO riscv-加上
+	return plic_irq_enable(vector);
 }
 
-void hal_intr_mask(int vector)
+int hal_intr_mask(int vector)
 {
-	// TODO riscv-加上
+	return plic_irq_disable(vector);
 }
 
 
@@ -43,18 +69,29 @@ void hal_intr_mask(int vector)
 
 void hal_intr_nesting_dec_comm()
 {
-	if (acoral_intr_nesting > 0)
-		acoral_intr_nesting--;
+	unsigned int cpu = HAL_GET_CURRENT_CPU();
+	if (acoral_intr_nestings[cpu] > 0 && --acoral_intr_nestings[cpu] == 0)
+	{
+#if CFG_THREAD_STATS
+		acoral_stat_intr_exit();
+#endif
+	}
 }
 
 void hal_intr_nesting_inc_comm()
 {
-	acoral_intr_nesting++;
+	if (acoral_intr_nestings[HAL_GET_CURRENT_CPU()]++ == 0)
+	{
+#if CFG_THREAD_STATS
+		acoral_stat_intr_enter();
+#endif
+	}
 }
 
 void hal_sched_bridge_comm()
 {
-	HAL_ENTER_CRITICAL(); //SPG这里关了中断，线程切换后，新的线程不就默认是关中断的状态了么
+	/*临界区层数随线程保存、恢复，切换回来的线程在这里退出的是它自己当初进入的那一层*/
+	HAL_ENTER_CRITICAL();
 	acoral_real_sched();
 	HAL_EXIT_CRITICAL();
 }
@@ -64,10 +101,17 @@ unsigned long hal_intr_exit_bridge_comm(unsigned long old_sp)
 
 	HAL_ENTER_CRITICAL();
 	unsigned long next_sp = acoral_real_intr_sched(old_sp);
-	HAL_EXIT_CRITICAL();
+	/*要切换线程时被换下线程的s0~s11还不在现场里，先不退出，等汇编补存完再由hal_intr_switch_finish退出*/
+	if (next_sp == old_sp)
+		HAL_EXIT_CRITICAL();
 	return next_sp;
 }
 
+void hal_intr_switch_finish()
+{
+	HAL_EXIT_CRITICAL();
+}
+
 void hal_intr_enable(){
 	sysctl_enable_irq();
 }
@@ -77,10 +121,96 @@ void hal_intr_disable(){
 }
 
 void hal_enter_critical(){
-    pre_mstatus_MIE = read_csr(mstatus) & MSTATUS_MIE; 
-    hal_intr_disable();                          
+	/*先关本核中断再读核号和嵌套数，之后就不会被抢占、也不会被迁移到另一个核上*/
+	unsigned long mie = HAL_INTR_SAVE();
+	unsigned int cpu = HAL_GET_CURRENT_CPU();
+
+	if (crit_nesting[cpu]++ == 0)
+	{
+		crit_mie[cpu] = mie;
+#ifdef CFG_SMP
+		spinlock_lock(&kernel_lock);
+		kernel_lock_owner = cpu;
+#endif
+	}
 }
 
 void hal_exit_critical(){
-	write_csr(mstatus,read_csr(mstatus) | pre_mstatus_MIE); 
-}
\ No newline at end of file
+	unsigned int cpu = HAL_GET_CURRENT_CPU();
+
+	if (crit_nesting[cpu] == 0)
+		return;
+	if (--crit_nesting[cpu] == 0)
+	{
+#ifdef CFG_SMP
+		kernel_lock_owner = -1;
+		spinlock_unlock(&kernel_lock);
+#endif
+		HAL_INTR_RESTORE(crit_mie[cpu]);
+	}
+}
+
+int hal_crit_save(unsigned long *mie){
+	unsigned int cpu = HAL_GET_CURRENT_CPU();
+	*mie = crit_mie[cpu];
+	return crit_nesting[cpu];
+}
+
+void hal_crit_restore(int nesting, unsigned long mie){
+	unsigned int cpu = HAL_GET_CURRENT_CPU();
+	crit_nesting[cpu] = nesting;
+	crit_mie[cpu] = mie;
+}
+
+void hal_switch_finish(){
+#ifdef CFG_SMP
+	unsigned int cpu = HAL_GET_CURRENT_CPU();
+	/*换上的是新线程或者在中断中被换下的线程，它们不在临界区里，切换期间一直持有的锁在这里放掉*/
+	if (crit_nesting[cpu] == 0 && kernel_lock_owner == (int)cpu)
+	{
+		kernel_lock_owner = -1;
+		spinlock_unlock(&kernel_lock);
+	}
+#endif
+}
+
+/**
+ * @brief 核间中断回调，只置位本核的调度标志，真正的调度在中断退出时进行
+ *
+ */
+static int ipi_handler(void *ctx){
+	unsigned int cpu = HAL_GET_CURRENT_CPU();
+	if (soft_intr_pending[cpu])
+	{
+		soft_intr_pending[cpu] = 0;
+		if (soft_intr_isr)
+			soft_intr_isr();
+	}
+	system_need_sched = true;
+	return 0;
+}
+
+void hal_ipi_init(){
+	clint_ipi_init();
+	clint_ipi_register(ipi_handler, NULL);
+	/*这里只打开软件中断源，mstatus.MIE由线程上下文决定，不用clint_ipi_enable*/
+	set_csr(mie, MIP_MSIP);
+}
+
+void hal_ipi_send(unsigned int cpu){
+	clint_ipi_send(cpu);
+}
+
+void hal_soft_intr_attach(void (*isr)(void)){
+	soft_intr_isr = isr;
+#ifndef CFG_SMP
+	/*单核时核间中断没有初始化过*/
+	hal_ipi_init();
+#endif
+}
+
+void hal_soft_intr_trigger(){
+	unsigned int cpu = HAL_GET_CURRENT_CPU();
+	soft_intr_pending[cpu] = 1;
+	clint_ipi_send(cpu);
+}
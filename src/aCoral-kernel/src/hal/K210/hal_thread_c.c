@@ -14,7 +14,18 @@
  */
 
 #include "./include/hal_thread.h"
+#include "./include/hal_int.h"
+#include "dump.h"
+#include "syscalls.h"
+#include <stdint.h>
 #include <stdio.h>
+
+#define MSTATUS_FS_OFF   0x0000 ///<mstatus.FS=Off，执行浮点指令触发非法指令异常
+#define MSTATUS_FS_CLEAN 0x4000 ///<mstatus.FS=Clean，浮点寄存器与保存的上下文一致
+#define MSTATUS_FS_DIRTY 0x6000 ///<mstatus.FS=Dirty，浮点寄存器被改过
+
+static hal_fpu_ctx_t *fpu_owner[CFG_MAX_CPU]; ///<每个核浮点寄存器里当前装着的上下文，NULL表示不属于任何线程
+static hal_fpu_ctx_t *fpu_cur[CFG_MAX_CPU];   ///<每个核上正在运行线程的浮点上下文
 /**
  * @brief 线程上下文初始化，用于线程被切换到cpu上运行后，替换之前的线程的上下文
  * 
@@ -51,7 +62,81 @@ unsigned int* hal_stack_init(unsigned int *stack, void *route, void *exit, void
 
     /* force to machine mode(MPP=11) and set MPIE to 1 ，在线程切换时，会使用mret指令，将MPIE赋给MIE，即打开中断 */
     //SPG 这里有一个问题，就是对于init线程，切换init上下文到init第一行代码关中断，这中间中断是打开的，虽然很短，但如果发生中断，可能会发生问题
-    frame->mstatus = 0x00007880;
+    //FS=Off，线程第一次使用浮点指令时才装载浮点上下文
+    frame->mstatus = 0x00001880;
     
     return stk;
 }
+
+/**
+ * @brief 清掉其他核对ctx的缓存，ctx刚在本核上被更新
+ * 
+ * @param ctx 浮点上下文
+ * @param cpu 本核
+ */
+static void fpu_invalidate_others(hal_fpu_ctx_t *ctx, unsigned int cpu)
+{
+    unsigned int i;
+    for (i = 0; i < CFG_MAX_CPU; i++)
+    {
+        if (i != cpu && fpu_owner[i] == ctx)
+            fpu_owner[i] = NULL;
+    }
+}
+
+void hal_fpu_switch(hal_fpu_ctx_t *prev, hal_fpu_ctx_t *next, unsigned int *next_stack)
+{
+    unsigned int cpu = HAL_GET_CURRENT_CPU();
+    hal_ctx_t *frame = (hal_ctx_t *)next_stack;
+
+    /* 干净的上下文和TCB里的副本一致，不用保存 */
+    if (prev && (read_csr(mstatus) & MSTATUS_FS) == MSTATUS_FS_DIRTY)
+    {
+        hal_fpu_save(prev);
+        fpu_owner[cpu] = prev;
+        fpu_invalidate_others(prev, cpu);
+    }
+    fpu_cur[cpu] = next;
+    frame->mstatus &= ~MSTATUS_FS;
+    frame->mstatus |= (fpu_owner[cpu] == next) ? MSTATUS_FS_CLEAN : MSTATUS_FS_OFF;
+}
+
+void hal_fpu_release(hal_fpu_ctx_t *ctx)
+{
+    unsigned int i;
+    for (i = 0; i < CFG_MAX_CPU; i++)
+    {
+        if (fpu_owner[i] == ctx)
+            fpu_owner[i] = NULL;
+    }
+}
+
+/**
+ * @brief 非法指令异常处理，覆盖bsp里的弱定义。
+ *        FS为Off时线程执行了浮点指令，在这里装载它的浮点上下文并把FS置为Clean，返回后重新执行这条指令
+ * @note 中断服务程序不能使用浮点指令
+ */
+uintptr_t handle_illegal_instruction(uintptr_t cause, uintptr_t epc, uintptr_t regs[32], uintptr_t fregs[32])
+{
+    unsigned int cpu = HAL_GET_CURRENT_CPU();
+    hal_fpu_ctx_t *ctx = fpu_cur[cpu];
+
+    /* regs[2]是现场里保存的mstatus */
+    if (ctx != NULL && (regs[2] & MSTATUS_FS) == MSTATUS_FS_OFF)
+    {
+        if (fpu_owner[cpu] != ctx)
+        {
+            set_csr(mstatus, MSTATUS_FS); //先打开FPU才能执行浮点装载指令
+            hal_fpu_restore(ctx);
+            fpu_owner[cpu] = ctx;
+            /* 刚装载的寄存器和上下文一致，中断退出时如果切走不用再保存一遍 */
+            clear_csr(mstatus, MSTATUS_FS);
+            set_csr(mstatus, MSTATUS_FS_CLEAN);
+        }
+        regs[2] |= MSTATUS_FS_CLEAN;
+        return epc;
+    }
+    dump_core("illegal instruction", cause, epc, regs, fregs);
+    sys_exit(1337);
+    return epc;
+}
@@ -2,6 +2,12 @@
 #include "autocfg.h"
 
 #include "clint.h"
+#include "encoding.h"
+
+/// 每个tick对应的mtime计数值
+static uint64_t tick_cycles;
+/// 进入tickless前mtimecmp的值，即下一个正常的tick边界
+static uint64_t tickless_next_cmp[CLINT_NUM_CORES];
 
 int hal_timer_init(int ticks_per_sec, void (*ticks_entry)(void *args), void *args){
 	int result = -1;
@@ -14,5 +20,40 @@ int hal_timer_init(int ticks_per_sec, void (*ticks_entry)(void *args), void *arg
 	if(result){
 		return -1;
 	}
+	/*和clint_timer_set_interval中的换算保持一致*/
+	tick_cycles = (1000/ticks_per_sec) * clint_timer_get_freq() / 1000ULL;
 	return 0;
 }
+
+int hal_timer_tickless_enter(unsigned int nticks){
+	unsigned long core_id = current_coreid();
+	uint64_t next_cmp = clint->mtimecmp[core_id];
+
+	if(nticks == 0 || tick_cycles == 0){
+		return -1;
+	}
+	/*tick已经到期但还没来得及处理，不能睡*/
+	if(clint->mtime >= next_cmp){
+		return -1;
+	}
+	tickless_next_cmp[core_id] = next_cmp;
+	clint->mtimecmp[core_id] = next_cmp + (uint64_t)(nticks - 1) * tick_cycles;
+	return 0;
+}
+
+unsigned int hal_timer_tickless_exit(void){
+	unsigned long core_id = current_coreid();
+	uint64_t next_cmp = tickless_next_cmp[core_id];
+	uint64_t now = clint->mtime;
+	uint64_t crossed;
+
+	if(now < next_cmp){
+		/*被其他中断提前唤醒，一个tick边界都没跨过*/
+		clint->mtimecmp[core_id] = next_cmp;
+		return 0;
+	}
+	crossed = (now - next_cmp) / tick_cycles + 1;
+	/*把mtimecmp设为跨过的最后一个边界，开中断后ticks中断立即处理它并按节拍继续*/
+	clint->mtimecmp[core_id] = next_cmp + (crossed - 1) * tick_cycles;
+	return (unsigned int)(crossed - 1);
+}
@@ -16,12 +16,23 @@
 #ifndef HAL_INT_H
 #define HAL_INT_H
 
+#include "autocfg.h"
 #include "encoding.h"
 
 #define HAL_INTR_ENABLE()     hal_intr_enable()
 #define HAL_INTR_DISABLE()    hal_intr_disable()
+#define HAL_INTR_SAVE()       (clear_csr(mstatus, MSTATUS_MIE) & MSTATUS_MIE) ///<只关本核中断，返回之前的mstatus.MIE
+#define HAL_INTR_RESTORE(mie) set_csr(mstatus, (mie))
 
-extern int acoral_intr_nesting;
+#ifdef CFG_SMP
+#define HAL_GET_CURRENT_CPU() ((unsigned int)read_csr(mhartid)) ///<当前hart号
+#else
+#define HAL_GET_CURRENT_CPU() (0)
+#endif
+
+///每个核各自的中断嵌套数，中断栈、mstatus都是每个核独立的
+extern int acoral_intr_nestings[CFG_MAX_CPU];
+#define acoral_intr_nesting (acoral_intr_nestings[HAL_GET_CURRENT_CPU()])
 
 void hal_intr_init();
 
@@ -38,18 +49,36 @@ void hal_intr_enable();
 void hal_intr_disable();
 
 /**
- * @brief 使能中断。通过向中断屏蔽（INTMSK）寄存器某位写入0来打开相应中断，对中断复用进行了合并处理
+ * @brief 为外部中断注册中断服务程序
  *
- * @param vector 中断向量号（中断复用展开后）
+ * @param vector PLIC中断号
+ * @param isr 中断服务程序
+ * @return int 成功返回0
  */
-void hal_intr_unmask(int vector);
+int hal_intr_attach(int vector, void (*isr)(int));
 
 /**
- * @brief 除能中断。通过向中断屏蔽（INTMSK）寄存器某位写入1来屏蔽相应中断，对中断复用进行了合并处理
+ * @brief 注销外部中断的中断服务程序
  *
- * @param vector 中断向量号（中断复用展开后）
+ * @param vector PLIC中断号
  */
-void hal_intr_mask(int vector);
+void hal_intr_detach(int vector);
+
+/**
+ * @brief 使能外部中断
+ *
+ * @param vector PLIC中断号
+ * @return int 成功返回0
+ */
+int hal_intr_unmask(int vector);
+
+/**
+ * @brief 除能外部中断
+ *
+ * @param vector PLIC中断号
+ * @return int 成功返回0
+ */
+int hal_intr_mask(int vector);
 
 void hal_intr_ack(unsigned int vector);
 
@@ -84,6 +113,73 @@ void hal_sched_bridge_comm();
  */
 unsigned long hal_intr_exit_bridge_comm(unsigned long old_sp);
 
+/**
+ * @brief 中断退出切换线程时，被换下线程的callee-saved寄存器存进现场之后调用，退出hal_intr_exit_bridge_comm留下的那层临界区
+ *
+ */
+void hal_intr_switch_finish(void);
+
+/**
+ * @brief 进入临界区：关当前核的中断，最外层进入时在多核下还要获取内核大锁
+ * @note 可以嵌套，只有最外层的hal_exit_critical才会放锁并恢复进入前的中断状态
+ */
+void hal_enter_critical(void);
+
+/**
+ * @brief 退出临界区
+ *
+ */
+void hal_exit_critical(void);
+
+/**
+ * @brief 读取当前核的临界区嵌套层数和最外层进入前的mstatus.MIE，线程切换时保存到被换下的线程
+ *
+ * @param mie 输出，最外层进入前的mstatus.MIE
+ * @return int 临界区嵌套层数
+ */
+int hal_crit_save(unsigned long *mie);
+
+/**
+ * @brief 把换上线程的临界区状态装载到当前核
+ * @note 内核锁跟着层数走：层数为0时锁要在新线程的栈换上之后由hal_switch_finish释放
+ *
+ * @param nesting 临界区嵌套层数
+ * @param mie 最外层进入前的mstatus.MIE
+ */
+void hal_crit_restore(int nesting, unsigned long mie);
+
+/**
+ * @brief 上下文切换换上新栈之后调用，新线程不在临界区中时释放切换期间持有的内核锁
+ *
+ */
+void hal_switch_finish(void);
+
+/**
+ * @brief 初始化当前核的核间中断，收到核间中断后当前核置位调度标志
+ *
+ */
+void hal_ipi_init(void);
+
+/**
+ * @brief 向指定核发送核间中断，让其在中断退出时重新调度
+ *
+ * @param cpu 目标核
+ */
+void hal_ipi_send(unsigned int cpu);
+
+/**
+ * @brief 注册软件中断的服务程序。软件中断借用当前核的核间中断（MSIP），用于测量中断延迟
+ *
+ * @param isr 中断服务程序，在中断上下文中执行，NULL表示注销
+ */
+void hal_soft_intr_attach(void (*isr)(void));
+
+/**
+ * @brief 在当前核上触发一次软件中断
+ *
+ */
+void hal_soft_intr_trigger(void);
+
 /****************************                                                                                                                 
 * the comm interrupt interface of hal     
 *  hal层中断部分通用接口
@@ -92,12 +188,23 @@ unsigned long hal_intr_exit_bridge_comm(unsigned long old_sp);
 #define HAL_INTR_NESTING_DEC()    hal_intr_nesting_dec_comm()
 #define HAL_INTR_NESTING_INC()    hal_intr_nesting_inc_comm()
 
-#define HAL_INTR_ATTACH(vecotr,isr) //TODO 该写什么？
+#define HAL_INTR_ATTACH(vector,isr) hal_intr_attach(vector,isr)
+#define HAL_INTR_DETACH(vector) hal_intr_detach(vector)
+#define HAL_INTR_UNMASK(vector) hal_intr_unmask(vector)
+#define HAL_INTR_MASK(vector) hal_intr_mask(vector)
 #define HAL_SCHED_BRIDGE() hal_sched_bridge_comm() //SPGcommon指的是老版本的acoral中，有stm32的版本，但是stm32的调度被放在pendsv中，比较特殊，所有这里封装了一层接口，除了stm32其他的实现称为common
 #define HAL_INTR_EXIT_BRIDGE(sp) hal_intr_exit_bridge_comm(sp)
 
 #define HAL_ENTER_CRITICAL() hal_enter_critical()
 #define HAL_EXIT_CRITICAL() hal_exit_critical()
+#define HAL_CRIT_SAVE(mie) hal_crit_save(mie)
+#define HAL_CRIT_RESTORE(nesting,mie) hal_crit_restore(nesting,mie)
+
+#define HAL_IPI_INIT() hal_ipi_init()
+#define HAL_IPI_SEND(cpu) hal_ipi_send(cpu)
+
+#define HAL_SOFT_INTR_ATTACH(isr) hal_soft_intr_attach(isr)
+#define HAL_SOFT_INTR_TRIGGER() hal_soft_intr_trigger()
 
 
 #endif
\ No newline at end of file
@@ -19,6 +19,8 @@
 
 /**
  * @brief aCoral线程上下文context在硬件层面的描述
+ * @note 中断进入时只存epc、mstatus和调用者保存的寄存器（ra、t0~t6、a0~a7），
+ *       gp、tp、s0~s11只在中断退出要切换线程时补存；主动切换则只存后者和ra
  */
 typedef struct {
   	unsigned long epc;        /* epc - epc    - program counter                     */
@@ -53,47 +55,56 @@ typedef struct {
     unsigned long t4;         /* x29 - t4     - temporary register 4                */
     unsigned long t5;         /* x30 - t5     - temporary register 5                */
     unsigned long t6;         /* x31 - t6     - temporary register 6                */
-#ifdef ARCH_ACORAL_FPU
-    unsigned int f0;      /* f0  */
-    unsigned int f1;      /* f1  */
-    unsigned int f2;      /* f2  */
-    unsigned int f3;      /* f3  */
-    unsigned int f4;      /* f4  */
-    unsigned int f5;      /* f5  */
-    unsigned int f6;      /* f6  */
-    unsigned int f7;      /* f7  */
-    unsigned int f8;      /* f8  */
-    unsigned int f9;      /* f9  */
-    unsigned int f10;     /* f10 */
-    unsigned int f11;     /* f11 */
-    unsigned int f12;     /* f12 */
-    unsigned int f13;     /* f13 */
-    unsigned int f14;     /* f14 */
-    unsigned int f15;     /* f15 */
-    unsigned int f16;     /* f16 */
-    unsigned int f17;     /* f17 */
-    unsigned int f18;     /* f18 */
-    unsigned int f19;     /* f19 */
-    unsigned int f20;     /* f20 */
-    unsigned int f21;     /* f21 */
-    unsigned int f22;     /* f22 */
-    unsigned int f23;     /* f23 */
-    unsigned int f24;     /* f24 */
-    unsigned int f25;     /* f25 */
-    unsigned int f26;     /* f26 */
-    unsigned int f27;     /* f27 */
-    unsigned int f28;     /* f28 */
-    unsigned int f29;     /* f29 */
-    unsigned int f30;     /* f30 */
-    unsigned int f31;     /* f31 */
-#endif
 }hal_ctx_t;
 
+/**
+ * @brief 线程的浮点上下文，不放在栈上的现场里，由FPU懒惰切换按需保存、恢复
+ * @note K210支持D扩展，浮点寄存器按64位保存
+ */
+typedef struct {
+    unsigned long f[32];      /* f0 - f31                                           */
+    unsigned long fcsr;       /*              - float control and status register   */
+}hal_fpu_ctx_t;
+
 void HAL_SWITCH_TO(unsigned int** next);
 void HAL_CONTEXT_SWITCH(unsigned int **prev , unsigned int **next);
 unsigned int* hal_stack_init(unsigned int *stack, void *route, void *exit, void *args);
 
+/**
+ * @brief 把当前核的浮点寄存器存到ctx
+ * 
+ * @param ctx 浮点上下文
+ */
+void hal_fpu_save(hal_fpu_ctx_t *ctx);
+
+/**
+ * @brief 从ctx恢复当前核的浮点寄存器
+ * 
+ * @param ctx 浮点上下文
+ */
+void hal_fpu_restore(hal_fpu_ctx_t *ctx);
+
+/**
+ * @brief 线程切换时的FPU懒惰处理：换下的线程改过浮点寄存器（mstatus.FS为Dirty）才保存；
+ *        换上的线程如果就是本核浮点寄存器的主人，FS置Clean直接用，否则置Off，第一次用浮点指令时再恢复
+ * @note 在内核锁内、切栈之前调用
+ * 
+ * @param prev 换下线程的浮点上下文，不需要保存时传NULL
+ * @param next 换上线程的浮点上下文
+ * @param next_stack 换上线程的栈指针，指向它的hal_ctx_t现场
+ */
+void hal_fpu_switch(hal_fpu_ctx_t *prev, hal_fpu_ctx_t *next, unsigned int *next_stack);
+
+/**
+ * @brief 浮点上下文不再使用（线程退出或TCB重新分配）时调用，清掉各核对它的缓存
+ * 
+ * @param ctx 浮点上下文
+ */
+void hal_fpu_release(hal_fpu_ctx_t *ctx);
+
 //线程相关的硬件抽象接口 //TODO 全大写为了和汇编接口统一
 #define HAL_STACK_INIT(stack,route,exit,args) hal_stack_init(stack, route,exit, args)
+#define HAL_FPU_SWITCH(prev,next,next_stack) hal_fpu_switch(prev,next,next_stack)
+#define HAL_FPU_RELEASE(ctx) hal_fpu_release(ctx)
 
 #endif
\ No newline at end of file
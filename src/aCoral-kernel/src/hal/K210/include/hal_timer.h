@@ -15,6 +15,18 @@
 #ifndef HAL_TIMER_H
 #define HAL_TIMER_H
 
+#include "encoding.h"
+
+///读取当前核的mcycle周期计数器，用于测量调度等热路径的开销
+#define HAL_GET_CYCLES()    read_cycle()
+///HAL_GET_CYCLES的计数单位，基准测试输出时使用
+#define HAL_CYCLES_UNIT     "cycle"
+
+#define HAL_TICKLESS_ENTER(nticks)  hal_timer_tickless_enter(nticks)
+#define HAL_TICKLESS_EXIT()         hal_timer_tickless_exit()
+///等待中断，即使mstatus.MIE为0，mie中使能的中断到来也会唤醒
+#define HAL_WAIT_FOR_INTR()         __asm__ __volatile__("wfi")
+
 /**
  * @brief 配置ticks定时器的频率,打开其中断，并为其注册中断服务函数acoral_ticks_entry
  * 
@@ -25,4 +37,22 @@
  */
 int hal_timer_init(int ticks_per_sec, void (*ticks_entry)(void *args), void* args);
 
+/**
+ * @brief 进入tickless睡眠前，把当前核的mtimecmp推迟到nticks个tick之后
+ * @note 必须在关中断的情况下调用，之后执行HAL_WAIT_FOR_INTR，醒来后仍在关中断时调用hal_timer_tickless_exit
+ * 
+ * @param nticks 睡眠的tick数，第nticks个tick边界到来时唤醒
+ * @return int 成功返回0；已经有tick中断挂起时返回-1，此时不应睡眠
+ */
+int hal_timer_tickless_enter(unsigned int nticks);
+
+/**
+ * @brief tickless睡眠醒来后，恢复mtimecmp到正常的tick节拍上
+ * @note 睡眠期间跨过的最后一个tick边界留给ticks中断自己处理（开中断后立刻进入），
+ *       返回值是在它之前跨过、需要由软件补上的tick数
+ * 
+ * @return unsigned int 需要调用acoral_ticks_announce补上的tick数
+ */
+unsigned int hal_timer_tickless_exit(void);
+
 #endif
\ No newline at end of file
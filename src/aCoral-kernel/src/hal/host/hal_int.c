@@ -0,0 +1,179 @@
+/**
+ * @file hal_int.c
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief hal层，Linux主机替身的中断、临界区
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ * @revisionHistory
+ *  <table>
+ *   <tr><th> 版本 <th>作者 <th>日期 <th>修改内容
+ *   <tr><td> 1.0 <td>王彬浩 <td> 2026-10-17 <td>Created
+ *  </table>
+ */
+
+#include "./include/hal_int.h"
+#include "./include/hal_thread.h"
+#include "thread.h"
+#include "int.h"
+#include <signal.h>
+#include <ucontext.h>
+
+///中断嵌套数
+int acoral_intr_nestings[CFG_MAX_CPU];
+
+static int crit_nesting;			///<临界区嵌套层数
+static unsigned long crit_mie;		///<进入最外层临界区之前是否允许中断
+static sigset_t intr_signals;		///<当作中断的信号
+static void (*soft_intr_isr)(void);	///<软件中断服务程序
+
+static void soft_intr_entry(void *args)
+{
+	(void)args;
+	if (soft_intr_isr)
+		soft_intr_isr();
+}
+
+static void soft_intr_handler(int sig)
+{
+	(void)sig;
+	hal_intr_dispatch(soft_intr_entry, NULL);
+}
+
+void hal_intr_init(){
+	struct sigaction sa;
+
+	sigemptyset(&intr_signals);
+	sigaddset(&intr_signals, SIGALRM);
+	sigaddset(&intr_signals, SIGUSR1);
+
+	/*处理期间屏蔽全部中断信号，相当于进中断时硬件关MIE*/
+	sa.sa_handler = soft_intr_handler;
+	sa.sa_mask = intr_signals;
+	sa.sa_flags = SA_RESTART;
+	sigaction(SIGUSR1, &sa, NULL);
+}
+
+void hal_intr_enable(){
+	sigprocmask(SIG_UNBLOCK, &intr_signals, NULL);
+}
+
+void hal_intr_disable(){
+	sigprocmask(SIG_BLOCK, &intr_signals, NULL);
+}
+
+unsigned long hal_intr_save(){
+	sigset_t old;
+	sigprocmask(SIG_BLOCK, &intr_signals, &old);
+	return !sigismember(&old, SIGALRM);
+}
+
+void hal_intr_restore(unsigned long mie){
+	if (mie)
+		sigprocmask(SIG_UNBLOCK, &intr_signals, NULL);
+}
+
+int hal_intr_attach(int vector, void (*isr)(int)){
+	(void)vector;
+	(void)isr;
+	return -1;
+}
+
+void hal_intr_detach(int vector){
+	(void)vector;
+}
+
+int hal_intr_unmask(int vector){
+	(void)vector;
+	return -1;
+}
+
+int hal_intr_mask(int vector){
+	(void)vector;
+	return -1;
+}
+
+void hal_intr_nesting_dec_comm()
+{
+	if (acoral_intr_nestings[0] > 0 && --acoral_intr_nestings[0] == 0)
+	{
+#if CFG_THREAD_STATS
+		acoral_stat_intr_exit();
+#endif
+	}
+}
+
+void hal_intr_nesting_inc_comm()
+{
+	if (acoral_intr_nestings[0]++ == 0)
+	{
+#if CFG_THREAD_STATS
+		acoral_stat_intr_enter();
+#endif
+	}
+}
+
+void hal_intr_dispatch(void (*isr)(void *args), void *args)
+{
+	unsigned long old_sp, next_sp;
+
+	HAL_INTR_NESTING_INC();
+	isr(args);
+	HAL_INTR_NESTING_DEC();
+
+	/*线程的stack始终指向它栈顶的hal_ctx_t，在信号处理函数里直接swapcontext，换回来时从这里返回再由sigreturn恢复被中断的现场*/
+	old_sp = (unsigned long)acoral_cur_thread->stack;
+	next_sp = acoral_intr_exit(old_sp);
+	if (next_sp != old_sp)
+		swapcontext(&((hal_ctx_t *)old_sp)->uc, &((hal_ctx_t *)next_sp)->uc);
+}
+
+void hal_sched_bridge_comm()
+{
+	HAL_ENTER_CRITICAL();
+	acoral_real_sched();
+	HAL_EXIT_CRITICAL();
+}
+
+unsigned long hal_intr_exit_bridge_comm(unsigned long old_sp)
+{
+	HAL_ENTER_CRITICAL();
+	unsigned long next_sp = acoral_real_intr_sched(old_sp);
+	HAL_EXIT_CRITICAL();
+	return next_sp;
+}
+
+void hal_enter_critical(){
+	unsigned long mie = HAL_INTR_SAVE();
+
+	if (crit_nesting++ == 0)
+		crit_mie = mie;
+}
+
+void hal_exit_critical(){
+	if (crit_nesting == 0)
+		return;
+	if (--crit_nesting == 0)
+		HAL_INTR_RESTORE(crit_mie);
+}
+
+int hal_crit_save(unsigned long *mie){
+	*mie = crit_mie;
+	return crit_nesting;
+}
+
+void hal_crit_restore(int nesting, unsigned long mie){
+	crit_nesting = nesting;
+	crit_mie = mie;
+}
+
+void hal_switch_finish(){
+}
+
+void hal_soft_intr_attach(void (*isr)(void)){
+	soft_intr_isr = isr;
+}
+
+void hal_soft_intr_trigger(){
+	raise(SIGUSR1);
+}
@@ -0,0 +1,62 @@
+/**
+ * @file hal_thread.c
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief hal层，Linux主机替身的线程上下文，基于ucontext
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ * @revisionHistory
+ *  <table>
+ *   <tr><th> 版本 <th>作者 <th>日期 <th>修改内容
+ *   <tr><td> 1.0 <td>王彬浩 <td> 2026-10-17 <td>Created
+ *  </table>
+ */
+
+#include "./include/hal_thread.h"
+#include "autocfg.h"
+#include <stdint.h>
+#include <signal.h>
+#include <stddef.h>
+
+#define ACORAL_ALIGN_DOWN(size, align)      ((size) & ~((align) - 1))
+
+///makecontext的入口只能收int参数，上下文指针拆成两半传
+static void thread_entry(unsigned int hi, unsigned int lo)
+{
+    hal_ctx_t *ctx = (hal_ctx_t *)(((uintptr_t)hi << 32) | lo);
+    ctx->route(ctx->args);
+    ctx->exit();
+}
+
+unsigned int* hal_stack_init(unsigned int *stack, void *route, void *exit, void *args)
+{
+    hal_ctx_t *ctx;
+    uintptr_t top = ACORAL_ALIGN_DOWN((uintptr_t)stack + sizeof(unsigned int), 16);
+    uintptr_t span = CFG_MIN_STACK_SIZE - ACORAL_ALIGN_DOWN(sizeof(hal_ctx_t) + 32, 16);
+
+    ctx = (hal_ctx_t *)ACORAL_ALIGN_DOWN(top - sizeof(hal_ctx_t), 16);
+    ctx->route = (void (*)(void *))route;
+    ctx->exit = (void (*)(void))exit;
+    ctx->args = args;
+
+    getcontext(&ctx->uc);
+    /*线程栈至少有CFG_MIN_STACK_SIZE，makecontext只用ss_sp+ss_size当初始栈顶*/
+    ctx->uc.uc_stack.ss_sp = (char *)ctx - span;
+    ctx->uc.uc_stack.ss_size = span;
+    ctx->uc.uc_link = NULL;
+    /*新线程开着中断开始运行，和K210上MPIE=1一样*/
+    sigemptyset(&ctx->uc.uc_sigmask);
+    makecontext(&ctx->uc, (void (*)(void))thread_entry, 2,
+                (unsigned int)((uintptr_t)ctx >> 32), (unsigned int)(uintptr_t)ctx);
+    return (unsigned int *)ctx;
+}
+
+void HAL_SWITCH_TO(unsigned int **next)
+{
+    setcontext(&((hal_ctx_t *)*next)->uc);
+}
+
+void HAL_CONTEXT_SWITCH(unsigned int **prev, unsigned int **next)
+{
+    swapcontext(&((hal_ctx_t *)*prev)->uc, &((hal_ctx_t *)*next)->uc);
+}
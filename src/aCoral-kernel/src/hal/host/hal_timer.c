@@ -0,0 +1,57 @@
+/**
+ * @file hal_timer.c
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief hal层，Linux主机替身的ticks定时器
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ * @revisionHistory
+ *  <table>
+ *   <tr><th> 版本 <th>作者 <th>日期 <th>修改内容
+ *   <tr><td> 1.0 <td>王彬浩 <td> 2026-10-17 <td>Created
+ *  </table>
+ */
+
+#include "./include/hal_timer.h"
+#include "./include/hal_int.h"
+#include <signal.h>
+#include <sys/time.h>
+#include <time.h>
+
+static void (*ticks_isr)(void *args);
+static void *ticks_args;
+
+static void ticks_handler(int sig)
+{
+	(void)sig;
+	hal_intr_dispatch(ticks_isr, ticks_args);
+}
+
+unsigned long hal_get_cycles(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long)ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+int hal_timer_init(int ticks_per_sec, void (*ticks_entry)(void *args), void *args){
+	struct sigaction sa;
+	struct itimerval it;
+
+	ticks_isr = ticks_entry;
+	ticks_args = args;
+
+	sa.sa_handler = ticks_handler;
+	sigemptyset(&sa.sa_mask);
+	sigaddset(&sa.sa_mask, SIGALRM);
+	sigaddset(&sa.sa_mask, SIGUSR1);
+	sa.sa_flags = SA_RESTART;
+	if (sigaction(SIGALRM, &sa, NULL))
+		return -1;
+
+	it.it_interval.tv_sec = 0;
+	it.it_interval.tv_usec = 1000000 / ticks_per_sec;
+	it.it_value = it.it_interval;
+	if (setitimer(ITIMER_REAL, &it, NULL))
+		return -1;
+	return 0;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file hal_int.h
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief hal层，Linux主机替身的中断相关头文件
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ * @revisionHistory
+ *  <table>
+ *   <tr><th> 版本 <th>作者 <th>日期 <th>修改内容
+ *   <tr><td> 1.0 <td>王彬浩 <td> 2026-10-17 <td>Created
+ *  </table>
+ * @note 用信号模拟中断：SIGALRM是ticks中断，SIGUSR1是软件中断；
+ *       信号屏蔽字就是“中断使能位”，跟着ucontext一起保存、恢复
+ */
+#ifndef HAL_INT_H
+#define HAL_INT_H
+
+#include "autocfg.h"
+
+#define HAL_INTR_ENABLE()     hal_intr_enable()
+#define HAL_INTR_DISABLE()    hal_intr_disable()
+#define HAL_INTR_SAVE()       hal_intr_save()       ///<屏蔽中断信号，返回之前是否允许中断
+#define HAL_INTR_RESTORE(mie) hal_intr_restore(mie)
+
+#define HAL_GET_CURRENT_CPU() (0)
+
+///中断嵌套数
+extern int acoral_intr_nestings[CFG_MAX_CPU];
+#define acoral_intr_nesting (acoral_intr_nestings[HAL_GET_CURRENT_CPU()])
+
+/**
+ * @brief 初始化中断信号
+ *
+ */
+void hal_intr_init();
+
+/**
+ * @brief 开启全局中断，即解除中断信号的屏蔽
+ *
+ */
+void hal_intr_enable();
+
+/**
+ * @brief 关闭全局中断，即屏蔽中断信号
+ *
+ */
+void hal_intr_disable();
+
+/**
+ * @brief 屏蔽中断信号
+ *
+ * @return unsigned long 之前允许中断返回1，否则返回0
+ */
+unsigned long hal_intr_save(void);
+
+/**
+ * @brief mie不为0时解除中断信号的屏蔽，和K210一样只开不关
+ *
+ * @param mie hal_intr_save的返回值
+ */
+void hal_intr_restore(unsigned long mie);
+
+/**
+ * @brief 主机上没有外部中断，总是失败
+ *
+ * @return int -1
+ */
+int hal_intr_attach(int vector, void (*isr)(int));
+void hal_intr_detach(int vector);
+int hal_intr_unmask(int vector);
+int hal_intr_mask(int vector);
+
+/**
+ * @brief 中断信号的公共处理：嵌套计数、执行服务程序，退出时按需切换线程
+ *
+ * @param isr 中断服务程序
+ * @param args 服务程序参数
+ */
+void hal_intr_dispatch(void (*isr)(void *args), void *args);
+
+void hal_intr_nesting_dec_comm();
+void hal_intr_nesting_inc_comm();
+void hal_sched_bridge_comm();
+unsigned long hal_intr_exit_bridge_comm(unsigned long old_sp);
+void hal_enter_critical(void);
+void hal_exit_critical(void);
+int hal_crit_save(unsigned long *mie);
+void hal_crit_restore(int nesting, unsigned long mie);
+void hal_switch_finish(void);
+
+/**
+ * @brief 注册软件中断（SIGUSR1）的服务程序
+ *
+ * @param isr 中断服务程序，NULL表示注销
+ */
+void hal_soft_intr_attach(void (*isr)(void));
+
+/**
+ * @brief 触发一次软件中断，没有屏蔽时返回前服务程序已经执行完
+ *
+ */
+void hal_soft_intr_trigger(void);
+
+#define HAL_INTR_NESTING_DEC()    hal_intr_nesting_dec_comm()
+#define HAL_INTR_NESTING_INC()    hal_intr_nesting_inc_comm()
+
+#define HAL_INTR_ATTACH(vector,isr) hal_intr_attach(vector,isr)
+#define HAL_INTR_DETACH(vector) hal_intr_detach(vector)
+#define HAL_INTR_UNMASK(vector) hal_intr_unmask(vector)
+#define HAL_INTR_MASK(vector) hal_intr_mask(vector)
+#define HAL_SCHED_BRIDGE() hal_sched_bridge_comm()
+#define HAL_INTR_EXIT_BRIDGE(sp) hal_intr_exit_bridge_comm(sp)
+
+#define HAL_ENTER_CRITICAL() hal_enter_critical()
+#define HAL_EXIT_CRITICAL() hal_exit_critical()
+#define HAL_CRIT_SAVE(mie) hal_crit_save(mie)
+#define HAL_CRIT_RESTORE(nesting,mie) hal_crit_restore(nesting,mie)
+
+#define HAL_SOFT_INTR_ATTACH(isr) hal_soft_intr_attach(isr)
+#define HAL_SOFT_INTR_TRIGGER() hal_soft_intr_trigger()
+
+#endif
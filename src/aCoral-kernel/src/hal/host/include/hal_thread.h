@@ -0,0 +1,45 @@
+/**
+ * @file hal_thread.h
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief hal层，Linux主机替身的线程相关头文件
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ * @revisionHistory
+ *  <table>
+ *   <tr><th> 版本 <th>作者 <th>日期 <th>修改内容
+ *   <tr><td> 1.0 <td>王彬浩 <td> 2026-10-17 <td>Created
+ *  </table>
+ */
+
+#ifndef HAL_THREAD_H
+#define HAL_THREAD_H
+
+#include <ucontext.h>
+
+/**
+ * @brief 线程上下文，放在线程栈顶，线程的stack指针一直指向它
+ */
+typedef struct {
+    ucontext_t uc;                  ///<寄存器、浮点和信号屏蔽字（中断使能）
+    void (*route)(void *args);      ///<线程函数
+    void (*exit)(void);             ///<线程函数返回后调用
+    void *args;                     ///<线程函数参数
+}hal_ctx_t;
+
+/**
+ * @brief 浮点寄存器由ucontext保存，这里只占位
+ */
+typedef struct {
+    char unused;
+}hal_fpu_ctx_t;
+
+void HAL_SWITCH_TO(unsigned int** next);
+void HAL_CONTEXT_SWITCH(unsigned int **prev , unsigned int **next);
+unsigned int* hal_stack_init(unsigned int *stack, void *route, void *exit, void *args);
+
+#define HAL_STACK_INIT(stack,route,exit,args) hal_stack_init(stack, route,exit, args)
+#define HAL_FPU_SWITCH(prev,next,next_stack)
+#define HAL_FPU_RELEASE(ctx)
+
+#endif
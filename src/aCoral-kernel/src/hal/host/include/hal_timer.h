@@ -0,0 +1,44 @@
+/**
+ * @file hal_timer.h
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief hal层，Linux主机替身的定时器头文件
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ * @revisionHistory
+ *  <table>
+ *   <tr><th> 版本 <th>作者 <th>日期 <th>修改内容
+ *   <tr><td> 1.0 <td>王彬浩 <td> 2026-10-17 <td>Created
+ *  </table>
+ */
+
+#ifndef HAL_TIMER_H
+#define HAL_TIMER_H
+
+///主机上没有mcycle，用单调时钟的纳秒数代替
+#define HAL_GET_CYCLES()    hal_get_cycles()
+///HAL_GET_CYCLES的计数单位，基准测试输出时使用
+#define HAL_CYCLES_UNIT     "ns"
+
+#define HAL_TICKLESS_ENTER(nticks)  (-1)
+#define HAL_TICKLESS_EXIT()         (0)
+#define HAL_WAIT_FOR_INTR()
+
+/**
+ * @brief 读取单调时钟
+ *
+ * @return unsigned long 纳秒数
+ */
+unsigned long hal_get_cycles(void);
+
+/**
+ * @brief 用setitimer产生ticks_per_sec频率的SIGALRM，作为ticks中断
+ *
+ * @param ticks_per_sec 每秒的ticks中断数
+ * @return result
+ *     - 0      Success
+ *     - Other  Fail
+ */
+int hal_timer_init(int ticks_per_sec, void (*ticks_entry)(void *args), void* args);
+
+#endif
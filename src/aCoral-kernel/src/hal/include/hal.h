@@ -28,6 +28,14 @@
 #define hal_sp_align 16 
 
 #elif CFG_SOC == SOC_S3C2440 
+
+/* Linux主机上的HAL替身 */
+#elif CFG_SOC == SOC_HOST
+#include "../host/include/hal_int.h"
+#include "../host/include/hal_thread.h"
+#include "../host/include/hal_timer.h"
+
+#define hal_sp_align 16 
 #endif
 
 
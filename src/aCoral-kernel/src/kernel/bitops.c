@@ -9,35 +9,26 @@
 
 #include "bitops.h" 
 
+const unsigned char acoral_debruijn_ctz32[32] = {
+    0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+    31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+};
+
+const unsigned char acoral_debruijn_log2_32[32] = {
+    0, 9, 1, 10, 13, 21, 2, 29, 11, 14, 16, 18, 22, 25, 3, 30,
+    8, 12, 20, 28, 15, 17, 24, 7, 19, 27, 23, 6, 26, 5, 4, 31
+};
+
 unsigned int acoral_find_first_bit_in_integer(unsigned int word, int bit)
 {
-    if(bit)
+    if(!bit)
     {
-        if (word == 0) {
-            return -1;  // 特殊情况：所有位都是0
-        }
-        unsigned int k = 31;
-	    if (word & 0x0000ffff) { k -= 16; word <<= 16; }
-	    if (word & 0x00ff0000) { k -= 8;  word <<= 8;  }
-	    if (word & 0x0f000000) { k -= 4;  word <<= 4;  }
-	    if (word & 0x30000000) { k -= 2;  word <<= 2;  }
-	    if (word & 0x40000000) { k -= 1; }
-        return k;
+        word = ~word; // 找0就是在取反后的整型数里找1
     }
-    else
-    {
-        if (word == 0xFFFFFFFF) {
-            return -1;  // 特殊情况：所有位都是1
-        }
-        unsigned int k = 31;
-	    if ((word & 0x0000ffff) != 0xffff) { k -= 16; word <<= 16; }
-	    if ((word & 0x00ff0000) != 0xff0000) { k -= 8;  word <<= 8;  }
-	    if ((word & 0x0f000000) != 0xf000000) { k -= 4;  word <<= 4;  }
-	    if ((word & 0x30000000) != 0x30000000) { k -= 2;  word <<= 2;  }
-	    if ((word & 0x40000000) != 0x40000000) { k -= 1; }
-        return k;
+    if (word == 0) {
+        return -1;  // 特殊情况：没有要找的位
     }
-	
+    return acoral_ffs32(word);
 }
 
 unsigned int acoral_find_first_bit_in_array(const unsigned int *b,unsigned int length, int bit)
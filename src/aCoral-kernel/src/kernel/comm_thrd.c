@@ -28,6 +28,7 @@ static void comm_thread_exit(){
  */
 static int comm_policy_thread_init(acoral_thread_t *thread, void *data)
 {
+	(void)data;
 	if (thread_stack_init(thread, comm_thread_exit) != 0)
 	{
 		ACORAL_LOG_ERROR("No thread stack:%s", thread->name);
@@ -11,7 +11,11 @@
 #include "hal.h"
 
 #include <stdlib.h>
-int daemon_id, idle_id, init_id;
+int idle_id, init_id;
+
+#ifdef CFG_SMP
+static volatile int secondary_cpu_go = 0; ///<主核把系统线程都建好之后置1，从核才能开始调度
+#endif
 
 char* logo = "\n\
               \n\
@@ -35,7 +39,13 @@ extern void user_main();
  */
 static void idle()
 {
-	for(;;){}
+	for(;;){
+#if CFG_TICKLESS
+		/*tick只在0号核上产生，idle线程在哪个核上都可能运行，只有0号核能停tick*/
+		if (acoral_current_cpu() == 0)
+			acoral_tickless_idle();
+#endif
+	}
 }
 
 /**
@@ -53,9 +63,6 @@ static void init()
     /* 初始化全局超时队列 */
 	acoral_init_list(&(((timer_res_private_data*)(acoral_res_system.system_res_ctrl_container[ACORAL_RES_TIMER].type_private_data))->global_timeout_queue));
     
-    /* 初始化daem线程回收的线程队列 */
-	acoral_init_list(&(((thread_res_private_data*)(acoral_res_system.system_res_ctrl_container[ACORAL_RES_THREAD].type_private_data))->global_daem_release_queue));
-
 	if(system_ticks_init()!=0){
 		ACORAL_LOG_ERROR("Ticks Init Failed");
 		exit(1);
@@ -74,49 +81,7 @@ static void init()
 }
 
 /**
- * @brief aCoral资源回收线程daem函数
- *
- */
-static void daem()
-{
-	acoral_thread_t *thread;
-	acoral_list_t *head, *tmp, *tmp1;
-    acoral_list_t* daem_res_release_queue = &(((thread_res_private_data*)(acoral_res_system.system_res_ctrl_container[ACORAL_RES_THREAD].type_private_data))->global_daem_release_queue); ///< 将被daem线程回收的线程队列
-
-	head = daem_res_release_queue;
-	while (1)
-	{
-		for (tmp = head->next; tmp != head;)
-		{
-			tmp1 = tmp->next;
-			acoral_enter_critical();
-			thread = list_entry(tmp, acoral_thread_t, daem_hook);
-
-			/* 如果线程资源已经不再使用，即release状态，则释放 */
-			acoral_list_del(tmp);
-			acoral_exit_critical();
-			tmp = tmp1;
-			if (thread->state == ACORAL_THREAD_STATE_RELEASE)
-			{
-				ACORAL_LOG_INFO("Daem is Cleaning Thread: %s",thread->name);
-				system_policy_thread_release(thread);
-  				acoral_free((void *)thread->stack_buttom);
-				acoral_release_res((acoral_res_t *)thread);
-			}
-			else
-			{
-				acoral_enter_critical();
-				tmp1 = head->prev;
-				acoral_list_add2_tail(&thread->daem_hook, head); /**/
-				acoral_exit_critical();
-			}
-		}
-		acoral_suspend_self();
-	}
-}
-
-/**
- * @brief 主CPU创建idle、init、daem线程
+ * @brief 主CPU创建idle、init线程
  * 
  */
 static void main_cpu_start()
@@ -138,19 +103,44 @@ static void main_cpu_start()
 		exit(2);
 	}
 
-	/* 创建daem线程 */
-	daemon_id = acoral_create_thread("daemon",daem, NULL, DAEM_STACK_SIZE, ACORAL_SCHED_POLICY_COMM, ACORAL_DAEMON_PRIO,ACORAL_HARD_PRIO,NULL);
-	if (daemon_id == -1){
-		ACORAL_LOG_ERROR("Create Daem Thread Failed");
-		exit(2);
-	}	
+#ifdef CFG_SMP
+	/* 每个核各有一个idle线程，保证任何核总能选出线程 */
+	for (int cpu = 1; cpu < CFG_MAX_CPU; cpu++)
+	{
+		int id = acoral_create_thread("idle1",idle, NULL, IDLE_STACK_SIZE, ACORAL_SCHED_POLICY_COMM, ACORAL_IDLE_PRIO,ACORAL_HARD_PRIO,NULL);
+		if (id == -1)
+		{
+			ACORAL_LOG_ERROR("Create Idle Thread Failed");
+			exit(2);
+		}
+		/* idle线程固定在各自的核上，它们的优先级不会被偷 */
+		acoral_enter_critical();
+		acoral_rdyqueue_migrate((acoral_thread_t *)acoral_get_res_by_id(id), cpu);
+		acoral_exit_critical();
+	}
+	HAL_IPI_INIT();
+#endif
 	printf("%s",logo);
 
 	system_sched_locked = false;
-	system_need_sched = false; 
-	system_set_running_thread(acoral_select_thread());
-	HAL_SWITCH_TO(&acoral_cur_thread->stack);
+#ifdef CFG_SMP
+	secondary_cpu_go = 1;
+#endif
+	acoral_start_sched();
+}
+
+#ifdef CFG_SMP
+void acoral_secondary_cpu_start()
+{
+	/* 从核被唤醒时已经开了中断，开始调度之前先关掉 */
+	HAL_INTR_SAVE();
+	while (!secondary_cpu_go)
+		;
+	ACORAL_LOG_TRACE("Core %u Start Sched", acoral_current_cpu());
+	HAL_IPI_INIT();
+	acoral_start_sched();
 }
+#endif
 
 void system_start()
 {
@@ -1,4 +1,19 @@
+/**
+ * @file dag.c
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief kernel层，DAG任务图执行器
+ * @version 2.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ */
 #include "dag.h"
+#include "sem.h"
+#include "int.h"
+#include "log.h"
+
+#include <stdio.h>
+
+#if CFG_THRD_DAG
 
 acoral_dag_t dag_global;
 
@@ -6,37 +21,381 @@ int dag_init(){
     for(int i = 0;i<CFG_DAG_SIZE;i++){
         for(int j = 0;j<CFG_DAG_SIZE;j++){
             dag_global.edges[i][j] = 0;
+            dag_global.tokens[i][j] = 0;
         }
+        dag_global.nodes[i].valid = 0;
     }
     dag_global.node_num = 0;
+    dag_global.started = 0;
+    dag_global.frames_done = 0;
+    dag_global.inflight = NULL;
+    return ACORAL_DAG_SUCCESS;
+}
+
+static int dag_node_valid(int node){
+    return node >= 0 && node < CFG_DAG_SIZE && dag_global.nodes[node].valid;
 }
 
 int dag_add_node(void (*route)(void *args),int core_id, void* input, void* output){
-    // if(dag_global.num>=10){
-    //     return ACORAL_DAG_NODE_FULL;
-    // }
-    // acoral_create_thread(func,1024,input,"DAG##")
-    // acoral_thread_t* tcb = (acoral_thread_t *)acoral_get_res_by_id(tid);
-    // if(tcb == NULL){
-    //     return ACORAL_DAG_NODE_THREAD_NULL;
-    // }
-    // dag_global.nodes[dag_global.num] = (node){
-    //     tid,
-    //     tcb,
-    //     0
-    // };
-    // return dag_global.num++;
+    int i;
+    acoral_dag_node *node;
+    if(dag_global.started){
+        return ACORAL_DAG_STARTED;
+    }
+    if(route == NULL){
+        return ACORAL_DAG_NODE_THREAD_NULL;
+    }
+    if(core_id != ACORAL_DAG_ANY_CORE && (core_id < 0 || core_id >= CFG_MAX_CPU)){
+        return ACORAL_DAG_CORE_NULL;
+    }
+    for(i = 0;i<CFG_DAG_SIZE;i++){
+        if(!dag_global.nodes[i].valid)
+            break;
+    }
+    if(i>=CFG_DAG_SIZE){
+        return ACORAL_DAG_NODE_FULL;
+    }
+    node = &dag_global.nodes[i];
+    node->nid = i;
+    node->tid = -1;
+    node->tcb = NULL;
+    node->former_task_num = 0;
+    node->former_task_num_origin = 0;
+    node->core_id = core_id;
+    node->valid = 1;
+    snprintf(node->name, sizeof(node->name), "DAG%d", i);
+    node->route = route;
+    node->input = input;
+    node->output = output;
+    node->weight = 1;
+    node->rank = 0;
+    node->prio = 0;
+    node->runs = 0;
+    node->sem = NULL;
+    dag_global.node_num++;
+    return i;
+}
+
+int dag_set_node_weight(int node, unsigned int weight){
+    if(!dag_node_valid(node)){
+        return ACORAL_DAG_NODE_NULL;
+    }
+    dag_global.nodes[node].weight = weight;
+    return ACORAL_DAG_SUCCESS;
+}
+
+int dag_delete_node(int node){
+    if(dag_global.started){
+        return ACORAL_DAG_STARTED;
+    }
+    if(!dag_node_valid(node)){
+        return ACORAL_DAG_NODE_NULL;
+    }
+    for(int i = 0;i<CFG_DAG_SIZE;i++){
+        dag_global.edges[node][i] = 0;
+        dag_global.edges[i][node] = 0;
+    }
+    dag_global.nodes[node].valid = 0;
+    dag_global.node_num--;
+    return ACORAL_DAG_SUCCESS;
 }
 
 int dag_add_edge(int start, int end){
     if((start<0)||(start>=CFG_DAG_SIZE)||(end<0)||(end>=CFG_DAG_SIZE)){
         return ACORAL_DAG_EDGE_NULL;
     }
+    if(dag_global.started){
+        return ACORAL_DAG_STARTED;
+    }
+    if(!dag_global.nodes[start].valid || !dag_global.nodes[end].valid){
+        return ACORAL_DAG_NODE_NULL;
+    }
     dag_global.edges[start][end] = 1;
     return ACORAL_DAG_EDGE_SUCCESS;
 }
 
+int dag_delete_edge(int start, int end){
+    if((start<0)||(start>=CFG_DAG_SIZE)||(end<0)||(end>=CFG_DAG_SIZE)){
+        return ACORAL_DAG_EDGE_NULL;
+    }
+    if(dag_global.started){
+        return ACORAL_DAG_STARTED;
+    }
+    dag_global.edges[start][end] = 0;
+    return ACORAL_DAG_EDGE_SUCCESS;
+}
+
+/**
+ * @brief Kahn算法拓扑排序
+ * 
+ * @param order 输出拓扑序，长度至少为CFG_DAG_SIZE
+ * @return int 排进拓扑序的节点数，小于node_num说明有环
+ */
+static int dag_topo_sort(int *order){
+    int indegree[CFG_DAG_SIZE];
+    int head = 0, tail = 0;
+    int i, j;
+
+    for(j = 0;j<CFG_DAG_SIZE;j++){
+        indegree[j] = 0;
+        if(!dag_global.nodes[j].valid)
+            continue;
+        for(i = 0;i<CFG_DAG_SIZE;i++){
+            if(dag_global.edges[i][j] && dag_global.nodes[i].valid)
+                indegree[j]++;
+        }
+        if(indegree[j] == 0)
+            order[tail++] = j;
+    }
+    /*order同时充当队列，head之前是已经出队的节点*/
+    while(head < tail){
+        i = order[head++];
+        for(j = 0;j<CFG_DAG_SIZE;j++){
+            if(dag_global.edges[i][j] && dag_global.nodes[j].valid && --indegree[j] == 0)
+                order[tail++] = j;
+        }
+    }
+    return tail;
+}
+
+int dag_check_cycle(){
+    int order[CFG_DAG_SIZE];
+    if(dag_topo_sort(order) < dag_global.node_num){
+        return ACORAL_DAG_CYCLE;
+    }
+    return ACORAL_DAG_SUCCESS;
+}
+
+/**
+ * @brief 按关键路径分配优先级：逆拓扑序计算rank，rank越大优先级越高
+ * 
+ * @param order 拓扑序
+ * @param num 节点数
+ */
+static void dag_assign_prio(int *order, int num){
+    int i, j, k, tmp;
+    unsigned int longest;
+    acoral_dag_node *node;
+
+    for(k = num - 1;k >= 0;k--){
+        i = order[k];
+        node = &dag_global.nodes[i];
+        longest = 0;
+        for(j = 0;j<CFG_DAG_SIZE;j++){
+            if(dag_global.edges[i][j] && dag_global.nodes[j].valid && dag_global.nodes[j].rank > longest)
+                longest = dag_global.nodes[j].rank;
+        }
+        node->rank = node->weight + longest;
+    }
+    /*按rank降序稳定排序（插入排序，节点数很少），rank相同的保持拓扑序*/
+    for(k = 1;k < num;k++){
+        tmp = order[k];
+        for(j = k - 1;j >= 0 && dag_global.nodes[order[j]].rank < dag_global.nodes[tmp].rank;j--)
+            order[j + 1] = order[j];
+        order[j + 1] = tmp;
+    }
+    for(k = 0;k < num;k++){
+        dag_global.nodes[order[k]].prio = CFG_DAG_PRIO_BASE + k;
+    }
+}
+
+/**
+ * @brief 节点线程的主体：等待被释放、执行任务函数、通知后继，循环往复
+ * 
+ * @param args DAG节点指针
+ */
+static void dag_node_thread(void *args){
+    acoral_dag_node *node = (acoral_dag_node *)args;
+    for(;;){
+        acoral_sem_pend(node->sem, 0);
+        node->route(node->input);
+        acoral_dag_thread_exit();
+    }
+}
+
+/**
+ * @brief dag_start中途失败时回收已经创建的节点线程和信号量
+ * @note 节点线程此时都阻塞在自己的信号量上，还没有执行过任务函数
+ * 
+ */
+static void dag_unwind(){
+    acoral_dag_node *node;
+    for(int i = 0;i<CFG_DAG_SIZE;i++){
+        node = &dag_global.nodes[i];
+        if(!node->valid)
+            continue;
+        if(node->tcb != NULL){
+            acoral_kill_thread(node->tcb);
+            node->tcb = NULL;
+            node->tid = -1;
+        }
+        if(node->sem != NULL){
+            acoral_enter_critical();
+            acoral_release_res((acoral_res_t *)node->sem);
+            acoral_exit_critical();
+            node->sem = NULL;
+        }
+    }
+    if(dag_global.inflight != NULL){
+        acoral_enter_critical();
+        acoral_release_res((acoral_res_t *)dag_global.inflight);
+        acoral_exit_critical();
+        dag_global.inflight = NULL;
+    }
+}
+
+int dag_start(){
+    int order[CFG_DAG_SIZE];
+    int i, j, num;
+    acoral_dag_node *node;
+
+    if(dag_global.started){
+        return ACORAL_DAG_STARTED;
+    }
+    if(dag_global.node_num == 0){
+        return ACORAL_DAG_EMPTY;
+    }
+    num = dag_topo_sort(order);
+    if(num < dag_global.node_num){
+        ACORAL_LOG_ERROR("DAG has a cycle, %d of %d nodes sorted", num, dag_global.node_num);
+        return ACORAL_DAG_CYCLE;
+    }
+    dag_assign_prio(order, num);
+
+    dag_global.inflight = acoral_sem_create(CFG_DAG_PIPELINE_DEPTH);
+    if(dag_global.inflight == NULL){
+        return ACORAL_DAG_NODE_THREAD_NULL;
+    }
+    for(i = 0;i<CFG_DAG_SIZE;i++){
+        node = &dag_global.nodes[i];
+        if(!node->valid)
+            continue;
+        node->former_task_num_origin = 0;
+        for(j = 0;j<CFG_DAG_SIZE;j++){
+            dag_global.tokens[j][i] = 0;
+            if(dag_global.edges[j][i] && dag_global.nodes[j].valid)
+                node->former_task_num_origin++;
+        }
+        node->former_task_num = node->former_task_num_origin;
+        node->runs = 0;
+        node->tcb = NULL;
+        node->sem = acoral_sem_create(0);
+        if(node->sem == NULL){
+            dag_unwind();
+            return ACORAL_DAG_NODE_THREAD_NULL;
+        }
+    }
+    dag_global.frames_done = 0;
+    for(i = 0;i<CFG_DAG_SIZE;i++){
+        node = &dag_global.nodes[i];
+        if(!node->valid)
+            continue;
+        node->tid = acoral_create_thread(node->name, dag_node_thread, node, 0, ACORAL_SCHED_POLICY_COMM, node->prio, ACORAL_HARD_PRIO, NULL);
+        if(node->tid < 0){
+            ACORAL_LOG_ERROR("Create DAG Thread %s Failed", node->name);
+            dag_unwind();
+            return ACORAL_DAG_NODE_THREAD_NULL;
+        }
+        node->tcb = (acoral_thread_t *)acoral_get_res_by_id(node->tid);
+        /*线程先阻塞在自己的信号量上，第一次被释放之前挪到目标核*/
+        if(node->core_id != ACORAL_DAG_ANY_CORE)
+            acoral_thread_set_affinity(node->tid, ACORAL_CPU_MASK(node->core_id));
+        ACORAL_LOG_TRACE("DAG node %d: rank %u, prio %d", i, node->rank, node->prio);
+    }
+    dag_global.started = 1;
+    return ACORAL_DAG_SUCCESS;
+}
+
+int dag_trigger(){
+    acoral_dag_node *node;
+    if(!dag_global.started){
+        return ACORAL_DAG_NOT_STARTED;
+    }
+    /*流水线满了就等最早的一帧完成*/
+    acoral_sem_pend(dag_global.inflight, 0);
+    for(int i = 0;i<CFG_DAG_SIZE;i++){
+        node = &dag_global.nodes[i];
+        if(node->valid && node->former_task_num_origin == 0)
+            acoral_sem_post(node->sem);
+    }
+    return ACORAL_DAG_SUCCESS;
+}
+
+/**
+ * @brief 释放一个前驱都已完成的节点：每条入边消费一个令牌，重新统计还缺的前驱数
+ * @note 需要在关中断时调用
+ * 
+ * @param node DAG节点号
+ * @return int 该节点可以被释放的次数，入边上攒了多帧令牌时可能大于1
+ */
+static int dag_node_release(int node){
+    acoral_dag_node *n = &dag_global.nodes[node];
+    int times = 0;
+    while(n->former_task_num == 0){
+        times++;
+        for(int i = 0;i<CFG_DAG_SIZE;i++){
+            if(dag_global.edges[i][node] && dag_global.nodes[i].valid && --dag_global.tokens[i][node] == 0)
+                n->former_task_num++;
+        }
+    }
+    return times;
+}
+
 int acoral_dag_thread_exit(){
-    acoral_suspend_self();
+    acoral_dag_node *node = NULL;
+    int post[CFG_DAG_SIZE];
+    int i, frame_done = 0, is_sink = 1;
+    unsigned int min_runs = (unsigned int)-1;
+
+    for(i = 0;i<CFG_DAG_SIZE;i++){
+        if(dag_global.nodes[i].valid && dag_global.nodes[i].tcb == acoral_cur_thread){
+            node = &dag_global.nodes[i];
+            break;
+        }
+    }
+    if(node == NULL){
+        return ACORAL_DAG_NODE_NULL;
+    }
+
+    /*令牌计数在关中断下完成；信号量post内部会自己进出临界区，不能嵌套，放到后面做*/
+    acoral_enter_critical();
+    node->runs++;
+    for(i = 0;i<CFG_DAG_SIZE;i++){
+        post[i] = 0;
+        if(!dag_global.edges[node->nid][i] || !dag_global.nodes[i].valid)
+            continue;
+        is_sink = 0;
+        if(dag_global.tokens[node->nid][i]++ == 0 && --dag_global.nodes[i].former_task_num == 0)
+            post[i] = dag_node_release(i);
+    }
+    if(is_sink){
+        /*每个节点按帧序运行，所有出口节点完成次数的最小值就是完成的帧数*/
+        for(i = 0;i<CFG_DAG_SIZE;i++){
+            if(!dag_global.nodes[i].valid)
+                continue;
+            int j;
+            for(j = 0;j<CFG_DAG_SIZE;j++){
+                if(dag_global.edges[i][j] && dag_global.nodes[j].valid)
+                    break;
+            }
+            if(j == CFG_DAG_SIZE && dag_global.nodes[i].runs < min_runs)
+                min_runs = dag_global.nodes[i].runs;
+        }
+        if(min_runs > dag_global.frames_done){
+            dag_global.frames_done++;
+            frame_done = 1;
+        }
+    }
+    acoral_exit_critical();
+
+    for(i = 0;i<CFG_DAG_SIZE;i++){
+        while(post[i]--)
+            acoral_sem_post(dag_global.nodes[i].sem);
+    }
+    if(frame_done){
+        acoral_sem_post(dag_global.inflight);
+    }
+    return ACORAL_DAG_SUCCESS;
+}
 
-}
\ No newline at end of file
+#endif
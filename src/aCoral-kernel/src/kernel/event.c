@@ -25,6 +25,7 @@
 void acoral_evt_init(acoral_evt_t *evt)
 {
 	acoral_init_list(&evt->wait_queue);
+	acoral_init_list(&evt->owner_hook);
 }
 
 _Bool acoral_evt_queue_empty(acoral_evt_t *evt)
@@ -0,0 +1,267 @@
+/**
+ * @file heap.c
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief kernel层，统一堆，按大小把请求分给任意大小分配系统和伙伴系统，并统一统计
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ * @note 释放时不需要块头：地址落在TLSF内存池里且是TLSF已分配的块就还给TLSF，否则交给伙伴系统检查
+ */
+#include "heap.h"
+#include "mem.h"
+#include "int.h"
+#include "log.h"
+#include <stdio.h>
+#include <string.h>
+
+extern int _heap_start; ///< 堆内存起始地址，定义于链接脚本
+extern int _heap_end;	///< 堆内存结束地址，定义于链接脚本
+
+/**
+ * @brief 统一堆控制块
+ *
+ */
+static struct{
+	volatile unsigned char ready;   ///<伙伴系统和TLSF是否已经初始化
+	unsigned long in_use;           ///<还没有释放的内存
+	unsigned long peak;             ///<in_use的峰值
+	unsigned int allocs;            ///<分配成功的次数
+	unsigned int frees;             ///<释放的次数
+	unsigned int fails;             ///<分配失败的次数
+}heap_ctrl;
+
+void acoral_heap_init(void)
+{
+	if (heap_ctrl.ready)
+		return;
+	acoral_mem_init((unsigned int)(unsigned long)&_heap_start, (unsigned int)(unsigned long)&_heap_end); // 伙伴系统初始化
+	heap_ctrl.ready = 1; // TLSF初始化失败时打印日志可能又要分配内存，这时伙伴系统已经能用了
+#ifdef CFG_MEM2
+	acoral_mem_init2(); // 任意大小内存分配系统初始化
+#endif
+}
+
+/**
+ * @brief 记一次分配、释放或失败
+ *
+ * @param add 新占用的字节数
+ * @param sub 归还的字节数
+ * @param counter 要加1的次数统计，NULL表示不加
+ */
+static void heap_account(unsigned long add, unsigned long sub, unsigned int *counter)
+{
+	acoral_enter_critical();
+	if (counter != NULL)
+		(*counter)++;
+	heap_ctrl.in_use = heap_ctrl.in_use + add - sub;
+	if (heap_ctrl.in_use > heap_ctrl.peak)
+		heap_ctrl.peak = heap_ctrl.in_use;
+	acoral_exit_critical();
+}
+
+/**
+ * @brief 分配，不计入统计
+ *
+ * @param size 用户需要的大小，不为0
+ * @return void* 分配的地址
+ */
+static void *heap_alloc(unsigned long size)
+{
+	void *ptr = NULL;
+	if (size > 0x7FFFFFFFul)
+		return NULL;
+#ifdef CFG_MEM2
+	if (size <= CFG_HEAP_SMALL_MAX)
+	{
+		ptr = acoral_malloc2(size);
+		if (ptr != NULL)
+			return ptr;
+	}
+#endif
+	return acoral_malloc(size); // 大块，或者TLSF不够了
+}
+
+/**
+ * @brief 已分配块的大小，不是已分配块返回0
+ *
+ * @param small 返回这块是不是TLSF的
+ */
+static unsigned long heap_block_size(void *ptr, int *small)
+{
+	unsigned long size = 0;
+	*small = 0;
+#ifdef CFG_MEM2
+	size = acoral_malloc_usable_size2(ptr);
+	if (size)
+	{
+		*small = 1;
+		return size;
+	}
+#endif
+	return acoral_malloc_usable_size(ptr);
+}
+
+void *acoral_heap_malloc(unsigned long size)
+{
+	void *ptr;
+	int small;
+	if (!heap_ctrl.ready)
+		acoral_heap_init();
+	if (size == 0)
+		return NULL;
+	ptr = heap_alloc(size);
+	if (ptr == NULL)
+	{
+		heap_account(0, 0, &heap_ctrl.fails);
+		return NULL;
+	}
+	heap_account(heap_block_size(ptr, &small), 0, &heap_ctrl.allocs);
+	return ptr;
+}
+
+void acoral_heap_free(void *ptr)
+{
+	unsigned long size;
+	int small;
+	if (ptr == NULL || !heap_ctrl.ready)
+		return;
+	size = heap_block_size(ptr, &small);
+	if (size == 0)
+	{
+		acoral_free(ptr); // 让伙伴系统打印非法地址或者重复释放
+		return;
+	}
+#ifdef CFG_MEM2
+	if (small)
+		acoral_free2(ptr);
+	else
+#endif
+		acoral_free(ptr);
+	heap_account(0, size, &heap_ctrl.frees);
+}
+
+void *acoral_heap_realloc(void *ptr, unsigned long size)
+{
+	unsigned long old;
+	int small;
+	void *new_ptr;
+
+	if (ptr == NULL)
+		return acoral_heap_malloc(size);
+	if (size == 0)
+	{
+		acoral_heap_free(ptr);
+		return NULL;
+	}
+	old = heap_block_size(ptr, &small);
+	if (old == 0)
+	{
+		printf("Invalid Realloc Address:0x%lx\n", (unsigned long)ptr);
+		return NULL;
+	}
+#ifdef CFG_MEM2
+	/*小块在TLSF里调整，能原地就原地；TLSF满了再换到伙伴系统*/
+	if (small && size <= CFG_HEAP_SMALL_MAX)
+	{
+		new_ptr = acoral_realloc2(ptr, size);
+		if (new_ptr != NULL)
+		{
+			heap_account(acoral_malloc_usable_size2(new_ptr), old, NULL);
+			return new_ptr;
+		}
+	}
+#endif
+	/*伙伴系统的块还放得下，缩小后也不会空出一半以上，就不搬*/
+	if (!small && size <= old && size > old / 2)
+		return ptr;
+	new_ptr = acoral_heap_malloc(size);
+	if (new_ptr == NULL)
+		return NULL; // 原来的块不动
+	memcpy(new_ptr, ptr, size < old ? size : old);
+	acoral_heap_free(ptr);
+	return new_ptr;
+}
+
+void *acoral_heap_calloc(unsigned long num, unsigned long size)
+{
+	void *ptr;
+	if (size != 0 && num > (unsigned long)-1 / size)
+	{
+		heap_account(0, 0, &heap_ctrl.fails);
+		return NULL;
+	}
+	ptr = acoral_heap_malloc(num * size);
+	if (ptr != NULL)
+		memset(ptr, 0, num * size);
+	return ptr;
+}
+
+void *acoral_heap_memalign(unsigned long align, unsigned long size)
+{
+	void *ptr;
+	int small;
+	if (align == 0 || (align & (align - 1)))
+		return NULL;
+	if (align <= sizeof(void *))
+		return acoral_heap_malloc(size);
+	if (!heap_ctrl.ready)
+		acoral_heap_init();
+	if (size == 0 || size > 0x7FFFFFFFul || align > 0x7FFFFFFFul)
+		return NULL;
+	/*伙伴系统的块相对堆起始地址按块大小对齐，块不小于align就行*/
+	ptr = acoral_malloc(size > align ? size : align);
+	if (ptr != NULL && ((unsigned long)ptr & (align - 1)))
+	{
+		acoral_free(ptr);
+		ptr = NULL;
+	}
+	if (ptr == NULL)
+	{
+		heap_account(0, 0, &heap_ctrl.fails);
+		return NULL;
+	}
+	heap_account(heap_block_size(ptr, &small), 0, &heap_ctrl.allocs);
+	return ptr;
+}
+
+unsigned long acoral_heap_usable_size(void *ptr)
+{
+	int small;
+	if (ptr == NULL || !heap_ctrl.ready)
+		return 0;
+	return heap_block_size(ptr, &small);
+}
+
+void acoral_heap_stat(acoral_heap_stat_t *stat)
+{
+	acoral_mem_stat_t mem;
+
+	acoral_mem_stat(&mem);
+	stat->total = mem.total_bytes;
+	stat->free = mem.free_bytes;
+	stat->largest_free = mem.largest_free;
+	stat->small_total = 0;
+	stat->small_free = 0;
+#ifdef CFG_MEM2
+	acoral_mem_stat2(&mem);
+	stat->small_total = mem.total_bytes;
+	stat->small_free = mem.free_bytes;
+#endif
+	acoral_enter_critical();
+	stat->in_use = heap_ctrl.in_use;
+	stat->peak = heap_ctrl.peak;
+	stat->allocs = heap_ctrl.allocs;
+	stat->frees = heap_ctrl.frees;
+	stat->fails = heap_ctrl.fails;
+	acoral_exit_critical();
+}
+
+void acoral_heap_scan(void)
+{
+	acoral_heap_stat_t stat;
+
+	acoral_heap_stat(&stat);
+	printf("Heap Total %lu, Free %lu, Largest Free %lu\r\n", stat.total, stat.free, stat.largest_free);
+	printf("Small Pool %lu, Free %lu\r\n", stat.small_total, stat.small_free);
+	printf("In Use %lu, Peak %lu, Allocs %u, Frees %u, Fails %u\r\n", stat.in_use, stat.peak, stat.allocs, stat.frees, stat.fails);
+}
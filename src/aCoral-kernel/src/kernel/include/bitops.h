@@ -11,6 +11,47 @@
 #ifndef ACORAL_BITOPS_H
 #define ACORAL_BITOPS_H
 
+///de Bruijn序列查找表，供没有硬件ctz指令的平台使用
+extern const unsigned char acoral_debruijn_ctz32[32];
+///de Bruijn序列查找表，供没有硬件clz指令的平台使用
+extern const unsigned char acoral_debruijn_log2_32[32];
+
+/**
+ * @brief 查找整型数中为1的最低位（count trailing zeros），word不能为0
+ * @note 有硬件位扫描指令（如RISC-V Zbb扩展的ctz）时交给编译器生成单条指令；
+ *       K210这类没有Zbb的核上使用de Bruijn乘法查表，一次乘法、一次移位、一次访存，同样是常数时间
+ * @param word 整型数，不能为0
+ * @return unsigned int 最低为1的位的位置
+ */
+static inline unsigned int acoral_ffs32(unsigned int word)
+{
+#if defined(__riscv_zbb) || !defined(__riscv)
+    return __builtin_ctz(word);
+#else
+    return acoral_debruijn_ctz32[((word & -word) * 0x077CB531U) >> 27];
+#endif
+}
+
+/**
+ * @brief 查找整型数中为1的最高位，即向下取整的log2，word不能为0
+ * @note 没有Zbb时先把最高位以下全部置1，再和acoral_ffs32一样用de Bruijn乘法查表
+ * @param word 整型数，不能为0
+ * @return unsigned int 最高为1的位的位置
+ */
+static inline unsigned int acoral_fls32(unsigned int word)
+{
+#if defined(__riscv_zbb) || !defined(__riscv)
+    return 31 - __builtin_clz(word);
+#else
+    word |= word >> 1;
+    word |= word >> 2;
+    word |= word >> 4;
+    word |= word >> 8;
+    word |= word >> 16;
+    return acoral_debruijn_log2_32[(word * 0x07C4ACDDU) >> 27];
+#endif
+}
+
 /**
  * @brief 查找长度为length的整型数组中，最低非0bit的位置。
  *        bit从低到高排序为 b[0]:bit0 -> b[0]:bit31 -> b[1]:bit[0] -> ... b[length-1]:bit31
@@ -47,7 +88,7 @@ void acoral_clear_bit_in_bitmap(int nr,unsigned int *p);
 unsigned int acoral_get_bit_in_bitmap(int nr,unsigned int *bitmap);
 
 /**
- * @brief 二分法查找整型数为1的最低位
+ * @brief 查找整型数为1（或为0）的最低位
  * 
  * @param word 整型数
  * @param bit 找0还是1
@@ -9,9 +9,10 @@
 #ifndef ACORAL_CORE_H
 #define ACORAL_CORE_H
 
-#define DAEM_STACK_SIZE (256)
-#define IDLE_STACK_SIZE (128)
-#define INIT_STACK_SIZE (512)
+#include "autocfg.h"
+
+#define IDLE_STACK_SIZE (CFG_MIN_STACK_SIZE)
+#define INIT_STACK_SIZE (CFG_DEFAULT_STACK_SIZE) ///<init线程里运行user_main
 
 /**
  * @brief aCoral入口
@@ -19,4 +20,12 @@
  */
 void system_start(void);
 
+#ifdef CFG_SMP
+/**
+ * @brief 从核入口，等主核建好系统线程后在本核上开始调度，不再返回
+ * 
+ */
+void acoral_secondary_cpu_start(void);
+#endif
+
 #endif
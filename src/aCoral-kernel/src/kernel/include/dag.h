@@ -1,15 +1,31 @@
+/**
+ * @file dag.h
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief kernel层，DAG任务图执行器头文件
+ * @version 2.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ */
 #ifndef DAG_H
 #define DAG_H
 
 #include "thread.h"
+#include "event.h"
 
-
+#define ACORAL_DAG_ANY_CORE (-1) ///<节点线程不绑定核
 
 typedef enum{
     ACORAL_DAG_NODE_FULL= -10,
     ACORAL_DAG_NODE_THREAD_NULL,
     ACORAL_DAG_EDGE_NULL,
-    ACORAL_DAG_EDGE_SUCCESS
+    ACORAL_DAG_EDGE_SUCCESS,
+    ACORAL_DAG_NODE_NULL,           ///<节点号非法或节点不存在
+    ACORAL_DAG_CYCLE,               ///<DAG图中存在环
+    ACORAL_DAG_STARTED,             ///<DAG已经启动，不能再修改图
+    ACORAL_DAG_NOT_STARTED,         ///<DAG还没有启动
+    ACORAL_DAG_EMPTY,               ///<DAG图中没有节点
+    ACORAL_DAG_CORE_NULL,           ///<目标核号超出CFG_MAX_CPU
+    ACORAL_DAG_SUCCESS = 0
 }acoralDagEnum;
 
 typedef struct node_struct
@@ -17,10 +33,21 @@ typedef struct node_struct
     int nid;                      ///<DAG节点id，用于全局DAG图中的节点数组索引
     int tid;                        ///<DAG节点对应的线程id
     acoral_thread_t* tcb;           ///<DAG节点对应的线程
-    int former_task_num;            ///<DAG节点剩余未完成的前驱节点数
+    int former_task_num;            ///<DAG节点下一次运行还缺的前驱节点数，即没有令牌的入边数
     int former_task_num_origin;     ///<DAG节点前驱节点数
-    int core_id;                    ///<DAG节点运行的目标核
+    int core_id;                    ///<DAG节点运行的目标核，ACORAL_DAG_ANY_CORE表示不绑定
     //spinlock
+
+    unsigned char valid;            ///<节点槽位是否被占用
+    char name[8];                   ///<线程名，DAGn
+    void (*route)(void *args);      ///<节点的任务函数
+    void* input;                    ///<任务函数的参数
+    void* output;                   ///<任务的输出缓冲区，供后继节点读取
+    unsigned int weight;            ///<节点执行时间估计，用于计算关键路径，默认为1
+    unsigned int rank;              ///<关键路径长度，即从本节点到出口节点的最长路径（含本节点）
+    unsigned char prio;             ///<按关键路径分配的线程优先级
+    unsigned int runs;              ///<节点已经完成的次数
+    acoral_evt_t* sem;              ///<节点就绪信号量，每次释放post一次
 }acoral_dag_node;
 
 typedef struct dag_struct
@@ -30,49 +57,96 @@ typedef struct dag_struct
     int node_num;                                ///<既表示系统中DAG节点数量
     //spinlock
     //加一个最近完成的节点编号用于核间中断传参
+
+    unsigned char tokens[CFG_DAG_SIZE][CFG_DAG_SIZE]; ///<每条边上尚未被后继消费的完成令牌数，流水线时可能大于1
+    unsigned char started;                       ///<是否已经调用dag_start
+    unsigned int frames_done;                    ///<所有出口节点都完成的帧数
+    acoral_evt_t* inflight;                      ///<限制同时在流水线中的帧数，初值为CFG_DAG_PIPELINE_DEPTH
 }acoral_dag_t;
 
 /**
- * @brief 往dag_global中添加一个DAG节点，并创建对应的线程
+ * @brief 初始化全局DAG图
+ * @note 调用时机为系统初始化阶段
+ * 
+ * @return int ACORAL_DAG_SUCCESS
+ */
+int dag_init(void);
+
+/**
+ * @brief 往dag_global中添加一个DAG节点，节点线程在dag_start时创建
  * 
  * @param route 线程函数
- * @param core_id 
- * @param input 
- * @param output 
- * @return int DAG节点号
+ * @param core_id 目标核，节点线程创建后按它设置亲和性；ACORAL_DAG_ANY_CORE表示可以在任意核上运行
+ * @param input 线程函数参数
+ * @param output 输出缓冲区
+ * @return int DAG节点号，失败返回acoralDagEnum中的错误码
  */
 int dag_add_node(void (*route)(void *args), int core_id, void* input, void* output);
 
 /**
- * @brief 
+ * @brief 设置DAG节点的执行时间估计，用于关键路径优先级分配
  * 
  * @param node DAG节点号
- * @return int 
+ * @param weight 执行时间估计，单位任意但各节点需一致（如毫秒）
+ * @return int ACORAL_DAG_SUCCESS或错误码
+ */
+int dag_set_node_weight(int node, unsigned int weight);
+
+/**
+ * @brief 删除DAG节点及其所有边，只能在dag_start之前调用
+ * 
+ * @param node DAG节点号
+ * @return int ACORAL_DAG_SUCCESS或错误码
  */
 int dag_delete_node(int node);
 
 /**
- * @brief 
+ * @brief 添加一条依赖边，end要等start完成后才能运行
  * 
- * @param start 起始节点
- * @param end 终止节点
- * @return int 
+ * @param start 起始节点，必须是已添加的节点
+ * @param end 终止节点，必须是已添加的节点
+ * @return int ACORAL_DAG_EDGE_SUCCESS或错误码
  */
 int dag_add_edge(int start, int end);
 
 /**
- * @brief 
+ * @brief 删除一条依赖边，只能在dag_start之前调用
  * 
  * @param start 起始节点
  * @param end 终止节点
- * @return int 
+ * @return int ACORAL_DAG_EDGE_SUCCESS或错误码
  */
 int dag_delete_edge(int start, int end);
 
+/**
+ * @brief 检查DAG图并启动：环检测、按关键路径分配优先级、为每个节点创建线程
+ * @note 节点线程在dag_trigger释放入口节点之后才开始运行；中途失败时已经创建的信号量和线程都会回收，可以改图后重试
+ * 
+ * @return int ACORAL_DAG_SUCCESS或错误码
+ */
 int dag_start();
 
+/**
+ * @brief 用Kahn算法做拓扑排序，检查DAG图中是否有环
+ * 
+ * @return int 无环返回ACORAL_DAG_SUCCESS，有环返回ACORAL_DAG_CYCLE
+ */
 int dag_check_cycle();
 
+/**
+ * @brief 开始一帧：释放所有入口节点
+ * @note 流水线中已经有CFG_DAG_PIPELINE_DEPTH帧未完成时阻塞，直到最早的一帧完成
+ * 
+ * @return int ACORAL_DAG_SUCCESS或错误码
+ */
+int dag_trigger();
+
+/**
+ * @brief 当前DAG节点本次运行结束，给所有后继节点的入边放一个令牌，前驱都完成的后继被释放
+ * @note 由节点线程在任务函数返回后自动调用
+ * 
+ * @return int ACORAL_DAG_SUCCESS或错误码
+ */
 int acoral_dag_thread_exit();
 
-#endif
\ No newline at end of file
+#endif
@@ -29,8 +29,9 @@ typedef enum{
 typedef struct{
 	acoral_res_t  res; 			///<event也是一种资源
   	unsigned char type; 		///<类型，ACORAL_EVENT_SEM（信号量）或ACORAL_EVENT_MUTEX（互斥量）
-	int           count; 		///<当type是互斥量时：23~16位表示这个互斥量的优先级天花板。\这个值在互斥量被创建的时候就确定了且不会改变。15~8位表示这个互斥量已经被占用时，因为尝试申请互斥量而被阻塞的线程中最高的优先级。7~0位在互斥量没有被上锁时，为全1，表示互斥量可用；在被上锁，也就是被占用时，会被赋值为占用它的线程的原始优先级。之所以说是原始优先级，是因为占用线程在使用互斥量的过程中可能被提升优先级，那在释放互斥量之后就要恢复之前的优先级，那就是从count成员的7~0位取值。当type是信号量或消息队列时，自行探索。
+	int           count; 		///<当type是互斥量时：23~16位表示这个互斥量的优先级天花板，在互斥量被创建的时候就确定了且不会改变；第24位为1表示当前占用者是按天花板协议（acoral_mutex_pend2）申请到的；7~0位在互斥量没有被上锁时为全1，表示互斥量可用，被占用时为占用线程申请时的优先级。继承来的优先级不记在这里，由占用线程的held_mutexes和各互斥量的等待队列算出。当type是信号量时，表示可用资源数的相反数加1
 	acoral_list_t wait_queue; 	///<等待使用这个event的线程队列
+	acoral_list_t owner_hook; 	///<当event是mutex且被占用时，挂在占用线程的held_mutexes上
 	char*		  name; 		///<名字
 	void*		  data; 		///<当event是mutex或Semaphore时，指向占用线程，当event是消息队列时，存放传递的消息
 }acoral_evt_t;
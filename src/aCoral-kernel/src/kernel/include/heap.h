@@ -0,0 +1,106 @@
+/**
+ * @file heap.h
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief kernel层，统一堆头文件
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ * @note 内核、应用和C库共用一个堆：小块走任意大小分配系统（TLSF），大块直接用伙伴系统的整块，
+ *       两者都在链接脚本的_heap_start~_heap_end里，只有一份预算和一套统计
+ */
+#ifndef ACORAL_HEAP_H
+#define ACORAL_HEAP_H
+
+#include "autocfg.h"
+
+/**
+ * @brief 统一堆的使用情况
+ *
+ */
+typedef struct{
+   unsigned long total;         ///<伙伴系统管理的内存总量
+   unsigned long free;          ///<伙伴系统的空闲内存，TLSF内存池整块算作已用
+   unsigned long largest_free;  ///<伙伴系统中最大的空闲块，大块分配能否成功看它
+   unsigned long small_total;   ///<TLSF内存池的大小
+   unsigned long small_free;    ///<TLSF内存池的空闲内存
+   unsigned long in_use;        ///<经统一堆分配、还没有释放的内存，按实际占用的块大小计
+   unsigned long peak;          ///<in_use的峰值
+   unsigned int allocs;         ///<分配成功的次数
+   unsigned int frees;          ///<释放的次数
+   unsigned int fails;          ///<分配失败的次数
+}acoral_heap_stat_t;
+
+/**
+ * @brief 初始化伙伴系统和任意大小内存分配系统，只做一次
+ * @note system_mem_module_init会调用；内核启动之前C++全局对象的构造函数等就调用了malloc时，在那里提前初始化
+ *
+ */
+void acoral_heap_init(void);
+
+/**
+ * @brief 从统一堆分配内存
+ * @note 不超过CFG_HEAP_SMALL_MAX的从TLSF分配，TLSF不够时退到伙伴系统；更大的直接分配伙伴系统的整块。
+ *       返回的地址按指针大小对齐，要求更严的用acoral_heap_memalign
+ *
+ * @param size 用户需要的大小
+ * @return void* 分配的地址，size为0或内存不足返回NULL
+ */
+void *acoral_heap_malloc(unsigned long size);
+
+/**
+ * @brief 释放统一堆的内存，按地址判断属于哪个分配器
+ *
+ * @param ptr acoral_heap_*分配的地址，NULL时什么都不做
+ */
+void acoral_heap_free(void *ptr);
+
+/**
+ * @brief 改变已分配内存的大小
+ * @note 小块先在TLSF里原地调整；伙伴系统的块够大、缩小后也不会空出一半以上时原地不动；否则分配新块并拷贝
+ *
+ * @param ptr 原来的地址，NULL时等价于acoral_heap_malloc
+ * @param size 新的大小，0时等价于acoral_heap_free并返回NULL
+ * @return void* 新的地址，失败返回NULL，此时原来的内存不变
+ */
+void *acoral_heap_realloc(void *ptr, unsigned long size);
+
+/**
+ * @brief 分配num个size大小的元素并清零
+ *
+ * @return void* 分配的地址，乘积溢出或内存不足返回NULL
+ */
+void *acoral_heap_calloc(unsigned long num, unsigned long size);
+
+/**
+ * @brief 按指定对齐分配
+ * @note 不超过指针大小的对齐等价于acoral_heap_malloc；更大的对齐用伙伴系统的块，块按块大小自然对齐，
+ *       超过基本内存块大小的对齐只有在堆的起始地址也满足时才能成功
+ *
+ * @param align 对齐，必须是2的幂
+ * @param size 用户需要的大小
+ * @return void* 分配的地址，对齐不合法或满足不了返回NULL
+ */
+void *acoral_heap_memalign(unsigned long align, unsigned long size);
+
+/**
+ * @brief 已分配内存的实际可用大小
+ *
+ * @param ptr acoral_heap_*分配的地址
+ * @return unsigned long 可用大小，不是统一堆分配的地址返回0
+ */
+unsigned long acoral_heap_usable_size(void *ptr);
+
+/**
+ * @brief 获取统一堆的使用情况
+ *
+ * @param stat 结果
+ */
+void acoral_heap_stat(acoral_heap_stat_t *stat);
+
+/**
+ * @brief 打印统一堆的使用情况
+ *
+ */
+void acoral_heap_scan(void);
+
+#endif
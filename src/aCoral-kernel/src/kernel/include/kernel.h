@@ -21,15 +21,21 @@
 #include "int.h"
 #include "soft_timer.h"
 #include "mem.h"
+#include "heap.h"
 #include "event.h"
 #include "mutex.h"
 #include "sem.h"
 #include "policy.h"
 #include "comm_thrd.h"
 #include "period_thrd.h"
+#include "rr_thrd.h"
 #include "shell.h"
 #include "message.h"
 #include "dag.h"
+#include "workqueue.h"
+#include "slab.h"
+#include "srp_task.h"
+#include "reserve.h"
 #include "log.h"
 #include "resource.h"
 
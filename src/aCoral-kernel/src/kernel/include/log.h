@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include "autocfg.h"
 
 typedef enum{
     LOG_DEBUG = 0,
@@ -12,27 +13,32 @@ typedef enum{
     LOG_ERROR
 }acoral_log_enum;
 
-#define ACORAL_LOG_DEBUG(format , ...)  { \
+///低于CFG_LOG_LEVEL的日志在编译期被丢弃，做时延测试时可以关掉线程切换路径上的LOG_TRACE
+#ifndef CFG_LOG_LEVEL
+#define CFG_LOG_LEVEL LOG_DEBUG
+#endif
+
+#define ACORAL_LOG_DEBUG(format , ...)  if (LOG_DEBUG >= CFG_LOG_LEVEL) { \
                                           printf("[\033[0;36mLOG_DEBUG\033[0m] %s:%d -> "format, __FILE__, __LINE__ , ##__VA_ARGS__); \
                                           printf("\n"); \
                                         }
 
-#define ACORAL_LOG_TRACE(format , ...)  { \
+#define ACORAL_LOG_TRACE(format , ...)  if (LOG_TRACE >= CFG_LOG_LEVEL) { \
                                           printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> "format, __FILE__, __LINE__ , ##__VA_ARGS__); \
                                           printf("\n"); \
                                         }
 
-#define ACORAL_LOG_INFO(format , ...)   { \
+#define ACORAL_LOG_INFO(format , ...)   if (LOG_INFO >= CFG_LOG_LEVEL) { \
                                           printf("[\033[0;35mLOG_INFO\033[0m] %s:%d -> "format, __FILE__, __LINE__ , ##__VA_ARGS__); \
                                           printf("\n"); \
                                         }
 
-#define ACORAL_LOG_WARN(format , ...)   { \
+#define ACORAL_LOG_WARN(format , ...)   if (LOG_WARN >= CFG_LOG_LEVEL) { \
                                           printf("[\033[0;33mLOG_WARN\033[0m] %s:%d -> "format, __FILE__, __LINE__ , ##__VA_ARGS__); \
                                           printf("\n"); \
                                         }
 
-#define ACORAL_LOG_ERROR(format , ...)  { \
+#define ACORAL_LOG_ERROR(format , ...)  if (LOG_ERROR >= CFG_LOG_LEVEL) { \
                                           printf("[\033[0;31mLOG_ERROR\033[0m] %s:%d -> "format, __FILE__, __LINE__ , ##__VA_ARGS__); \
                                           printf("\n"); \
                                         }
@@ -2,8 +2,8 @@
  * @file mem.h
  * @author 王彬浩 (SPGGOGOGO@outlook.com)
  * @brief kernel层，内存相关头文件
- * @version 1.1
- * @date 2023-04-20
+ * @version 1.3
+ * @date 2026-10-17
  * @copyright Copyright (c) 2023
  * @revisionHistory 
  *  <table> 
@@ -11,6 +11,8 @@
  *   <tr><td> 0.1 <td>jivin <td>2010-03-08 <td>Created 
  *   <tr><td> 1.0 <td>王彬浩 <td> 2022-07-08 <td>Standardized 
  *   <tr><td> 1.1 <td>王彬浩 <td> 2023-04-20 <td>optimized 
+ *   <tr><td> 1.2 <td>王彬浩 <td> 2026-10-17 <td>buddy system uses per-order free lists 
+ *   <tr><td> 1.3 <td>王彬浩 <td> 2026-10-17 <td>usable size and stat queries for the unified heap 
  *  </table>
  */
 #ifndef ACORAL_MEM_H
@@ -21,6 +23,16 @@
 #include "list.h"
 #include "resource.h"
 
+/**
+ * @brief 内存分配系统的使用情况
+ *
+ */
+typedef struct{
+   unsigned long total_bytes;    ///<管理的内存总量
+   unsigned long free_bytes;     ///<空闲块的总大小
+   unsigned long largest_free;   ///<最大的空闲块，和free_bytes相差越多碎片越严重
+}acoral_mem_stat_t;
+
 /**
  * 伙伴系统部分
 */
@@ -36,6 +48,7 @@ unsigned int buddy_init(unsigned int start, unsigned int end);
 
 /**
  * @brief 伙伴系统分配内存
+ * @note 在空闲位图里找不小于所需阶的最低非空阶，取下一块后逐阶对半分，与内存大小无关
  *
  * @param size 用户需要的大小
  * @return void* 返回分配的地址
@@ -45,6 +58,7 @@ void* buddy_malloc(unsigned int  size);
 
 /**
  * @brief 伙伴系统回收内存
+ * @note 伙伴空闲且同阶就合并，逐阶向上，最多合并LEVEL-1次
  *
  * @param ptr 要回收的地址
  */
@@ -56,57 +70,110 @@ void buddy_free(void *p);
  */
 void buddy_scan(void);
 
+/**
+ * @brief 已分配块的实际大小
+ *
+ * @param ptr buddy_malloc返回的地址
+ * @return unsigned int 块大小，ptr不是已分配块的开头时返回0
+ */
+unsigned int buddy_usable_size(void *ptr);
+
+/**
+ * @brief 获取伙伴系统的空闲总量和最大空闲块
+ *
+ * @param stat 结果
+ */
+void buddy_stat(acoral_mem_stat_t *stat);
+
 #define acoral_malloc(size) buddy_malloc(size)
 #define acoral_free(ptr) buddy_free(ptr)
 #define acoral_malloc_adjust_size(size) buddy_malloc_size(size)
 #define acoral_mem_init(start,end) buddy_init(start,end)
 #define acoral_mem_scan() buddy_scan()
+#define acoral_malloc_usable_size(ptr) buddy_usable_size(ptr)
+#define acoral_mem_stat(stat) buddy_stat(stat)
 
 #ifdef CFG_MEM2 
+
 /**
- * @brief 任意大小内存分配
- * 
+ * @brief 任意大小内存分配，两级分离适配（TLSF），常数时间
+ * @note 只关一小段临界区，中断里也能调用，但中断里建议用tlsf_malloc_isr
+ *
+ * @param size 用户需要的大小
+ * @return void* 按指针大小对齐的地址，内存不足返回NULL
  */
-   void * v_malloc(int size);
+void *tlsf_malloc(unsigned int size);
 
 /**
- * @brief 任意大小内存释放
- * 
+ * @brief 中断中使用的任意大小内存分配，只分配不超过CFG_MEM2_ISR_MAX_SIZE的小块，免得中断把池子耗光
+ *
+ * @param size 用户需要的大小
+ * @return void* 分配的地址，太大或内存不足返回NULL
+ */
+void *tlsf_malloc_isr(unsigned int size);
+
+/**
+ * @brief 任意大小内存释放，和物理上相邻的空闲块常数时间合并
+ *
+ * @param ptr tlsf_malloc、tlsf_malloc_isr或tlsf_realloc返回的地址，NULL时什么都不做
+ */
+void tlsf_free(void *ptr);
+
+/**
+ * @brief 改变已分配内存的大小，缩小或者后面紧挨着的空闲块够用时原地完成，否则分配新块并拷贝
+ *
+ * @param ptr 原来的地址，NULL时等价于tlsf_malloc
+ * @param size 新的大小，0时等价于tlsf_free并返回NULL
+ * @return void* 新的地址，失败返回NULL，此时原来的内存不变
+ */
+void *tlsf_realloc(void *ptr, unsigned int size);
+
+/**
+ * @brief 已分配块的用户可用大小
+ *
+ * @param ptr tlsf_malloc等返回的地址
+ * @return unsigned int 可用大小，ptr不在内存池里或者已经释放时返回0，可以据此判断地址是不是本分配器分出去的
  */
-   void v_free(void * p);
+unsigned int tlsf_usable_size(void *ptr);
 
 /**
- * @brief 任意大小内存分配系统初始化。从伙伴系统中拿出一部分内存，用作任意大小分配的内存
+ * @brief 任意大小内存分配系统初始化。从伙伴系统中拿出CFG_MEM2_SIZE，用作任意大小分配的内存池
  * 
  */
-   void v_mem_init(void);
-   void v_mem_scan(void);
-   #define acoral_mem_init2() v_mem_init()
-   #define acoral_malloc2(size) v_malloc(size) //SPG有问题
-   #define acoral_free2(p) v_free(p)
-   #define acoral_mem_scan2() v_mem_scan()
+void tlsf_mem_init(void);
+
+/**
+ * @brief 获取空闲总量和最大空闲块，用于观察碎片
+ *
+ * @param stat 结果
+ */
+void tlsf_stat(acoral_mem_stat_t *stat);
+
+/**
+ * @brief 打印内存池中所有块
+ *
+ */
+void tlsf_scan(void);
+
+#define acoral_mem_init2() tlsf_mem_init()
+#define acoral_malloc2(size) tlsf_malloc(size)
+#define acoral_malloc2_isr(size) tlsf_malloc_isr(size)
+#define acoral_realloc2(p,size) tlsf_realloc(p,size)
+#define acoral_free2(p) tlsf_free(p)
+#define acoral_mem_scan2() tlsf_scan()
+#define acoral_mem_stat2(stat) tlsf_stat(stat)
+#define acoral_malloc_usable_size2(ptr) tlsf_usable_size(ptr)
 #endif
 
-#define LEVEL 14                          ///<最大层数
-#define BLOCK_INDEX(index) ((index)>>1)   ///<bitmap的index换算，因为除去最大内存块的剩余层中64块用一个32位图表示，所以要除以2
-#define BLOCK_SHIFT 7                     ///<基本内存块偏移量
-#define BASIC_BLOCK_SIZE (1<<BLOCK_SHIFT) ///<基本内存块大小 128B
-
-#define MAGIC 0xcc
-#define MAGIC_MASK 0xfe
-#define USED 1
-#define FREE 0 
-#define USETAG_MASK 0x1
-#define SIZE_MASK 0xffffff00
-#define SIZE_BIT 8
-#define BLOCK_CHECK(value) (((value&MAGIC_MASK)==MAGIC))
-#define BLOCK_SIZE(value) ((value&SIZE_MASK)>>SIZE_BIT)
-#define BLOCK_TAG(value) (value&USETAG_MASK)
-#define BLOCK_FREE(value) (BLOCK_TAG(value)==FREE)
-#define BLOCK_USED(value) (BLOCK_TAG(value)==USED)
-#define BLOCK_SET_USED(ptr,size) (*ptr=(size<<SIZE_BIT)|0x1|MAGIC)
-#define BLOCK_SET_FREE(ptr,size) (*ptr=(size<<SIZE_BIT)|MAGIC)
-#define BLOCK_CLEAR(ptr) (*ptr=0)
+#define LEVEL 14                          ///<最大阶数，最大内存块为BASIC_BLOCK_SIZE<<(LEVEL-1)，不能超过32
+#define BLOCK_SHIFT CFG_MEM_BLOCK_SHIFT   ///<基本内存块偏移量
+#define BASIC_BLOCK_SIZE (1<<BLOCK_SHIFT) ///<基本内存块大小
+#define BLOCK_FREE 0x80                   ///<基本内存块状态：空闲块的首块，低位是阶
+#define BLOCK_NONE 0x7F                   ///<基本内存块状态：不是任何块的首块
+
+#if CFG_MEM_BLOCK_SHIFT < 4
+#error "CFG_MEM_BLOCK_SHIFT must be at least 4, free blocks hold a list node"
+#endif
 
 typedef enum{
    MEM_NO_ALLOC,  ///<内存系统状态定义：容量太小不可分配
@@ -114,26 +181,24 @@ typedef enum{
 }acoralMemAllocStateEnum;
 
 /**
- * @brief 内存块层数结构体，用于回收内存块时，描述要回收的内存块的大小。
- * 因为知道回收的起始地址，所以就知道要回收的这块内存的第一块基本内存块的编号是多少，那只要知道了这个基本内存块是哪一层分配出去的，就知道实际分配了多少大小的内存。
- * 详见书p131
+ * @brief 基本内存块状态。已分配块的首块记着块的阶，回收时据此知道实际分配了多大；
+ * 空闲块的首块记着阶|BLOCK_FREE，回收时据此O(1)判断伙伴能否合并；其余基本块为BLOCK_NONE
  * 
  */
 typedef struct{
-	char level;
-}acoral_block_t; //SPG 这个结构有必要？
+	unsigned char level;
+}acoral_block_t;
 
 /**
  * @brief 内存控制块结构体
  * 
  */
 typedef struct{
-	int *free_list[LEVEL];  ///<各层空闲位图链表
-	unsigned int *bitmap[LEVEL];    ///<各层内存状态位图块，两种情况：一. 最大内存块层，为一块内存空闲与否；二.其余层，1 标识两块相邻内存块有一块空闲，0 标识没有空闲
-	int free_cur[LEVEL];    ///<各层空闲位图链表头
-	unsigned int num[LEVEL];        ///<各层内存块个数
-	char level;               ///<层数 
-	unsigned char state;              ///<状态
+	acoral_list_t free_list[LEVEL]; ///<各阶空闲块链表，链表节点就放在空闲块的开头
+	unsigned int free_map;          ///<各阶空闲链表非空位图，第k位为1表示第k阶有空闲块
+	unsigned int num[LEVEL];        ///<各阶空闲块个数
+	unsigned char level;            ///<阶数
+	unsigned char state;            ///<状态
 	unsigned int start_adr;         ///<内存起始地址
 	unsigned int end_adr;           ///<内存终止地址
 	unsigned int block_num;         ///<基本内存块数
@@ -18,12 +18,14 @@
 #define _ACORAL_MUTEX_H
 
 #include "event.h"
+#include "thread.h"
 
 #define MUTEX_AVAI 0x00FF
 
 #define MUTEX_L_MASK 0x00FF
 #define MUTEX_U_MASK 0xFF00
 #define MUTEX_CEILING_MASK 0xFF0000
+#define MUTEX_CEILING_HELD 0x1000000 ///<占用者是按天花板协议申请到的，占用期间生效优先级不低于天花板
 
 typedef enum
 {
@@ -85,6 +87,10 @@ acoralMutexRetVal acoral_mutex_pend(acoral_evt_t *evt, unsigned int timeout);
 
 /**
  * @brief 获取互斥量（优先级天花板的优先级反转解决）
+ * @note 占用期间生效优先级提升到天花板，释放后按还占用着的互斥量重新计算。
+ *       CFG_SRP时同时按栈资源策略把天花板压到当前核的系统天花板上：优先级不高于系统天花板的线程不能开始运行，
+ *       所以同一个核上使用这个互斥量的线程申请时它一定是空闲的，线程开始运行之后不会再在天花板互斥量上阻塞。
+ *       跨核使用时仍可能被占用，这时按优先级继承的方式等待
  *
  * @param evt 互斥量指针
  * @param timeout timeout 申请超时时间（0代表不设置超时时间）
@@ -92,6 +98,36 @@ acoralMutexRetVal acoral_mutex_pend(acoral_evt_t *evt, unsigned int timeout);
  */
 acoralMutexRetVal acoral_mutex_pend2(acoral_evt_t *evt, unsigned int timeout);
 
+/**
+ * @brief 重新计算线程的生效优先级，并沿等待链传递
+ * @note 生效优先级取base_prio、所占用互斥量上最高的等待者优先级、按天花板协议占用的互斥量的天花板三者中最高的；
+ *       线程正在等待另一个互斥量时，它的变化会继续传给那个互斥量的占用者，直到链上某个线程的优先级不再变化。
+ *       需在临界区中调用
+ *
+ * @param thread 线程指针
+ */
+void acoral_mutex_prio_update(acoral_thread_t *thread);
+
+#if CFG_SRP
+/**
+ * @brief SRP抢占测试，在选择下一个线程时调用
+ *
+ * @param cpu 核号
+ * @param prio 该核就绪队列中最高的优先级
+ * @return acoral_thread_t* prio不高于系统天花板时返回最近占用天花板互斥量的线程，由它继续运行；
+ *         可以正常按优先级调度时返回NULL
+ */
+acoral_thread_t *acoral_srp_preempt_check(unsigned int cpu, unsigned int prio);
+
+/**
+ * @brief 查看某个核的系统天花板
+ *
+ * @param cpu 核号
+ * @return int 系统天花板，没有占用天花板互斥量时返回-1
+ */
+int acoral_srp_ceiling(unsigned int cpu);
+#endif
+
 /**
  * @brief 释放互斥量
  *
@@ -19,16 +19,82 @@
 #include "thread.h"
 
 /**
- * @brief 周期策略数据块
+ * @brief 周期线程运行统计，时间单位为mcycle周期数
  * 
  */
+typedef struct{
+	unsigned int jobs;				///<已释放的作业数
+	unsigned int overruns;			///<超限次数，即释放时上一个作业还没有结束
+	unsigned long jitter_last;		///<最近一次释放抖动，从释放到作业真正开始运行
+	unsigned long jitter_max;		///<最大释放抖动
+	unsigned long response_last;	///<最近一次响应时间，从释放到作业调用acoral_period_wait
+	unsigned long response_max;		///<最大响应时间
+}acoral_period_stat_t;
+
+/**
+ * @brief 周期策略数据块
+ * @note 创建线程时只需填写period_time_mm等配置项，其余成员由内核维护
+ */
 typedef struct{
 	unsigned int period_time_mm; 			///<线程周期，单位为毫秒
+	unsigned int deadline_mm;				///<相对截止期，单位为毫秒，0表示等于周期，仅EDF线程使用
+	unsigned int wcet_mm;					///<最坏执行时间预算，单位为毫秒，仅EDF线程用于准入控制
+	unsigned int abs_deadline;				///<当前作业的绝对截止期（ticks），由内核在每次释放时填写
+
+	unsigned int base_ticks;				///<首次释放的绝对时间（ticks）
+	unsigned long release_mm;				///<下一次释放相对base_ticks的毫秒数，按毫秒累加避免周期不是tick整数倍时的漂移
+	unsigned int next_release;				///<下一次释放的绝对时间（ticks），周期等待队列按它排序
+	unsigned int release_ticks;				///<当前作业的释放时间（ticks）
+	unsigned char waiting;					///<线程正在acoral_period_wait中等待下一次释放
+	unsigned int pending;					///<已经释放但线程还没来得及等待的作业数（超限）
+	unsigned long release_cycles;			///<当前作业的释放时刻（mcycle）
+	unsigned long pending_cycles;			///<最近一次超限释放的时刻（mcycle）
+	acoral_period_stat_t stat;				///<运行统计
 }acoral_period_policy_data_t;
 
 void period_thread_exit(void);
-void period_thread_delay(acoral_thread_t* thread,unsigned int time);
 void period_delay_deal(void);
+void acoral_periodqueue_add(acoral_thread_t *new);
+
+/**
+ * @brief 距离周期等待队列中最近一次释放还有多少个tick
+ * 
+ * @return unsigned int tick数，至少为1；队列为空时返回0xFFFFFFFF
+ */
+unsigned int period_next_expiry(void);
 
 void period_policy_init(void);
+
+/***************周期线程API****************/
+
+/**
+ * @brief 周期线程结束本周期的作业，原地睡眠到下一次释放的绝对时间
+ * @note 线程函数可以写成 for(;;){ 作业; acoral_period_wait(); } 的形式，局部变量在周期之间保留；
+ *       如果下一次释放已经到了（超限），立即返回开始新作业
+ */
+void acoral_period_wait(void);
+
+/**
+ * @brief 获取周期线程（包括EDF线程）的运行统计
+ * 
+ * @param thread_id 线程id
+ * @param stat 统计结果输出
+ * @return int 成功返回0，线程不是周期线程返回-1
+ */
+int acoral_period_get_stat(int thread_id, acoral_period_stat_t *stat);
+
+#if CFG_THRD_EDF
+/**
+ * @brief 注册EDF机制
+ * @note 调用时机为系统初始化阶段，EDF线程复用周期线程的释放机制
+ */
+void edf_policy_init(void);
+
+/**
+ * @brief 获取当前已准入的EDF线程总利用率
+ * 
+ * @return unsigned int 利用率，千分比
+ */
+unsigned int acoral_edf_get_util(void);
+#endif
 #endif
@@ -25,7 +25,10 @@ typedef struct acoral_thread_tcb acoral_thread_t;
 
 typedef enum{
 	ACORAL_SCHED_POLICY_COMM,
-	ACORAL_SCHED_POLICY_PERIOD
+	ACORAL_SCHED_POLICY_PERIOD,
+	ACORAL_SCHED_POLICY_RR,
+	ACORAL_SCHED_POLICY_EDF,
+	ACORAL_SCHED_POLICY_MAX ///<策略种数，新策略加在它前面
 }acoralSchedPolicyEnum;
 
 /**
@@ -34,7 +37,7 @@ typedef enum{
  */
 typedef struct{
     acoral_res_t res;
-	acoral_list_t list; 	///<用于把各个调度策略串到一个链表上，创建线程找策略的时候就去这个链表上，根据策略名找
+	acoral_list_t list; 	///<用于把各个调度策略串到一个链表上，时钟中断里依次调用各策略的delay_deal
 	unsigned char type; 		///<策略名
 	int (*policy_thread_init)(acoral_thread_t *,void *); ///<某种策略的初始化函数，用于线程创建时调用
 	void (*policy_thread_release)(acoral_thread_t *); 	///<某种策略的释放函数，用于消灭线程时调用
@@ -0,0 +1,145 @@
+/**
+ * @file reserve.h
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief kernel层，CPU预留与硬实时段头文件
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ */
+#ifndef ACORAL_RESERVE_H
+#define ACORAL_RESERVE_H
+
+#include "autocfg.h"
+#include "list.h"
+#include "thread.h"
+
+#if CFG_RESERVE
+
+/**
+ * @brief 预算用完时对线程的处理
+ *
+ */
+typedef enum{
+	ACORAL_RESERVE_DEMOTE,		///<降到ACORAL_NONHARD_RT_PRIO_MIN继续运行，只用别人剩下的CPU，补充后恢复
+	ACORAL_RESERVE_SUSPEND		///<挂起到补充为止；占用着互斥量时改为降级，免得把等待者也拖住
+}acoralReserveActionEnum;
+
+/**
+ * @brief 预留参数
+ *
+ */
+typedef struct{
+	unsigned int budget_mm;				///<每个补充周期内可用的CPU时间，单位为毫秒
+	unsigned int period_mm;				///<补充周期，单位为毫秒
+	acoralReserveActionEnum action;		///<预算用完时的处理
+}acoral_reserve_param_t;
+
+/**
+ * @brief 一次待补充的预算
+ *
+ */
+typedef struct{
+	unsigned int due;					///<补充的绝对时间（ticks）
+	unsigned int amount;				///<补充的ticks数
+}acoral_reserve_repl_t;
+
+/**
+ * @brief CPU预留，按偶发服务器（sporadic server）的规则补充：
+ *        线程从有预算时开始运行起算一次激活，这次激活用掉多少，就在激活开始后一个周期补回多少
+ * @note 预算按tick计，每个tick记给正在各核上运行的线程，精度和时间片轮转一样是一个tick
+ */
+typedef struct acoral_reserve{
+	acoral_list_t hook;					///<挂到全局预留链表，在ticks中断中遍历
+	acoral_thread_t *thread;			///<所属线程，线程创建完成之前为NULL
+	unsigned int budget;				///<预算，单位为ticks
+	unsigned int period;				///<补充周期，单位为ticks
+	unsigned int remain;				///<剩余预算
+	unsigned int act_start;				///<本次激活开始的时间（ticks）
+	unsigned int act_used;				///<本次激活已经用掉的ticks
+	unsigned int util;					///<预算占周期的千分比，硬实时线程用于准入控制
+	unsigned int overruns;				///<预算用完的次数
+	acoralReserveActionEnum action;		///<预算用完时的处理
+	unsigned char active;				///<本次激活还没结束
+	unsigned char throttled;			///<预算已经用完，等待补充
+	unsigned char suspended;			///<throttled时线程是被挂起的，否则是被降级的
+	unsigned char hard;					///<硬实时段线程的预留
+	unsigned char cpu;					///<硬实时线程绑定的核
+	unsigned char base_prio;			///<被降级前线程的base_prio
+	unsigned char repl_head;			///<补充环形队列的队头
+	unsigned char repl_num;				///<补充环形队列中的个数
+	acoral_reserve_repl_t repl[CFG_RESERVE_MAX_REPL];	///<按时间先后排列的待补充预算
+}acoral_reserve_t;
+
+/**
+ * @brief 预留的ticks处理：到期的补充、给正在运行的线程扣预算、结束已经阻塞的线程的激活
+ * @note 在ticks中断中调用，调用时已经在临界区里
+ */
+void acoral_reserve_tick(void);
+
+#if CFG_TICKLESS
+/**
+ * @brief 距离被限制的线程最近一次补充还有多少个tick
+ *
+ * @return unsigned int tick数，至少为1；没有被限制的线程时返回0xFFFFFFFF
+ */
+unsigned int acoral_reserve_next_expiry(void);
+#endif
+
+/**
+ * @brief 线程退出时解除它的预留，硬实时线程的利用率从所在核上减掉
+ * @note 在acoral_kill_thread的临界区中调用
+ *
+ * @param thread 线程指针
+ */
+void acoral_reserve_release(acoral_thread_t *thread);
+
+/***************CPU预留API****************/
+
+/**
+ * @brief 给线程设置CPU预留，限制它在每个补充周期内最多用多少CPU
+ * @note 只支持普通策略和时间片轮转策略的线程，周期、EDF线程有自己的时间模型；
+ *       已经有预留的线程会先解除旧的预留、用新参数重新开始；硬实时线程的预留不能修改
+ *
+ * @param thread_id 线程id
+ * @param param 预留参数，NULL表示解除预留
+ * @return int 成功返回0，参数错误、线程策略不支持、内存不足或者是硬实时线程返回-1
+ */
+int acoral_thread_set_reserve(int thread_id, acoral_reserve_param_t *param);
+
+/**
+ * @brief 查询线程预算用完的次数
+ *
+ * @param thread_id 线程id
+ * @return int 次数，线程不存在或没有预留返回-1
+ */
+int acoral_thread_reserve_overruns(int thread_id);
+
+#if CFG_HARD_RT_PRIO_NUM
+/**
+ * @brief 在硬实时段创建线程，线程绑定在核cpu上并带有CPU预留
+ * @note 准入控制：核cpu上所有硬实时线程的预算/周期之和不能超过CFG_HARD_RT_UTIL_BOUND，
+ *       超过时拒绝创建；硬实时段高于所有其他用户线程，预算保证了它们占不满CPU
+ *
+ * @param name 线程名字
+ * @param route 线程函数
+ * @param args 线程函数参数
+ * @param stack_size 线程栈大小
+ * @param prio 段内优先级，0最高，小于CFG_HARD_RT_PRIO_NUM
+ * @param cpu 绑定的核
+ * @param param 预留参数
+ * @return int 成功返回线程id，参数错误、准入失败或资源不足返回-1
+ */
+int acoral_create_hard_rt_thread(char *name, void (*route)(void *args), void *args, unsigned int stack_size, unsigned char prio, unsigned int cpu, acoral_reserve_param_t *param);
+
+/**
+ * @brief 查询核上硬实时线程已经占用的利用率
+ *
+ * @param cpu 核
+ * @return unsigned int 千分比
+ */
+unsigned int acoral_hard_rt_get_util(unsigned int cpu);
+#endif
+
+#endif
+
+#endif
@@ -12,20 +12,26 @@
 #include "autocfg.h"
 #include "list.h"
 
-///pool->id[9:0]表示该资源池在acoral_res_system.system_res_pools中的编号
-#define ACORAL_POOL_INDEX_BIT 0
-#define ACORAL_POOL_INDEX_MASK (0x3FF << ACORAL_POOL_INDEX_BIT)
-
-///res->id[13:10]表示该资源的类型（acoralResourceTypeEnum）
-#define ACORAL_RES_TYPE_BIT 10
-#define ACORAL_RES_TYPE_MASK   (0xF << ACORAL_RES_TYPE_BIT)
-
-///res->id[23:16]表示该资源在本资源池中的编号
-#define ACORAL_RES_INDEX_BIT 16 ///<资源在资源池被创建后，初始的res->id的高16位表示该资源在资源池中的编号
-#define ACORAL_RES_INDEX_MASK  (0xFF << ACORAL_RES_INDEX_BIT)
+///在用资源的id就是句柄：id[11:0]是句柄表下标，id[27:12]是该句柄的代数
+#define ACORAL_HANDLE_INDEX_BITS 12
+#define ACORAL_HANDLE_INDEX_MASK ((1u << ACORAL_HANDLE_INDEX_BITS) - 1)
+#define ACORAL_HANDLE_GEN_MASK 0xFFFF
+
+///根据资源id获取句柄表下标
+#define ACORAL_HANDLE_INDEX(id) ((unsigned int)(id) & ACORAL_HANDLE_INDEX_MASK)
+///根据资源id获取句柄代数
+#define ACORAL_HANDLE_GEN(id) ((unsigned int)(id) >> ACORAL_HANDLE_INDEX_BITS)
+///空闲句柄链表的结尾
+#define ACORAL_HANDLE_NONE 0xFFFF
+
+#if CFG_MAX_HANDLES > (1 << ACORAL_HANDLE_INDEX_BITS)
+#error "CFG_MAX_HANDLES must not exceed 4096"
+#endif
 
-///根据资源id获取资源类型
-#define ACORAL_RES_TYPE(id) ((id&ACORAL_RES_TYPE_MASK)>>ACORAL_RES_TYPE_BIT)
+///空闲资源的id[31:16]是它在本资源池中的编号，id[15:0]即next_id
+#define ACORAL_RES_SLOT_BIT 16
+///一个资源池最多容纳的资源数
+#define ACORAL_RES_MAX_SLOTS (1u << ACORAL_RES_SLOT_BIT)
 
 /**
  * @brief aCoral包含的资源类型
@@ -51,6 +57,14 @@ typedef enum{
 #endif
 
     ACORAL_RES_TIMER, ///<定时器
+
+#if CFG_WORKQUEUE
+    ACORAL_RES_WORK, ///<工作队列任务描述符
+#endif
+
+#if CFG_SLAB
+    ACORAL_RES_CACHE, ///<对象缓存控制块，对象缓存自己的slab也记为这个类型
+#endif
     ACORAL_RES_MAX ///<未分配的资源池
 }acoralResourceTypeEnum;
 
@@ -66,7 +80,7 @@ typedef enum{
 }acoralResourceReturnValEnum;
 
 /**
- * @brief id虽然是32位的，但实际上只有高16位，因为低16位属于next_id，之所以用union的写法：
+ * @brief 资源空闲时，id的高16位是它在资源池中的编号，低16位属于next_id；分配出去后id整体是句柄。之所以用union的写法：
  *        1、是为了给id的低16位取个名字叫next_id。提高代码的可读性
  *        2、是为了将id直接作为资源的id，可以整体访问，如果用struct的方式，分段定义id的各个字段，那返回整个struct才是资源的id
  */
@@ -75,17 +89,20 @@ typedef union {
    unsigned short next_id; 
 }acoral_res_t;
 
+struct acoral_res_pool_ctrl;
+
 /**
  * @brief  资源池
 */
 typedef struct {
    void *base_adr; ///< 在资源池未被未分配的时,在acoral_res_system.system_free_res_pool数组中指向下一个未被分配的资源池；分配后为该资源池管理的资源的基地址
    void *res_free; ///< 指向当前资源池中第一个空闲的资源
-   int id; ///< bit[13:10]:资源类型；bit[9:0]:在acoral_res_system.system_res_pools中的编号
+   int id; ///< 在acoral_res_system.system_res_pools中的编号
    unsigned int size; ///< 该资源池中每个资源的大小
    unsigned int num; ///< 资源池中资源的总数
    unsigned int free_num; ///< 资源池中未分配的资源个数
-   acoralResourceTypeEnum type; ///< 该资源池的类型（acoralResourceTypeEnum）//SPG 好像没用到
+   acoralResourceTypeEnum type; ///< 该资源池的类型（acoralResourceTypeEnum）
+   struct acoral_res_pool_ctrl *ctrl; ///< 该资源池所属的资源池控制块，释放资源时据此把资源池挂回free_pools
    acoral_list_t ctrl_list; ///< 资源池创建后挂载到资源池控制块pools链表上的钩子
    acoral_list_t free_list; ///< 资源池中尚有未分配的资源时，挂载到资源池控制块free_pools链表的钩子
 }acoral_pool_t;
@@ -94,7 +111,7 @@ typedef struct {
  * @brief  资源池控制块
  * 
  */
-typedef struct {
+typedef struct acoral_res_pool_ctrl {
   unsigned int type;            ///< 该资源池控制块所管理的资源类型（acoralResourceTypeEnum）
   unsigned int size;            ///< 该资源池控制块所管理的单个资源的大小
   unsigned int num_per_pool;    ///< 该资源池控制块管理的资源池中，每个资源池包含的资源数量
@@ -105,14 +122,28 @@ typedef struct {
   void* type_private_data;      ///< 该资源池控制块所拥有的一些独占数据结构，一般都是一些全局列表、变量等，放在一起便于管理
 }acoral_res_pool_ctrl_t;
 
+/**
+ * @brief 句柄表项，资源id通过它O(1)找到资源
+ *
+ */
+typedef struct {
+   void *obj;            ///< 句柄指向的资源，空闲句柄为NULL
+   unsigned short gen;   ///< 代数，每释放一次加1，旧id的代数对不上就查不到资源
+   unsigned short pool;  ///< 资源所在资源池在system_res_pools中的编号；句柄空闲时是下一个空闲句柄
+   unsigned char type;   ///< 资源类型（acoralResourceTypeEnum）
+}acoral_handle_t;
+
 /**
  * @brief aCoral资源管理系统顶层数据结构
  * 
  */
 typedef struct {
     acoral_pool_t system_res_pools[CFG_MAX_RES_POOLS]; ///<系统中所有的资源池
-    int system_res_pools_bitmap[(CFG_MAX_RES_POOLS+31)/32]; ///<每一位0代表未分配，1代表已分配
+    unsigned int system_res_pools_bitmap[(CFG_MAX_RES_POOLS+31)/32]; ///<每一位0代表未分配，1代表已分配
     acoral_res_pool_ctrl_t system_res_ctrl_container[ACORAL_RES_MAX]; ///<各类资源池控制块的容器
+    acoral_handle_t handles[CFG_MAX_HANDLES]; ///<句柄表
+    unsigned int free_handle; ///<空闲句柄链表头，ACORAL_HANDLE_NONE表示句柄用完了
+    unsigned int live_bitmap[ACORAL_RES_MAX][(CFG_MAX_HANDLES+31)/32]; ///<每类资源一张位图，置位的句柄正在使用
 }acoral_res_system_t;
 
 extern acoral_res_system_t acoral_res_system;
@@ -141,14 +172,55 @@ acoral_res_t *acoral_get_res(acoralResourceTypeEnum res_type);
  */
 void acoral_release_res(acoral_res_t *res);
 
+/**
+ * @brief 从任意资源池控制块中获取一个资源，空闲资源池用完时在max_pools以内新建一个
+ * @note acoral_get_res按类型找到系统的资源池控制块后调用它；对象缓存用自己的资源池控制块调用它
+ *
+ * @param pool_ctrl 资源池控制块
+ * @return acoral_res_t* 资源指针，资源池数量到上限或内存不足返回NULL
+ */
+acoral_res_t *acoral_pool_ctrl_get_res(acoral_res_pool_ctrl_t *pool_ctrl);
+
+/**
+ * @brief 把资源还给指定的资源池，资源池从满变为不满时挂回所属控制块的free_pools
+ * @note 不检查资源的id，调用者要保证res确实属于pool；资源的第一个字会被改写成空闲链表
+ *
+ * @param pool 资源所在的资源池
+ * @param res 要释放的资源
+ */
+void acoral_pool_put_res(acoral_pool_t *pool, acoral_res_t *res);
+
+/**
+ * @brief 把整个资源池还给伙伴系统，并归还它在acoral_res_system.system_res_pools中的位置
+ * @note 不检查资源池里是否还有在用的资源
+ *
+ * @param pool 资源池
+ */
+void acoral_release_res_pool(acoral_pool_t *pool);
+
 /**
  * @brief 根据id获取某一资源
+ * @note 在临界区里核对代数，id对应的资源已经释放时返回NULL；返回之后资源仍可能被释放，要继续使用的话调用者自己在临界区中调用
  *
  * @param id 资源id
  * @return acoral_res_t* 获取到的资源
  */
 acoral_res_t * acoral_get_res_by_id(int id);
 
+/**
+ * @brief 从pos开始找下一个type类型的在用资源，只扫在用句柄位图，和资源池容量无关
+ * @note 必须在临界区中遍历，调度锁只管本核，另一个核仍然可能释放资源；要打印等耗时处理的先在临界区里拷出来
+ *
+ * @param type 资源类型
+ * @param pos 遍历位置，从0开始，返回时指向下一次开始的位置
+ * @return acoral_res_t* 找到的资源，没有了返回NULL
+ */
+acoral_res_t *acoral_res_iter(acoralResourceTypeEnum type, unsigned int *pos);
+
+///遍历某一类型的全部在用资源
+#define acoral_for_each_res(type, pos, res) \
+    for ((pos) = 0; ((res) = acoral_res_iter((type), &(pos))) != NULL;)
+
 /**
  * @brief 资源池中的资源id和next_id初始化
  *
@@ -0,0 +1,36 @@
+/**
+ * @file rr_thrd.h
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief kernel层，时间片轮转（Round-Robin）策略线程
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ */
+#ifndef ACORAL_RR_THRD_H
+#define ACORAL_RR_THRD_H
+
+#include "thread.h"
+
+/**
+ * @brief 时间片轮转策略数据块
+ * @note 创建线程时data可以为NULL，此时时间片为CFG_RR_DEFAULT_SLICE_MS
+ */
+typedef struct{
+	unsigned int slice_mm;		///<时间片长度，单位为毫秒，0表示使用默认值
+	unsigned int slice_ticks;	///<时间片长度换算成的ticks数，由内核填写
+	unsigned int remain_ticks;	///<本轮剩余的ticks数，主动让出或阻塞时保留，用完后才重新装满
+}acoral_rr_policy_data_t;
+
+/**
+ * @brief 时间片轮转策略的ticks处理，当前线程时间片用完时将其轮转到同优先级队列尾部
+ * @note 在ticks中断中通过acoral_policy_delay_deal调用
+ */
+void rr_delay_deal(void);
+
+/**
+ * @brief 注册时间片轮转机制
+ * @note 调用时机为系统初始化阶段
+ */
+void rr_policy_init(void);
+
+#endif
@@ -0,0 +1,143 @@
+/**
+ * @file slab.h
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief kernel层，对象缓存（slab）头文件
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ */
+#ifndef ACORAL_SLAB_H
+#define ACORAL_SLAB_H
+
+#include "autocfg.h"
+#include "list.h"
+#include "resource.h"
+
+#if CFG_SLAB
+
+///一个slab最多放的对象数，受资源id中资源编号的位数限制
+#define ACORAL_SLAB_MAX_OBJS ACORAL_RES_MAX_SLOTS
+
+/**
+ * @brief 每个核上的弹匣，分配释放先在这里进行，只需要关本核中断
+ *
+ */
+typedef struct{
+	void *objs[CFG_SLAB_MAG_SIZE];	///<弹匣里的对象，后进先出，刚释放的对象还在cache里
+	unsigned int num;				///<弹匣里的对象个数
+	unsigned int alloc_hit;			///<直接从弹匣分配的次数
+	unsigned int alloc_miss;		///<弹匣空了，从slab层补充的次数
+	unsigned int free_hit;			///<直接放回弹匣的次数
+	unsigned int free_miss;			///<弹匣满了，还一半给slab层的次数
+}acoral_cache_mag_t;
+
+/**
+ * @brief 对象缓存，从ACORAL_RES_CACHE资源池中分配。
+ *        slab层沿用资源池：每个slab是一个资源池，空闲对象用资源池的空闲链表串起来，slab从伙伴系统分配、空了以后还给伙伴系统
+ *
+ */
+typedef struct{
+	acoral_res_t res;				///<对象缓存控制块也是资源
+	char *name;						///<名字
+	unsigned int obj_size;			///<创建时指定的对象大小
+	void (*ctor)(void *obj);		///<对象从slab层取出时调用的构造函数，可以为NULL
+	acoral_res_pool_ctrl_t slabs;	///<slab层的资源池控制块，size是按对齐取整后的对象间距
+	unsigned int free_objs;			///<slab层的空闲对象数，不含弹匣里的
+	unsigned int grows;				///<新建slab的次数
+	unsigned int shrinks;			///<释放slab的次数
+	unsigned int fails;				///<分配失败的次数
+	acoral_list_t list;				///<挂到全局对象缓存链表上
+	acoral_cache_mag_t mag[CFG_MAX_CPU];	///<各核的弹匣
+}acoral_cache_t;
+
+/**
+ * @brief 对象缓存的统计信息
+ *
+ */
+typedef struct{
+	unsigned int obj_size;			///<对象大小
+	unsigned int stride;			///<按对齐取整后每个对象占用的字节数
+	unsigned int objs_per_slab;		///<每个slab中的对象数
+	unsigned int slabs;				///<当前的slab数
+	unsigned int in_use;			///<在用的对象数
+	unsigned int cached;			///<各核弹匣中的对象数
+	unsigned int free;				///<slab层的空闲对象数
+	unsigned int allocs;			///<分配次数
+	unsigned int alloc_misses;		///<弹匣空了的次数
+	unsigned int frees;				///<释放次数
+	unsigned int free_misses;		///<弹匣满了的次数
+	unsigned int grows;				///<新建slab的次数
+	unsigned int shrinks;			///<释放slab的次数
+	unsigned int fails;				///<分配失败的次数
+}acoral_cache_stat_t;
+
+/***************对象缓存API****************/
+
+/**
+ * @brief 创建对象缓存
+ * @note 对象间距为obj_size按align取整，至少4字节；每个slab按CFG_SLAB_OBJS_PER_SLAB个对象向伙伴系统申请，
+ *       取整后多出来的空间也放对象；slab数受CFG_SLAB_MAX_SLABS限制
+ *
+ * @param name 名字，只保存指针
+ * @param obj_size 对象大小
+ * @param align 对齐，2的幂，不超过伙伴系统的基本内存块大小；0表示按指针大小对齐
+ * @param ctor 构造函数，对象从slab层进入弹匣时调用，之后在弹匣里循环使用的对象不再构造，
+ *             所以释放对象时要让它保持构造后的状态；NULL表示不构造
+ * @return acoral_cache_t* 对象缓存，参数错误或资源不足返回NULL
+ */
+acoral_cache_t *acoral_cache_create(char *name, unsigned int obj_size, unsigned int align, void (*ctor)(void *obj));
+
+/**
+ * @brief 销毁对象缓存，slab全部还给伙伴系统
+ * @note 调用者保证没有线程还会使用这个对象缓存
+ *
+ * @param cache 对象缓存
+ * @return int 成功返回0，还有对象没有释放返回-1，此时对象缓存不变
+ */
+int acoral_cache_destroy(acoral_cache_t *cache);
+
+/**
+ * @brief 从对象缓存分配一个对象
+ * @note 弹匣非空时只关本核中断取一个对象；弹匣空了从slab层成批补充半个弹匣，必要时新建slab；可在中断中调用
+ *
+ * @param cache 对象缓存
+ * @return void* 对象，内存不足或slab数到上限返回NULL
+ */
+void *acoral_cache_alloc(acoral_cache_t *cache);
+
+/**
+ * @brief 把对象还给对象缓存
+ * @note 弹匣没满时只关本核中断放回；满了就把半个弹匣还给slab层，slab层空闲对象超过一个slab时把全空的slab还给伙伴系统
+ *
+ * @param cache 对象缓存
+ * @param obj 对象
+ */
+void acoral_cache_free(acoral_cache_t *cache, void *obj);
+
+/**
+ * @brief 把本核弹匣里的对象还给slab层，再把所有全空的slab还给伙伴系统
+ * @note 其他核弹匣里的对象不动
+ *
+ * @param cache 对象缓存
+ * @return unsigned int 释放的slab数
+ */
+unsigned int acoral_cache_shrink(acoral_cache_t *cache);
+
+/**
+ * @brief 获取对象缓存的统计信息
+ *
+ * @param cache 对象缓存
+ * @param stat 结果
+ * @return int 成功返回0，参数为NULL返回-1
+ */
+int acoral_cache_stat(acoral_cache_t *cache, acoral_cache_stat_t *stat);
+
+/**
+ * @brief 打印所有对象缓存的统计信息
+ *
+ */
+void acoral_cache_scan(void);
+
+#endif
+
+#endif
@@ -84,5 +84,35 @@ void acoral_set_ticks(unsigned int time);
  */
 unsigned int acoral_get_ticks();
 
+#if CFG_TICKLESS
+/**
+ * @brief 计算延时、超时、周期等待队列中最早到期的时间
+ * @note 需要在关中断时调用
+ * 
+ * @return unsigned int 距离最早到期还有多少个tick，至少为1；都为空时返回CFG_TICKLESS_MAX_TICKS
+ */
+unsigned int acoral_next_expiry_ticks(void);
+
+/**
+ * @brief 一次补上n个tick：推进ticks计数，并把差分队列整体推进n个tick，途中到期的线程照常就绪
+ * @note 用于tickless睡眠醒来后补上被跳过的tick，需要在关中断时调用
+ * 
+ * @param n tick数
+ */
+void acoral_ticks_announce(unsigned int n);
+
+/**
+ * @brief idle线程的tickless睡眠：把定时器推迟到最早到期的时间后WFI，醒来后补上跳过的tick
+ * 
+ */
+void acoral_tickless_idle(void);
+
+/**
+ * @brief 队列里新加的到期成了队首时调用，别的核正在tickless睡眠就用核间中断叫醒它重新计算睡眠时长，需在临界区中调用
+ * 
+ */
+void acoral_tickless_kick(void);
+#endif
+
 #endif
 
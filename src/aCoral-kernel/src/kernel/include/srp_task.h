@@ -0,0 +1,78 @@
+/**
+ * @file srp_task.h
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief kernel层，共享栈的运行到完成任务头文件
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ */
+#ifndef ACORAL_SRP_TASK_H
+#define ACORAL_SRP_TASK_H
+
+#include "autocfg.h"
+#include "list.h"
+#include "thread.h"
+
+#if CFG_SRP
+
+/**
+ * @brief 抢占级别，同一个核上同一优先级的任务都由它的执行线程依次运行，共用执行线程的栈
+ *
+ */
+typedef struct
+{
+	acoral_list_t hook;             ///<用于挂载到全局的级别链表
+	acoral_list_t ready;            ///<已激活、等待执行的任务，先进先出
+	acoral_thread_t *thread;        ///<执行线程，栈大小为CFG_SRP_STACK_SIZE；执行线程创建完之前为NULL
+	unsigned char prio;             ///<抢占级别，也是执行线程的优先级
+	unsigned char cpu;              ///<执行线程绑定的核
+	unsigned char idle;             ///<执行线程没有任务可运行、挂起了自己
+	unsigned int ntasks;            ///<属于这个级别的任务数
+}acoral_srp_level_t;
+
+/**
+ * @brief 运行到完成任务，没有自己的TCB和栈，激活一次就在所属级别的执行线程上运行一次route
+ *
+ */
+typedef struct
+{
+	acoral_list_t hook;             ///<激活后挂到所属级别的ready链表
+	char *name;                     ///<名字
+	void (*route)(void *args);      ///<任务函数，必须返回，不能阻塞
+	void *args;                     ///<任务函数参数
+	acoral_srp_level_t *level;      ///<所属级别
+	unsigned int pending;           ///<已激活但还没执行完的次数，0表示空闲
+	unsigned int runs;              ///<已执行完的次数
+}acoral_srp_task_t;
+
+/***************共享栈任务API****************/
+
+/**
+ * @brief 创建运行到完成任务
+ * @note 第一次在某个核的某个优先级上创建任务时，会创建这个级别的执行线程并绑定到该核上。
+ *       同一级别的任务不会互相抢占，一个运行完了才开始下一个，所以只需要一个栈；
+ *       只用acoral_mutex_pend2申请本核上的天花板互斥量时，SRP保证任务开始运行之后不会阻塞，
+ *       不同级别之间的抢占也只会在栈上层层往下压，不会出现一个任务停在半路、另一个任务又用同一个栈的情况。
+ *       任务函数里不能延时、等信号量、等消息，也不能申请跨核使用的互斥量，否则会挡住同一级别的其他任务
+ *
+ * @param name 名字
+ * @param route 任务函数
+ * @param args 任务函数参数
+ * @param prio 抢占级别，即执行线程的优先级（ACORAL_HARD_PRIO）
+ * @param cpu 执行线程绑定的核
+ * @return acoral_srp_task_t* 任务指针，失败返回NULL
+ */
+acoral_srp_task_t *acoral_srp_task_create(char *name, void (*route)(void *args), void *args, unsigned char prio, unsigned int cpu);
+
+/**
+ * @brief 激活任务，任务会在它所属的级别上执行一次
+ * @note 不阻塞，可以在中断中调用；任务还没执行完时再激活，会在执行完后接着再执行一次
+ *
+ * @param task 任务指针
+ * @return int 成功返回0，参数错误返回-1
+ */
+int acoral_srp_task_activate(acoral_srp_task_t *task);
+
+#endif
+
+#endif
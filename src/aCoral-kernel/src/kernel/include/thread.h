@@ -22,15 +22,31 @@
 #include "event.h"
 #include "policy.h"
 #include "soft_timer.h"
+#include "hal.h"
 
 #include <stdbool.h>
 
-extern unsigned char system_need_sched; 
+extern unsigned char system_need_scheds[CFG_MAX_CPU];
 extern unsigned char system_sched_locked;
-extern acoral_thread_t *acoral_cur_thread;
+extern unsigned int acoral_sched_lock_nesting[CFG_MAX_CPU];
+extern acoral_thread_t *acoral_cur_threads[CFG_MAX_CPU];
 
-///就绪队列中的优先级位图的大小，目前等于2，算法就是优先级数目除以32向上取整
-#define ACORAL_MAX_PRIO_NUM ((CFG_MAX_THREAD + 1) & 0xff) ///<41。总共有40个线程，就有0~40共41个优先级
+#define acoral_current_cpu() HAL_GET_CURRENT_CPU() ///<当前核号
+
+#define ACORAL_CPU_MASK(cpu) (1u << (cpu))               ///<只含一个核的亲和性掩码
+#define ACORAL_CPU_MASK_ALL ((1u << CFG_MAX_CPU) - 1)    ///<允许在所有核上运行
+
+#define ACORAL_STACK_PAINT 0xdeadbeef ///<CFG_STACK_PAINT时填充线程栈的标记，和hal_stack_init填充初始上下文的值相同
+
+///当前核的调度标志
+#define system_need_sched (system_need_scheds[acoral_current_cpu()])
+
+///当前核上运行的线程，关中断读取，防止读到核号之后被迁移到另一个核
+#define acoral_cur_thread (acoral_get_cur_thread())
+
+#define ACORAL_MAX_PRIO_NUM (CFG_MAX_PRIO_NUM) ///<优先级个数，由CFG_MAX_PRIO_NUM单独配置，不再和线程数绑定
+
+///就绪队列中二级优先级位图的大小，算法就是优先级数目除以32向上取整，最多256个优先级时为8
 #define PRIO_BITMAP_SIZE ((ACORAL_MAX_PRIO_NUM+31)/32) 
 
 /**
@@ -41,14 +57,16 @@ typedef enum{
 	ACORAL_INIT_PRIO,	///<init线程独有的0优先级
 	ACORAL_MAX_PRIO,	///<aCoral系统中允许的最高优先级
 	ACORAL_HARD_RT_PRIO_MAX,	///<硬实时任务最高优先级
-	ACORAL_HARD_RT_PRIO_MIN = ACORAL_HARD_RT_PRIO_MAX+CFG_HARD_RT_PRIO_NUM,	///<硬实时任务最低优先级
+	ACORAL_HARD_RT_PRIO_MIN = ACORAL_HARD_RT_PRIO_MAX+CFG_HARD_RT_PRIO_NUM-1,	///<硬实时任务最低优先级，CFG_HARD_RT_PRIO_NUM为0时硬实时段为空
 	ACORAL_NONHARD_RT_PRIO_MAX,	///<非硬实时任务最高优先级
 
-    ACORAL_NONHARD_RT_PRIO_MIN = CFG_MAX_THREAD-2,	///<非硬实时任务最低优先级
-	ACORAL_DAEMON_PRIO,	///<daemon回收线程专用优先级
+    ACORAL_NONHARD_RT_PRIO_MIN = ACORAL_MAX_PRIO_NUM-3,	///<非硬实时任务最低优先级
 	ACORAL_IDLE_PRIO	///<idle线程专用优先级，也是系统最低优先级ACORAL_MINI_PRIO
 }acoralPrioEnum;
 
+///优先级是否落在硬实时段
+#define ACORAL_IS_HARD_RT_PRIO(prio) ((prio) >= ACORAL_HARD_RT_PRIO_MAX && (prio) <= ACORAL_HARD_RT_PRIO_MIN)
+
 typedef enum{
 	ACORAL_NONHARD_PRIO, ///<非硬实时任务的优先级，会将tcb中的prio加上ACORAL_NONHARD_RT_PRIO_MAX
 	ACORAL_HARD_PRIO	 ///<硬实时任务优先级，会将tcb中的prio加上ACORAL_HARD_RT_PRIO_MAX
@@ -58,8 +76,8 @@ typedef enum{
 	ACORAL_THREAD_STATE_READY = 1,			///表示线程已经被挂载到acoral_ready_queues，就绪状态
 	ACORAL_THREAD_STATE_SUSPEND = 1<<1,		///表示线程已经被从acoral_ready_queues取下，挂起状态
 	ACORAL_THREAD_STATE_RUNNING = 1<<2, 	///表示线程正在运行
-	ACORAL_THREAD_STATE_EXIT = 1<<3,		///表示线程已经运行完毕，但还不能被daem线程释放，等待被切换之后才能彻底送走
-	ACORAL_THREAD_STATE_RELEASE = 1<<4,		///表示线程已经运行完毕并已经被切换，等待daem回收TCB和堆栈资源
+	ACORAL_THREAD_STATE_EXIT = 1<<3,		///表示线程已经运行完毕，但还不能被释放，等待被切换之后才能彻底送走
+	ACORAL_THREAD_STATE_RELEASE = 1<<4,		///表示线程已经运行完毕并已经被切换，等待下一次调度或创建线程时回收TCB和堆栈资源
 	ACORAL_THREAD_STATE_DELAY = 1<<5,		///表示线程将在一段时间之后被重新唤醒并挂载到acoral_ready_queues上，对于普通线程来说，就是调用了delay接口，对于周期线程来说，就是周期
 }acoralThreadStateEnum;
 
@@ -76,7 +94,8 @@ typedef struct acoral_thread_tcb{
 	acoralThreadStateEnum state;    ///<线程状态  
     void (*route)(void *args); 	    ///<线程函数
 	void* args; 				    ///<线程函数的参数
-	unsigned char prio;             ///<原始优先级
+	unsigned char prio;             ///<当前生效的优先级，就绪队列按它排序，可能被互斥量的优先级继承或天花板提升
+	unsigned char base_prio;        ///<线程自己的优先级，不含继承来的提升，互斥量全部释放后恢复到它
     acoralPrioTypeEnum prio_type;   ///<线程优先级类型，包括硬实时任务ACORAL_HARD_PRIO、非硬实时任务ACORAL_NONHARD_PRIO
 	acoralSchedPolicyEnum policy;   ///<调度策略
     void* policy_data;              ///<调度策略专用数据
@@ -89,38 +108,153 @@ typedef struct acoral_thread_tcb{
     /* 钩子 */
     acoral_list_t ready_hook;	        ///<用于挂载到全局就绪队列
 	acoral_list_t timeout_hook;         ///<用于挂载到全局timeout队列
-    acoral_list_t daem_hook;            ///<用于挂载到daem线程回收队列
+    acoral_list_t release_hook;         ///<用于挂载到线程回收队列
     acoral_list_t ipc_waiting_hook;     ///<用于挂载到ipc（互斥量、信号量、消息）等待队列
 #if	CFG_THRD_PERIOD
 	acoral_list_t period_wait_hook; ///<周期等待队列
+#endif
 
     /* timer */
-    acoral_timer_t* thread_period_timer; ///<用于周期线程等待下一个周期到来，因为线程在等待这个周期的过程中是处于运行状态的，因此不能和thread_timer共用
-#endif
     acoral_timer_t* thread_timer; ///<用于等待互斥量、信号量等的超时时间timeout、线程延时acoral_delay_self的时间，这些等待过程的共同点在于线程都是在suspend状态下等待的，不存在又等互斥量又等线程延时时间的情况，因此可以共用一个timer
 	
     /* 获取的资源 */
-    acoral_evt_t* evt; //SPG 只能获取一个信号量或者互斥量？
+    acoral_evt_t* evt;              ///<正在等待的信号量或互斥量，不在等待时为NULL
+    acoral_list_t held_mutexes;     ///<当前占用的互斥量，通过acoral_evt_t的owner_hook串起来，用于计算继承来的优先级
+#if CFG_RESERVE
+    struct acoral_reserve *reserve; ///<CPU预留，没有预留时为NULL
+#endif
+#if CFG_SRP
+    unsigned char srp_nesting;      ///<按SRP占用的天花板互斥量个数，不为0时系统天花板记在所在核上，线程不能迁移
+#endif
+
+    /* 多核 */
+    unsigned char cpu;              ///<所在就绪队列的核，也是最近一次运行所在的核
+    unsigned int affinity;          ///<CPU亲和性掩码，第i位为1表示允许在核i上运行
+    unsigned int migrations;        ///<在核之间迁移的次数
+    int crit_nesting;               ///<被换下时所在核的临界区嵌套层数，换上时恢复
+    unsigned long crit_mie;         ///<被换下时最外层临界区进入前的mstatus.MIE
+
+    /* 浮点 */
+    hal_fpu_ctx_t fpu_ctx;          ///<浮点上下文，线程使用过浮点且被换下时才保存
+
+#if CFG_THREAD_STATS
+    /* 统计 */
+    unsigned long run_cycles;       ///<累计运行时间（HAL_GET_CYCLES单位），不含运行期间中断服务程序占用的时间
+    unsigned int nvcsw;             ///<主动让出核（阻塞、挂起、延时、退出）的次数
+    unsigned int nivcsw;            ///<仍然就绪时被换下（被抢占、时间片用完、acoral_yield）的次数
+#endif
 }acoral_thread_t;
 
+#if CFG_THREAD_STATS
+/**
+ * @brief 线程运行统计
+ *
+ */
+typedef struct{
+    unsigned long run_cycles;       ///<累计运行时间，正在运行的线程含这一次已经运行的部分
+    unsigned int nvcsw;             ///<主动让出核的次数
+    unsigned int nivcsw;            ///<被抢占的次数
+}acoral_thread_stat_t;
+
+/**
+ * @brief 核运行统计，所有时间都是从开始调度起的累计值，两次读取相减得到一个窗口内的值
+ *
+ */
+typedef struct{
+    unsigned long cycles;           ///<读取时的HAL_GET_CYCLES，作为窗口的时间基准
+    unsigned long idle_cycles;      ///<idle线程运行的时间
+    unsigned long isr_cycles;       ///<中断服务程序占用的时间
+    unsigned long switches;         ///<线程切换次数
+}acoral_cpu_stat_t;
+#endif
+
 /**
  * @brief aCoral就绪队列
- * 
+ * @note 采用两级位图：group的第i位为1表示bitmap[i]中至少有一个优先级有就绪线程，
+ *       查找最高优先级只需要对group和对应的bitmap字各做一次acoral_ffs32，与线程数、优先级数无关
  */
 typedef struct{
 	unsigned int num;							///<就绪的线程数
-	unsigned int bitmap[PRIO_BITMAP_SIZE];		///<优先级位图，每一位对应一个优先级，为1表示这个优先级有就绪线程
+	unsigned int group;							///<一级位图，每一位对应bitmap中的一个字
+	unsigned int bitmap[PRIO_BITMAP_SIZE];		///<二级优先级位图，每一位对应一个优先级，为1表示这个优先级有就绪线程
 	acoral_list_t queue[ACORAL_MAX_PRIO_NUM];	///<每一个优先级都有独立的队列
 }acoral_rdy_queue_t;
 
 typedef struct{
-    acoral_list_t global_daem_release_queue;
-    acoral_rdy_queue_t global_ready_queue;
+    acoral_rdy_queue_t ready_queues[CFG_MAX_CPU]; ///<每个核一个就绪队列
 }thread_res_private_data;
 
+/**
+ * @brief 为线程分配栈并初始化上下文
+ * @note stack_size为0时使用CFG_DEFAULT_STACK_SIZE，小于CFG_MIN_STACK_SIZE时使用CFG_MIN_STACK_SIZE；
+ *       栈大小按伙伴系统的分配粒度向上取整，落在前CFG_STACK_CACHE_CLASSES个大小级别内的栈优先从栈缓存中取
+ *
+ * @param thread 线程指针，stack_size会被改成实际分到的大小
+ * @param exit 线程函数返回后调用的退出函数
+ * @return int 成功返回0，内存不足返回-1
+ */
 int thread_stack_init(acoral_thread_t *thread,void (*exit)(void));
+
+#if CFG_STACK_PAINT
+/**
+ * @brief 扫描线程栈，求创建以来用到的最大深度（高水位）
+ *
+ * @param thread 线程指针
+ * @return unsigned int 高水位字节数，等于stack_size说明栈很可能已经溢出
+ */
+unsigned int acoral_thread_stack_used(acoral_thread_t *thread);
+
+/**
+ * @brief 根据栈的高水位给出建议的栈大小
+ *
+ * @param used 高水位字节数
+ * @return unsigned int 建议的stack_size，已经按伙伴系统的分配粒度取整
+ */
+unsigned int acoral_stack_recommend(unsigned int used);
+#endif
+
+/**
+ * @brief 回收已经被换下的退出线程的TCB、定时器、策略数据和栈
+ * @note 每次调度和创建线程时都会调用，被回收的栈优先放进栈缓存
+ */
+void acoral_thread_reap(void);
 void system_thread_module_init(void);
 void unrdy_thread(acoral_thread_t *thread);
+
+/**
+ * @brief 修改线程当前生效的优先级，线程在就绪队列上时重新入队
+ * @note 内核内部使用，不改base_prio；用户修改优先级请用acoral_change_prio_self或acoral_thread_change_prio_by_id
+ *
+ * @param thread 线程指针
+ * @param prio 新的生效优先级
+ */
+void acoral_thread_change_prio(acoral_thread_t* thread, unsigned int prio);
+
+/**
+ * @brief 修改线程自己的优先级base_prio，再按占用的互斥量重新计算生效的优先级
+ * @note 内核内部使用，不检查硬实时段，也不调度
+ *
+ * @param thread 线程指针
+ * @param prio 新的base_prio
+ */
+void acoral_thread_change_base_prio(acoral_thread_t* thread, unsigned int prio);
+
+#if CFG_RESERVE
+/**
+ * @brief 创建带CPU预留的普通策略线程，预留在线程第一次运行之前就已生效
+ * @note 内核内部使用，由acoral_create_hard_rt_thread调用；只有它能把线程建在硬实时段里
+ *
+ * @param name 线程名字
+ * @param route 线程函数
+ * @param args 线程函数参数
+ * @param stack_size 线程栈大小
+ * @param prio 线程优先级（绝对值）
+ * @param cpu 线程绑定的核
+ * @param reserve 已经挂到预留链表上的预留，thread成员由本函数填写
+ * @return int 成功返回线程id，失败返回-1
+ */
+int acoral_create_reserved_thread(char *name, void (*route)(void *args), void *args, unsigned int stack_size, unsigned char prio, unsigned int cpu, struct acoral_reserve *reserve);
+#endif
 void ready_thread(acoral_thread_t *thread);
 
 /***************线程控制API****************/
@@ -135,7 +269,7 @@ void ready_thread(acoral_thread_t *thread);
  * @param stack 线程栈指针
  * @param sched_policy 线程调度策略
  * @param data 线程策略数据
- * @return int 成功返回线程id，失败返回-1
+ * @return int 成功返回线程id，失败返回-1；ACORAL_HARD_PRIO的prio落在硬实时段时也返回-1，硬实时线程要用acoral_create_hard_rt_thread创建
  */
 int acoral_create_thread(char *name, void (*route)(void *args),void *args,unsigned int stack_size,acoralSchedPolicyEnum sched_policy,unsigned char prio,acoralPrioTypeEnum prio_type,void *data);
 
@@ -173,6 +307,13 @@ void acoral_resume_thread_by_id(int thread_id);
  */
 void acoral_delay_self(unsigned int time);
 
+/**
+ * @brief aCoral当前线程主动让出CPU API
+ * @note 当前线程被移到同优先级队列的尾部，只有同优先级的其他就绪线程能借此获得CPU；
+ *       时间片轮转线程未用完的时间片会被保留
+ */
+void acoral_yield(void);
+
 /**
  * @brief aCoral杀死线程API
  * 
@@ -187,8 +328,64 @@ void acoral_kill_thread(acoral_thread_t *thread);
  */
 void acoral_kill_thread_by_id(int id);
 
+#if CFG_STACK_PAINT
+/**
+ * @brief aCoral查询线程栈高水位API
+ * @note 扫描整个未用过的栈，耗时与栈的空闲部分成正比，不要在时间敏感的路径上调用
+ *
+ * @param thread_id 线程id
+ * @return int 创建以来用到的最大栈深度（字节），线程不存在返回-1
+ */
+int acoral_thread_stack_hwm(int thread_id);
+#endif
+
+#if CFG_THREAD_STATS
+/**
+ * @brief aCoral查询线程运行统计API
+ * @note 正在其他核上运行的线程，这一次已经运行的部分按当前核的HAL_GET_CYCLES计算，各核计数器近似同步
+ *
+ * @param thread_id 线程id
+ * @param stat 统计结果
+ * @return int 成功返回0，线程不存在返回-1
+ */
+int acoral_thread_get_stat(int thread_id, acoral_thread_stat_t *stat);
+
+/**
+ * @brief aCoral查询核运行统计API
+ *
+ * @param cpu 核号
+ * @param stat 统计结果
+ * @return int 成功返回0，核号无效返回-1
+ */
+int acoral_cpu_get_stat(unsigned int cpu, acoral_cpu_stat_t *stat);
+
+/**
+ * @brief 最外层中断进入时由HAL调用，记录进入时间
+ *
+ */
+void acoral_stat_intr_enter(void);
+
+/**
+ * @brief 最外层中断退出时由HAL调用，中断占用的时间记到本核上，不算在被中断的线程头上
+ *
+ */
+void acoral_stat_intr_exit(void);
+#endif
+
+/**
+ * @brief aCoral设置线程CPU亲和性API
+ * @note 线程不在允许的核上时会被迁移；正在其他核上运行的线程在被换下时迁移
+ * 
+ * @param thread_id 线程id
+ * @param mask 亲和性掩码，例如ACORAL_CPU_MASK(1)表示只在核1上运行
+ * @return int 成功返回0，线程不存在、掩码中没有可用的核或者是绑定了核的硬实时线程返回-1
+ */
+int acoral_thread_set_affinity(int thread_id, unsigned int mask);
+
 /**
  * @brief aCoral改变当前线程优先级API
+ * @note 改的是base_prio，线程占用的互斥量上有更高优先级的等待者时，生效的优先级仍然是继承来的；
+ *       不能改进或改出硬实时段，这样的请求被忽略
  * 
  * @param prio 目标优先级
  */
@@ -196,6 +393,7 @@ void acoral_change_prio_self(unsigned int prio);
 
 /**
  * @brief aCoral改变线程优先级API
+ * @note 同acoral_change_prio_self，线程正在等待互斥量时，新的优先级会沿等待链继续传递
  * 
  * @param thread_id 线程id
  * @param prio 目标优先级
@@ -211,6 +409,77 @@ void acoral_thread_change_prio_by_id(unsigned int thread_id, unsigned int prio);
 void system_set_running_thread(acoral_thread_t *thread);
 void acoral_thread_runqueue_init(void);
 
+/**
+ * @brief 按负载选择核：亲和性允许且已经开始调度的核中就绪队列最短的那个
+ * 
+ * @param mask 亲和性掩码
+ * @return unsigned int 核号
+ */
+unsigned int acoral_select_cpu(unsigned int mask);
+
+/**
+ * @brief 把线程挪到指定核的就绪队列上，线程就绪时会按需通知目标核
+ * @note 必须在临界区中调用；不能用于正在运行的线程
+ * 
+ * @param thread 线程指针
+ * @param cpu 目标核
+ */
+void acoral_rdyqueue_migrate(acoral_thread_t *thread, unsigned int cpu);
+
+/**
+ * @brief 获取当前核上运行的线程
+ * 
+ * @return acoral_thread_t* 当前线程
+ */
+acoral_thread_t *acoral_get_cur_thread(void);
+
+/**
+ * @brief 在当前核上开始调度，选出最高优先级线程并切换过去，不再返回
+ * @note 主核在main_cpu_start中调用，从核在acoral_secondary_cpu_start中调用
+ */
+void acoral_start_sched(void);
+
+/**
+ * @brief 初始化一个优先级队列
+ * 
+ * @param array 优先级队列
+ */
+void acoral_prio_queue_init(acoral_rdy_queue_t *array);
+
+/**
+ * @brief 将钩子挂到优先级队列中prio对应队列的尾部
+ * 
+ * @param array 优先级队列
+ * @param prio 优先级
+ * @param list 钩子
+ */
+void acoral_prio_queue_add(acoral_rdy_queue_t *array, unsigned char prio, acoral_list_t *list);
+
+/**
+ * @brief 将钩子从优先级队列中prio对应的队列上取下
+ * 
+ * @param array 优先级队列
+ * @param prio 优先级
+ * @param list 钩子
+ */
+void acoral_prio_queue_del(acoral_rdy_queue_t *array, unsigned char prio, acoral_list_t *list);
+
+/**
+ * @brief 获取优先级队列中就绪的最高优先级，O(1)
+ * 
+ * @param array 优先级队列
+ * @return unsigned int 最高优先级
+ */
+unsigned int acoral_get_highprio(acoral_rdy_queue_t *array);
+
+/**
+ * @brief 将就绪线程移到其优先级队列的尾部，同优先级有其他就绪线程时置位线程所在核的调度标志
+ * @note EDF线程按截止期重新插入，只排到截止期不晚于它的线程之后
+ * 
+ * @param thread 线程指针
+ */
+void acoral_rdyqueue_rotate(acoral_thread_t *thread);
+
 /**
  * @brief 将某个线程挂载到就绪队列上
  * 
@@ -227,13 +496,31 @@ void acoral_rdyqueue_del(acoral_thread_t *old);
 
 
 /**
- * @brief 从就绪队列中选出优先级最高的线程
+ * @brief 从当前核的就绪队列中选出优先级最高的线程
+ * @note 多核下本核只剩idle时，会先从其他核偷一个可迁移的普通线程
  * 
  * @return acoral_thread_t* 优先级最高的线程
  */
 acoral_thread_t* acoral_select_thread();
 
 void acoral_sched(void);
+
+/**
+ * @brief 锁住当前核的调度，可以嵌套
+ * @note 只推迟抢占，不关中断：中断照常进入、照常就绪线程，需要的调度记在调度标志里，
+ *       最外层acoral_sched_unlock时补上。用于只需要不被本核其他线程打断的较长的遍历（如打印线程信息）。
+ *       不挡另一个核，也不挡中断服务程序，要和它们互斥的数据仍然要用acoral_enter_critical；
+ *       持有期间不能调用会阻塞的接口，不能在中断中调用
+ *
+ */
+void acoral_sched_lock(void);
+
+/**
+ * @brief 解开acoral_sched_lock，最外层解锁时如果期间有调度请求就马上调度
+ * 
+ */
+void acoral_sched_unlock(void);
+
 void acoral_real_sched();
 unsigned long acoral_real_intr_sched(unsigned long old_sp);
 
@@ -0,0 +1,81 @@
+/**
+ * @file workqueue.h
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief kernel层，工作队列（固定线程池）头文件
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ */
+#ifndef ACORAL_WORKQUEUE_H
+#define ACORAL_WORKQUEUE_H
+
+#include "autocfg.h"
+#include "list.h"
+#include "event.h"
+#include "resource.h"
+
+#if CFG_WORKQUEUE
+
+/**
+ * @brief 任务描述符，从ACORAL_RES_WORK资源池中分配，执行完由工作线程归还
+ *
+ */
+typedef struct
+{
+	acoral_res_t res;               ///<任务描述符也是资源
+	acoral_list_t hook;             ///<用于挂载到工作队列的任务链表
+	void (*route)(void *args);      ///<任务函数
+	void *args;                     ///<任务函数参数
+}acoral_work_t;
+
+/**
+ * @brief 工作队列，由一组预先创建好的普通线程执行提交的任务
+ *
+ */
+typedef struct
+{
+	acoral_list_t jobs;             ///<待执行的任务，先进先出
+	acoral_evt_t *job_sem;          ///<计数为排队中的任务数，工作线程在上面等待
+	acoral_evt_t *idle_sem;         ///<任务全部执行完时释放，acoral_work_wait在上面等待
+	unsigned int pending;           ///<已提交但还没执行完的任务数
+	unsigned int waiters;           ///<在acoral_work_wait中等待的线程数
+	unsigned int nthreads;          ///<工作线程数
+	unsigned char prio;             ///<工作线程优先级
+}acoral_workqueue_t;
+
+/***************工作队列API****************/
+
+/**
+ * @brief 创建工作队列
+ * @note 工作线程是普通策略线程，多核时第i个工作线程绑定在核i%CFG_MAX_CPU上，所以线程池覆盖所有核；
+ *       任务链表是共享的，哪个工作线程先空下来就取下一个任务
+ *
+ * @param nthreads 工作线程数
+ * @param prio 工作线程优先级
+ * @return acoral_workqueue_t* 工作队列指针，失败返回NULL
+ */
+acoral_workqueue_t *acoral_workqueue_create(unsigned int nthreads, unsigned char prio);
+
+/**
+ * @brief 向工作队列提交任务
+ * @note 不阻塞，可以在中断中调用；任务描述符用完时返回失败，调用者可以自己执行route或者稍后重试
+ *
+ * @param wq 工作队列
+ * @param route 任务函数
+ * @param args 任务函数参数
+ * @return int 成功返回0，参数错误或任务描述符用完返回-1
+ */
+int acoral_work_submit(acoral_workqueue_t *wq, void (*route)(void *args), void *args);
+
+/**
+ * @brief 等待工作队列中已经提交的任务全部执行完
+ * @note 不能在中断或工作队列自己的任务中调用
+ *
+ * @param wq 工作队列
+ * @return int 成功返回0，参数错误返回-1
+ */
+int acoral_work_wait(acoral_workqueue_t *wq);
+
+#endif
+
+#endif
@@ -16,7 +16,6 @@
 #include "hal.h"
 #include "thread.h"
 #include "int.h"
-#include "plic.h"
 #include <stdio.h>
 
 void system_intr_module_init()
@@ -26,40 +25,45 @@ void system_intr_module_init()
 }
 
 int acoral_intr_attach(int vector,void (*isr)(int)){
-	plic_irq_register(vector,isr,NULL);
-	return 0;
+	return HAL_INTR_ATTACH(vector,isr);
 }
 
 int acoral_intr_detach(int vector){
-	plic_irq_deregister(vector);
-	plic_irq_register(vector,acoral_default_isr,NULL);
-	return 0;
+	HAL_INTR_DETACH(vector);
+	return HAL_INTR_ATTACH(vector,acoral_default_isr);
 }
 
 int acoral_intr_unmask(int vector){
-	return plic_irq_enable(vector);
+	return HAL_INTR_UNMASK(vector);
 }
 
 int acoral_intr_mask(int vector){
-	return plic_irq_disable(vector);
+	return HAL_INTR_MASK(vector);
 }
 
 void acoral_default_isr(int vector){
+	(void)vector;
 	printf("in acoral_default_isr");
 }
 
 unsigned long acoral_intr_exit(unsigned long old_sp){
+    /*不需要切换线程时必须原样返回被中断线程的栈指针，汇编里会直接拿返回值当sp*/
     if(!system_need_sched)
     {
-        return ;
+        return old_sp;
     } 
 	if(acoral_intr_nesting)
     {
-        return ;
+        return old_sp;
     }
 	if(system_sched_locked)
     {
-        return ;
+        return old_sp;
+    }
+	/*被中断的线程锁住了调度，等它解锁时再切换*/
+	if(acoral_sched_lock_nesting[acoral_current_cpu()])
+    {
+        return old_sp;
     }
 	    
 	    
@@ -2,7 +2,7 @@
  * @file mem.c
  * @author 王彬浩 (SPGGOGOGO@outlook.com)
  * @brief kernel层，整合了伙伴系统和资源池系统初始化的两级内存管理系统
- * @version 1.2
+ * @version 1.4
  * @date 2023-04-20
  * @copyright Copyright (c) 2023
  * @revisionHistory
@@ -12,6 +12,8 @@
  *   <tr><td> 1.0 <td>王彬浩 <td> 2022-07-04 <td>Standardized, add acoral_res_sys_init
  * 	 <tr><td> 1.1 <td>王彬浩 <td> 2022-07-06 <td>将resource.c 和 buddy.c放进来
  *   <tr><td> 1.2 <td>王彬浩 <td> 2023-04-20 <td>optimized
+ *   <tr><td> 1.3 <td>王彬浩 <td> 2026-10-17 <td>buddy system uses per-order free lists and a bitmap of non-empty orders
+ *   <tr><td> 1.4 <td>王彬浩 <td> 2026-10-17 <td>heap init moved to the unified heap, add usable size and stat
  *  </table>
  */
 
@@ -24,6 +26,7 @@
 #include <stdio.h>
 #include "bitops.h"
 #include "log.h"
+#include "heap.h"
 
 extern int _heap_start; ///< 堆内存起始地址，定义于链接脚本
 extern int _heap_end;	///< 堆内存结束地址，定义于链接脚本
@@ -33,13 +36,10 @@ extern int _sdk_heap_end;
 void system_mem_module_init()
 {
 #ifdef CFG_DEBUG_INFO
-	ACORAL_LOG_DEBUG("aCoral Heap Start: 0x%x, aCoral Heap End: 0x%x",(unsigned int)&_heap_start, (unsigned int)&_heap_end);
-	ACORAL_LOG_DEBUG("SDK Heap Start: 0x%x, SDK Heap End: 0x%x",(unsigned int)&_sdk_heap_start, (unsigned int)&_sdk_heap_end);
+	ACORAL_LOG_DEBUG("aCoral Heap Start: 0x%lx, aCoral Heap End: 0x%lx",(unsigned long)&_heap_start, (unsigned long)&_heap_end);
+	ACORAL_LOG_DEBUG("SDK Heap Start: 0x%lx, SDK Heap End: 0x%lx",(unsigned long)&_sdk_heap_start, (unsigned long)&_sdk_heap_end);
 #endif	
-	acoral_mem_init((unsigned int)&_heap_start, (unsigned int)&_heap_end); // 伙伴系统初始化
-#ifdef CFG_MEM2
-	acoral_mem_init2(); // 任意大小内存分配系统初始化
-#endif
+	acoral_heap_init(); // 伙伴系统和任意大小内存分配系统初始化，C库在这之前分配过内存的话已经初始化了
 	acoral_res_sys_init(); // 资源池系统初始化
 }
 
@@ -48,687 +48,248 @@ void system_mem_module_init()
 acoral_block_ctr_t *acoral_mem_ctrl; ///< 内存控制块,只有一个
 acoral_block_t *acoral_mem_blocks;	 ///< 这是一个数组，每个基本内存块对应一个
 
+/// 第num个基本内存块的地址，空闲块的链表节点就放在这里
+#define BUDDY_ADR(num) ((acoral_list_t *)(unsigned long)(acoral_mem_ctrl->start_adr + ((num) << BLOCK_SHIFT)))
+/// 地址换算成基本内存块编号
+#define BUDDY_NUM(adr) (((unsigned int)(unsigned long)(adr) - acoral_mem_ctrl->start_adr) >> BLOCK_SHIFT)
+
+/**
+ * @brief 能放下size的最小阶
+ *
+ */
+static inline unsigned int buddy_order(unsigned int size)
+{
+	if (size <= BASIC_BLOCK_SIZE)
+		return 0;
+	return acoral_fls32(size - 1) + 1 - BLOCK_SHIFT;
+}
+
+/**
+ * @brief 把以num开头的order阶块挂到空闲链表上
+ *
+ */
+static inline void buddy_push(unsigned int num, unsigned int order)
+{
+	acoral_mem_blocks[num].level = order | BLOCK_FREE;
+	acoral_list_add(BUDDY_ADR(num), &acoral_mem_ctrl->free_list[order]);
+	acoral_mem_ctrl->free_map |= 1u << order;
+	acoral_mem_ctrl->num[order]++;
+}
+
+/**
+ * @brief 把order阶的空闲块从链表上摘下来
+ *
+ */
+static inline void buddy_unlink(acoral_list_t *node, unsigned int order)
+{
+	acoral_list_del(node);
+	if (--acoral_mem_ctrl->num[order] == 0)
+		acoral_mem_ctrl->free_map &= ~(1u << order);
+}
+
+#define BUDDY_SCAN_MAX (8) ///<buddy_scan每阶最多列出的空闲块号，多出来的只计数
+
 void buddy_scan()
 {
-	unsigned int i, k, n;
-	unsigned int num_perlevel;
-	unsigned int max_level = acoral_mem_ctrl->level;
-	for (i = 0; i < max_level; i++)
+	unsigned int num[LEVEL], listed[LEVEL];
+	unsigned int blocks[LEVEL][BUDDY_SCAN_MAX];
+	unsigned int i, j, level, free_num, block_num;
+	acoral_list_t *tmp;
+	if (acoral_mem_ctrl->state == MEM_NO_ALLOC)
+		return;
+	/*临界区里只拷贝，打印放到出了临界区之后，串口输出时不关中断、不占内核大锁*/
+	acoral_enter_critical();
+	level = acoral_mem_ctrl->level;
+	for (i = 0; i < level; i++)
+	{
+		num[i] = acoral_mem_ctrl->num[i];
+		listed[i] = 0;
+		for (tmp = acoral_mem_ctrl->free_list[i].next; tmp != &acoral_mem_ctrl->free_list[i] && listed[i] < BUDDY_SCAN_MAX; tmp = tmp->next)
+			blocks[i][listed[i]++] = BUDDY_NUM(tmp);
+	}
+	free_num = acoral_mem_ctrl->free_num;
+	block_num = acoral_mem_ctrl->block_num;
+	acoral_exit_critical();
+
+	for (i = 0; i < level; i++)
 	{
-		printf("Level%d\r\n", i);
-		printf("bitmap:");
-		num_perlevel = acoral_mem_ctrl->num[i];
-		for (k = 0; k < num_perlevel;)
-		{
-			for (n = 0; n < 8 && k < num_perlevel; n++, k++)
-			{
-				printf("%x ", acoral_mem_ctrl->bitmap[i][k]);
-			}
-			printf("\r\n");
-		}
-		printf("Free Block head:%d\r\n", acoral_mem_ctrl->free_cur[i]);
+		if (num[i] == 0)
+			continue;
+		printf("Order%d(%dB) free %d:", i, BASIC_BLOCK_SIZE << i, num[i]);
+		for (j = 0; j < listed[i]; j++)
+			printf(" %d", blocks[i][j]);
+		if (listed[i] < num[i])
+			printf(" ...");
 		printf("\r\n");
 	}
-	printf("Free Mem Block Number:%d\r\n", acoral_mem_ctrl->free_num);
-	printf("\r\n");
+	printf("Free Block Num:%d/%d\r\n", free_num, block_num);
 }
 
 unsigned int buddy_init(unsigned int start_adr, unsigned int end_adr)
 {
-	int i, k;
-	unsigned int resize_size;
-	unsigned int save_adr;
-	unsigned int index;
-	unsigned int num = 1;
-	unsigned int adjust_level = 1;
-	int level = 0;
-	unsigned int max_num, o_num;
-	unsigned int cur;
-	start_adr += 3;
-	start_adr &= ~(4 - 1); // 首地址四字节对齐
-	end_adr &= ~(4 - 1);   // 尾地址四字节对齐
-	resize_size = BASIC_BLOCK_SIZE;
-	end_adr = end_adr - sizeof(acoral_block_ctr_t);	 // 减去内存控制块的大小，剩下的才是可分配内存
-	end_adr &= ~(4 - 1);							 // 尾地址再进行一次四字节对齐
-	acoral_mem_ctrl = (acoral_block_ctr_t *)end_adr; // 内存控制块的地址
+	unsigned int i, num, order;
+	start_adr = (start_adr + BASIC_BLOCK_SIZE - 1) & ~(BASIC_BLOCK_SIZE - 1); // 首地址按基本块对齐，分出去的块都是自然对齐的
+	end_adr &= ~(sizeof(void *) - 1);
+	end_adr = end_adr - sizeof(acoral_block_ctr_t); // 减去内存控制块的大小，剩下的才是可分配内存
+	end_adr &= ~(sizeof(void *) - 1);
+	acoral_mem_ctrl = (acoral_block_ctr_t *)(unsigned long)end_adr; // 内存控制块的地址
 
 	// 如果内存这么少，不适合分配
-	if (start_adr > end_adr || end_adr - start_adr < BASIC_BLOCK_SIZE)
+	if (start_adr >= end_adr || end_adr - start_adr < BASIC_BLOCK_SIZE + sizeof(acoral_block_t))
 	{
 		acoral_mem_ctrl->state = MEM_NO_ALLOC;
 		return -1;
 	}
 	acoral_mem_ctrl->state = MEM_OK;
 
-	while (1)
-	{
-		if (end_adr <= start_adr + resize_size)
-			break;
-		resize_size = resize_size << 1;
-		num = num << 1; // 全分成基本内存块的数量
-		adjust_level++;
-	}
-	acoral_mem_blocks = (acoral_block_t *)end_adr - num;
-	save_adr = (unsigned int)acoral_mem_blocks;
-	level = adjust_level; // 实际层数
-	// 如果层数较小，则最大层用一块构成，如果层数较多，限制层数范围，最大层由多块构成
-	if (adjust_level > LEVEL)
-		level = LEVEL;
-	num = num / 32; // 每32个基本内存块由一个32位位图表示
-	for (i = 0; i < level - 1; i++)
-	{
-		num = num >> 1; // 除去最大层，其他每层的32位图都是64个块构成，所以要除以2
-		if (num == 0)
-		{
-			num = 1; // 不足一个位图的，用一个位图表示
-		}
+	// 每个基本内存块带一个状态字节，状态数组放在控制块下面
+	num = (end_adr - start_adr) / (BASIC_BLOCK_SIZE + sizeof(acoral_block_t));
+	acoral_mem_blocks = (acoral_block_t *)(unsigned long)end_adr - num;
+	for (i = 0; i < num; i++)
+		acoral_mem_blocks[i].level = BLOCK_NONE;
 
-		save_adr -= num * 4;								   // 每一个32位位图为4个字节
-		save_adr &= ~(4 - 1);								   // 四字节对齐
-		acoral_mem_ctrl->bitmap[i] = (unsigned int *)save_adr; // 当层bitmap地址
-		acoral_mem_ctrl->num[i] = num;
-		save_adr -= num * 4;							 // 每一个32位位图为4个字节
-		save_adr &= ~(4 - 1);							 // 四字节对齐
-		acoral_mem_ctrl->free_list[i] = (int *)save_adr; // 当层free_list地址
-		for (k = 0; k < num; k++)
-		{
-			acoral_mem_ctrl->bitmap[i][k] = 0;	   // 初始化当层bitmap
-			acoral_mem_ctrl->free_list[i][k] = -1; // 初始化当层free_list
-		}
-		acoral_mem_ctrl->free_cur[i] = -1; // 初始化当层free_cur
-	}
-
-	// 最大内存块层如果不足一个位图的，用一个位图表示
-	if (num == 0)
-	{
-		num = 1;
-	}
-	save_adr -= num * 4;
-	save_adr &= ~(4 - 1);
-	acoral_mem_ctrl->bitmap[i] = (unsigned int *)save_adr;
-	acoral_mem_ctrl->num[i] = num;
-	save_adr -= num * 4;
-	save_adr &= ~(4 - 1);
-	acoral_mem_ctrl->free_list[i] = (int *)save_adr;
-	for (k = 0; k < num; k++)
+	acoral_mem_ctrl->level = acoral_fls32(num) + 1; // 最大块不超过全部内存
+	if (acoral_mem_ctrl->level > LEVEL)
+		acoral_mem_ctrl->level = LEVEL;
+	for (i = 0; i < LEVEL; i++)
 	{
-		acoral_mem_ctrl->bitmap[i][k] = 0;
-		;
-		acoral_mem_ctrl->free_list[i][k] = -1;
+		acoral_init_list(&acoral_mem_ctrl->free_list[i]);
+		acoral_mem_ctrl->num[i] = 0;
 	}
-	acoral_mem_ctrl->free_cur[i] = -1;
-
-	// 如果剩余内存大小不够形成现在的level
-	if (save_adr <= (start_adr + (resize_size >> 1)))
-		adjust_level--;
-	if (adjust_level > LEVEL)
-		level = LEVEL;
-
-	////初始化内存控制块
-	acoral_mem_ctrl->level = level;
+	acoral_mem_ctrl->free_map = 0;
 	acoral_mem_ctrl->start_adr = start_adr;
-	num = (save_adr - start_adr) >> BLOCK_SHIFT;
 	acoral_mem_ctrl->end_adr = start_adr + (num << BLOCK_SHIFT);
 	acoral_mem_ctrl->block_num = num;
 	acoral_mem_ctrl->free_num = num;
 	acoral_mem_ctrl->block_size = BASIC_BLOCK_SIZE;
 
-	i = 0;
-	max_num = (1 << level) - 1; // 最大内存块层的每块内存大小
-	o_num = 0;
-
-	if (num > 0)
-	{ // 有内存块，则最大内存块层的free_cur为0
-		acoral_mem_ctrl->free_cur[level - 1] = 0;
-	}
-	else
-	{ // 无内存块，则最大内存块层的free_cur为-1
-		acoral_mem_ctrl->free_cur[level - 1] = -1;
-	}
-
-	////整块内存优先分给最大内存块层
-	// 计算当前可分配内存容量是否能直接形成一个最大内存块层的32位图
-	while (num >= max_num * 32)
-	{
-		acoral_mem_ctrl->bitmap[level - 1][i] = -1;
-		;
-		acoral_mem_ctrl->free_list[level - 1][i] = i + 1;
-		num -= max_num * 32;
-		o_num += max_num * 32;
-		i++;
-	}
-	if (num == 0)
-	{ // 所有块正好分配到最大内存块层的32位图
-		acoral_mem_ctrl->free_list[level - 1][i - 1] = -1;
-	}
-
-	// 计算当前可分配内存是否还能形成最大内存块层的一块
-	while (num >= max_num)
+	// 从头切成尽量大的块，每块都按自己的大小对齐，这样伙伴就是编号异或块大小
+	for (i = 0; i < num; i += 1u << order)
 	{
-		index = (o_num >> level) - 1;
-		acoral_set_bit_in_bitmap(index, acoral_mem_ctrl->bitmap[level - 1]);
-		num -= max_num;
-		o_num += max_num;
-	}
-	acoral_mem_ctrl->free_list[level - 1][i] = -1;
-
-	// 接下来的每层初始化
-	while (--level > 0)
-	{
-		index = o_num >> level;
-		if (num == 0)
-			break;
-		cur = index / 32;
-		max_num = (1 << level) - 1; // 每层的内存块大小
-		if (num >= max_num)
-		{
-			acoral_mem_blocks[BLOCK_INDEX(o_num)].level = -1;
-			acoral_set_bit_in_bitmap(index, acoral_mem_ctrl->bitmap[level - 1]);
-			acoral_mem_ctrl->free_list[level - 1][cur] = -1;
-			acoral_mem_ctrl->free_cur[level - 1] = cur;
-			o_num += max_num;
-			num -= max_num;
-		}
+		order = acoral_mem_ctrl->level - 1;
+		if (i && acoral_ffs32(i) < order)
+			order = acoral_ffs32(i);
+		while (i + (1u << order) > num)
+			order--;
+		buddy_push(i, order);
 	}
 	return 0;
 }
 
-/**
- * @brief 迭代获取空闲块的首num
- *
- * @param level 要获取的层数，起始为0
- * @return int 空闲块的首num
- */
-static int recus_malloc(int level)
-{
-	unsigned int index;
-	int cur;
-	int num;
-	if (level >= acoral_mem_ctrl->level) // 层数超出范围
-		return -1;
-	cur = acoral_mem_ctrl->free_cur[level]; // 获取首个空闲位图
-	if (cur < 0)							// 无空闲
-	{
-		num = recus_malloc(level + 1); // 迭代向上寻找
-		if (num < 0)
-			return -1;
-		index = num >> level + 1;							   // 计算在位图中位置
-		cur = index / 32;									   // 计算在位图链表中位置
-		acoral_set_bit_in_bitmap(index, acoral_mem_ctrl->bitmap[level]); // 在位图中置1，把偶数块分出去
-		// 当前层无空闲，两个空闲块是从上层分配的，所以空闲位图链表更改，然后分配完一块还有一块，所以移动空闲位图链表头
-		acoral_mem_ctrl->free_list[level][cur] = -1;
-		acoral_mem_ctrl->free_cur[level] = cur;
-		return num;
-	}
-	index = acoral_find_first_bit_in_integer(acoral_mem_ctrl->bitmap[level][cur], 1); // 获取空闲块在其32位图中的位置
-	index = cur * 32 + index;								 // 计算空闲块实际位置
-	acoral_clear_bit_in_bitmap(index, acoral_mem_ctrl->bitmap[level]); // 从只有一块空闲变成两块都不空闲了，所以清0
-	if (acoral_mem_ctrl->bitmap[level][cur] == 0)			 // 如果此位图无空闲块了
-	{
-		acoral_mem_ctrl->free_cur[level] = acoral_mem_ctrl->free_list[level][cur]; // 移动空闲位图链表头
-	}
-	num = index << level + 1; // 计算空闲块首个num
-	/*最高level情况*/
-	if (level == acoral_mem_ctrl->level - 1) // 最大内存块层
-	{
-		if ((num >> 1) + (1 << level) > acoral_mem_ctrl->block_num)
-			return -1;
-		return num >> 1;
-	}
-	// 其余层
-	if (acoral_mem_blocks[BLOCK_INDEX(num)].level >= 0) // 检查这块内存有没有被分配
-	{
-		return num + (1 << level);
-	} // 如果此块已经被分配，那就是后面一块为空闲块
-	else
-	{
-		return num;
-	}
-}
-
-/**
- * @brief 伙伴系统实际内存分配
- *
- * @param level 要分配的层数，起始为0
- * @return void* 返回分配的地址
- */
-static void *r_malloc(unsigned char level)
-{
-	unsigned int index;
-	int num, cur;
-	acoral_enter_critical();
-	acoral_mem_ctrl->free_num -= 1 << level; // 提前减去即将分配的基本内存块数
-	cur = acoral_mem_ctrl->free_cur[level];
-	if (cur < 0)
-	{
-		num = recus_malloc(level + 1);
-		if (num < 0)
-		{
-			acoral_exit_critical();
-			return NULL;
-		}
-		index = num >> level + 1;
-		cur = index / 32;
-		acoral_set_bit_in_bitmap(index, acoral_mem_ctrl->bitmap[level]);
-		acoral_mem_ctrl->free_list[level][cur] = -1;
-		acoral_mem_ctrl->free_cur[level] = cur;
-		if ((num & 0x1) == 0)
-			acoral_mem_blocks[BLOCK_INDEX(num)].level = level;
-#ifdef CFG_TEST_MEM
-		buddy_scan();
-#endif
-		acoral_exit_critical();
-		return (void *)(acoral_mem_ctrl->start_adr + (num << BLOCK_SHIFT));
-	}
-	index = acoral_find_first_bit_in_integer(acoral_mem_ctrl->bitmap[level][cur],1);
-	index = index + cur * 32;
-	acoral_clear_bit_in_bitmap(index, acoral_mem_ctrl->bitmap[level]);
-	if (acoral_mem_ctrl->bitmap[level][cur] == 0)
-	{
-		acoral_mem_ctrl->free_cur[level] = acoral_mem_ctrl->free_list[level][cur];
-	}
-	if (level == acoral_mem_ctrl->level - 1)
-	{
-		num = index << level;
-		if (num + (1 << level) > acoral_mem_ctrl->block_num)
-		{
-			acoral_exit_critical();
-			return NULL;
-		}
-	}
-	else
-	{
-		num = index << level + 1;
-		if (acoral_mem_blocks[BLOCK_INDEX(num)].level >= 0)
-			num += (1 << level);
-	}
-	if ((num & 0x1) == 0)
-		acoral_mem_blocks[BLOCK_INDEX(num)].level = level;
-#ifdef CFG_TEST_MEM
-	buddy_scan();
-#endif
-	acoral_exit_critical();
-	return (void *)(acoral_mem_ctrl->start_adr + (num << BLOCK_SHIFT));
-}
-
 unsigned int buddy_malloc_size(unsigned int size)
 {
-	unsigned int resize_size;
-	unsigned char level = 0;
-	unsigned int num = 1;
-	resize_size = BASIC_BLOCK_SIZE;
+	unsigned int order;
 	if (acoral_mem_ctrl->state == MEM_NO_ALLOC)
 		return 0;
-	while (resize_size < size && level < acoral_mem_ctrl->level)
-	{
-		num = num << 1;
-		level++;
-		resize_size = resize_size << 1;
-	}
-	return resize_size;
+	order = buddy_order(size);
+	if (order > acoral_mem_ctrl->level)
+		order = acoral_mem_ctrl->level;
+	return BASIC_BLOCK_SIZE << order;
 }
 
 void *buddy_malloc(unsigned int size)
 {
-	unsigned int resize_size;
-	unsigned char level = 0;
-	unsigned int num = 1;
-	resize_size = BASIC_BLOCK_SIZE;
+	unsigned int order, cur, mask, num;
+	acoral_list_t *node;
 	if (acoral_mem_ctrl->state == MEM_NO_ALLOC)
 		return NULL;
-	while (resize_size < size) // 本层块大小不满足申请内存
-	{
-		num = num << 1;
-		level++;
-		resize_size = resize_size << 1;
-	}
-	if (num > acoral_mem_ctrl->free_num) // 剩余内存不足
-		return NULL;
-	if (level >= acoral_mem_ctrl->level) // 申请内存块大小超过顶层内存块大小
+	order = buddy_order(size);
+	if (order >= acoral_mem_ctrl->level) // 申请内存块大小超过顶层内存块大小
 		return NULL;
-	return r_malloc(level); // 实际的分配函数
-}
-
-void buddy_free(void *ptr)
-{
-	unsigned char level;
-	unsigned char buddy_level;
-	int cur;
-	unsigned int index;
-	unsigned int num;
-	unsigned int max_level;
-	unsigned int adr;
-	adr = (unsigned int)ptr;
-	if (acoral_mem_ctrl->state == MEM_NO_ALLOC)
-	{
-		return;
-	}
-
-	// 无效地址
-	if (ptr == NULL || adr < acoral_mem_ctrl->start_adr || adr + BASIC_BLOCK_SIZE > acoral_mem_ctrl->end_adr)
-	{
-		printf("Invalid Free Address:0x%x\n", (unsigned int)ptr);
-		return;
-	}
-	max_level = acoral_mem_ctrl->level;						 // 记下层数
-	num = (adr - acoral_mem_ctrl->start_adr) >> BLOCK_SHIFT; // 地址与基本块数换算
-	// 如果不是block整数倍，肯定是非法地址
-	if (adr != acoral_mem_ctrl->start_adr + (num << BLOCK_SHIFT))
-	{
-		printf("Invalid Free Address:0x%x\n", (unsigned int)ptr);
-		return;
-	}
 	acoral_enter_critical();
-	if (num & 0x1) // 奇数基本内存块
-	{
-		level = 0; // 奇数基本内存块一定是从0层分配
-		// 下面是地址检查
-		index = num >> 1;
-		buddy_level = acoral_mem_blocks[BLOCK_INDEX(num)].level;
-
-		// 不是从0层，直接返回错误
-		if (buddy_level > 0)
-		{
-			printf("Invalid Free Address:0x%x\n", (unsigned int)ptr);
-			acoral_exit_critical();
-			return;
-		}
-		/*伙伴分配出去，如果对应的位为1,肯定是回收过一次了*/
-		if (buddy_level == 0 && acoral_get_bit_in_bitmap(index, acoral_mem_ctrl->bitmap[level]))
-		{
-			printf("Address:0x%x have been freed\n", (unsigned int)ptr);
-			acoral_exit_critical();
-			return;
-		}
-		/*伙伴没有分配出去了，如果对应的位为0,肯定是回收过一次了*/
-		if (buddy_level < 0 && !acoral_get_bit_in_bitmap(index, acoral_mem_ctrl->bitmap[level]))
-		{
-			printf("Address:0x%x have been freed\n", (unsigned)ptr);
-			acoral_exit_critical();
-			return;
-		}
-	}
-	else
-	{
-		level = acoral_mem_blocks[BLOCK_INDEX(num)].level;
-		/*已经释放*/
-		if (level < 0)
-		{
-			printf("Address:0x%x have been freed\n", (unsigned int)ptr);
-			acoral_exit_critical();
-			return;
-		}
-		acoral_mem_ctrl->free_num += 1 << level;		// 空闲基本块数增加
-		acoral_mem_blocks[BLOCK_INDEX(num)].level = -1; // 标志此基本块未被分配
-	}
-	if (level == max_level - 1) // 最大内存块直接回收
+	mask = acoral_mem_ctrl->free_map & (~0u << order);
+	if (mask == 0) // 没有够大的空闲块
 	{
-		index = num >> level;								   // 最大内存块层，一块一位
-		acoral_set_bit_in_bitmap(index, acoral_mem_ctrl->bitmap[level]); // 标志空闲
 		acoral_exit_critical();
-		return;
+		return NULL;
 	}
-	index = (num >> 1) + level; // 其余层，两块一位
-	while (level < max_level)	// 其余层回收，有可能回收到最大层
+	cur = acoral_ffs32(mask); // 够用的最小一阶
+	node = acoral_mem_ctrl->free_list[cur].next;
+	buddy_unlink(node, cur);
+	num = BUDDY_NUM(node);
+	while (cur > order) // 逐阶对半分，后一半挂回低一阶
 	{
-		cur = index / 32;
-		if (!acoral_get_bit_in_bitmap(index, acoral_mem_ctrl->bitmap[level])) // 两块都没空闲
-		{
-			acoral_set_bit_in_bitmap(index, acoral_mem_ctrl->bitmap[level]);								// 设置成有一块空闲
-			if (acoral_mem_ctrl->free_cur[level] < 0 || cur < acoral_mem_ctrl->free_cur[level]) // 无空闲块或者释放的位比空闲位图链表头小
-			{
-				acoral_mem_ctrl->free_list[level][cur] = acoral_mem_ctrl->free_cur[level];
-				acoral_mem_ctrl->free_cur[level] = cur;
-			}
-			break;
-		}
-		/*有个伙伴是空闲的，向上级回收*/
-		acoral_clear_bit_in_bitmap(index, acoral_mem_ctrl->bitmap[level]);
-		if (cur == acoral_mem_ctrl->free_cur[level])
-			acoral_mem_ctrl->free_cur[level] = acoral_mem_ctrl->free_list[level][cur];
-		level++;
-		if (level < max_level - 1)
-			index = index >> 1;
+		cur--;
+		buddy_push(num + (1u << cur), cur);
 	}
+	acoral_mem_blocks[num].level = order;
+	acoral_mem_ctrl->free_num -= 1u << order;
 	acoral_exit_critical();
-#ifdef CFG_TEST_MEM
-	buddy_scan();
-#endif
-}
-
-//SPG原malloc.c
-
-/**
- * @file malloc.c
- * @author 王彬浩 (SPGGOGOGO@outlook.com)
- * @brief kernel层，内存malloc
- * @version 1.0
- * @date 2023-04-21
- * @copyright Copyright (c) 2023
- * @revisionHistory
- *  <table>
- *   <tr><th> 版本 <th>作者 <th>日期 <th>修改内容
- *   <tr><td> 0.1 <td>jivin <td>2010-03-08 <td>Created
- *   <tr><td> 1.0 <td>王彬浩 <td> 2023-04-21 <td>Standardized
- *  </table>
- */
-
-#include "mutex.h"
-#include "mem.h"
-#include "thread.h"
-#include <stdio.h>
-
-struct mem2_ctrl_t
-{
-	acoral_evt_t mutex;
-	char *top_p;
-	char *down_p;
-	unsigned int *freep_p;
-	unsigned char mem_state;
-} mem_ctrl;
-
-static void *real_malloc(int size)
-{
-	unsigned int *tp;
-	char *ctp;
-	unsigned int b_size;
-	size = size + 4;
-	while (acoral_mutex_pend(&mem_ctrl.mutex, 0) != MUTEX_SUCCED)
-		acoral_suspend_self();
-
-	tp = mem_ctrl.freep_p;
-	ctp = (char *)tp;
-	while (ctp < mem_ctrl.top_p)
-	{
-		b_size = BLOCK_SIZE(*tp);
-		if (b_size == 0)
-		{
-			printf("Err address is 0x%x,size should not be 0", (unsigned int)tp);
-			acoral_mutex_post(&mem_ctrl.mutex);
-			return NULL;
-		}
-		if (BLOCK_USED(*tp) || b_size < size)
-		{
-			ctp = ctp + b_size;
-			tp = (unsigned int *)ctp;
-		}
-		else
-		{
-			BLOCK_SET_USED(tp, size);
-			ctp = ctp + size;
-			tp = (unsigned int *)ctp;
-			if (b_size - size > 0)
-				BLOCK_SET_FREE(tp, b_size - size);
-			mem_ctrl.freep_p = tp;
-
-			acoral_mutex_post(&mem_ctrl.mutex);
-			return (void *)(ctp - size + 4);
-		}
-	}
-	ctp = mem_ctrl.down_p;
-	tp = (unsigned int *)ctp;
-	while (tp < mem_ctrl.freep_p)
-	{
-		b_size = BLOCK_SIZE(*tp);
-		if (b_size == 0)
-		{
-			printf("Err address is 0x%x,size should not be 0", (unsigned int)tp);
-			acoral_mutex_post(&mem_ctrl.mutex);
-			return NULL;
-		}
-		if (BLOCK_USED(*tp) || b_size < size)
-		{
-			ctp = ctp + b_size;
-			tp = (unsigned int *)ctp;
-		}
-		else
-		{
-			BLOCK_SET_USED(tp, size);
-			ctp = ctp + size;
-			tp = (unsigned int *)ctp;
-			if (b_size - size > 0)
-				BLOCK_SET_FREE(tp, b_size - size);
-			mem_ctrl.freep_p = tp;
-
-			acoral_mutex_post(&mem_ctrl.mutex);
-			return (void *)(ctp - size + 4);
-		}
-	}
-	acoral_mutex_post(&mem_ctrl.mutex);
-	return NULL;
-}
-
-void *v_malloc(int size)
-{
-	if (mem_ctrl.mem_state == 0)
-		return NULL;
-	size = (size + 3) & ~3;
-	return real_malloc(size);
+	return (void *)node;
 }
 
-void v_free(void *p)
+void buddy_free(void *ptr)
 {
-	unsigned int *tp, *prev_tp;
-	char *ctp;
-	unsigned int b_size, size = 0;
-	if (mem_ctrl.mem_state == 0)
+	unsigned int adr = (unsigned int)(unsigned long)ptr;
+	unsigned int num, order, buddy;
+	unsigned char state;
+	if (acoral_mem_ctrl->state == MEM_NO_ALLOC)
 		return;
-	p = (char *)p - 4;
-	tp = (unsigned int *)p;
-	while (acoral_mutex_pend(&mem_ctrl.mutex, 0) != 0) // 周期性任务
-		acoral_suspend_self();
-	if (p == NULL || (char *)p < mem_ctrl.down_p || (char *)p >= mem_ctrl.top_p || !BLOCK_CHECK(*tp))
+
+	// 不在堆里或者不是基本块的整数倍，肯定是非法地址
+	if (ptr == NULL || adr < acoral_mem_ctrl->start_adr || adr >= acoral_mem_ctrl->end_adr || ((adr - acoral_mem_ctrl->start_adr) & (BASIC_BLOCK_SIZE - 1)))
 	{
-		printf("Invalide Free address:0x%x\n", (unsigned int)tp);
+		printf("Invalid Free Address:0x%x\n", adr);
 		return;
 	}
-	if (BLOCK_FREE(*tp))
+	num = BUDDY_NUM(adr);
+	acoral_enter_critical();
+	state = acoral_mem_blocks[num].level;
+	if (state == BLOCK_NONE) // 不是某一块的开头
 	{
-		printf("Address:0x%x have been freed\n", (unsigned int)tp);
+		acoral_exit_critical();
+		printf("Invalid Free Address:0x%x\n", adr);
 		return;
 	}
-	prev_tp = tp;
-	ctp = (char *)tp;
-	b_size = BLOCK_SIZE(*tp);
-
-	ctp = ctp + b_size;
-	tp = (unsigned int *)ctp;
-	if (BLOCK_FREE(*tp))
-	{
-		size = BLOCK_SIZE(*tp);
-		if (size == 0)
-		{
-			printf("Err address is 0x%x,size should not be 0", (unsigned int)tp);
-			acoral_mutex_post(&mem_ctrl.mutex);
-			return;
-		}
-		b_size += size;
-		BLOCK_CLEAR(tp);
-	}
-	BLOCK_SET_FREE(prev_tp, b_size);
-	mem_ctrl.freep_p = prev_tp;
-	if (p == mem_ctrl.down_p)
+	if (state & BLOCK_FREE)
 	{
-
-		acoral_mutex_post(&mem_ctrl.mutex);
+		acoral_exit_critical();
+		printf("Address:0x%x have been freed\n", adr);
 		return;
 	}
-	ctp = mem_ctrl.down_p;
-	tp = (unsigned int *)ctp;
-	while (ctp < (char *)p)
+	order = state;
+	acoral_mem_ctrl->free_num += 1u << order;
+	acoral_mem_blocks[num].level = BLOCK_NONE;
+	while (order + 1 < acoral_mem_ctrl->level) // 伙伴空闲且同阶就合并，再看上一阶
 	{
-		size = BLOCK_SIZE(*tp);
-		if (size == 0)
-		{
-			printf("err address is 0x%x,size should not be 0", (unsigned int)tp);
-			acoral_mutex_post(&mem_ctrl.mutex);
-			return;
-		}
-		ctp = ctp + size;
-		prev_tp = tp;
-		tp = (unsigned int *)ctp;
-	}
-	if (BLOCK_FREE(*prev_tp))
-	{
-		tp = (unsigned int *)p;
-		BLOCK_CLEAR(tp);
-		BLOCK_SET_FREE(prev_tp, b_size + size);
-		mem_ctrl.freep_p = prev_tp;
+		buddy = num ^ (1u << order);
+		if (buddy >= acoral_mem_ctrl->block_num || acoral_mem_blocks[buddy].level != (order | BLOCK_FREE))
+			break;
+		buddy_unlink(BUDDY_ADR(buddy), order);
+		acoral_mem_blocks[buddy].level = BLOCK_NONE;
+		num &= ~(1u << order);
+		order++;
 	}
-
-	acoral_mutex_post(&mem_ctrl.mutex);
+	buddy_push(num, order);
+	acoral_exit_critical();
 }
 
-void v_mem_init()
+unsigned int buddy_usable_size(void *ptr)
 {
-	unsigned int size;
-	size = acoral_malloc_adjust_size(CFG_MEM2_SIZE);
-	mem_ctrl.down_p = (char *)acoral_malloc(size);
-	if (mem_ctrl.down_p == NULL)
-	{
-		mem_ctrl.mem_state = 0;
-		return;
-	}
-	else
-	{
-		mem_ctrl.mem_state = 1;
-	}
-	acoral_mutex_init(&mem_ctrl.mutex, 0);
-	mem_ctrl.top_p = mem_ctrl.down_p + size;
-	mem_ctrl.freep_p = (unsigned int *)mem_ctrl.down_p;
-	BLOCK_SET_FREE(mem_ctrl.freep_p, size);
+	unsigned int adr = (unsigned int)(unsigned long)ptr;
+	unsigned char state;
+	if (acoral_mem_ctrl == NULL || acoral_mem_ctrl->state == MEM_NO_ALLOC)
+		return 0;
+	if (adr < acoral_mem_ctrl->start_adr || adr >= acoral_mem_ctrl->end_adr || ((adr - acoral_mem_ctrl->start_adr) & (BASIC_BLOCK_SIZE - 1)))
+		return 0;
+	state = acoral_mem_blocks[BUDDY_NUM(adr)].level;
+	if (state == BLOCK_NONE || (state & BLOCK_FREE))
+		return 0;
+	return BASIC_BLOCK_SIZE << state;
 }
 
-void v_mem_scan(void)
+void buddy_stat(acoral_mem_stat_t *stat)
 {
-	char *ctp;
-	unsigned int *tp;
-	unsigned int size;
-	if (mem_ctrl.mem_state == 0)
-	{
-		printf("Mem Init Err ,so no mem space to malloc\r\n");
+	stat->total_bytes = 0;
+	stat->free_bytes = 0;
+	stat->largest_free = 0;
+	if (acoral_mem_ctrl == NULL || acoral_mem_ctrl->state == MEM_NO_ALLOC)
 		return;
-	}
-	ctp = mem_ctrl.down_p;
-	do
-	{
-		tp = (unsigned int *)ctp;
-		size = BLOCK_SIZE(*tp);
-		if (size == 0)
-		{
-			printf("Err address is 0x%x,size should not be 0\r\n", (unsigned int)tp);
-			break;
-		}
-		if (BLOCK_USED(*tp))
-		{
-			printf("The address is 0x%x,the block is used and it's size is %d\r\n", (unsigned int)tp, size);
-		}
-		else
-		{
-
-			printf("The address is 0x%x,the block is unused and it's size is %d\r\n", (unsigned int)tp, size);
-		}
-		ctp = ctp + size;
-	} while (ctp < mem_ctrl.top_p);
+	stat->total_bytes = (unsigned long)acoral_mem_ctrl->block_num << BLOCK_SHIFT;
+	acoral_enter_critical();
+	stat->free_bytes = (unsigned long)acoral_mem_ctrl->free_num << BLOCK_SHIFT;
+	/*最高的非空阶就是最大的空闲块*/
+	if (acoral_mem_ctrl->free_map)
+		stat->largest_free = (unsigned long)BASIC_BLOCK_SIZE << acoral_fls32(acoral_mem_ctrl->free_map);
+	acoral_exit_critical();
 }
-
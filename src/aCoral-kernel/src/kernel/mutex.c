@@ -19,6 +19,7 @@
 #include "int.h"
 #include "soft_timer.h"
 #include "mutex.h"
+#include "log.h"
 #include <stdio.h>
 
 extern void acoral_evt_queue_del(acoral_thread_t *thread);
@@ -26,6 +27,100 @@ extern void acoral_evt_queue_add(acoral_evt_t *evt, acoral_thread_t *new);
 
 acoral_thread_t *acoral_evt_high_thread(acoral_evt_t *evt);
 
+#if CFG_SRP
+/**
+ * @brief 一个核上的SRP状态
+ *
+ */
+typedef struct
+{
+	acoral_evt_t *held[CFG_SRP_MAX_NEST]; ///<本核上按SRP占用的互斥量，按加锁顺序排列
+	unsigned int depth;                   ///<held中的互斥量个数
+	unsigned int ceiling;                 ///<系统天花板，held中天花板最高的，depth为0时无效
+}acoral_srp_cpu_t;
+
+static acoral_srp_cpu_t srp_cpus[CFG_MAX_CPU];
+
+/**
+ * @brief 把互斥量的天花板压到当前核的系统天花板上，需在临界区中调用
+ *
+ * @param evt 刚被占用的互斥量
+ * @param thread 占用线程
+ * @return int 成功返回0，嵌套超过CFG_SRP_MAX_NEST返回-1
+ */
+static int srp_push(acoral_evt_t *evt, acoral_thread_t *thread)
+{
+	acoral_srp_cpu_t *srp = srp_cpus + acoral_current_cpu();
+	unsigned int ceiling = (evt->count & MUTEX_CEILING_MASK) >> 16;
+
+	if (srp->depth >= CFG_SRP_MAX_NEST)
+		return -1;
+	if (srp->depth == 0 || ceiling < srp->ceiling)
+		srp->ceiling = ceiling;
+	srp->held[srp->depth++] = evt;
+	thread->srp_nesting++;
+	return 0;
+}
+
+/**
+ * @brief 从系统天花板中去掉互斥量，需在临界区中调用
+ * @note 正确嵌套时就是栈顶；不按顺序释放时从中间取出，系统天花板按剩下的重新计算
+ *
+ * @param evt 将要释放的互斥量
+ */
+static void srp_pop(acoral_evt_t *evt)
+{
+	acoral_srp_cpu_t *srp;
+	unsigned int cpu, i, ceiling;
+
+	for (cpu = 0; cpu < CFG_MAX_CPU; cpu++)
+	{
+		srp = srp_cpus + cpu;
+		for (i = 0; i < srp->depth && srp->held[i] != evt; i++)
+			;
+		if (i == srp->depth)
+			continue;
+		for (srp->depth--; i < srp->depth; i++)
+			srp->held[i] = srp->held[i + 1];
+		for (i = 0; i < srp->depth; i++)
+		{
+			ceiling = (srp->held[i]->count & MUTEX_CEILING_MASK) >> 16;
+			if (i == 0 || ceiling < srp->ceiling)
+				srp->ceiling = ceiling;
+		}
+		((acoral_thread_t *)evt->data)->srp_nesting--;
+		/*天花板降下来了，被挡住的线程可以开始运行*/
+		system_need_scheds[cpu] = true;
+#ifdef CFG_SMP
+		if (cpu != acoral_current_cpu())
+			HAL_IPI_SEND(cpu);
+#endif
+		return;
+	}
+}
+
+acoral_thread_t *acoral_srp_preempt_check(unsigned int cpu, unsigned int prio)
+{
+	acoral_srp_cpu_t *srp = srp_cpus + cpu;
+	acoral_thread_t *top;
+
+	if (srp->depth == 0 || prio < srp->ceiling)
+		return NULL;
+	top = (acoral_thread_t *)srp->held[srp->depth - 1]->data;
+	/*占用者自己阻塞了（SRP下不该这样用），不能让整个核停下来，退回按优先级调度*/
+	if (!(top->state & ACORAL_THREAD_STATE_READY) || top->cpu != cpu)
+		return NULL;
+	return top;
+}
+
+int acoral_srp_ceiling(unsigned int cpu)
+{
+	if (cpu >= CFG_MAX_CPU || srp_cpus[cpu].depth == 0)
+		return -1;
+	return srp_cpus[cpu].ceiling;
+}
+#endif
+
 acoralMutexRetVal acoral_mutex_init(acoral_evt_t *evt, unsigned char prio)
 {
 	if ((acoral_evt_t *)0 == evt)
@@ -59,6 +154,7 @@ acoral_evt_t *acoral_mutex_create(unsigned char prio, unsigned int *err) // SPG
 
 acoralMutexRetVal acoral_mutex_del(acoral_evt_t *evt, unsigned int opt)
 {
+	(void)opt;
 	/* 参数检测 */
 	if (NULL == evt)
 	{
@@ -86,82 +182,90 @@ acoralMutexRetVal acoral_mutex_del(acoral_evt_t *evt, unsigned int opt)
 	}
 }
 
-acoralMutexRetVal acoral_mutex_trypend(acoral_evt_t *evt)
+/**
+ * @brief 求线程的生效优先级
+ *
+ * @param thread 线程指针
+ * @return unsigned char base_prio、所占用互斥量上最高的等待者、天花板中最高的优先级
+ */
+static unsigned char mutex_effective_prio(acoral_thread_t *thread)
 {
-	acoral_thread_t *cur;
-
-	if (acoral_intr_nesting > 0)
-		return MUTEX_ERR_INTR;
-
-	cur = acoral_cur_thread;
-
-	acoral_enter_critical();
-	if (NULL == evt)
-	{
-		acoral_exit_critical();
-		return MUTEX_ERR_NULL;
-	}
+	acoral_list_t *tmp;
+	acoral_evt_t *evt;
+	acoral_thread_t *waiter;
+	unsigned char prio = thread->base_prio;
+	unsigned char ceiling;
 
-	if ((unsigned char)(evt->count & MUTEX_L_MASK) == MUTEX_AVAI)
+	for (tmp = thread->held_mutexes.next; tmp != &thread->held_mutexes; tmp = tmp->next)
 	{
-		/* 申请成功*/
-		evt->count &= MUTEX_U_MASK;
-		evt->count |= cur->prio;
-		evt->data = (void *)cur;
-		acoral_exit_critical();
-		return MUTEX_SUCCED;
+		evt = list_entry(tmp, acoral_evt_t, owner_hook);
+		if (evt->count & MUTEX_CEILING_HELD)
+		{
+			ceiling = (unsigned char)((evt->count & MUTEX_CEILING_MASK) >> 16);
+			if (ceiling < prio)
+				prio = ceiling;
+		}
+		/*等待队列按优先级排序，队头就是最高的*/
+		waiter = acoral_evt_high_thread(evt);
+		if (waiter != NULL && waiter->prio < prio)
+			prio = waiter->prio;
 	}
-
-	acoral_exit_critical();
-	return MUTEX_ERR_TIMEOUT;
+	return prio;
 }
 
-acoralMutexRetVal acoral_mutex_pend(acoral_evt_t *evt, unsigned int timeout)
+void acoral_mutex_prio_update(acoral_thread_t *thread)
 {
-	unsigned char highPrio;
-	acoral_thread_t *thread;
-	acoral_thread_t *cur;
-
-	if (acoral_intr_nesting > 0)
-		return MUTEX_ERR_INTR;
-
-	cur = acoral_cur_thread;
-
-	acoral_enter_critical();
-	if (NULL == evt)
-	{
-		acoral_exit_critical();
-		return MUTEX_ERR_NULL;
-	}
+	acoral_evt_t *evt;
+	unsigned char prio;
+	unsigned int depth;
 
-	if ((unsigned char)(evt->count & MUTEX_L_MASK) == MUTEX_AVAI)
+	/*链长不会超过线程数，限制一下，死锁成环时也能停下来*/
+	for (depth = 0; thread != NULL && depth < CFG_MAX_THREAD; depth++)
 	{
-		/* 申请成功*/
-		evt->count &= MUTEX_U_MASK;
-		evt->count |= cur->prio;
-		evt->data = (void *)cur;
-		acoral_exit_critical();
-		return MUTEX_SUCCED;
+		prio = mutex_effective_prio(thread);
+		if (prio == thread->prio)
+			return;
+		acoral_thread_change_prio(thread, prio);
+		evt = thread->evt;
+		if (evt == NULL)
+			return;
+		/*等待队列按优先级排序，优先级变了要重新排队*/
+		acoral_evt_queue_del(thread);
+		acoral_evt_queue_add(evt, thread);
+		if (evt->type != ACORAL_EVENT_MUTEX)
+			return;
+		thread = (acoral_thread_t *)evt->data;
 	}
+}
 
-	/* 互斥量已被占有*/
-	highPrio = (unsigned char)(evt->count >> 8);
-	thread = (acoral_thread_t *)evt->data;
+/**
+ * @brief 把互斥量交给线程，需在临界区中调用
+ *
+ * @param evt 互斥量指针
+ * @param thread 新的占用线程
+ */
+static void mutex_take(acoral_evt_t *evt, acoral_thread_t *thread)
+{
+	evt->count &= ~(MUTEX_L_MASK | MUTEX_CEILING_HELD);
+	evt->count |= thread->prio;
+	evt->data = (void *)thread;
+	acoral_list_add2_tail(&evt->owner_hook, &thread->held_mutexes);
+}
 
-	/*有可能优先级反转，继承最高优先级*/
-	if (thread->prio > cur->prio)
-	{
-		if (cur->prio < highPrio)
-		{
-			highPrio = cur->prio;
-			evt->count &= ~MUTEX_U_MASK;
-			evt->count |= highPrio << 8;
-		}
-		acoral_thread_change_prio_by_id(thread->res.id, highPrio);
-	}
-	/*不需要或不能提高优先级*/
+/**
+ * @brief 等待被占用的互斥量，被唤醒后检查是否真的拿到了，需在临界区中调用，返回时已退出临界区
+ *
+ * @param evt 互斥量指针
+ * @param cur 当前线程
+ * @param timeout 超时时间，0表示一直等
+ * @return acoralMutexRetVal
+ */
+static acoralMutexRetVal mutex_wait(acoral_evt_t *evt, acoral_thread_t *cur, unsigned int timeout)
+{
 	unrdy_thread(cur);
 	acoral_evt_queue_add(evt, cur);
+	/*占用者继承当前线程的优先级，占用者自己也在等互斥量时沿等待链一直传下去*/
+	acoral_mutex_prio_update((acoral_thread_t *)evt->data);
 	if (timeout > 0)
 	{
 		/*加载到超时队列*/
@@ -173,9 +277,11 @@ acoralMutexRetVal acoral_mutex_pend(acoral_evt_t *evt, unsigned int timeout)
 	acoral_enter_critical();
 	if (evt->data != cur && timeout > 0 && cur->thread_timer->delay_time <= 0)
 	{
-		printf("Time Out Return\n");
 		acoral_evt_queue_del(cur);
+		/*不再等了，占用者从当前线程继承的优先级要退回去*/
+		acoral_mutex_prio_update((acoral_thread_t *)evt->data);
 		acoral_exit_critical();
+		printf("Time Out Return\n"); //出了临界区再打印，printf要拿newlib锁
 		return MUTEX_ERR_TIMEOUT;
 	}
 
@@ -185,16 +291,17 @@ acoralMutexRetVal acoral_mutex_pend(acoral_evt_t *evt, unsigned int timeout)
 
 	if (evt->data != cur)
 	{
-		printf("Err Ready Return\n");
 		acoral_evt_queue_del(cur);
+		acoral_mutex_prio_update((acoral_thread_t *)evt->data);
 		acoral_exit_critical();
+		printf("Err Ready Return\n");
 		return MUTEX_ERR_RDY;
 	}
-
+	acoral_exit_critical();
 	return MUTEX_SUCCED;
 }
 
-acoralMutexRetVal acoral_mutex_pend2(acoral_evt_t *evt, unsigned int timeout)
+acoralMutexRetVal acoral_mutex_trypend(acoral_evt_t *evt)
 {
 	acoral_thread_t *cur;
 
@@ -213,101 +320,134 @@ acoralMutexRetVal acoral_mutex_pend2(acoral_evt_t *evt, unsigned int timeout)
 	if ((unsigned char)(evt->count & MUTEX_L_MASK) == MUTEX_AVAI)
 	{
 		/* 申请成功*/
-		evt->count &= MUTEX_U_MASK;
-		evt->count |= cur->prio;
-		evt->data = (void *)cur;
-
-		/*提升至天花板优先级*/
-		cur->prio = (evt->count & MUTEX_CEILING_MASK) >> 16;
+		mutex_take(evt, cur);
 		acoral_exit_critical();
 		return MUTEX_SUCCED;
 	}
 
-	/* 互斥量已被占有*/
-	unrdy_thread(cur);
-	acoral_evt_queue_add(evt, cur);
-	if (timeout > 0)
-	{
-		/*加载到超时队列*/
-		cur->thread_timer->delay_time = time_to_ticks(timeout);
-		timeout_queue_add(cur);
-	}
 	acoral_exit_critical();
+	return MUTEX_ERR_TIMEOUT;
+}
 
-	/*触发调度*/
-	acoral_sched();
+acoralMutexRetVal acoral_mutex_pend(acoral_evt_t *evt, unsigned int timeout)
+{
+	acoral_thread_t *cur;
+
+	if (acoral_intr_nesting > 0)
+		return MUTEX_ERR_INTR;
+
+	cur = acoral_cur_thread;
 
 	acoral_enter_critical();
+	if (NULL == evt)
+	{
+		acoral_exit_critical();
+		return MUTEX_ERR_NULL;
+	}
 
-	/*超时时间内未获得互斥量*/
-	if (evt->data != cur && timeout > 0 && cur->thread_timer->delay_time <= 0)
+	if ((unsigned char)(evt->count & MUTEX_L_MASK) == MUTEX_AVAI)
 	{
-		printf("Time Out Return\n");
-		acoral_evt_queue_del(cur);
+		/* 申请成功*/
+		mutex_take(evt, cur);
 		acoral_exit_critical();
-		return MUTEX_ERR_TIMEOUT;
+		return MUTEX_SUCCED;
 	}
 
-	/*超时时间内获得了互斥量*/
-	timeout_queue_del(cur);
+	/* 互斥量已被占有，优先级继承*/
+	return mutex_wait(evt, cur, timeout);
+}
 
-	if (evt->data != cur)
+acoralMutexRetVal acoral_mutex_pend2(acoral_evt_t *evt, unsigned int timeout)
+{
+	acoral_thread_t *cur;
+	acoralMutexRetVal ret;
+#if CFG_SRP
+	int srp_ret;
+#endif
+
+	if (acoral_intr_nesting > 0)
+		return MUTEX_ERR_INTR;
+
+	cur = acoral_cur_thread;
+
+	acoral_enter_critical();
+	if (NULL == evt)
 	{
-		printf("Err Ready Return\n");
-		acoral_evt_queue_del(cur);
 		acoral_exit_critical();
-		return MUTEX_ERR_RDY;
+		return MUTEX_ERR_NULL;
 	}
 
+	if ((unsigned char)(evt->count & MUTEX_L_MASK) != MUTEX_AVAI)
+	{
+		/* 互斥量已被占有*/
+		ret = mutex_wait(evt, cur, timeout);
+		if (ret != MUTEX_SUCCED)
+			return ret;
+		acoral_enter_critical();
+	}
+	else
+	{
+		/* 申请成功*/
+		mutex_take(evt, cur);
+	}
+
+	/*提升至天花板优先级，释放时由acoral_mutex_prio_update退回*/
+	evt->count |= MUTEX_CEILING_HELD;
+	acoral_mutex_prio_update(cur);
+#if CFG_SRP
+	srp_ret = srp_push(evt, cur);
+#endif
+	acoral_exit_critical();
+#if CFG_SRP
+	if (srp_ret != 0)
+		ACORAL_LOG_ERROR("SRP Nesting Beyond %d, Mutex Not In System Ceiling", CFG_SRP_MAX_NEST);
+#endif
 	return MUTEX_SUCCED;
 }
 
 acoralMutexRetVal acoral_mutex_post(acoral_evt_t *evt)
 {
-	unsigned char ownerPrio;
-	unsigned char highPrio;
 	acoral_thread_t *thread;
 	acoral_thread_t *cur;
 
-	acoral_enter_critical();
-
 	if (NULL == evt)
 	{
 		printf("mutex NULL\n");
-		acoral_exit_critical();
 		return MUTEX_ERR_NULL; /*error*/
 	}
 
-	highPrio = (unsigned char)(evt->count >> 8);
-	ownerPrio = (unsigned char)(evt->count & MUTEX_L_MASK);
+	acoral_enter_critical();
 	cur = acoral_cur_thread;
-	if (highPrio != 0 && cur->prio != highPrio && cur->prio != ownerPrio)
+	if (evt->data != cur)
 	{
-		printf("mutex prio err\n");
 		acoral_exit_critical();
+		printf("mutex owner err\n");
 		return MUTEX_ERR_UNDEF;
 	}
-	cur->evt = NULL;
-	if (cur->prio != ownerPrio)
-	{
-		/* 提升过优先级，进行优先级复原*/
-		acoral_change_prio_self(ownerPrio);
-	}
+	acoral_list_del(&evt->owner_hook);
+#if CFG_SRP
+	if (evt->count & MUTEX_CEILING_HELD)
+		srp_pop(evt);
+#endif
 
 	thread = acoral_evt_high_thread(evt);
 	if (thread == NULL)
 	{
+		evt->count &= ~MUTEX_CEILING_HELD;
 		evt->count |= MUTEX_AVAI;
 		evt->data = NULL;
-		acoral_exit_critical();
-		return MUTEX_SUCCED;
 	}
-	timeout_queue_del(thread);
-	acoral_evt_queue_del(thread);
-	evt->count &= MUTEX_U_MASK;
-	evt->count |= thread->prio;
-	evt->data = thread;
-	ready_thread(thread);
+	else
+	{
+		timeout_queue_del(thread);
+		acoral_evt_queue_del(thread);
+		mutex_take(evt, thread);
+		/*新占用者继承剩下的等待者的优先级*/
+		acoral_mutex_prio_update(thread);
+		ready_thread(thread);
+	}
+	/*提升过优先级的，按还占用着的互斥量重新计算，全部释放后回到base_prio*/
+	acoral_mutex_prio_update(cur);
 	acoral_exit_critical();
 	acoral_sched();
 	return MUTEX_SUCCED;
@@ -0,0 +1,396 @@
+/**
+ * @file newlib.c
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief kernel层，newlib的接口：malloc系列由统一堆提供，_lock_*由aCoral互斥量实现
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ * @note newlib的malloc、free等和库里其他函数用的_malloc_r、_free_r等都在这里定义，链接时不再拉进newlib自己的
+ *       分配器，_sbrk也就不会被调用；C++的new最终调用malloc，nncase等第三方库也一起落到统一堆上。
+ *       锁在线程里睡在互斥量上等，带优先级继承；中断里、调度锁住时和调度开始之前不能睡，自旋等别的核上的占用者，
+ *       本核上的占用者等不到，按核递归放行，和原来的自旋锁一样。已经在临界区里的只能拿空闲的锁，
+ *       别人占着时直接失败，不在占着内核大锁时自旋，所以临界区里不要打印
+ */
+#include "autocfg.h"
+
+#if CFG_NEWLIB_GLUE
+#include "heap.h"
+#include "thread.h"
+#include "mutex.h"
+#include "event.h"
+#include "int.h"
+#include "hal.h"
+#include <stddef.h>
+#include <errno.h>
+#include <reent.h>
+#include <sys/lock.h>
+
+/******************** malloc ********************/
+
+void *malloc(size_t size)
+{
+	void *ptr = acoral_heap_malloc(size);
+	if (ptr == NULL && size != 0)
+		errno = ENOMEM;
+	return ptr;
+}
+
+void free(void *ptr)
+{
+	acoral_heap_free(ptr);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	void *new_ptr = acoral_heap_realloc(ptr, size);
+	if (new_ptr == NULL && size != 0)
+		errno = ENOMEM;
+	return new_ptr;
+}
+
+void *calloc(size_t num, size_t size)
+{
+	void *ptr = acoral_heap_calloc(num, size);
+	if (ptr == NULL && num != 0 && size != 0)
+		errno = ENOMEM;
+	return ptr;
+}
+
+void *memalign(size_t align, size_t size)
+{
+	void *ptr = acoral_heap_memalign(align, size);
+	if (ptr == NULL && size != 0)
+		errno = ENOMEM;
+	return ptr;
+}
+
+size_t malloc_usable_size(void *ptr)
+{
+	return acoral_heap_usable_size(ptr);
+}
+
+void *_malloc_r(struct _reent *reent, size_t size)
+{
+	void *ptr = acoral_heap_malloc(size);
+	if (ptr == NULL && size != 0)
+		reent->_errno = ENOMEM;
+	return ptr;
+}
+
+void _free_r(struct _reent *reent, void *ptr)
+{
+	acoral_heap_free(ptr);
+}
+
+void *_realloc_r(struct _reent *reent, void *ptr, size_t size)
+{
+	void *new_ptr = acoral_heap_realloc(ptr, size);
+	if (new_ptr == NULL && size != 0)
+		reent->_errno = ENOMEM;
+	return new_ptr;
+}
+
+void *_calloc_r(struct _reent *reent, size_t num, size_t size)
+{
+	void *ptr = acoral_heap_calloc(num, size);
+	if (ptr == NULL && num != 0 && size != 0)
+		reent->_errno = ENOMEM;
+	return ptr;
+}
+
+void *_memalign_r(struct _reent *reent, size_t align, size_t size)
+{
+	void *ptr = acoral_heap_memalign(align, size);
+	if (ptr == NULL && size != 0)
+		reent->_errno = ENOMEM;
+	return ptr;
+}
+
+size_t _malloc_usable_size_r(struct _reent *reent, void *ptr)
+{
+	return acoral_heap_usable_size(ptr);
+}
+
+/******************** lock ********************/
+
+#define NEWLIB_LOCK_HART(cpu) ((void *)(unsigned long)((cpu) + 1)) ///<中断里和调度开始之前的占用者记成所在的核，和线程指针不会重
+#define NEWLIB_LOCK_IS_HART(owner) ((unsigned long)(owner) <= CFG_MAX_CPU)
+
+#define NEWLIB_LOCK_CRIT (-1) ///<已经在临界区里，占着内核大锁，别人占着时不能等
+#define NEWLIB_LOCK_SPIN 0    ///<中断里、调度锁住时或调度开始之前，不能睡，自旋等
+#define NEWLIB_LOCK_SLEEP 1   ///<普通线程，睡在互斥量上等
+
+/**
+ * @brief newlib锁对应的表项
+ * @note newlib的锁是静态初始化为0的_lock_t，第一次加锁时才绑定一个表项，_lock_t里记表项编号加1，表满了记-1，共用备用表项。
+ *       表项的状态都由内核大锁保护
+ *
+ */
+typedef struct{
+	acoral_evt_t mutex;     ///<线程占用的互斥量，占用者就是mutex.data，等锁的线程按优先级排队，占用者继承等待者的优先级
+	void *owner;            ///<中断里或调度开始之前占用的核，NEWLIB_LOCK_HART(核号)，NULL表示没有；不为NULL时它才是占用者
+	unsigned int depth;     ///<占用者递归加锁的层数
+	_lock_t *lock;          ///<绑定的newlib锁，NULL表示表项空闲
+}newlib_lock_t;
+
+static newlib_lock_t newlib_locks[CFG_NEWLIB_LOCKS];
+static newlib_lock_t newlib_lock_spare; ///<表满时绑不上表项的newlib锁都共用它，互斥照样有，只是粒度粗了
+
+/**
+ * @brief 当前上下文的占用者记号，要在newlib锁自己进入的临界区里调用
+ *
+ * @param mode 返回NEWLIB_LOCK_CRIT、NEWLIB_LOCK_SPIN或NEWLIB_LOCK_SLEEP
+ * @return void* 线程里是线程指针，中断里和调度开始之前是NEWLIB_LOCK_HART(核号)
+ */
+static void *newlib_lock_self(int *mode)
+{
+	unsigned long mie;
+	unsigned int cpu = acoral_current_cpu();
+
+	if (HAL_CRIT_SAVE(&mie) > 1) // 自己进的那一层不算
+		*mode = NEWLIB_LOCK_CRIT;
+	else if (acoral_intr_nesting > 0 || acoral_cur_thread == NULL || system_sched_locked || acoral_sched_lock_nesting[cpu])
+		*mode = NEWLIB_LOCK_SPIN;
+	else
+		*mode = NEWLIB_LOCK_SLEEP;
+	if (acoral_intr_nesting > 0 || acoral_cur_thread == NULL)
+		return NEWLIB_LOCK_HART(cpu);
+	return acoral_cur_thread;
+}
+
+/**
+ * @brief 取newlib锁对应的表项，还没有就绑定一个
+ * @note 这里不能打印：printf又会来要newlib锁
+ *
+ * @return newlib_lock_t* 表项，表满了返回NULL，这个锁以后都用备用表项
+ */
+static newlib_lock_t *newlib_lock_get(_lock_t *lock)
+{
+	newlib_lock_t *l = NULL;
+	unsigned int i;
+
+	if (*lock > 0 && *lock <= CFG_NEWLIB_LOCKS)
+		return &newlib_locks[*lock - 1];
+	if (*lock < 0)
+		return NULL;
+	acoral_enter_critical();
+	if (*lock == 0) // 另一个核可能刚绑定过
+	{
+		for (i = 0; i < CFG_NEWLIB_LOCKS; i++)
+		{
+			if (newlib_locks[i].lock == NULL)
+			{
+				l = &newlib_locks[i];
+				acoral_mutex_init(&l->mutex, 0);
+				l->owner = NULL;
+				l->depth = 0;
+				l->lock = lock;
+				*lock = i + 1;
+				break;
+			}
+		}
+		if (*lock == 0)
+		{
+			if (newlib_lock_spare.lock == NULL)
+			{
+				acoral_mutex_init(&newlib_lock_spare.mutex, 0);
+				newlib_lock_spare.lock = lock;
+			}
+			*lock = -1;
+		}
+	}
+	else if (*lock > 0)
+		l = &newlib_locks[*lock - 1];
+	acoral_exit_critical();
+	return l;
+}
+
+/**
+ * @brief 尝试占用一次，需在临界区中调用
+ *
+ * @return int 0：拿到了或者放行；-1：在临界区里，别人占着；1：要自旋再试；2：要睡在互斥量上等
+ */
+static int newlib_lock_claim(newlib_lock_t *l, void *self, int mode)
+{
+	acoral_thread_t *holder;
+	unsigned int cpu;
+
+	if (self == l->owner || (l->owner == NULL && self == l->mutex.data))
+	{
+		l->depth++;
+		return 0;
+	}
+	if (l->owner == NULL && (l->mutex.count & MUTEX_L_MASK) == MUTEX_AVAI)
+	{
+		if (NEWLIB_LOCK_IS_HART(self))
+			l->owner = self;
+		else
+			acoral_mutex_trypend(&l->mutex);
+		l->depth = 1;
+		return 0;
+	}
+	/*在临界区里等别的核上的占用者，它要进临界区时就互相卡住了，直接失败*/
+	if (mode == NEWLIB_LOCK_CRIT)
+		return -1;
+	if (mode == NEWLIB_LOCK_SLEEP)
+		return 2;
+	if (l->owner != NULL)
+		cpu = (unsigned long)l->owner - 1;
+	else
+	{
+		holder = (acoral_thread_t *)l->mutex.data;
+		cpu = holder->cpu;
+	}
+	/*本核上被打断或者被调度锁挡住的占用者等不到，和原来按核递归的自旋锁一样放行，解锁时不是占用者什么也不做*/
+	if (cpu == acoral_current_cpu())
+		return 0;
+	return 1;
+}
+
+/**
+ * @brief 加锁，同一个占用者可以递归加锁
+ * @note 线程睡在互斥量上等，占用线程继承等待者的优先级；不能睡时自旋等别的核上的占用者，两次尝试之间开中断；
+ *       已经在临界区里时只能拿空闲的锁，不等
+ *
+ * @param wait 是否等待
+ * @return int 0：拿到了；-1：没拿到
+ */
+static int newlib_lock_take(_lock_t *lock, int wait)
+{
+	newlib_lock_t *l = newlib_lock_get(lock);
+	void *self;
+	int mode, ret;
+
+	if (l == NULL)
+		l = &newlib_lock_spare;
+	for (;;)
+	{
+		acoral_enter_critical();
+		self = newlib_lock_self(&mode);
+		ret = newlib_lock_claim(l, self, mode);
+		acoral_exit_critical();
+		if (ret <= 0)
+			return ret;
+		if (!wait)
+			return -1;
+		if (ret == 2)
+			break;
+	}
+	if (acoral_mutex_pend(&l->mutex, 0) != MUTEX_SUCCED)
+		return -1;
+	/*别的核上的中断可能趁互斥量空着时占了锁，很快就会放*/
+	for (;;)
+	{
+		acoral_enter_critical();
+		if (l->owner == NULL)
+		{
+			l->depth = 1;
+			acoral_exit_critical();
+			return 0;
+		}
+		acoral_exit_critical();
+	}
+}
+
+/**
+ * @brief 解锁，按记下的占用者判断，和当前是不是在临界区、调度锁里无关
+ *
+ */
+static void newlib_lock_give(_lock_t *lock)
+{
+	newlib_lock_t *l;
+	void *self;
+	int mode;
+	int post = 0;
+
+	if (*lock == 0 || *lock > CFG_NEWLIB_LOCKS)
+		return;
+	l = *lock > 0 ? &newlib_locks[*lock - 1] : &newlib_lock_spare;
+	acoral_enter_critical();
+	self = newlib_lock_self(&mode);
+	if (self == l->owner)
+	{
+		if (--l->depth == 0)
+			l->owner = NULL;
+	}
+	else if (l->owner == NULL && self == l->mutex.data)
+		post = (--l->depth == 0);
+	acoral_exit_critical();
+	if (post)
+		acoral_mutex_post(&l->mutex);
+}
+
+/**
+ * @brief 解除newlib锁和表项的绑定
+ *
+ */
+static void newlib_lock_close(_lock_t *lock)
+{
+	newlib_lock_t *l;
+
+	acoral_enter_critical();
+	if (*lock < 0)
+		*lock = 0;
+	else if (*lock > 0 && *lock <= CFG_NEWLIB_LOCKS)
+	{
+		l = &newlib_locks[*lock - 1];
+		if (l->owner == NULL && l->mutex.data == NULL && acoral_evt_queue_empty(&l->mutex))
+		{
+			l->lock = NULL;
+			*lock = 0;
+		}
+	}
+	acoral_exit_critical();
+}
+
+void _lock_init(_lock_t *lock)
+{
+	*lock = 0;
+}
+
+void _lock_init_recursive(_lock_t *lock)
+{
+	*lock = 0;
+}
+
+void _lock_close(_lock_t *lock)
+{
+	newlib_lock_close(lock);
+}
+
+void _lock_close_recursive(_lock_t *lock)
+{
+	newlib_lock_close(lock);
+}
+
+void _lock_acquire(_lock_t *lock)
+{
+	newlib_lock_take(lock, 1);
+}
+
+void _lock_acquire_recursive(_lock_t *lock)
+{
+	newlib_lock_take(lock, 1);
+}
+
+int _lock_try_acquire(_lock_t *lock)
+{
+	return newlib_lock_take(lock, 0);
+}
+
+int _lock_try_acquire_recursive(_lock_t *lock)
+{
+	return newlib_lock_take(lock, 0);
+}
+
+void _lock_release(_lock_t *lock)
+{
+	newlib_lock_give(lock);
+}
+
+void _lock_release_recursive(_lock_t *lock)
+{
+	newlib_lock_give(lock);
+}
+
+#endif
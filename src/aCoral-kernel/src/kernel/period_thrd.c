@@ -22,11 +22,49 @@
 #include "period_thrd.h"
 #include "int.h"
 #include "dag.h"
+#include "log.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #if CFG_THRD_PERIOD
 
+#if CFG_THRD_EDF
+/// 已准入的EDF线程总利用率，千分比
+static unsigned int edf_total_util = 0;
+
+/**
+ * @brief 计算EDF线程的利用率（千分比），截止期小于周期时按密度wcet/deadline计算
+ * 
+ * @param data 周期线程数据
+ * @return unsigned int 利用率，千分比
+ */
+static unsigned int edf_thread_util(acoral_period_policy_data_t *data){
+	unsigned int window = data->period_time_mm;
+	if(data->deadline_mm != 0 && data->deadline_mm < window)
+		window = data->deadline_mm;
+	if(window == 0)
+		return CFG_EDF_UTIL_BOUND + 1; //周期为0的线程一律拒绝
+	return (data->wcet_mm * 1000 + window - 1) / window;
+}
+
+unsigned int acoral_edf_get_util(void){
+	return edf_total_util;
+}
+#endif
+
+/**
+ * @brief 推进到下一次释放的绝对时间
+ * @note 以首次释放的tick为基准累加毫秒数再换算成ticks，周期不是tick的整数倍（如30Hz）时也不会累积漂移
+ * 
+ * @param policy_data 周期策略数据
+ */
+static void period_next_release(acoral_period_policy_data_t *policy_data){
+	policy_data->release_mm+=policy_data->period_time_mm;
+	policy_data->next_release=policy_data->base_ticks+
+		(unsigned int)((unsigned long long)policy_data->release_mm*CFG_TICKS_PER_SEC/1000);
+}
+
 /**
  * @brief 初始化周期线程的一些数据
  * 
@@ -46,19 +84,23 @@ static int period_policy_thread_init(acoral_thread_t *thread,void *data){
         return -1;
     }
     policy_data->period_time_mm=((acoral_period_policy_data_t*)data)->period_time_mm;
+    policy_data->deadline_mm=((acoral_period_policy_data_t*)data)->deadline_mm;
+    if(policy_data->deadline_mm==0)
+        policy_data->deadline_mm=policy_data->period_time_mm;
+    policy_data->wcet_mm=((acoral_period_policy_data_t*)data)->wcet_mm;
+    /*第一个作业在创建时立即释放，之后的释放时间都以它为基准*/
+    policy_data->base_ticks=acoral_get_ticks();
+    policy_data->release_mm=0;
+    policy_data->release_ticks=policy_data->base_ticks;
+    policy_data->abs_deadline=policy_data->release_ticks+time_to_ticks(policy_data->deadline_mm);
+    policy_data->waiting=0;
+    policy_data->pending=0;
+    policy_data->release_cycles=HAL_GET_CYCLES();
+    policy_data->pending_cycles=0;
+    memset(&policy_data->stat,0,sizeof(acoral_period_stat_t));
+    policy_data->stat.jobs=1;
     thread->policy_data=policy_data;
 
-    /* 分配TCB中的period_timer */
-    acoral_timer_t* period_timer = (acoral_timer_t *)acoral_get_res(ACORAL_RES_TIMER);
-    if(NULL==period_timer){
-        printf("Alloc thread timer fail\n");
-        printf("No Mem Space or Beyond the max thread\n");
-        return -1;
-    }
-    acoral_init_list(&period_timer->delay_queue_hook);
-    thread->thread_period_timer = period_timer;
-    thread->thread_period_timer->owner = thread->res;
-
 	if(thread_stack_init(thread,period_thread_exit)!=0){
 		printf("No thread stack:%s\n",thread->name);
 		acoral_enter_critical();
@@ -69,78 +111,217 @@ static int period_policy_thread_init(acoral_thread_t *thread,void *data){
         /*将线程就绪，并重新调度*/
 	acoral_resume_thread(thread);
 	acoral_enter_critical();
-	period_thread_delay(thread,((acoral_period_policy_data_t*)data)->period_time_mm);
+	period_next_release(policy_data);
+	acoral_periodqueue_add(thread);
 	acoral_exit_critical();
 	return thread->res.id;
 }
 
 void period_policy_thread_release(acoral_thread_t *thread){
-	acoral_free2(thread->policy_data);	
+	acoral_free(thread->policy_data); //policy_data由acoral_malloc分配，必须用对应的acoral_free释放
 }
 
+#if CFG_THRD_EDF
+/**
+ * @brief 初始化EDF线程，先做利用率准入控制，再按周期线程初始化
+ * 
+ * @param thread 线程指针
+ * @param data 周期线程数据，acoral_period_policy_data_t，wcet_mm必须填写
+ * @return int 线程id，准入失败返回-1
+ */
+static int edf_policy_thread_init(acoral_thread_t *thread,void *data){
+	unsigned int util;
+	int ret;
+
+	if(data==NULL){
+		ACORAL_LOG_ERROR("EDF thread %s needs period data",thread->name);
+		acoral_enter_critical();
+		acoral_release_res((acoral_res_t *)thread);
+		acoral_exit_critical();
+		return -1;
+	}
+	util=edf_thread_util((acoral_period_policy_data_t*)data);
+	acoral_enter_critical();
+	if(util>CFG_EDF_UTIL_BOUND||edf_total_util+util>CFG_EDF_UTIL_BOUND){
+		acoral_release_res((acoral_res_t *)thread);
+		acoral_exit_critical();
+		ACORAL_LOG_ERROR("EDF admission failed:%s,util %u+%u > %u",thread->name,edf_total_util,util,CFG_EDF_UTIL_BOUND);
+		return -1;
+	}
+	/*先占住利用率，防止并发创建时同时通过准入*/
+	edf_total_util+=util;
+	acoral_exit_critical();
+
+	ret=period_policy_thread_init(thread,data);
+	if(ret<0){
+		acoral_enter_critical();
+		edf_total_util-=util;
+		acoral_exit_critical();
+	}
+	return ret;
+}
+
+static void edf_policy_thread_release(acoral_thread_t *thread){
+	acoral_enter_critical();
+	edf_total_util-=edf_thread_util((acoral_period_policy_data_t*)thread->policy_data);
+	acoral_exit_critical();
+	period_policy_thread_release(thread);
+}
+#endif
+
 void acoral_periodqueue_add(acoral_thread_t *new){
 	acoral_list_t   *tmp,*head;
 	acoral_thread_t *thread;
-	int  delay2;
-	int  new_thread_period= new->thread_period_timer->delay_time;
+	unsigned int release=((acoral_period_policy_data_t*)new->policy_data)->next_release;
 	head = &(((policy_res_private_data*)(acoral_res_system.system_res_ctrl_container[ACORAL_RES_POLICY].type_private_data))->global_period_wait_queue);
 	new->state|=ACORAL_THREAD_STATE_DELAY;
 
-    /* 找到period_wait_queue中新线程应该插入的位置并插入 */
-	for (tmp=head->next; delay2 = new_thread_period, tmp != head; tmp = tmp->next){
+    /* 队列按下一次释放的绝对时间排序，用差值比较，ticks回绕时仍然正确 */
+	for (tmp=head->next; tmp != head; tmp = tmp->next){
 		thread = list_entry (tmp, acoral_thread_t, period_wait_hook);
-		new_thread_period  = new_thread_period - thread->thread_period_timer->delay_time;
-		if (new_thread_period < 0)
+		if ((int)(release - ((acoral_period_policy_data_t*)thread->policy_data)->next_release) < 0)
 			break;
 	}
-	new->thread_period_timer->delay_time = delay2;
-	acoral_list_add(&new->period_wait_hook,tmp->prev);
-
-	/* 插入新线程后，后续线程的时间处理*/
-	if(tmp != head){
-		thread = list_entry(tmp, acoral_thread_t, period_wait_hook);
-		thread->thread_period_timer->delay_time-=delay2;
-	}
+	acoral_list_add2_tail(&new->period_wait_hook,tmp);
+#if CFG_TICKLESS
+	if(head->next == &new->period_wait_hook)
+		acoral_tickless_kick();
+#endif
 }
 
-void period_thread_delay(acoral_thread_t* thread,unsigned int time){
-	thread->thread_period_timer->delay_time=time_to_ticks(time);
-	acoral_periodqueue_add(thread);
+/**
+ * @brief 释放周期线程的一个作业
+ * @note 线程在acoral_period_wait中等待则直接就绪，不重建栈；否则说明上一个作业还没结束，记一次超限
+ * 
+ * @param thread 线程指针
+ * @param policy_data 周期策略数据
+ */
+static void period_release_job(acoral_thread_t *thread,acoral_period_policy_data_t *policy_data){
+	policy_data->release_ticks=policy_data->next_release;
+	policy_data->stat.jobs++;
+	if(policy_data->waiting){
+		policy_data->waiting=0;
+		policy_data->release_cycles=HAL_GET_CYCLES();
+		/*新作业的绝对截止期，必须在挂上就绪队列之前更新，EDF按它排序*/
+		policy_data->abs_deadline=policy_data->release_ticks+time_to_ticks(policy_data->deadline_mm);
+		ready_thread(thread);
+	}else{
+		policy_data->stat.overruns++;
+		if(policy_data->pending!=(unsigned int)-1) //饱和，不回绕成0
+			policy_data->pending++;
+		policy_data->pending_cycles=HAL_GET_CYCLES();
+	}
 }
 
 void period_delay_deal(){
-	// int need_re_sched= 0;
-	acoral_list_t *tmp,*tmp1,*head;
+	acoral_list_t *head;
 	acoral_thread_t * thread;
+	acoral_period_policy_data_t *policy_data;
+	unsigned int now=acoral_get_ticks();
 	head = &(((policy_res_private_data*)(acoral_res_system.system_res_ctrl_container[ACORAL_RES_POLICY].type_private_data))->global_period_wait_queue);
-	if(acoral_list_empty(head))
-	    	return;
-	thread=list_entry(head->next,acoral_thread_t,period_wait_hook);
-	thread->thread_period_timer->delay_time--;
-	for(tmp=head->next;tmp!=head;){
-		thread=list_entry(tmp,acoral_thread_t,period_wait_hook);
-		if(thread->thread_period_timer->delay_time>0)
+	while(!acoral_list_empty(head)){
+		thread=list_entry(head->next,acoral_thread_t,period_wait_hook);
+		policy_data=(acoral_period_policy_data_t*)thread->policy_data;
+		if((int)(now-policy_data->next_release)<0)
 		    break;
-		/*防止add判断delay时取下thread*/
-		tmp1=tmp->next;
 		acoral_list_del(&thread->period_wait_hook);
-		tmp=tmp1;
-		if(thread->state&ACORAL_THREAD_STATE_SUSPEND){
-			thread->stack=(unsigned int *)((char *)thread->stack_buttom+thread->stack_size-4);
-			thread->stack = HAL_STACK_INIT(thread->stack,thread->route,period_thread_exit,thread->args);
+		period_release_job(thread,policy_data);
+		/*下一次释放按绝对时间推进，和本次处理的延迟无关*/
+		period_next_release(policy_data);
+		acoral_periodqueue_add(thread);
+	}
+}
+
+unsigned int period_next_expiry(void){
+	acoral_list_t *head;
+	acoral_thread_t *thread;
+	int left;
+	head = &(((policy_res_private_data*)(acoral_res_system.system_res_ctrl_container[ACORAL_RES_POLICY].type_private_data))->global_period_wait_queue);
+	if(acoral_list_empty(head))
+		return (unsigned int)-1;
+	thread=list_entry(head->next,acoral_thread_t,period_wait_hook);
+	left=(int)(((acoral_period_policy_data_t*)thread->policy_data)->next_release-acoral_get_ticks());
+	return left>1?left:1;
+}
+
+void acoral_period_wait(void){
+	acoral_thread_t *thread=acoral_cur_thread;
+	acoral_period_policy_data_t *policy_data;
+	acoral_period_stat_t *stat;
+	unsigned long now;
+	unsigned long long release_mm;
+
+	if(thread->policy!=ACORAL_SCHED_POLICY_PERIOD
+#if CFG_THRD_EDF
+		&&thread->policy!=ACORAL_SCHED_POLICY_EDF
+#endif
+	){
+		ACORAL_LOG_ERROR("Thread %s is not a period thread",thread->name);
+		return;
+	}
+	policy_data=(acoral_period_policy_data_t*)thread->policy_data;
+	stat=&policy_data->stat;
+
+	/*本周期作业结束，记录响应时间*/
+	now=HAL_GET_CYCLES();
+	stat->response_last=now-policy_data->release_cycles;
+	if(stat->response_last>stat->response_max)
+		stat->response_max=stat->response_last;
+
+	acoral_enter_critical();
+	if(policy_data->pending){
+		/*超限：下一个作业早已释放，不睡眠直接开始*/
+		policy_data->pending--;
+		policy_data->release_cycles=policy_data->pending_cycles;
+		/*开始的是积压作业中最早的一个，它之后还有pending个已释放的作业；
+		  release_mm对应下一次释放，按它倒推，和period_next_release一样不累积取整误差*/
+		release_mm=policy_data->release_mm-(policy_data->pending+1ULL)*policy_data->period_time_mm;
+		policy_data->release_ticks=policy_data->base_ticks+(unsigned int)(release_mm*CFG_TICKS_PER_SEC/1000);
+		policy_data->abs_deadline=policy_data->release_ticks+time_to_ticks(policy_data->deadline_mm);
+#if CFG_THRD_EDF
+		if(thread->policy==ACORAL_SCHED_POLICY_EDF){
+			/*截止期变了，按新截止期重新排队*/
+			unrdy_thread(thread);
 			ready_thread(thread);
-			// need_re_sched = 1;
+			thread->state|=ACORAL_THREAD_STATE_RUNNING;
 		}
-		period_thread_delay(thread,((acoral_period_policy_data_t*)thread->policy_data)->period_time_mm);
-		// if(need_re_sched)
-		// {
-		// 	acoral_sched();//SPG我是小丑，时钟中断里不能调度的，应该在把中断退出函数加回来
-		// }
+#endif
+	}else{
+		policy_data->waiting=1;
+		unrdy_thread(thread);
 	}
+	acoral_exit_critical();
+	acoral_sched();
+
+	/*新作业开始，记录释放抖动*/
+	now=HAL_GET_CYCLES();
+	stat->jitter_last=now-policy_data->release_cycles;
+	if(stat->jitter_last>stat->jitter_max)
+		stat->jitter_max=stat->jitter_last;
+}
+
+int acoral_period_get_stat(int thread_id, acoral_period_stat_t *stat){
+	acoral_thread_t *thread=(acoral_thread_t *)acoral_get_res_by_id(thread_id);
+	if(thread==NULL||stat==NULL)
+		return -1;
+	if(thread->policy!=ACORAL_SCHED_POLICY_PERIOD
+#if CFG_THRD_EDF
+		&&thread->policy!=ACORAL_SCHED_POLICY_EDF
+#endif
+	)
+		return -1;
+	acoral_enter_critical();
+	*stat=((acoral_period_policy_data_t*)thread->policy_data)->stat;
+	acoral_exit_critical();
+	return 0;
 }
 
 void period_thread_exit(){
-	acoral_suspend_self();
+	/*route返回即本周期作业结束，原地等待下一次释放后再次调用route，不再每个周期重建线程栈*/
+	for(;;){
+		acoral_period_wait();
+		acoral_cur_thread->route(acoral_cur_thread->args);
+	}
 }
 
 
@@ -148,7 +329,7 @@ void period_policy_init(void){
     /* 初始化全局周期线程等待队列 */
     acoral_init_list(&(((policy_res_private_data*)(acoral_res_system.system_res_ctrl_container[ACORAL_RES_POLICY].type_private_data))->global_period_wait_queue));
 
-    acoral_sched_policy_t* period_policy = acoral_get_res(ACORAL_RES_POLICY);
+    acoral_sched_policy_t* period_policy = (acoral_sched_policy_t *)acoral_get_res(ACORAL_RES_POLICY);
 
 	period_policy->type=ACORAL_SCHED_POLICY_PERIOD;
 	period_policy->policy_thread_init=period_policy_thread_init;
@@ -157,4 +338,16 @@ void period_policy_init(void){
 	acoral_register_sched_policy(period_policy);
 }
 
+#if CFG_THRD_EDF
+void edf_policy_init(void){
+    acoral_sched_policy_t* edf_policy = (acoral_sched_policy_t *)acoral_get_res(ACORAL_RES_POLICY);
+
+	edf_policy->type=ACORAL_SCHED_POLICY_EDF;
+	edf_policy->policy_thread_init=edf_policy_thread_init;
+	edf_policy->policy_thread_release=edf_policy_thread_release;
+	edf_policy->delay_deal=NULL; //周期释放统一由period_delay_deal处理
+	acoral_register_sched_policy(edf_policy);
+}
+#endif
+
 #endif
\ No newline at end of file
@@ -2,14 +2,15 @@
  * @file policy.c
  * @author 王彬浩 (SPGGOGOGO@outlook.com)
  * @brief kernel层，调度策略
- * @version 1.0
- * @date 2023-05-08
+ * @version 1.1
+ * @date 2026-10-17
  * @copyright Copyright (c) 2023
  * @revisionHistory
  *  <table>
  *   <tr><th> 版本 <th>作者 <th>日期 <th>修改内容
  *   <tr><td> 0.1 <td>jivin <td> 2010-03-08 <td>Created
  *   <tr><td> 1.0 <td>王彬浩 <td> 2023-05-08 <td>Standardized
+ *   <tr><td> 1.1 <td>王彬浩 <td> 2026-10-17 <td>policy lookup indexes a table by type
  *  </table>
  */
 #include "hal.h"
@@ -18,35 +19,18 @@
 #include "int.h"
 #include "comm_thrd.h"
 #include "period_thrd.h"
+#include "rr_thrd.h"
 #include "log.h"
 
 #include <stdio.h>
 acoral_list_t policy_list;
+static acoral_sched_policy_t *policy_table[ACORAL_SCHED_POLICY_MAX]; ///<按策略名直接索引的策略控制块
 
 acoral_sched_policy_t *acoral_get_policy_ctrl(unsigned char type){
-    acoral_list_t *head;
-    acoral_list_t *list;
-    acoral_pool_t* pool;
-    acoral_res_t *res;
-    acoral_sched_policy_t* policy_ctrl;
-
-    head = &acoral_res_system.system_res_ctrl_container[ACORAL_RES_POLICY].pools;
-    for (list = head->next; list != head; list = list->next)
-	{
-        pool = list_entry(list,acoral_pool_t,ctrl_list);
-        for(int i =0 ; i<pool->num ; i++){
-            res = (acoral_res_t*)(pool->base_adr + pool->size * i);
-            if(ACORAL_RES_TYPE(res->id) == ACORAL_RES_POLICY){ //表示资源被分配了，而不是free的资源
-                policy_ctrl = list_entry(res,acoral_sched_policy_t,res);
-                if(policy_ctrl->type==type)
-                {
-                 return policy_ctrl;
-                }
-			
-	        }
-        }
-    }
-	return NULL;
+    /* 策略只在初始化时注册、之后不再增删，按策略名直接取，也不用关中断 */
+    if (type >= ACORAL_SCHED_POLICY_MAX)
+        return NULL;
+    return policy_table[type];
 }
 
 int acoral_policy_thread_init(acoralSchedPolicyEnum policy,acoral_thread_t *thread,void *data){
@@ -67,6 +51,11 @@ int acoral_policy_thread_init(acoralSchedPolicyEnum policy,acoral_thread_t *thre
 }
 
 void acoral_register_sched_policy(acoral_sched_policy_t *policy){
+	if(policy->type>=ACORAL_SCHED_POLICY_MAX){
+		ACORAL_LOG_ERROR("Sched Policy %d Out Of Range",policy->type);
+		return;
+	}
+	policy_table[policy->type]=policy;
 	acoral_list_add2_tail(&policy->list,&policy_list);
 }
 
@@ -97,6 +86,14 @@ void acoral_sched_policy_init(){
 #if CFG_THRD_PERIOD
 	period_policy_init();
 #endif
+
+#if CFG_THRD_EDF
+	edf_policy_init();
+#endif
+
+#if CFG_THRD_RR
+	rr_policy_init();
+#endif
 }
 
 
@@ -0,0 +1,363 @@
+/**
+ * @file reserve.c
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief kernel层，CPU预留（偶发服务器）与硬实时段
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ */
+#include "reserve.h"
+#include "thread.h"
+#include "soft_timer.h"
+#include "mem.h"
+#include "int.h"
+#include "log.h"
+
+#if CFG_RESERVE
+
+/// 所有预留，ticks中断中遍历
+static acoral_list_t reserve_list = LIST_HEAD_INIT(reserve_list);
+
+#if CFG_HARD_RT_PRIO_NUM
+/// 每个核上硬实时线程预留的利用率之和，千分比
+static unsigned int hard_util[CFG_MAX_CPU];
+#endif
+
+/**
+ * @brief 按参数分配并初始化预留
+ *
+ * @param param 预留参数
+ * @return acoral_reserve_t* 预留，参数错误或内存不足返回NULL
+ */
+static acoral_reserve_t *reserve_alloc(acoral_reserve_param_t *param)
+{
+	acoral_reserve_t *r;
+	unsigned int budget, period;
+
+	if (param == NULL || param->budget_mm == 0 || param->budget_mm > param->period_mm)
+		return NULL;
+	budget = time_to_ticks(param->budget_mm);
+	period = time_to_ticks(param->period_mm);
+	if (budget == 0)
+		budget = 1; //预算至少一个tick
+	if (period < budget)
+		period = budget;
+	r = (acoral_reserve_t *)acoral_malloc(sizeof(acoral_reserve_t));
+	if (r == NULL)
+	{
+		ACORAL_LOG_ERROR("No Mem Space For Reserve");
+		return NULL;
+	}
+	acoral_init_list(&r->hook);
+	r->thread = NULL;
+	r->budget = budget;
+	r->period = period;
+	r->remain = budget;
+	r->act_start = 0;
+	r->act_used = 0;
+	r->util = param->budget_mm * 1000 / param->period_mm;
+	r->overruns = 0;
+	r->action = param->action;
+	r->active = 0;
+	r->throttled = 0;
+	r->suspended = 0;
+	r->hard = 0;
+	r->cpu = 0;
+	r->base_prio = 0;
+	r->repl_head = 0;
+	r->repl_num = 0;
+	return r;
+}
+
+/**
+ * @brief 线程是否正在某个核上运行
+ *
+ */
+static int reserve_running(acoral_thread_t *thread)
+{
+	unsigned int cpu;
+	for (cpu = 0; cpu < CFG_MAX_CPU; cpu++)
+	{
+		if (acoral_cur_threads[cpu] == thread)
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief 结束本次激活，用掉的预算在激活开始后一个周期补回
+ *
+ */
+static void reserve_close(acoral_reserve_t *r)
+{
+	acoral_reserve_repl_t *repl;
+
+	r->active = 0;
+	if (r->act_used == 0)
+		return;
+	if (r->repl_num == CFG_RESERVE_MAX_REPL)
+	{
+		/*队列满了，并到最后一次里，推迟补充只会更保守*/
+		repl = &r->repl[(r->repl_head + r->repl_num - 1) % CFG_RESERVE_MAX_REPL];
+		repl->amount += r->act_used;
+		repl->due = r->act_start + r->period;
+	}
+	else
+	{
+		repl = &r->repl[(r->repl_head + r->repl_num) % CFG_RESERVE_MAX_REPL];
+		repl->amount = r->act_used;
+		repl->due = r->act_start + r->period;
+		r->repl_num++;
+	}
+	r->act_used = 0;
+}
+
+/**
+ * @brief 预算用完，按action降级或挂起线程
+ *
+ */
+static void reserve_throttle(acoral_reserve_t *r)
+{
+	acoral_thread_t *thread = r->thread;
+
+	r->throttled = 1;
+	r->overruns++;
+	if (r->action == ACORAL_RESERVE_SUSPEND && acoral_list_empty(&thread->held_mutexes))
+	{
+		r->suspended = 1;
+		unrdy_thread(thread);
+		return;
+	}
+	r->suspended = 0;
+	r->base_prio = thread->base_prio;
+	acoral_thread_change_base_prio(thread, ACORAL_NONHARD_RT_PRIO_MIN);
+}
+
+/**
+ * @brief 预算补回来了，恢复被降级或挂起的线程
+ *
+ */
+static void reserve_unthrottle(acoral_reserve_t *r)
+{
+	acoral_thread_t *thread = r->thread;
+
+	r->throttled = 0;
+	if (r->suspended)
+	{
+		r->suspended = 0;
+		/*挂起期间又被延时或者在等待事件的线程不动，它们会按自己的方式就绪*/
+		if ((thread->state & ACORAL_THREAD_STATE_SUSPEND) && !(thread->state & ACORAL_THREAD_STATE_DELAY) && thread->evt == NULL)
+			ready_thread(thread);
+	}
+	else if (thread->base_prio == ACORAL_NONHARD_RT_PRIO_MIN)
+		acoral_thread_change_base_prio(thread, r->base_prio);
+}
+
+/**
+ * @brief 处理到期的补充
+ *
+ */
+static void reserve_replenish(acoral_reserve_t *r, unsigned int now)
+{
+	acoral_reserve_repl_t *repl;
+
+	while (r->repl_num)
+	{
+		repl = &r->repl[r->repl_head];
+		if ((int)(now - repl->due) < 0)
+			break;
+		r->remain += repl->amount;
+		if (r->remain > r->budget)
+			r->remain = r->budget;
+		r->repl_head = (r->repl_head + 1) % CFG_RESERVE_MAX_REPL;
+		r->repl_num--;
+	}
+	if (r->throttled && r->remain)
+		reserve_unthrottle(r);
+}
+
+void acoral_reserve_tick(void)
+{
+	acoral_list_t *tmp;
+	acoral_reserve_t *r;
+	acoral_thread_t *thread;
+	unsigned int now = acoral_get_ticks();
+
+	for (tmp = reserve_list.next; tmp != &reserve_list; tmp = tmp->next)
+	{
+		r = list_entry(tmp, acoral_reserve_t, hook);
+		thread = r->thread;
+		if (thread == NULL)
+			continue;
+		reserve_replenish(r, now);
+		if (reserve_running(thread))
+		{
+			/*被降级的线程用的是别人剩下的CPU，不扣预算*/
+			if (r->throttled)
+				continue;
+			if (!r->active)
+			{
+				r->active = 1;
+				r->act_start = now - 1; //这个tick开始时线程就在运行了
+				r->act_used = 0;
+			}
+			r->act_used++;
+			if (--r->remain == 0)
+			{
+				reserve_close(r);
+				reserve_throttle(r);
+			}
+		}
+		else if (r->active && !(thread->state & ACORAL_THREAD_STATE_READY))
+		{
+			/*被抢占不算激活结束，阻塞了才算*/
+			reserve_close(r);
+		}
+	}
+}
+
+#if CFG_TICKLESS
+unsigned int acoral_reserve_next_expiry(void)
+{
+	acoral_list_t *tmp;
+	acoral_reserve_t *r;
+	unsigned int next = (unsigned int)-1;
+	int left;
+
+	/*没被限制的预留晚一点补充也没关系，下次运行前的tick里会补上*/
+	for (tmp = reserve_list.next; tmp != &reserve_list; tmp = tmp->next)
+	{
+		r = list_entry(tmp, acoral_reserve_t, hook);
+		if (!r->throttled || r->repl_num == 0)
+			continue;
+		left = (int)(r->repl[r->repl_head].due - acoral_get_ticks());
+		if (left < 1)
+			left = 1;
+		if ((unsigned int)left < next)
+			next = left;
+	}
+	return next;
+}
+#endif
+
+void acoral_reserve_release(acoral_thread_t *thread)
+{
+	acoral_reserve_t *r = thread->reserve;
+
+	acoral_list_del(&r->hook);
+#if CFG_HARD_RT_PRIO_NUM
+	if (r->hard)
+		hard_util[r->cpu] -= r->util;
+#endif
+	thread->reserve = NULL;
+	acoral_free(r);
+}
+
+int acoral_thread_set_reserve(int thread_id, acoral_reserve_param_t *param)
+{
+	acoral_thread_t *thread = (acoral_thread_t *)acoral_get_res_by_id(thread_id);
+	acoral_reserve_t *r = NULL;
+
+	if (thread == NULL)
+		return -1;
+	if (thread->policy != ACORAL_SCHED_POLICY_COMM
+#if CFG_THRD_RR
+		&& thread->policy != ACORAL_SCHED_POLICY_RR
+#endif
+	)
+		return -1;
+	if (param != NULL)
+	{
+		r = reserve_alloc(param);
+		if (r == NULL)
+			return -1;
+	}
+
+	acoral_enter_critical();
+	if (thread->reserve != NULL)
+	{
+		if (thread->reserve->hard)
+		{
+			acoral_exit_critical();
+			if (r != NULL)
+				acoral_free(r);
+			return -1;
+		}
+		if (thread->reserve->throttled)
+			reserve_unthrottle(thread->reserve);
+		acoral_reserve_release(thread);
+	}
+	if (r != NULL)
+	{
+		r->thread = thread;
+		thread->reserve = r;
+		acoral_list_add2_tail(&r->hook, &reserve_list);
+	}
+	acoral_exit_critical();
+	acoral_sched();
+	return 0;
+}
+
+int acoral_thread_reserve_overruns(int thread_id)
+{
+	acoral_thread_t *thread = (acoral_thread_t *)acoral_get_res_by_id(thread_id);
+	int overruns = -1;
+
+	if (thread == NULL)
+		return -1;
+	acoral_enter_critical();
+	if (thread->reserve != NULL)
+		overruns = thread->reserve->overruns;
+	acoral_exit_critical();
+	return overruns;
+}
+
+#if CFG_HARD_RT_PRIO_NUM
+int acoral_create_hard_rt_thread(char *name, void (*route)(void *args), void *args, unsigned int stack_size, unsigned char prio, unsigned int cpu, acoral_reserve_param_t *param)
+{
+	acoral_reserve_t *r;
+	int id;
+
+	if (prio >= CFG_HARD_RT_PRIO_NUM || cpu >= CFG_MAX_CPU)
+		return -1;
+	r = reserve_alloc(param);
+	if (r == NULL)
+		return -1;
+	r->hard = 1;
+	r->cpu = cpu;
+
+	/*准入控制和挂链表在一个临界区里，两个线程同时创建也不会一起超过上限*/
+	acoral_enter_critical();
+	if (hard_util[cpu] + r->util > CFG_HARD_RT_UTIL_BOUND)
+	{
+		acoral_exit_critical();
+		ACORAL_LOG_ERROR("Hard RT Admission Failed:%s,util %u+%u > %u on cpu%u", name, hard_util[cpu], r->util, CFG_HARD_RT_UTIL_BOUND, cpu);
+		acoral_free(r);
+		return -1;
+	}
+	hard_util[cpu] += r->util;
+	acoral_list_add2_tail(&r->hook, &reserve_list);
+	acoral_exit_critical();
+
+	id = acoral_create_reserved_thread(name, route, args, stack_size, ACORAL_HARD_RT_PRIO_MAX + prio, cpu, r);
+	if (id < 0)
+	{
+		/*线程没能就绪，预留还没被用过*/
+		acoral_enter_critical();
+		acoral_list_del(&r->hook);
+		hard_util[cpu] -= r->util;
+		acoral_exit_critical();
+		acoral_free(r);
+	}
+	return id;
+}
+
+unsigned int acoral_hard_rt_get_util(unsigned int cpu)
+{
+	if (cpu >= CFG_MAX_CPU)
+		return 0;
+	return hard_util[cpu];
+}
+#endif
+
+#endif
@@ -14,15 +14,17 @@
 #include "log.h"
 #include "bitops.h"
 #include "soft_timer.h"
+#include "workqueue.h"
+#include "slab.h"
 
 
 
 
 ///aCoral资源池管理系统最顶层数据结构，描述了系统中所有的资源池以及资源池控制块
 acoral_res_system_t acoral_res_system = {
-    {0},
-    {0},
-    {
+    .system_res_pools = {{0}},
+    .system_res_pools_bitmap = {0},
+    .system_res_ctrl_container = {
         /* system_res_ctrl_container[ACORAL_RES_UNKNOWN] */
         {0},
 
@@ -37,8 +39,7 @@ acoral_res_system_t acoral_res_system = {
             .pools = LIST_HEAD_INIT(acoral_res_system.system_res_ctrl_container[ACORAL_RES_THREAD].pools),                                      
             // .list = {NULL , NULL},                              
             .type_private_data = &(thread_res_private_data){
-                .global_daem_release_queue = NULL,
-                .global_ready_queue = NULL
+                .ready_queues = {{0}}
             }
         },
 
@@ -54,7 +55,7 @@ acoral_res_system_t acoral_res_system = {
             // .list = {NULL , NULL},                              
             .type_private_data = &(policy_res_private_data){
 #if CFG_THRD_PERIOD
-                .global_period_wait_queue = NULL
+                .global_period_wait_queue = {NULL, NULL}
 #endif
             }
         },
@@ -112,10 +113,36 @@ acoral_res_system_t acoral_res_system = {
             .pools = LIST_HEAD_INIT(acoral_res_system.system_res_ctrl_container[ACORAL_RES_TIMER].pools),                             
             // .list = {NULL , NULL},                      
             .type_private_data = &(timer_res_private_data){
-                .global_time_delay_queue = NULL,
-                .global_timeout_queue = NULL
+                .global_time_delay_queue = {NULL, NULL},
+                .global_timeout_queue = {NULL, NULL}
             }
         },
+
+#if CFG_WORKQUEUE
+        /* system_res_ctrl_container[ACORAL_RES_WORK] */
+        {
+            .type = ACORAL_RES_WORK,
+            .size = sizeof(acoral_work_t),              // 任务描述符的大小
+            .num_per_pool = 16,                         // 每个任务描述符池中的描述符数量
+            .num = 0,                                   // 初始时没有创建任务描述符池
+            .max_pools = 4,                             // 最多允许创建任务描述符池的数量，也就是最多同时排队64个任务
+            .free_pools = LIST_HEAD_INIT(acoral_res_system.system_res_ctrl_container[ACORAL_RES_WORK].free_pools),
+            .pools = LIST_HEAD_INIT(acoral_res_system.system_res_ctrl_container[ACORAL_RES_WORK].pools),
+        },
+#endif
+
+#if CFG_SLAB
+        /* system_res_ctrl_container[ACORAL_RES_CACHE] */
+        {
+            .type = ACORAL_RES_CACHE,
+            .size = sizeof(acoral_cache_t),             // 对象缓存控制块的大小
+            .num_per_pool = 4,                          // 每个池中的对象缓存控制块数量
+            .num = 0,                                   // 初始时没有创建池
+            .max_pools = 4,                             // 最多允许创建池的数量
+            .free_pools = LIST_HEAD_INIT(acoral_res_system.system_res_ctrl_container[ACORAL_RES_CACHE].free_pools),
+            .pools = LIST_HEAD_INIT(acoral_res_system.system_res_ctrl_container[ACORAL_RES_CACHE].pools),
+        },
+#endif
     }
 };
 
@@ -137,14 +164,16 @@ static int allocate_res_pool(acoral_res_pool_ctrl_t *pool_ctrl)
     acoral_enter_critical();
     int first_free_res_pool_index = acoral_find_first_bit_in_array(acoral_res_system.system_res_pools_bitmap, (CFG_MAX_RES_POOLS+31)/32, 0);
     if(first_free_res_pool_index == -1){
-        return NULL;
+        acoral_exit_critical();
+        return ACORAL_RES_MAX_POOL;
     }
     acoral_set_bit_in_bitmap(first_free_res_pool_index, acoral_res_system.system_res_pools_bitmap);
     pool = &(acoral_res_system.system_res_pools[first_free_res_pool_index]);
 	acoral_exit_critical();	
 
-    /* 定义pool的类型 */
-	pool->id = pool_ctrl->type << ACORAL_RES_TYPE_BIT | pool->id;
+    /* 定义pool的类型，pool->id就是它在system_res_pools中的编号 */
+	pool->type = pool_ctrl->type;
+	pool->ctrl = pool_ctrl;
     
 	pool->size = pool_ctrl->size;
 	pool->num = pool_ctrl->num_per_pool;
@@ -153,6 +182,11 @@ static int allocate_res_pool(acoral_res_pool_ctrl_t *pool_ctrl)
 	pool->base_adr = (void *)acoral_malloc(pool->size * pool->num);
 	if (pool->base_adr == NULL)
     {
+        /* 没拿到内存，把占的位置还回去 */
+        pool->type = ACORAL_RES_MAX;
+        acoral_enter_critical();
+        acoral_clear_bit_in_bitmap(pool->id, acoral_res_system.system_res_pools_bitmap);
+        acoral_exit_critical();
         return ACORAL_RES_NO_MEM;
     }
 		
@@ -166,128 +200,189 @@ static int allocate_res_pool(acoral_res_pool_ctrl_t *pool_ctrl)
 	return 0;
 }
 
-/**
- * @brief 某一资源池控制块归还其所有资源池的使用权
- *
- * @param pool_ctrl 资源池控制块
- */
-static void release_all_res_pool(acoral_res_pool_ctrl_t *pool_ctrl)
+void acoral_release_res_pool(acoral_pool_t *pool)
 {
-	acoral_pool_t *pool;
-	acoral_list_t *list, *head;
-	head = &pool_ctrl->pools;
-	if (acoral_list_empty(head))
-		return;
-	for (list = head->next; list != head; list = list->next)
-	{
-		pool = list_entry(list, acoral_pool_t, free_list);
-		acoral_list_del(&pool->ctrl_list);
-		acoral_list_del(&pool->free_list);
-		acoral_free(pool->base_adr);
+	acoral_res_pool_ctrl_t *pool_ctrl = pool->ctrl;
 
-        /* 清除bitmap中这个资源池对应的位 */
-		acoral_clear_bit_in_bitmap((pool->id & ACORAL_POOL_INDEX_MASK), acoral_res_system.system_res_pools_bitmap);
+	acoral_enter_critical();
+	acoral_list_del(&pool->ctrl_list);
+	acoral_list_del(&pool->free_list);
+	pool_ctrl->num--;
 
-		/* 清除清除31到10位的内容，即该资源池的类型acoralResourceTypeEnum,只保留低9位的内容，即该资源池的在acoral_pools的编号 */
-		pool->id = pool->id & ACORAL_POOL_INDEX_MASK;
-	}
+	/* 清除bitmap中这个资源池对应的位 */
+	acoral_clear_bit_in_bitmap(pool->id, acoral_res_system.system_res_pools_bitmap);
+	pool->type = ACORAL_RES_MAX;
+	acoral_exit_critical();
+	acoral_free(pool->base_adr);
 }
 
-acoral_res_t *acoral_get_res(acoralResourceTypeEnum res_type)
+/**
+ * @brief 从资源池控制块中取一个空闲资源，调用者已经在临界区中
+ *
+ * @param pool_ctrl 资源池控制块
+ * @param ppool 返回资源所在的资源池
+ * @return acoral_res_t* 资源指针，失败返回NULL
+ */
+static acoral_res_t *pool_get(acoral_res_pool_ctrl_t *pool_ctrl, acoral_pool_t **ppool)
 {
-	acoral_list_t *first;
 	acoral_res_t *res;
 	acoral_pool_t *pool;
-	acoral_enter_critical();
-    acoral_res_pool_ctrl_t* pool_ctrl = &(acoral_res_system.system_res_ctrl_container[res_type]);
-	first = pool_ctrl->free_pools.next;
-	if (acoral_list_empty(first))
+	if (acoral_list_empty(&pool_ctrl->free_pools))
 	{
 		if (allocate_res_pool(pool_ctrl))
-		{
-			acoral_exit_critical();
 			return NULL;
-		}
-		else
-		{
-			first = pool_ctrl->free_pools.next;
-		}
 	}
-	pool = list_entry(first, acoral_pool_t, free_list);
+	pool = list_entry(pool_ctrl->free_pools.next, acoral_pool_t, free_list);
 	res = (acoral_res_t *)pool->res_free;
 	pool->res_free = (void *)((unsigned char *)pool->base_adr + res->next_id * pool->size);
-
-	/* 修改被获取的资源的id，使bit[13:0]表示所在资源池的id*/
-	res->id = res->id & ACORAL_RES_INDEX_MASK | pool->id;
-
-
 	pool->free_num--;
 	if (!pool->free_num)
 	{
 		acoral_list_del(&pool->free_list);
 	}
+	*ppool = pool;
+	return res;
+}
+
+acoral_res_t *acoral_pool_ctrl_get_res(acoral_res_pool_ctrl_t *pool_ctrl)
+{
+	acoral_res_t *res;
+	acoral_pool_t *pool;
+	acoral_enter_critical();
+	res = pool_get(pool_ctrl, &pool);
 	acoral_exit_critical();
 	return res;
 }
 
-void acoral_release_res(acoral_res_t *res)
+acoral_res_t *acoral_get_res(acoralResourceTypeEnum res_type)
 {
+	acoral_res_t *res;
 	acoral_pool_t *pool;
+	acoral_handle_t *handle;
 	unsigned int index;
-	void *tmp;
-	acoral_res_pool_ctrl_t *pool_ctrl;
-	if (res == NULL || acoral_get_res_by_id(res->id) != res)
-	{
-		return;
-	}
-	pool = acoral_get_pool_by_id(res->id);
-	if (pool == NULL)
+	acoral_enter_critical();
+	index = acoral_res_system.free_handle;
+	if (index == ACORAL_HANDLE_NONE)
 	{
-		ACORAL_LOG_ERROR("Resource %d Release Error",res->id);
-		return;
+		acoral_exit_critical();
+		ACORAL_LOG_ERROR("No Free Handle For Resource Type %d", res_type);
+		return NULL;
 	}
-	pool_ctrl = &(acoral_res_system.system_res_ctrl_container[pool->type]);
-	
-	index = (((unsigned int)res - (unsigned int)pool->base_adr) / pool->size);
-	if (index >= pool->num)
+	res = pool_get(&(acoral_res_system.system_res_ctrl_container[res_type]), &pool);
+	if (res == NULL)
 	{
-		ACORAL_LOG_ERROR("Err Res");
-		return;
+		acoral_exit_critical();
+		return NULL;
 	}
-	tmp = pool->res_free;
+	/* 从空闲句柄链表上取一个句柄，资源id就是句柄 */
+	handle = &acoral_res_system.handles[index];
+	acoral_res_system.free_handle = handle->pool;
+	handle->obj = res;
+	handle->pool = pool->id;
+	handle->type = res_type;
+	acoral_set_bit_in_bitmap(index, acoral_res_system.live_bitmap[res_type]);
+	res->id = handle->gen << ACORAL_HANDLE_INDEX_BITS | index;
+	acoral_exit_critical();
+	return res;
+}
+
+void acoral_pool_put_res(acoral_pool_t *pool, acoral_res_t *res)
+{
+	unsigned int index;
+	index = ((unsigned long)res - (unsigned long)pool->base_adr) / pool->size;
+	acoral_enter_critical();
+	/* 池子满的时候res_free指向的是一个在用的资源，不能拿它当链表的下一个 */
+	res->id = (int)(index << ACORAL_RES_SLOT_BIT);
+	res->next_id = pool->free_num ? (unsigned int)((acoral_res_t *)pool->res_free)->id >> ACORAL_RES_SLOT_BIT : index;
 	pool->res_free = (void *)res;
-	res->id = index << ACORAL_RES_INDEX_BIT;
-	res->next_id = ((acoral_res_t *)tmp)->id >> ACORAL_RES_INDEX_BIT;
 	pool->free_num++;
 	if (acoral_list_empty(&pool->free_list))
-    {
-        acoral_list_add(&pool->free_list, &pool_ctrl->free_pools);
-    }
-		
-	return;
+	{
+		acoral_list_add(&pool->free_list, &pool->ctrl->free_pools);
+	}
+	acoral_exit_critical();
 }
 
-acoral_pool_t *acoral_get_pool_by_id(int res_id)
+void acoral_release_res(acoral_res_t *res)
 {
+	acoral_handle_t *handle;
+	acoral_pool_t *pool;
 	unsigned int index;
-	index = res_id & ACORAL_POOL_INDEX_MASK;
-	if (index < CFG_MAX_RES_POOLS)
+	if (res == NULL)
 	{
-		return acoral_res_system.system_res_pools + index;
+		return;
 	}
-		
-	return NULL;
+	acoral_enter_critical();
+	/* 句柄对不上的是已经释放过的资源，或者根本不是资源 */
+	if (acoral_get_res_by_id(res->id) != res)
+	{
+		acoral_exit_critical();
+		return;
+	}
+	index = ACORAL_HANDLE_INDEX(res->id);
+	handle = &acoral_res_system.handles[index];
+	pool = &acoral_res_system.system_res_pools[handle->pool];
+	acoral_clear_bit_in_bitmap(index, acoral_res_system.live_bitmap[handle->type]);
+
+	/* 代数加1，之前发出去的这个句柄都失效了；代数跳过0，这样有效的id不会是0 */
+	handle->obj = NULL;
+	handle->gen = (handle->gen + 1) & ACORAL_HANDLE_GEN_MASK;
+	if (handle->gen == 0)
+		handle->gen = 1;
+	handle->pool = acoral_res_system.free_handle;
+	acoral_res_system.free_handle = index;
+
+	acoral_pool_put_res(pool, res);
+	acoral_exit_critical();
+}
+
+acoral_pool_t *acoral_get_pool_by_id(int res_id)
+{
+	if (acoral_get_res_by_id(res_id) == NULL)
+		return NULL;
+	return acoral_res_system.system_res_pools + acoral_res_system.handles[ACORAL_HANDLE_INDEX(res_id)].pool;
 }
 
 acoral_res_t *acoral_get_res_by_id(int id)
 {
-	acoral_pool_t *pool;
-	unsigned int index;
-	pool = acoral_get_pool_by_id(id);
-	if (pool == NULL)
+	acoral_handle_t *handle;
+	void *obj;
+	if (id <= 0 || ACORAL_HANDLE_INDEX(id) >= CFG_MAX_HANDLES)
 		return NULL;
-	index = (id & ACORAL_RES_INDEX_MASK) >> ACORAL_RES_INDEX_BIT;
-	return (acoral_res_t *)((unsigned char *)pool->base_adr + index * pool->size);
+	handle = &acoral_res_system.handles[ACORAL_HANDLE_INDEX(id)];
+	/* 指针和代数要一起读，另一个核可能正在释放这个句柄；两次普通读之间没有顺序保证，在临界区里读 */
+	acoral_enter_critical();
+	obj = handle->gen == ACORAL_HANDLE_GEN(id) ? handle->obj : NULL;
+	acoral_exit_critical();
+	return (acoral_res_t *)obj;
+}
+
+acoral_res_t *acoral_res_iter(acoralResourceTypeEnum type, unsigned int *pos)
+{
+	const unsigned int *live = acoral_res_system.live_bitmap[type];
+	unsigned int index = *pos;
+	unsigned int word;
+	void *obj;
+
+	while (index < CFG_MAX_HANDLES)
+	{
+		word = live[index / 32] & (~0u << (index % 32)); // 这个字里index之前的位不要
+		if (word == 0)
+		{
+			index = (index / 32 + 1) * 32;
+			continue;
+		}
+		index = (index & ~31u) + acoral_ffs32(word);
+		if (index >= CFG_MAX_HANDLES)
+			break;
+		*pos = index + 1;
+		obj = acoral_res_system.handles[index].obj;
+		if (obj != NULL)
+			return (acoral_res_t *)obj;
+		index++;
+	}
+	*pos = CFG_MAX_HANDLES;
+	return NULL;
 }
 
 void acoral_pool_res_init(acoral_pool_t *pool)
@@ -301,12 +396,12 @@ void acoral_pool_res_init(acoral_pool_t *pool)
 	pblk = (unsigned char *)pool->base_adr + pool->size;
 	for (i = 0; i < (blks - 1); i++)
 	{
-		res->id = i << ACORAL_RES_INDEX_BIT;
+		res->id = (int)(i << ACORAL_RES_SLOT_BIT);
 		res->next_id = i + 1;
 		res = (acoral_res_t *)pblk;
 		pblk += pool->size;
 	}
-	res->id = (blks - 1) << ACORAL_RES_INDEX_BIT; //SPG 括号是我加的，原本是没括号的，但是不对吧
+	res->id = (int)((blks - 1) << ACORAL_RES_SLOT_BIT);
 	res->next_id = 0;
 }
 
@@ -321,7 +416,8 @@ void acoral_pool_ctrl_init(acoral_res_pool_ctrl_t *pool_ctrl)
 
 	/* 调整资源池中资源的个数，以最大化利用分配的内存，详见绿书p144 */
 	size = acoral_malloc_adjust_size(pool_ctrl->size * pool_ctrl->num_per_pool);
-	if (size < pool_ctrl->size)
+	/* ACORAL_RES_UNKNOWN等未配置的资源类型size为0，不能拿来做除数 */
+	if (pool_ctrl->size == 0 || size < pool_ctrl->size)
 	{
 		pool_ctrl->num_per_pool = 0;
 	}
@@ -345,6 +441,18 @@ void acoral_res_sys_init()
 		pool++;
 	}
 	pool->base_adr = (void *)0;
+	pool->id = i;
+	pool->type = ACORAL_RES_MAX;
+
+	/* 所有句柄串成空闲句柄链表，代数从1开始 */
+	for (i = 0; i < CFG_MAX_HANDLES; i++)
+	{
+		acoral_res_system.handles[i].obj = NULL;
+		acoral_res_system.handles[i].gen = 1;
+		acoral_res_system.handles[i].pool = i + 1 < CFG_MAX_HANDLES ? i + 1 : ACORAL_HANDLE_NONE;
+		acoral_res_system.handles[i].type = ACORAL_RES_UNKNOWN;
+	}
+	acoral_res_system.free_handle = 0;
 
     /* 为每一类资源都先分配一个资源池 */
     for(int i = 0; i<ACORAL_RES_MAX; i++){
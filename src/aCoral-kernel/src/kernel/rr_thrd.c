@@ -0,0 +1,120 @@
+/**
+ * @file rr_thrd.c
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief kernel层，时间片轮转（Round-Robin）策略线程
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ */
+#include "rr_thrd.h"
+#include "thread.h"
+#include "policy.h"
+#include "mem.h"
+#include "soft_timer.h"
+#include "int.h"
+#include "log.h"
+
+#include "hal.h"
+
+#if CFG_THRD_RR
+
+static void rr_thread_exit(){
+    acoral_kill_thread(acoral_cur_thread);
+}
+
+/**
+ * @brief 初始化时间片轮转线程的一些数据
+ * 
+ * @param thread TCB指针
+ * @param data 线程私有数据，acoral_rr_policy_data_t，可以为NULL
+ * @return int 线程id
+ */
+static int rr_policy_thread_init(acoral_thread_t *thread, void *data)
+{
+	acoral_rr_policy_data_t *policy_data;
+	unsigned int slice_mm = CFG_RR_DEFAULT_SLICE_MS;
+
+	if (data != NULL && ((acoral_rr_policy_data_t *)data)->slice_mm != 0)
+	{
+		slice_mm = ((acoral_rr_policy_data_t *)data)->slice_mm;
+	}
+	policy_data = (acoral_rr_policy_data_t *)acoral_malloc(sizeof(acoral_rr_policy_data_t));
+	if (policy_data == NULL)
+	{
+		ACORAL_LOG_ERROR("No mem space for policy_data:%s", thread->name);
+		acoral_enter_critical();
+		acoral_release_res((acoral_res_t *)thread);
+		acoral_exit_critical();
+		return -1;
+	}
+	policy_data->slice_mm = slice_mm;
+	policy_data->slice_ticks = time_to_ticks(slice_mm);
+	if (policy_data->slice_ticks == 0)
+	{
+		policy_data->slice_ticks = 1; //时间片至少一个tick
+	}
+	policy_data->remain_ticks = policy_data->slice_ticks;
+	thread->policy_data = policy_data;
+
+	if (thread_stack_init(thread, rr_thread_exit) != 0)
+	{
+		ACORAL_LOG_ERROR("No thread stack:%s", thread->name);
+		acoral_free(policy_data);
+		acoral_enter_critical();
+		acoral_release_res((acoral_res_t *)thread);
+		acoral_exit_critical();
+		return -1;
+	}
+	/*将线程就绪，并重新调度*/
+	acoral_resume_thread(thread);
+	return thread->res.id;
+}
+
+static void rr_policy_thread_release(acoral_thread_t *thread)
+{
+	acoral_free(thread->policy_data);
+	thread->policy_data = NULL;
+}
+
+void rr_delay_deal(void)
+{
+	acoral_thread_t *thread;
+	acoral_rr_policy_data_t *policy_data;
+	unsigned int cpu;
+
+	/*tick只在0号核上产生，各核上正在运行的时间片轮转线程都在这里计时，被抢占或阻塞的线程保留剩余时间片*/
+	for (cpu = 0; cpu < CFG_MAX_CPU; cpu++)
+	{
+		thread = acoral_cur_threads[cpu];
+		if (thread == NULL || thread->policy != ACORAL_SCHED_POLICY_RR)
+			continue;
+		if (!(thread->state & ACORAL_THREAD_STATE_RUNNING))
+			continue;
+
+		policy_data = (acoral_rr_policy_data_t *)thread->policy_data;
+		if (policy_data->remain_ticks > 1)
+		{
+			policy_data->remain_ticks--;
+			continue;
+		}
+		/*时间片用完，重新装满并轮转到同优先级队列尾部，本核在中断退出时完成切换，别的核发核间中断叫它切换*/
+		policy_data->remain_ticks = policy_data->slice_ticks;
+		acoral_rdyqueue_rotate(thread);
+#ifdef CFG_SMP
+		if (cpu != acoral_current_cpu() && system_need_scheds[cpu])
+			HAL_IPI_SEND(cpu);
+#endif
+	}
+}
+
+void rr_policy_init(void)
+{
+	acoral_sched_policy_t *rr_policy = (acoral_sched_policy_t *)acoral_get_res(ACORAL_RES_POLICY);
+	rr_policy->type = ACORAL_SCHED_POLICY_RR;
+	rr_policy->policy_thread_init = rr_policy_thread_init;
+	rr_policy->policy_thread_release = rr_policy_thread_release;
+	rr_policy->delay_deal = rr_delay_deal;
+	acoral_register_sched_policy(rr_policy);
+}
+
+#endif
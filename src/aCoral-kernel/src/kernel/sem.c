@@ -103,7 +103,7 @@ acoralSemRetValEnum acoral_sem_trypend(acoral_evt_t *evt)
 
 	/* 计算信号量处理*/
 	acoral_enter_critical();
-	if ((char)evt->count <= SEM_RES_AVAI)
+	if ((int)evt->count <= SEM_RES_AVAI)
 	{ /* available*/
 		evt->count++;
 		acoral_exit_critical();
@@ -134,7 +134,7 @@ acoralSemRetValEnum acoral_sem_pend(acoral_evt_t *evt, unsigned int timeout)
 
 	/* 计算信号量处理*/
 	acoral_enter_critical();
-	if ((char)evt->count <= SEM_RES_AVAI)
+	if ((int)evt->count <= SEM_RES_AVAI)
 	{ /* available*/
 		evt->count++;
 		acoral_exit_critical();
@@ -188,7 +188,7 @@ acoralSemRetValEnum acoral_sem_post(acoral_evt_t *evt)
 	acoral_enter_critical();
 
 	/* 计算信号量的释放*/
-	if ((char)evt->count <= SEM_RES_NOAVAI)
+	if ((int)evt->count <= SEM_RES_NOAVAI)
 	{ /* no waiting thread*/
 		evt->count--;
 		acoral_exit_critical();
@@ -200,8 +200,8 @@ acoralSemRetValEnum acoral_sem_post(acoral_evt_t *evt)
 	if (thread == NULL)
 	{
 		/*应该有等待线程却没有找到*/
-		printf("Err Sem post\n");
 		acoral_exit_critical();
+		printf("Err Sem post\n");
 		return SEM_ERR_UNDEF;
 	}
 	timeout_queue_del(thread);
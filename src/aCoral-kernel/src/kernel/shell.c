@@ -125,7 +125,7 @@ void cmd_exe(char *buf){
 	}	
 }
 
-#define SHELL_STACK_SIZE 1024
+#define SHELL_STACK_SIZE CFG_DEFAULT_STACK_SIZE ///<shell命令都在shell线程上执行
 void system_shell_init(){
 
 	head_cmd=NULL;
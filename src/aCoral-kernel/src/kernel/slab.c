@@ -0,0 +1,378 @@
+/**
+ * @file slab.c
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief kernel层，对象缓存（slab），slab层建立在资源池系统上，每个核前面有一个弹匣
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ */
+#include "slab.h"
+#include "thread.h"
+#include "mem.h"
+#include "int.h"
+#include "hal.h"
+#include "log.h"
+#include <stdio.h>
+#include <string.h>
+
+#if CFG_SLAB
+
+/// 弹匣空了或满了时和slab层交换的对象数
+#define SLAB_BATCH ((CFG_SLAB_MAG_SIZE + 1) / 2)
+
+/// 所有对象缓存
+static acoral_list_t cache_list = LIST_HEAD_INIT(cache_list);
+
+/**
+ * @brief 找到对象所在的slab
+ *
+ * @return acoral_pool_t* slab，不属于这个对象缓存返回NULL
+ */
+static acoral_pool_t *cache_find_slab(acoral_cache_t *cache, void *obj)
+{
+	acoral_list_t *tmp;
+	acoral_pool_t *pool;
+	unsigned long offset;
+
+	for (tmp = cache->slabs.pools.next; tmp != &cache->slabs.pools; tmp = tmp->next)
+	{
+		pool = list_entry(tmp, acoral_pool_t, ctrl_list);
+		offset = (unsigned long)obj - (unsigned long)pool->base_adr;
+		if (offset < pool->num * pool->size)
+			return offset % pool->size ? NULL : pool;
+	}
+	return NULL;
+}
+
+/**
+ * @brief 从slab层取最多n个对象，空闲对象不够时新建slab
+ *
+ * @return unsigned int 取到的个数
+ */
+static unsigned int cache_grab(acoral_cache_t *cache, void **objs, unsigned int n)
+{
+	unsigned int i;
+	int grow;
+
+	acoral_enter_critical();
+	for (i = 0; i < n; i++)
+	{
+		grow = acoral_list_empty(&cache->slabs.free_pools);
+		objs[i] = acoral_pool_ctrl_get_res(&cache->slabs);
+		if (objs[i] == NULL)
+			break;
+		if (grow)
+		{
+			cache->grows++;
+			cache->free_objs += cache->slabs.num_per_pool;
+		}
+		cache->free_objs--;
+	}
+	if (i == 0)
+		cache->fails++;
+	acoral_exit_critical();
+	return i;
+}
+
+/**
+ * @brief 把n个对象还给slab层，空闲对象多出一个slab以上时把全空的slab还给伙伴系统
+ *
+ */
+static void cache_return(acoral_cache_t *cache, void **objs, unsigned int n)
+{
+	unsigned int i, bad = 0;
+	acoral_pool_t *pool;
+	void *bad_obj = NULL;
+
+	acoral_enter_critical();
+	for (i = 0; i < n; i++)
+	{
+		pool = cache_find_slab(cache, objs[i]);
+		if (pool == NULL)
+		{
+			bad_obj = objs[i];
+			bad++;
+			continue;
+		}
+		acoral_pool_put_res(pool, (acoral_res_t *)objs[i]);
+		cache->free_objs++;
+		/*留一个slab的余量，免得在边界上反复新建、释放*/
+		if (pool->free_num == pool->num && cache->free_objs - pool->num >= cache->slabs.num_per_pool)
+		{
+			cache->free_objs -= pool->num;
+			cache->shrinks++;
+			acoral_release_res_pool(pool);
+		}
+	}
+	acoral_exit_critical();
+	if (bad)
+		ACORAL_LOG_ERROR("Cache %s Free Error:0x%lx, %u Bad", cache->name, (unsigned long)bad_obj, bad);
+}
+
+acoral_cache_t *acoral_cache_create(char *name, unsigned int obj_size, unsigned int align, void (*ctor)(void *obj))
+{
+	acoral_cache_t *cache;
+	unsigned int stride, size, num, i;
+
+	if (obj_size == 0)
+		return NULL;
+	if (align == 0)
+		align = sizeof(void *);
+	if ((align & (align - 1)) || align > BASIC_BLOCK_SIZE)
+		return NULL;
+	stride = obj_size < sizeof(acoral_res_t) ? sizeof(acoral_res_t) : obj_size;
+	stride = (stride + align - 1) & ~(align - 1); // slab从伙伴系统按基本块对齐分配，对象间距对齐了对象就对齐了
+	size = acoral_malloc_adjust_size(stride * CFG_SLAB_OBJS_PER_SLAB);
+	num = size / stride;
+	if (num == 0)
+		return NULL;
+	if (num > ACORAL_SLAB_MAX_OBJS)
+		num = ACORAL_SLAB_MAX_OBJS;
+
+	cache = (acoral_cache_t *)acoral_get_res(ACORAL_RES_CACHE);
+	if (cache == NULL)
+	{
+		ACORAL_LOG_ERROR("No Res For Cache %s", name);
+		return NULL;
+	}
+	cache->name = name;
+	cache->obj_size = obj_size;
+	cache->ctor = ctor;
+	cache->slabs.type = ACORAL_RES_CACHE;
+	cache->slabs.size = stride;
+	cache->slabs.num_per_pool = num;
+	cache->slabs.num = 0;
+	cache->slabs.max_pools = CFG_SLAB_MAX_SLABS;
+	acoral_init_list(&cache->slabs.free_pools);
+	acoral_init_list(&cache->slabs.pools);
+	cache->slabs.type_private_data = cache;
+	cache->free_objs = 0;
+	cache->grows = 0;
+	cache->shrinks = 0;
+	cache->fails = 0;
+	for (i = 0; i < CFG_MAX_CPU; i++)
+	{
+		cache->mag[i].num = 0;
+		cache->mag[i].alloc_hit = 0;
+		cache->mag[i].alloc_miss = 0;
+		cache->mag[i].free_hit = 0;
+		cache->mag[i].free_miss = 0;
+	}
+	acoral_enter_critical();
+	acoral_list_add2_tail(&cache->list, &cache_list);
+	acoral_exit_critical();
+	return cache;
+}
+
+int acoral_cache_destroy(acoral_cache_t *cache)
+{
+	unsigned int i;
+	acoral_cache_mag_t *mag;
+
+	if (cache == NULL)
+		return -1;
+	/*cache_return自己进临界区，出错时在临界区外打印，弹匣放在外面倒空*/
+	for (i = 0; i < CFG_MAX_CPU; i++)
+	{
+		mag = &cache->mag[i];
+		cache_return(cache, mag->objs, mag->num);
+		mag->num = 0;
+	}
+	acoral_enter_critical();
+	if (cache->free_objs != cache->slabs.num * cache->slabs.num_per_pool)
+	{
+		acoral_exit_critical();
+		ACORAL_LOG_ERROR("Cache %s Still Has %d Objects In Use", cache->name, cache->slabs.num * cache->slabs.num_per_pool - cache->free_objs);
+		return -1;
+	}
+	while (!acoral_list_empty(&cache->slabs.pools))
+		acoral_release_res_pool(list_entry(cache->slabs.pools.next, acoral_pool_t, ctrl_list));
+	acoral_list_del(&cache->list);
+	acoral_exit_critical();
+	acoral_release_res((acoral_res_t *)cache);
+	return 0;
+}
+
+void *acoral_cache_alloc(acoral_cache_t *cache)
+{
+	void *objs[SLAB_BATCH];
+	acoral_cache_mag_t *mag;
+	unsigned long mie;
+	unsigned int n, i;
+	void *obj;
+
+	/*关了本核中断就不会被抢占、也不会被迁移，本核的弹匣只有自己在用*/
+	mie = HAL_INTR_SAVE();
+	mag = &cache->mag[acoral_current_cpu()];
+	if (mag->num)
+	{
+		obj = mag->objs[--mag->num];
+		mag->alloc_hit++;
+		HAL_INTR_RESTORE(mie);
+		return obj;
+	}
+	HAL_INTR_RESTORE(mie);
+
+	/*弹匣空了，成批从slab层取，构造函数在临界区外调用*/
+	n = cache_grab(cache, objs, SLAB_BATCH);
+	if (n == 0)
+		return NULL;
+	if (cache->ctor)
+	{
+		for (i = 0; i < n; i++)
+			cache->ctor(objs[i]);
+	}
+	obj = objs[--n];
+	mie = HAL_INTR_SAVE();
+	mag = &cache->mag[acoral_current_cpu()]; // 构造期间可能换了核
+	mag->alloc_miss++;
+	while (n && mag->num < CFG_SLAB_MAG_SIZE)
+		mag->objs[mag->num++] = objs[--n];
+	HAL_INTR_RESTORE(mie);
+	if (n)
+		cache_return(cache, objs, n);
+	return obj;
+}
+
+void acoral_cache_free(acoral_cache_t *cache, void *obj)
+{
+	void *objs[SLAB_BATCH];
+	acoral_cache_mag_t *mag;
+	unsigned long mie;
+	unsigned int n;
+
+	if (obj == NULL)
+		return;
+	mie = HAL_INTR_SAVE();
+	mag = &cache->mag[acoral_current_cpu()];
+	if (mag->num < CFG_SLAB_MAG_SIZE)
+	{
+		mag->objs[mag->num++] = obj;
+		mag->free_hit++;
+		HAL_INTR_RESTORE(mie);
+		return;
+	}
+	/*弹匣满了，把最早放进去的一半还给slab层，刚释放的留在弹匣里*/
+	for (n = 0; n < SLAB_BATCH; n++)
+		objs[n] = mag->objs[n];
+	for (n = SLAB_BATCH; n < CFG_SLAB_MAG_SIZE; n++)
+		mag->objs[n - SLAB_BATCH] = mag->objs[n];
+	mag->num -= SLAB_BATCH;
+	mag->objs[mag->num++] = obj;
+	mag->free_miss++;
+	HAL_INTR_RESTORE(mie);
+	cache_return(cache, objs, SLAB_BATCH);
+}
+
+unsigned int acoral_cache_shrink(acoral_cache_t *cache)
+{
+	void *objs[CFG_SLAB_MAG_SIZE];
+	acoral_cache_mag_t *mag;
+	acoral_list_t *tmp, *next;
+	acoral_pool_t *pool;
+	unsigned long mie;
+	unsigned int n, released = 0;
+
+	mie = HAL_INTR_SAVE();
+	mag = &cache->mag[acoral_current_cpu()];
+	for (n = 0; n < mag->num; n++)
+		objs[n] = mag->objs[n];
+	mag->num = 0;
+	HAL_INTR_RESTORE(mie);
+	cache_return(cache, objs, n);
+
+	acoral_enter_critical();
+	for (tmp = cache->slabs.pools.next; tmp != &cache->slabs.pools; tmp = next)
+	{
+		next = tmp->next;
+		pool = list_entry(tmp, acoral_pool_t, ctrl_list);
+		if (pool->free_num != pool->num)
+			continue;
+		cache->free_objs -= pool->num;
+		cache->shrinks++;
+		acoral_release_res_pool(pool);
+		released++;
+	}
+	acoral_exit_critical();
+	return released;
+}
+
+int acoral_cache_stat(acoral_cache_t *cache, acoral_cache_stat_t *stat)
+{
+	unsigned int i;
+	acoral_cache_mag_t *mag;
+
+	if (cache == NULL || stat == NULL)
+		return -1;
+	stat->obj_size = cache->obj_size;
+	stat->stride = cache->slabs.size;
+	stat->objs_per_slab = cache->slabs.num_per_pool;
+	stat->cached = 0;
+	stat->allocs = 0;
+	stat->alloc_misses = 0;
+	stat->frees = 0;
+	stat->free_misses = 0;
+	acoral_enter_critical();
+	for (i = 0; i < CFG_MAX_CPU; i++)
+	{
+		mag = &cache->mag[i];
+		stat->cached += mag->num;
+		stat->allocs += mag->alloc_hit + mag->alloc_miss;
+		stat->alloc_misses += mag->alloc_miss;
+		stat->frees += mag->free_hit + mag->free_miss;
+		stat->free_misses += mag->free_miss;
+	}
+	stat->slabs = cache->slabs.num;
+	stat->free = cache->free_objs;
+	stat->in_use = stat->slabs * stat->objs_per_slab - stat->free - stat->cached;
+	stat->grows = cache->grows;
+	stat->shrinks = cache->shrinks;
+	stat->fails = cache->fails;
+	acoral_exit_critical();
+	return 0;
+}
+
+#define SLAB_SCAN_MAX (16) ///<acoral_cache_scan最多列出的缓存数
+
+void acoral_cache_scan(void)
+{
+	acoral_list_t *tmp;
+	acoral_cache_t *cache;
+	struct
+	{
+		char name[16];
+		acoral_cache_stat_t stat;
+	} caches[SLAB_SCAN_MAX];
+	acoral_cache_stat_t *stat;
+	unsigned int i, n = 0, total = 0;
+
+	/*临界区里拷贝名字和统计，另一个核同时销毁缓存也不会在打印时访问已经释放的控制块*/
+	acoral_enter_critical();
+	for (tmp = cache_list.next; tmp != &cache_list; tmp = tmp->next)
+	{
+		if (n < SLAB_SCAN_MAX)
+		{
+			cache = list_entry(tmp, acoral_cache_t, list);
+			strncpy(caches[n].name, cache->name, sizeof(caches[n].name) - 1);
+			caches[n].name[sizeof(caches[n].name) - 1] = '\0';
+			acoral_cache_stat(cache, &caches[n].stat);
+			n++;
+		}
+		total++;
+	}
+	acoral_exit_critical();
+
+	printf("%-12s %6s %6s %5s %5s %6s %6s %6s %8s %6s %6s %6s %5s\r\n",
+		   "name", "size", "stride", "/slab", "slabs", "inuse", "cached", "free", "allocs", "miss", "grows", "shrink", "fails");
+	for (i = 0; i < n; i++)
+	{
+		stat = &caches[i].stat;
+		printf("%-12s %6u %6u %5u %5u %6u %6u %6u %8u %6u %6u %6u %5u\r\n",
+			   caches[i].name, stat->obj_size, stat->stride, stat->objs_per_slab, stat->slabs, stat->in_use, stat->cached, stat->free,
+			   stat->allocs, stat->alloc_misses + stat->free_misses, stat->grows, stat->shrinks, stat->fails);
+	}
+	if (total > n)
+		printf("... %u more caches\r\n", total - n);
+}
+
+#endif
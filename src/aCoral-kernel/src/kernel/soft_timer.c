@@ -29,6 +29,8 @@
 #include "thread.h"
 #include "log.h"
 #include "list.h"
+#include "period_thrd.h"
+#include "reserve.h"
 #include <stdbool.h>
 
 /*----------------*/
@@ -50,14 +52,20 @@ void acoral_set_ticks(unsigned int time){
 }
 
 void acoral_ticks_entry(){
+	/*ticks只在0号核上产生，但延时、超时队列和就绪队列是两个核共用的*/
+	acoral_enter_critical();
 	ticks++;
 	time_delay_deal();
 	acoral_policy_delay_deal();
+#if CFG_RESERVE
+	acoral_reserve_tick();
+#endif
 	/*--------------------*/
 	/* 超时链表处理函数*/
 	/* pegasus  0719*/
 	/*--------------------*/
 	timeout_delay_deal();
+	acoral_exit_critical();
 }
 
 int system_ticks_init(){
@@ -66,6 +74,22 @@ int system_ticks_init(){
 }
 
 
+#if CFG_TICKLESS
+static int tickless_cpu = -1; ///<正在tickless睡眠的核，-1表示没有；它的睡眠时长是按睡前的队列算的
+
+void acoral_tickless_kick(void)
+{
+#ifdef CFG_SMP
+	/*只有别的核能在睡眠期间往队列里加东西，发核间中断把它叫醒，醒来后补上tick、重新计算最早到期*/
+	if(tickless_cpu >= 0 && tickless_cpu != (int)acoral_current_cpu())
+	{
+		HAL_IPI_SEND(tickless_cpu);
+		tickless_cpu = -1;
+	}
+#endif
+}
+#endif
+
 void acoral_delayqueue_add(acoral_list_t *queue, acoral_thread_t *new){
 	acoral_list_t   *tmp, *head;
 	acoral_thread_t *thread;
@@ -90,6 +114,10 @@ void acoral_delayqueue_add(acoral_list_t *queue, acoral_thread_t *new){
 		thread = (acoral_thread_t *)acoral_get_res_by_id(((acoral_timer_t*)list_entry(tmp, acoral_timer_t, delay_queue_hook))->owner.id);
 		thread->thread_timer->delay_time-=delay2;
 	}
+#if CFG_TICKLESS
+	if(head->next == &new->thread_timer->delay_queue_hook)
+		acoral_tickless_kick();
+#endif
 	unrdy_thread(new);
 
 	acoral_exit_critical();
@@ -142,6 +170,10 @@ void timeout_queue_add(acoral_thread_t *new)
 		thread = list_entry(tmp, acoral_thread_t, timeout_hook);
 		thread->thread_timer->delay_time-=delay2;
 	}
+#if CFG_TICKLESS
+	if(head->next == &new->timeout_hook)
+		acoral_tickless_kick();
+#endif
 
 	acoral_exit_critical();
 	return;
@@ -183,3 +215,158 @@ void timeout_delay_deal()
 		ready_thread(thread);
 	}
 }
+
+#if CFG_TICKLESS
+unsigned int acoral_next_expiry_ticks(void)
+{
+	acoral_list_t *head;
+	acoral_thread_t *thread;
+	unsigned int next = CFG_TICKLESS_MAX_TICKS;
+	timer_res_private_data *timer_data = (timer_res_private_data*)(acoral_res_system.system_res_ctrl_container[ACORAL_RES_TIMER].type_private_data);
+
+	/*差分队列只需要看队首，delay_time<=0的在下一个tick就到期*/
+	head = &timer_data->global_time_delay_queue;
+	if(!acoral_list_empty(head))
+	{
+		thread = (acoral_thread_t *)acoral_get_res_by_id(((acoral_timer_t*)list_entry(head->next, acoral_timer_t, delay_queue_hook))->owner.id);
+		if(thread->thread_timer->delay_time < (int)next)
+			next = thread->thread_timer->delay_time > 1 ? thread->thread_timer->delay_time : 1;
+	}
+	head = &timer_data->global_timeout_queue;
+	if(!acoral_list_empty(head))
+	{
+		thread = list_entry(head->next, acoral_thread_t, timeout_hook);
+		if(thread->thread_timer->delay_time < (int)next)
+			next = thread->thread_timer->delay_time > 1 ? thread->thread_timer->delay_time : 1;
+	}
+#if CFG_THRD_PERIOD
+	if(period_next_expiry() < next)
+		next = period_next_expiry();
+#endif
+#if CFG_RESERVE
+	if(acoral_reserve_next_expiry() < next)
+		next = acoral_reserve_next_expiry();
+#endif
+	return next;
+}
+
+/**
+ * @brief 把延时队列推进n个tick，差分值不够减的部分带到后面的线程上
+ * 
+ * @param n tick数
+ */
+static void time_delay_advance(unsigned int n)
+{
+	acoral_list_t *head;
+	acoral_thread_t *thread;
+	head = &(((timer_res_private_data*)(acoral_res_system.system_res_ctrl_container[ACORAL_RES_TIMER].type_private_data))->global_time_delay_queue);
+	while(!acoral_list_empty(head))
+	{
+		thread = (acoral_thread_t *)acoral_get_res_by_id(((acoral_timer_t*)list_entry(head->next, acoral_timer_t, delay_queue_hook))->owner.id);
+		if(thread->thread_timer->delay_time > (int)n)
+		{
+			thread->thread_timer->delay_time -= n;
+			return;
+		}
+		if(thread->thread_timer->delay_time > 0)
+			n -= thread->thread_timer->delay_time;
+		thread->thread_timer->delay_time = 0;
+		acoral_list_del(&thread->thread_timer->delay_queue_hook);
+		thread->state&=~ACORAL_THREAD_STATE_DELAY;
+		ready_thread(thread);
+	}
+}
+
+/**
+ * @brief 把超时队列推进n个tick，差分值不够减的部分带到后面的线程上
+ * 
+ * @param n tick数
+ */
+static void timeout_delay_advance(unsigned int n)
+{
+	acoral_list_t *head;
+	acoral_thread_t *thread;
+	head = &(((timer_res_private_data*)(acoral_res_system.system_res_ctrl_container[ACORAL_RES_TIMER].type_private_data))->global_timeout_queue);
+	while(!acoral_list_empty(head))
+	{
+		thread = list_entry(head->next, acoral_thread_t, timeout_hook);
+		if(thread->thread_timer->delay_time > (int)n)
+		{
+			thread->thread_timer->delay_time -= n;
+			return;
+		}
+		if(thread->thread_timer->delay_time > 0)
+			n -= thread->thread_timer->delay_time;
+		thread->thread_timer->delay_time = 0;
+		acoral_list_del(&thread->timeout_hook);
+		ready_thread(thread);
+	}
+}
+
+void acoral_ticks_announce(unsigned int n)
+{
+	if(n == 0)
+		return;
+	ticks += n;
+	time_delay_advance(n);
+	/*周期队列按绝对时间排序，推进ticks之后处理一次即可*/
+	acoral_policy_delay_deal();
+#if CFG_RESERVE
+	/*睡眠期间各核都在跑idle，只需要处理到期的补充*/
+	acoral_reserve_tick();
+#endif
+	timeout_delay_advance(n);
+}
+
+#ifdef CFG_SMP
+/**
+ * @brief 其他核是否都在跑idle线程。有核在干活时它随时可能往延时队列里加线程，
+ *        这时不能停tick，否则睡眠前算好的到期时间就不对了
+ * 
+ * @return true 其他核都空闲
+ */
+static bool tickless_others_idle(void)
+{
+	unsigned int cpu;
+	for(cpu = 0; cpu < CFG_MAX_CPU; cpu++)
+	{
+		if(cpu != acoral_current_cpu() && acoral_cur_threads[cpu] && acoral_cur_threads[cpu]->prio != ACORAL_IDLE_PRIO)
+			return false;
+	}
+	return true;
+}
+#endif
+
+void acoral_tickless_idle(void)
+{
+	unsigned int next;
+	unsigned long mie;
+	/*本核一直关着中断，但睡眠时不持有内核锁，另一个核照常进出内核*/
+	mie = HAL_INTR_SAVE();
+	acoral_enter_critical();
+	next = acoral_next_expiry_ticks();
+#ifdef CFG_SMP
+	if(!tickless_others_idle())
+		next = 0;
+#endif
+	if(next >= CFG_TICKLESS_MIN_TICKS && HAL_TICKLESS_ENTER(next) == 0)
+	{
+		tickless_cpu = acoral_current_cpu();
+		acoral_exit_critical();
+		HAL_WAIT_FOR_INTR();
+		acoral_enter_critical();
+		tickless_cpu = -1;
+		acoral_ticks_announce(HAL_TICKLESS_EXIT());
+		acoral_exit_critical();
+	}
+	else
+	{
+		/*最近的到期就在下一个tick，等tick中断就行*/
+		acoral_exit_critical();
+		HAL_WAIT_FOR_INTR();
+	}
+	HAL_INTR_RESTORE(mie);
+	/*醒来的中断或补上的tick可能就绪了线程*/
+	acoral_sched();
+}
+#endif
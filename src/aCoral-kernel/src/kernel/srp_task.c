@@ -0,0 +1,191 @@
+/**
+ * @file srp_task.c
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief kernel层，共享栈的运行到完成任务
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ */
+#include "srp_task.h"
+#include "thread.h"
+#include "mem.h"
+#include "int.h"
+#include "log.h"
+
+#include <stdio.h>
+
+#if CFG_SRP
+
+/// 已经创建的抢占级别
+static acoral_list_t srp_levels = LIST_HEAD_INIT(srp_levels);
+
+/**
+ * @brief 执行线程：依次运行本级别已激活的任务，没有任务时挂起自己
+ *
+ * @param args 所属的级别
+ */
+static void srp_level_thread(void *args)
+{
+	acoral_srp_level_t *level = (acoral_srp_level_t *)args;
+	acoral_srp_task_t *task;
+
+	while (1)
+	{
+		acoral_enter_critical();
+		if (acoral_list_empty(&level->ready))
+		{
+			/*level->thread在创建之后才赋值，这里用当前线程*/
+			level->idle = 1;
+			unrdy_thread(acoral_cur_thread);
+			acoral_exit_critical();
+			acoral_sched();
+			continue;
+		}
+		task = list_entry(level->ready.next, acoral_srp_task_t, hook);
+		acoral_list_del(&task->hook);
+		acoral_exit_critical();
+
+		task->route(task->args);
+
+		acoral_enter_critical();
+		task->runs++;
+		/*运行期间又被激活过，排到队尾，不让它一直占着这个级别*/
+		if (--task->pending)
+			acoral_list_add2_tail(&task->hook, &level->ready);
+		acoral_exit_critical();
+	}
+}
+
+/**
+ * @brief 在级别链表中找核cpu上优先级为prio的级别，调用者已经在临界区中
+ *
+ * @return acoral_srp_level_t* 级别指针，没有返回NULL
+ */
+static acoral_srp_level_t *srp_level_find(unsigned char prio, unsigned int cpu)
+{
+	acoral_list_t *tmp;
+	acoral_srp_level_t *level;
+
+	for (tmp = srp_levels.next; tmp != &srp_levels; tmp = tmp->next)
+	{
+		level = list_entry(tmp, acoral_srp_level_t, hook);
+		if (level->prio == prio && level->cpu == cpu)
+			return level;
+	}
+	return NULL;
+}
+
+/**
+ * @brief 找到或创建核cpu上优先级为prio的级别，并把级别的任务数加1
+ * @note 查找和挂链表在同一个临界区里完成，并发第一次提交同一级别时只有一个线程创建执行线程，
+ *       其他线程等它创建完；创建失败时级别从链表上摘掉，等待的线程会自己再创建一次
+ *
+ * @param prio 抢占级别
+ * @param cpu 核号
+ * @return acoral_srp_level_t* 级别指针，创建失败返回NULL
+ */
+static acoral_srp_level_t *srp_level_get(unsigned char prio, unsigned int cpu)
+{
+	acoral_srp_level_t *level, *fresh;
+	int id;
+
+	/*先分配好，查找和挂链表之间不能离开临界区*/
+	fresh = (acoral_srp_level_t *)acoral_malloc(sizeof(acoral_srp_level_t));
+	if (fresh == NULL)
+		return NULL;
+	acoral_init_list(&fresh->ready);
+	fresh->thread = NULL;
+	fresh->prio = prio;
+	fresh->cpu = cpu;
+	fresh->ntasks = 0;
+	fresh->idle = 0;
+
+	while (1)
+	{
+		acoral_enter_critical();
+		level = srp_level_find(prio, cpu);
+		if (level == NULL)
+		{
+			acoral_list_add2_tail(&fresh->hook, &srp_levels);
+			acoral_exit_critical();
+			break;
+		}
+		if (level->thread != NULL)
+		{
+			level->ntasks++;
+			acoral_exit_critical();
+			acoral_free(fresh);
+			return level;
+		}
+		acoral_exit_critical();
+		acoral_delay_self(1); //另一个线程正在创建这个级别的执行线程
+	}
+
+	id = acoral_create_thread("srp_level", srp_level_thread, fresh, CFG_SRP_STACK_SIZE, ACORAL_SCHED_POLICY_COMM, prio, ACORAL_HARD_PRIO, NULL);
+	if (id < 0)
+	{
+		ACORAL_LOG_ERROR("SRP Level %d Thread Create Failed", prio);
+		acoral_enter_critical();
+		acoral_list_del(&fresh->hook);
+		acoral_exit_critical();
+		acoral_free(fresh);
+		return NULL;
+	}
+	/*绑定到一个核上，不会被别的核偷走，同一级别的任务就不会同时在两个核上用这个栈*/
+	acoral_thread_set_affinity(id, ACORAL_CPU_MASK(cpu));
+
+	acoral_enter_critical();
+	fresh->thread = (acoral_thread_t *)acoral_get_res_by_id(id);
+	fresh->ntasks++;
+	acoral_exit_critical();
+	return fresh;
+}
+
+acoral_srp_task_t *acoral_srp_task_create(char *name, void (*route)(void *args), void *args, unsigned char prio, unsigned int cpu)
+{
+	acoral_srp_task_t *task;
+	acoral_srp_level_t *level;
+
+	if (route == NULL || cpu >= CFG_MAX_CPU)
+		return NULL;
+	task = (acoral_srp_task_t *)acoral_malloc(sizeof(acoral_srp_task_t));
+	if (task == NULL)
+		return NULL;
+	level = srp_level_get(prio, cpu);
+	if (level == NULL)
+	{
+		acoral_free(task);
+		return NULL;
+	}
+	acoral_init_list(&task->hook);
+	task->name = name;
+	task->route = route;
+	task->args = args;
+	task->level = level;
+	task->pending = 0;
+	task->runs = 0;
+	return task;
+}
+
+int acoral_srp_task_activate(acoral_srp_task_t *task)
+{
+	if (task == NULL)
+		return -1;
+	acoral_enter_critical();
+	/*空闲的任务挂到级别上，执行线程在运行它或者它已经在排队的只记次数*/
+	if (task->pending++ == 0)
+	{
+		acoral_list_add2_tail(&task->hook, &task->level->ready);
+		/*执行线程只在自己挂起时叫醒，任务违反规则阻塞在别处时不能把它提前放回就绪队列*/
+		if (task->level->idle)
+		{
+			task->level->idle = 0;
+			ready_thread(task->level->thread);
+		}
+	}
+	acoral_exit_critical();
+	acoral_sched();
+	return 0;
+}
+
+#endif
@@ -9,28 +9,62 @@
 #include "thread.h"
 #include "int.h"
 #include "log.h"
+#include "bitops.h"
 
 #include "hal.h"
+#include "period_thrd.h"
+#include "dag.h"
+#include "mutex.h"
+#include "reserve.h"
 
 #include <stdio.h>
+#include <string.h>
 
 extern void acoral_evt_queue_del(acoral_thread_t *thread);
-extern int daemon_id;
 
-/// aCoral是否需要调度标志，仅当aCoral就绪队列ready_queue有线程加入或被取下时，该标志被置为true；
+/// aCoral是否需要调度标志，每个核一个，仅当aCoral就绪队列ready_queue有线程加入或被取下时，该标志被置为true；
 /// 当发生调度之后，该标志位被置为false，直到又有新的线程被就绪或者挂起
-unsigned char system_need_sched = false; 
+unsigned char system_need_scheds[CFG_MAX_CPU]; 
 
 /// aCoral初始化完成之前，调度都是被上锁的 
 unsigned char system_sched_locked = true;
 
-/// acoral当前运行的线程
-acoral_thread_t *acoral_cur_thread = NULL;		
+/// 每个核acoral_sched_lock的嵌套层数，不为0时该核不切换线程，调度请求留在system_need_scheds里
+unsigned int acoral_sched_lock_nesting[CFG_MAX_CPU];
 
-int acoral_create_thread(char *name, void (*route)(void *args),void *args,unsigned int stack_size,acoralSchedPolicyEnum sched_policy,unsigned char prio,acoralPrioTypeEnum prio_type,void *data){
+/// 每个核当前运行的线程，为NULL表示该核还没有开始调度
+acoral_thread_t *acoral_cur_threads[CFG_MAX_CPU];
+
+/// 每个核的就绪队列，在acoral_thread_runqueue_init中缓存，避免调度热路径上每次都从资源系统里解引用
+static acoral_rdy_queue_t *acoral_rdy_queues = NULL;
+
+#if CFG_THREAD_STATS
+static unsigned long stat_stamps[CFG_MAX_CPU];        ///<每个核上当前线程开始计时的时刻，中断占用的时间会把它往后推
+static unsigned long stat_intr_enters[CFG_MAX_CPU];   ///<每个核最外层中断进入的时刻
+static acoral_cpu_stat_t cpu_stats[CFG_MAX_CPU];      ///<每个核的累计统计，cycles字段不用
+#endif
+
+/// 已经退出、等待回收的线程，在下一次调度或创建线程时由acoral_thread_reap回收
+static acoral_list_t acoral_release_queue = LIST_HEAD_INIT(acoral_release_queue);
+
+/// 栈缓存，第i级缓存大小为(acoral_malloc_adjust_size(CFG_MIN_STACK_SIZE)<<i)的空闲栈，用栈底第一个字串成单链表
+static void *stack_cache[CFG_STACK_CACHE_CLASSES];
+static unsigned char stack_cache_num[CFG_STACK_CACHE_CLASSES]; ///<每级缓存的栈个数，不超过CFG_STACK_CACHE_DEPTH
+
+/**
+ * @brief 创建线程
+ *
+ * @param reserve CPU预留，不为NULL时线程绑定在核cpu上，并在第一次运行之前挂上预留
+ * @param cpu reserve不为NULL时线程绑定的核
+ * @return int 成功返回线程id，失败返回-1
+ */
+static int thread_create(char *name, void (*route)(void *args),void *args,unsigned int stack_size,acoralSchedPolicyEnum sched_policy,unsigned char prio,acoralPrioTypeEnum prio_type,void *data,struct acoral_reserve *reserve,unsigned int cpu){
 	acoral_thread_t* thread;
     acoral_timer_t* thread_timer;
 
+    /* 先回收已经退出的线程，刚释放的TCB和栈马上就能复用 */
+    acoral_thread_reap();
+
     /* 分配TCB资源*/
 	thread = (acoral_thread_t *)acoral_get_res(ACORAL_RES_THREAD);
 	if(NULL == thread){
@@ -46,6 +80,23 @@ int acoral_create_thread(char *name, void (*route)(void *args),void *args,unsign
     thread->policy = sched_policy;
     thread->prio = prio;
     thread->prio_type = prio_type;
+    thread->affinity = ACORAL_CPU_MASK_ALL;
+#if CFG_RESERVE
+    thread->reserve = NULL;
+    if (reserve != NULL)
+        thread->affinity = ACORAL_CPU_MASK(cpu);
+#endif
+    thread->migrations = 0;
+    thread->cpu = acoral_select_cpu(thread->affinity);
+    thread->crit_nesting = 0;
+    thread->crit_mie = 0;
+    memset(&thread->fpu_ctx, 0, sizeof(thread->fpu_ctx));
+    HAL_FPU_RELEASE(&thread->fpu_ctx); //TCB可能是复用的，其他核不能再把寄存器当成它的
+#if CFG_THREAD_STATS
+    thread->run_cycles = 0;
+    thread->nvcsw = 0;
+    thread->nivcsw = 0;
+#endif
 	thread->stack_size = stack_size&(~(hal_sp_align-1)); //确保堆栈是hal_sp_align字节对齐的
 
     /* 根据优先级类型调整prio */
@@ -54,6 +105,7 @@ int acoral_create_thread(char *name, void (*route)(void *args),void *args,unsign
 		if (thread->prio >= ACORAL_NONHARD_RT_PRIO_MIN)
 			thread->prio = ACORAL_NONHARD_RT_PRIO_MIN;
 	}
+	thread->base_prio = thread->prio;
 	// SPG加上硬实时判断
 	//  else{
 	//  	thread->prio += ACORAL_HARD_RT_PRIO_MAX;
@@ -65,23 +117,59 @@ int acoral_create_thread(char *name, void (*route)(void *args),void *args,unsign
     /* 钩子初始化 */
     acoral_init_list(&thread->timeout_hook);
     acoral_init_list(&thread->ready_hook);
-    acoral_init_list(&thread->daem_hook);
+    acoral_init_list(&thread->release_hook);
     acoral_init_list(&thread->ipc_waiting_hook);
+#if CFG_THRD_PERIOD
+    acoral_init_list(&thread->period_wait_hook);
+#endif
+    acoral_init_list(&thread->held_mutexes);
+    thread->evt = NULL;
+#if CFG_SRP
+    thread->srp_nesting = 0;
+#endif
 
     /* 初始化 thread_timer */
     thread_timer = (acoral_timer_t *)acoral_get_res(ACORAL_RES_TIMER);
     if(NULL == thread_timer){
 		ACORAL_LOG_ERROR("Alloc thread timer fail\n");
+		acoral_release_res((acoral_res_t *)thread);
 		return -1;
 	}
     acoral_init_list(&thread_timer->delay_queue_hook);
     thread->thread_timer = thread_timer;
     thread->thread_timer->owner = thread->res;
 
+#if CFG_RESERVE
+    /* 策略初始化会把线程就绪，高优先级的线程马上就会运行，预留要在这之前挂上 */
+    if (reserve != NULL)
+    {
+        acoral_enter_critical();
+        thread->reserve = reserve;
+        reserve->thread = thread;
+        acoral_exit_critical();
+    }
+#endif
+
     /* 根据策略进行特异初始化 */
 	return acoral_policy_thread_init(sched_policy,thread,data);
 }
 
+int acoral_create_thread(char *name, void (*route)(void *args),void *args,unsigned int stack_size,acoralSchedPolicyEnum sched_policy,unsigned char prio,acoralPrioTypeEnum prio_type,void *data){
+	/* 硬实时段只留给经过准入控制、带预留的线程 */
+	if (prio_type == ACORAL_HARD_PRIO && ACORAL_IS_HARD_RT_PRIO(prio))
+	{
+		ACORAL_LOG_ERROR("Thread %s: Prio %d Is Reserved For Hard Real-time Threads", name, prio);
+		return -1;
+	}
+	return thread_create(name, route, args, stack_size, sched_policy, prio, prio_type, data, NULL, 0);
+}
+
+#if CFG_RESERVE
+int acoral_create_reserved_thread(char *name, void (*route)(void *args), void *args, unsigned int stack_size, unsigned char prio, unsigned int cpu, struct acoral_reserve *reserve){
+	return thread_create(name, route, args, stack_size, ACORAL_SCHED_POLICY_COMM, prio, ACORAL_HARD_PRIO, NULL, reserve, cpu);
+}
+#endif
+
 static void suspend_thread(acoral_thread_t *thread){
 	unrdy_thread(thread);
 	acoral_sched();
@@ -93,6 +181,8 @@ void acoral_suspend_self(){
 
 void acoral_suspend_thread_by_id(int thread_id){
 	acoral_thread_t *thread = (acoral_thread_t *)acoral_get_res_by_id(thread_id);
+	if (thread == NULL) //线程已经释放，id失效了
+		return;
 	suspend_thread(thread);
 }
 
@@ -102,6 +192,8 @@ void acoral_resume_thread(acoral_thread_t *thread){
 }
 void acoral_resume_thread_by_id(int thread_id){
 	acoral_thread_t *thread = (acoral_thread_t *)acoral_get_res_by_id(thread_id);
+	if (thread == NULL)
+		return;
 	acoral_resume_thread(thread);
 }
 
@@ -120,10 +212,36 @@ void acoral_delay_self(unsigned int time){
 	delay_thread(acoral_cur_thread,time);
 }
 
+void acoral_yield(){
+	acoral_enter_critical();
+	acoral_rdyqueue_rotate(acoral_cur_thread);
+	acoral_exit_critical();
+	acoral_sched();
+}
+
 void acoral_kill_thread(acoral_thread_t *thread){
 	acoral_evt_t *evt;
+	unsigned int cpu;
+#if CFG_STACK_PROFILE
+	unsigned int used = acoral_thread_stack_used(thread);
+	ACORAL_LOG_INFO("Thread %s Stack Used %u/%u, Recommend %u", thread->name, used, thread->stack_size, acoral_stack_recommend(used));
+#endif
 	acoral_enter_critical();
 
+#if CFG_THRD_PERIOD
+	/*周期线程从创建起一直挂在周期等待队列上，回收时policy_data会被释放，先摘下来；
+	  DELAY标志是挂周期队列时设的，不在延时队列上就清掉，免得下面漏摘事件等待队列*/
+	if (thread->policy == ACORAL_SCHED_POLICY_PERIOD
+#if CFG_THRD_EDF
+		|| thread->policy == ACORAL_SCHED_POLICY_EDF
+#endif
+	)
+	{
+		acoral_list_del(&thread->period_wait_hook);
+		if (acoral_list_empty(&thread->thread_timer->delay_queue_hook))
+			thread->state &= ~ACORAL_THREAD_STATE_DELAY;
+	}
+#endif
 	if(thread->state & ACORAL_THREAD_STATE_SUSPEND){
 		evt=thread->evt;
 		if(thread->state&ACORAL_THREAD_STATE_DELAY){
@@ -133,19 +251,32 @@ void acoral_kill_thread(acoral_thread_t *thread){
 			/**/
 			if(evt!=NULL){
 				acoral_evt_queue_del(thread);
+				timeout_queue_del(thread);
+#if CFG_EVT_MUTEX
+				/*占用者从被杀的等待者继承的优先级要退回去，和mutex_wait超时一样*/
+				if(evt->type==ACORAL_EVENT_MUTEX)
+					acoral_mutex_prio_update((acoral_thread_t *)evt->data);
+#endif
 			}
 		}
 	}
 	unrdy_thread(thread);
+#if CFG_RESERVE
+	if (thread->reserve != NULL)
+		acoral_reserve_release(thread);
+#endif
 	
-    /* 让线程进入ACORAL_THREAD_STATE_EXIT状态，但此时TCB和堆栈在上下文切换和函数调用的时候还有用，直到切换到新线程的上下文之后，才会变成ACORAL_THREAD_STATE_RELEASE状态，这个状态下的线程才会被daem释放。详见绿书P98.*/
-    acoral_list_t* daem_res_release_queue = &(((thread_res_private_data*)(acoral_res_system.system_res_ctrl_container[ACORAL_RES_THREAD].type_private_data))->global_daem_release_queue); ///< 将被daem线程回收的线程队列
-
-    acoral_list_t *head = daem_res_release_queue;
-	acoral_thread_t *daem = (acoral_thread_t *)acoral_get_res_by_id(daemon_id);
+    /* 让线程进入ACORAL_THREAD_STATE_EXIT状态，但此时TCB和堆栈在上下文切换和函数调用的时候还有用，直到切换到新线程的上下文之后，才会变成ACORAL_THREAD_STATE_RELEASE状态，这个状态下的线程才能被回收。详见绿书P98.*/
 	thread->state=ACORAL_THREAD_STATE_EXIT;
-	acoral_list_add2_tail(&thread->daem_hook,head);
-	ready_thread(daem);
+	/* 没在任何核上运行的线程不会再被换下，可以直接回收 */
+	for (cpu = 0; cpu < CFG_MAX_CPU; cpu++)
+	{
+		if (acoral_cur_threads[cpu] == thread)
+			break;
+	}
+	if (cpu == CFG_MAX_CPU)
+		thread->state = ACORAL_THREAD_STATE_RELEASE;
+	acoral_list_add2_tail(&thread->release_hook, &acoral_release_queue);
 
     acoral_exit_critical();
 	acoral_sched();
@@ -154,10 +285,12 @@ void acoral_kill_thread(acoral_thread_t *thread){
 void acoral_kill_thread_by_id(int id){
 	acoral_thread_t *thread;
 	thread=(acoral_thread_t *)acoral_get_res_by_id(id);
+	if (thread == NULL)
+		return;
 	acoral_kill_thread(thread);
 }
 
-static void acoral_thread_change_prio(acoral_thread_t* thread, unsigned int prio){
+void acoral_thread_change_prio(acoral_thread_t* thread, unsigned int prio){
 	acoral_enter_critical();
 	if(thread->state&ACORAL_THREAD_STATE_READY){
 		acoral_rdyqueue_del(thread);
@@ -168,46 +301,200 @@ static void acoral_thread_change_prio(acoral_thread_t* thread, unsigned int prio
 	acoral_exit_critical();
 }
 
+void acoral_thread_change_base_prio(acoral_thread_t* thread, unsigned int prio){
+	acoral_enter_critical();
+	thread->base_prio = prio;
+#if CFG_EVT_MUTEX
+	/*占用着互斥量的线程要和等待者的优先级比较，等待互斥量的线程要把变化传给占用者*/
+	acoral_mutex_prio_update(thread);
+#else
+	acoral_thread_change_prio(thread, prio);
+#endif
+	acoral_exit_critical();
+}
+
+/**
+ * @brief 检查修改优先级的请求，只有带硬实时预留的线程能待在硬实时段里
+ *
+ * @param thread 线程指针
+ * @param prio 目标优先级
+ * @return int 允许返回0，否则返回-1
+ */
+static int prio_band_check(acoral_thread_t *thread, unsigned int prio){
+	int hard = 0;
+#if CFG_RESERVE
+	hard = thread->reserve != NULL && thread->reserve->hard;
+#endif
+	if (ACORAL_IS_HARD_RT_PRIO(prio) != hard)
+	{
+		ACORAL_LOG_ERROR("Thread %s: Prio %u Crosses The Hard Real-time Band", thread->name, prio);
+		return -1;
+	}
+	return 0;
+}
+
 void acoral_change_prio_self(unsigned int prio){
-	acoral_thread_change_prio(acoral_cur_thread, prio);
+	acoral_thread_t *thread = acoral_cur_thread;
+	if (prio_band_check(thread, prio) != 0)
+		return;
+	acoral_thread_change_base_prio(thread, prio);
+	acoral_sched();
 }
 
 void acoral_thread_change_prio_by_id(unsigned int thread_id, unsigned int prio){
 	acoral_thread_t *thread=(acoral_thread_t *)acoral_get_res_by_id(thread_id);
-	acoral_thread_change_prio(thread, prio);
+	if (thread == NULL || prio_band_check(thread, prio) != 0)
+		return;
+	acoral_thread_change_base_prio(thread, prio);
+	acoral_sched();
 }
 
 void ready_thread(acoral_thread_t *thread){
-	if(!(ACORAL_THREAD_STATE_SUSPEND&thread->state)) //SPG线程必须要不在就绪队列上（有suspend状态）才能被就绪（加入就绪队列）
-		return;
-
-	acoral_rdyqueue_add(thread);
+	acoral_enter_critical();
+	if(ACORAL_THREAD_STATE_SUSPEND&thread->state) //SPG线程必须要不在就绪队列上（有suspend状态）才能被就绪（加入就绪队列）
+		acoral_rdyqueue_add(thread);
+	acoral_exit_critical();
 }
 
 void unrdy_thread(acoral_thread_t *thread){
     /* 挂起一个线程等价于把线程从acoral_ready_queues上取下，这就意味着这个线程必须之前在acoral_ready_queues上，也就等价于必须是就绪状态的线程才能被挂起*/
-	if(!(ACORAL_THREAD_STATE_READY&thread->state))
-		return;
+	acoral_enter_critical();
+	if(ACORAL_THREAD_STATE_READY&thread->state)
+		acoral_rdyqueue_del(thread); /* 从就绪队列取下 */
+	acoral_exit_critical();
+}
+
+/**
+ * @brief 求栈大小对应的缓存级别
+ *
+ * @param size 按伙伴系统取整之后的栈大小
+ * @return int 缓存级别，不缓存这个大小的栈返回-1
+ */
+static int stack_cache_class(unsigned int size)
+{
+	unsigned int class_size = acoral_malloc_adjust_size(CFG_MIN_STACK_SIZE);
+	int i;
+	for (i = 0; i < CFG_STACK_CACHE_CLASSES; i++, class_size <<= 1)
+	{
+		if (size == class_size)
+			return i;
+	}
+	return -1;
+}
+
+static void *stack_cache_get(unsigned int size)
+{
+	void *stack = NULL;
+	int i = stack_cache_class(size);
+	if (i < 0)
+		return NULL;
+	acoral_enter_critical();
+	if (stack_cache[i] != NULL)
+	{
+		stack = stack_cache[i];
+		stack_cache[i] = *(void **)stack;
+		stack_cache_num[i]--;
+	}
+	acoral_exit_critical();
+	return stack;
+}
 
-    /* 从就绪队列取下 */
-	acoral_rdyqueue_del(thread);
+static void stack_cache_put(void *stack, unsigned int size)
+{
+	int i = stack_cache_class(size);
+	acoral_enter_critical();
+	if (i >= 0 && stack_cache_num[i] < CFG_STACK_CACHE_DEPTH)
+	{
+		*(void **)stack = stack_cache[i];
+		stack_cache[i] = stack;
+		stack_cache_num[i]++;
+		stack = NULL;
+	}
+	acoral_exit_critical();
+	if (stack != NULL)
+		acoral_free(stack);
 }
 
 int thread_stack_init(acoral_thread_t *thread,void (*exit)(void)){
-    if(thread->stack_size<CFG_MIN_STACK_SIZE)
+	unsigned int size;
+	if (thread->stack_size == 0)
+	{
+		thread->stack_size = CFG_DEFAULT_STACK_SIZE;
+	}
+    else if(thread->stack_size<CFG_MIN_STACK_SIZE)
     {
         thread->stack_size=CFG_MIN_STACK_SIZE;
-    }	
-	thread->stack_buttom=(unsigned int *)acoral_malloc(thread->stack_size);
+    }
+	/* 伙伴系统按2的幂分配，多出来的部分也给线程用，这样同一级别的栈可以互相复用；
+	   超过最大块的请求不取整，留给acoral_malloc报错 */
+	size = acoral_malloc_adjust_size(thread->stack_size);
+	if (size >= thread->stack_size)
+		thread->stack_size = size;
+	thread->stack_buttom = (unsigned int *)stack_cache_get(thread->stack_size);
+	if (thread->stack_buttom == NULL)
+		thread->stack_buttom=(unsigned int *)acoral_malloc(thread->stack_size);
 	if(thread->stack_buttom==NULL)
     {
 		return -1;
 	}
+#if CFG_STACK_PAINT
+	/* 整个栈填上标记，没被用过的地方会一直保持，acoral_thread_stack_used据此找到高水位 */
+	for (size = 0; size < thread->stack_size / sizeof(unsigned int); size++)
+		thread->stack_buttom[size] = ACORAL_STACK_PAINT;
+#endif
 	thread->stack = HAL_STACK_INIT((unsigned int *)((char *)thread->stack_buttom+thread->stack_size-4),thread->route,exit,thread->args);
 
 	return 0;
 }
 
+#if CFG_STACK_PAINT
+unsigned int acoral_thread_stack_used(acoral_thread_t *thread){
+	unsigned int *p = thread->stack_buttom;
+	unsigned int *end = thread->stack_buttom + thread->stack_size / sizeof(unsigned int);
+
+	/* 栈从高地址往低地址长，从栈底往上数还保持着标记的字 */
+	while (p < end && *p == ACORAL_STACK_PAINT)
+		p++;
+	return (unsigned int)((char *)end - (char *)p);
+}
+
+int acoral_thread_stack_hwm(int thread_id){
+	acoral_thread_t *thread = (acoral_thread_t *)acoral_get_res_by_id(thread_id);
+	if (thread == NULL || thread->stack_buttom == NULL)
+		return -1;
+	return acoral_thread_stack_used(thread);
+}
+
+unsigned int acoral_stack_recommend(unsigned int used){
+	/* 留出四分之一的余量，再按伙伴系统的分配粒度取整，就是这个线程实际要占用的内存 */
+	unsigned int size = used + used / 4;
+	if (size < CFG_MIN_STACK_SIZE)
+		size = CFG_MIN_STACK_SIZE;
+	return acoral_malloc_adjust_size(size);
+}
+#endif
+
+void acoral_thread_reap(){
+	acoral_list_t *tmp, *tmp1;
+	acoral_thread_t *thread;
+
+	acoral_enter_critical();
+	for (tmp = acoral_release_queue.next; tmp != &acoral_release_queue; tmp = tmp1)
+	{
+		tmp1 = tmp->next;
+		thread = list_entry(tmp, acoral_thread_t, release_hook);
+		/* 状态在持锁时读，另一个核置RELEASE之后直到换上新栈才放锁 */
+		if (thread->state != ACORAL_THREAD_STATE_RELEASE)
+			continue;
+		acoral_list_del(tmp);
+		system_policy_thread_release(thread);
+		stack_cache_put(thread->stack_buttom, thread->stack_size);
+		acoral_release_res((acoral_res_t *)thread->thread_timer);
+		acoral_release_res((acoral_res_t *)thread);
+	}
+	acoral_exit_critical();
+}
+
 void acoral_sched_mechanism_init(){
 	acoral_thread_runqueue_init();
 }
@@ -215,6 +502,9 @@ void acoral_sched_mechanism_init(){
 void system_thread_module_init(){
 	acoral_sched_mechanism_init();
 	acoral_sched_policy_init();
+#if CFG_THRD_DAG
+	dag_init();
+#endif
 }
 
 
@@ -230,7 +520,8 @@ void acoral_prio_queue_add(acoral_rdy_queue_t *array, unsigned char prio, acoral
 	queue = array->queue + prio;
 	head = queue;
 	acoral_list_add2_tail(list, head);
-	acoral_set_bit_in_bitmap(prio, array->bitmap);
+	array->bitmap[prio >> 5] |= 1u << (prio & 31);
+	array->group |= 1u << (prio >> 5);
 }
 
 void acoral_prio_queue_del(acoral_rdy_queue_t *array, unsigned char prio, acoral_list_t *list)
@@ -242,20 +533,28 @@ void acoral_prio_queue_del(acoral_rdy_queue_t *array, unsigned char prio, acoral
 	array->num--;
 	acoral_list_del(list);
 	if (acoral_list_empty(head))
-		acoral_clear_bit_in_bitmap(prio, array->bitmap);
+	{
+		array->bitmap[prio >> 5] &= ~(1u << (prio & 31));
+		if (!array->bitmap[prio >> 5])
+			array->group &= ~(1u << (prio >> 5));
+	}
 }
 
 unsigned int acoral_get_highprio(acoral_rdy_queue_t *array)
 {
-	return acoral_find_first_bit_in_array(array->bitmap, PRIO_BITMAP_SIZE,1);
+	unsigned int grp;
+	/*先在一级位图中找到最高优先级所在的字，再在该字里找最低置位，两次常数时间查找*/
+	grp = acoral_ffs32(array->group);
+	return (grp << 5) + acoral_ffs32(array->bitmap[grp]);
 }
 
 void acoral_prio_queue_init(acoral_rdy_queue_t *array)
 {
-	unsigned char i;
+	unsigned int i;
 	acoral_list_t *queue;
 	acoral_list_t *head;
 	array->num = 0;
+	array->group = 0;
 	for (i = 0; i < PRIO_BITMAP_SIZE; i++)
 		array->bitmap[i] = 0;
 	for (i = 0; i < ACORAL_MAX_PRIO_NUM; i++)
@@ -267,34 +566,347 @@ void acoral_prio_queue_init(acoral_rdy_queue_t *array)
 }
 
 
+#if CFG_THREAD_STATS
+/**
+ * @brief 切换线程时把这一段运行时间记到被换下的线程上
+ *
+ * @param cpu 当前核
+ * @param prev 被换下的线程，开始调度时为NULL
+ */
+static void thread_stat_switch(unsigned int cpu, acoral_thread_t *prev)
+{
+	unsigned long now = HAL_GET_CYCLES();
+	unsigned long delta = now - stat_stamps[cpu];
+
+	stat_stamps[cpu] = now;
+	if (prev == NULL)
+		return;
+	prev->run_cycles += delta;
+	if (prev->prio == ACORAL_IDLE_PRIO)
+		cpu_stats[cpu].idle_cycles += delta;
+	/*还在就绪队列上说明是被别人挤下去的，否则是自己阻塞、挂起或者退出*/
+	if (prev->state & ACORAL_THREAD_STATE_READY)
+		prev->nivcsw++;
+	else
+		prev->nvcsw++;
+	cpu_stats[cpu].switches++;
+}
+
+void acoral_stat_intr_enter()
+{
+	stat_intr_enters[acoral_current_cpu()] = HAL_GET_CYCLES();
+}
+
+void acoral_stat_intr_exit()
+{
+	unsigned int cpu = acoral_current_cpu();
+	unsigned long delta = HAL_GET_CYCLES() - stat_intr_enters[cpu];
+
+	cpu_stats[cpu].isr_cycles += delta;
+	stat_stamps[cpu] += delta;
+}
+
+int acoral_thread_get_stat(int thread_id, acoral_thread_stat_t *stat)
+{
+	acoral_thread_t *thread = (acoral_thread_t *)acoral_get_res_by_id(thread_id);
+
+	if (thread == NULL || stat == NULL)
+		return -1;
+	acoral_enter_critical();
+	stat->run_cycles = thread->run_cycles;
+	stat->nvcsw = thread->nvcsw;
+	stat->nivcsw = thread->nivcsw;
+	if (thread->state & ACORAL_THREAD_STATE_RUNNING)
+		stat->run_cycles += HAL_GET_CYCLES() - stat_stamps[thread->cpu];
+	acoral_exit_critical();
+	return 0;
+}
+
+int acoral_cpu_get_stat(unsigned int cpu, acoral_cpu_stat_t *stat)
+{
+	acoral_thread_t *cur;
+
+	if (cpu >= CFG_MAX_CPU || stat == NULL)
+		return -1;
+	acoral_enter_critical();
+	*stat = cpu_stats[cpu];
+	stat->cycles = HAL_GET_CYCLES();
+	cur = acoral_cur_threads[cpu];
+	if (cur != NULL && cur->prio == ACORAL_IDLE_PRIO)
+		stat->idle_cycles += stat->cycles - stat_stamps[cpu];
+	acoral_exit_critical();
+	return 0;
+}
+#endif
+
 void system_set_running_thread(acoral_thread_t *thread)
 {
-	acoral_cur_thread->state &= ~ACORAL_THREAD_STATE_RUNNING;
+	unsigned int cpu = acoral_current_cpu();
+#if CFG_THREAD_STATS
+	thread_stat_switch(cpu, acoral_cur_threads[cpu]);
+#endif
+	if (acoral_cur_threads[cpu])
+		acoral_cur_threads[cpu]->state &= ~ACORAL_THREAD_STATE_RUNNING;
 	thread->state |= ACORAL_THREAD_STATE_RUNNING;
-	acoral_cur_thread = thread;
+	thread->cpu = cpu;
+	acoral_cur_threads[cpu] = thread;
+}
+
+acoral_thread_t *acoral_get_cur_thread()
+{
+	acoral_thread_t *thread;
+	unsigned long mie = HAL_INTR_SAVE();
+	thread = acoral_cur_threads[acoral_current_cpu()];
+	HAL_INTR_RESTORE(mie);
+	return thread;
+}
+
+void acoral_start_sched()
+{
+	acoral_thread_t *next;
+	/*切换到第一个线程期间持有内核锁，线程栈换上之后由hal_switch_finish释放*/
+	acoral_enter_critical();
+	system_need_sched = false;
+	next = acoral_select_thread();
+	system_set_running_thread(next);
+	HAL_FPU_SWITCH(NULL, &next->fpu_ctx, next->stack);
+	HAL_CRIT_RESTORE(next->crit_nesting, next->crit_mie);
+	HAL_SWITCH_TO(&next->stack);
 }
 
 
-void acoral_thread_runqueue_init() //TODO多核队列？
+void acoral_thread_runqueue_init()
 {
+	unsigned int cpu;
 	/*初始化每个核上的优先级队列*/
-    acoral_rdy_queue_t* rdy_queue = &(((thread_res_private_data*)(acoral_res_system.system_res_ctrl_container[ACORAL_RES_THREAD].type_private_data))->global_ready_queue);
-	acoral_prio_queue_init(rdy_queue);
+	acoral_rdy_queues = ((thread_res_private_data*)(acoral_res_system.system_res_ctrl_container[ACORAL_RES_THREAD].type_private_data))->ready_queues;
+	for (cpu = 0; cpu < CFG_MAX_CPU; cpu++)
+		acoral_prio_queue_init(acoral_rdy_queues + cpu);
+}
+
+unsigned int acoral_select_cpu(unsigned int mask)
+{
+	unsigned int cpu;
+	int best = -1;
+	/*还没开始调度的核不参与分配*/
+	for (cpu = 0; cpu < CFG_MAX_CPU; cpu++)
+	{
+		if (!(mask & ACORAL_CPU_MASK(cpu)) || acoral_cur_threads[cpu] == NULL)
+			continue;
+		if (best < 0 || acoral_rdy_queues[cpu].num < acoral_rdy_queues[best].num)
+			best = cpu;
+	}
+	if (best >= 0)
+		return best;
+	/*允许的核都还没开始调度，优先放在当前核上，否则放在掩码里的第一个核上*/
+	if (mask & ACORAL_CPU_MASK(acoral_current_cpu()))
+		return acoral_current_cpu();
+	return acoral_ffs32(mask);
+}
+
+#if CFG_THRD_EDF
+/**
+ * @brief 按绝对截止期把EDF线程插入其优先级队列，截止期早的排在前面
+ * @note 同一优先级上的非EDF线程视为截止期无穷大，排在所有EDF线程之后
+ * 
+ * @param array 优先级队列
+ * @param thread EDF线程
+ */
+static void edf_prio_queue_add(acoral_rdy_queue_t *array, acoral_thread_t *thread)
+{
+	acoral_list_t *head = array->queue + thread->prio;
+	acoral_list_t *tmp;
+	acoral_thread_t *peer;
+	unsigned int deadline = ((acoral_period_policy_data_t *)thread->policy_data)->abs_deadline;
+
+	for (tmp = head->next; tmp != head; tmp = tmp->next)
+	{
+		peer = list_entry(tmp, acoral_thread_t, ready_hook);
+		/*用差值比较，ticks回绕时仍然正确*/
+		if (peer->policy != ACORAL_SCHED_POLICY_EDF ||
+			(int)(deadline - ((acoral_period_policy_data_t *)peer->policy_data)->abs_deadline) < 0)
+			break;
+	}
+	acoral_prio_queue_add(array, thread->prio, &thread->ready_hook);
+	if (tmp != head)
+	{
+		/*先挂到尾部维护好位图，再挪到tmp之前*/
+		acoral_list_del(&thread->ready_hook);
+		acoral_list_add2_tail(&thread->ready_hook, tmp);
+	}
+}
+#endif
+
+/**
+ * @brief 按策略把线程挂到它所在核的就绪队列上，EDF线程按截止期插入
+ * 
+ * @param thread 线程指针
+ */
+static void rdyqueue_insert(acoral_thread_t *thread)
+{
+	acoral_rdy_queue_t *queue = acoral_rdy_queues + thread->cpu;
+#if CFG_THRD_EDF
+	if (thread->policy == ACORAL_SCHED_POLICY_EDF)
+		edf_prio_queue_add(queue, thread);
+	else
+#endif
+	acoral_prio_queue_add(queue, thread->prio, &thread->ready_hook);
+}
+
+#ifdef CFG_SMP
+/**
+ * @brief 置位某个核的调度标志，不是当前核就发核间中断
+ * 
+ * @param cpu 目标核
+ */
+static void smp_kick_cpu(unsigned int cpu)
+{
+	system_need_scheds[cpu] = true;
+	if (cpu != acoral_current_cpu() && acoral_cur_threads[cpu] != NULL)
+		HAL_IPI_SEND(cpu);
+}
+
+/**
+ * @brief 新就绪的线程能抢占所在队列的核就通知那个核；抢占不了就叫醒一个正在跑idle的核来偷
+ * 
+ * @param thread 新就绪的线程
+ */
+static void smp_preempt_check(acoral_thread_t *thread)
+{
+	unsigned int cpu;
+	acoral_thread_t *cur = acoral_cur_threads[thread->cpu];
+
+	if (cur == NULL || thread->prio < cur->prio)
+	{
+		smp_kick_cpu(thread->cpu);
+		return;
+	}
+	if (thread->policy != ACORAL_SCHED_POLICY_COMM)
+		return;
+	for (cpu = 0; cpu < CFG_MAX_CPU; cpu++)
+	{
+		cur = acoral_cur_threads[cpu];
+		if (cpu != thread->cpu && (thread->affinity & ACORAL_CPU_MASK(cpu)) && cur && cur->prio == ACORAL_IDLE_PRIO)
+		{
+			smp_kick_cpu(cpu);
+			return;
+		}
+	}
 }
 
+/**
+ * @brief 当前核即将空闲时，从其他核的就绪队列偷一个优先级最高、没有在运行的普通线程
+ * @note 只迁移普通（COMM）策略线程，周期、EDF、时间片线程留在原来的核上，保证它们的时间分析不受迁移影响
+ * 
+ * @param cpu 当前核
+ * @return acoral_thread_t* 偷到的线程，已经挂到当前核的就绪队列上；没有可偷的返回NULL
+ */
+static acoral_thread_t *smp_steal_thread(unsigned int cpu)
+{
+	unsigned int victim, group, word, index, prio;
+	acoral_rdy_queue_t *queue;
+	acoral_list_t *head, *tmp;
+	acoral_thread_t *thread, *best = NULL;
+
+	for (victim = 0; victim < CFG_MAX_CPU; victim++)
+	{
+		if (victim == cpu)
+			continue;
+		queue = acoral_rdy_queues + victim;
+		/*按优先级从高到低找，比已经找到的低就不用再往下找了*/
+		for (group = queue->group; group; group &= group - 1)
+		{
+			index = acoral_ffs32(group);
+			for (word = queue->bitmap[index]; word; word &= word - 1)
+			{
+				prio = (index << 5) + acoral_ffs32(word);
+				if (prio >= ACORAL_IDLE_PRIO || (best && prio >= best->prio))
+					goto next_victim;
+				head = queue->queue + prio;
+				for (tmp = head->next; tmp != head; tmp = tmp->next)
+				{
+					thread = list_entry(tmp, acoral_thread_t, ready_hook);
+					if (!(thread->state & ACORAL_THREAD_STATE_RUNNING) && thread->policy == ACORAL_SCHED_POLICY_COMM &&
+						(thread->affinity & ACORAL_CPU_MASK(cpu))
+#if CFG_SRP
+						&& thread->srp_nesting == 0 //系统天花板记在原来的核上
+#endif
+					)
+					{
+						best = thread;
+						goto next_victim;
+					}
+				}
+			}
+		}
+next_victim:
+		;
+	}
+	if (best)
+	{
+		/*就在调度过程中，直接挪队列，不再触发调度标志和核间中断*/
+		acoral_prio_queue_del(acoral_rdy_queues + best->cpu, best->prio, &best->ready_hook);
+		best->cpu = cpu;
+		best->migrations++;
+		acoral_prio_queue_add(acoral_rdy_queues + cpu, best->prio, &best->ready_hook);
+	}
+	return best;
+}
+
+/**
+ * @brief 当前核上被换下的线程如果已经不允许在本核运行，把它挪到允许的核上
+ * @note 在选择下一个线程之前调用，此时仍持有内核锁，目标核要等锁释放、被换下的线程现场保存完之后才能选中它。
+ *       被换下时已经阻塞或延时的线程也要改thread->cpu，否则以后会在原来的核上就绪
+ * 
+ * @param thread 当前核上的线程
+ */
+static void smp_affinity_check(acoral_thread_t *thread)
+{
+#if CFG_SRP
+	/*占用着天花板互斥量的线程等全部释放之后再挪*/
+	if (thread->srp_nesting)
+		return;
+#endif
+	if (!(thread->state & (ACORAL_THREAD_STATE_EXIT | ACORAL_THREAD_STATE_RELEASE)) && !(thread->affinity & ACORAL_CPU_MASK(acoral_current_cpu())))
+		acoral_rdyqueue_migrate(thread, acoral_select_cpu(thread->affinity));
+}
+#endif
+
 void acoral_rdyqueue_add(acoral_thread_t *thread)
 {
-	 acoral_rdy_queue_t* rdy_queue = &(((thread_res_private_data*)(acoral_res_system.system_res_ctrl_container[ACORAL_RES_THREAD].type_private_data))->global_ready_queue);
-	acoral_prio_queue_add(rdy_queue, thread->prio, &thread->ready_hook);
+#ifdef CFG_SMP
+	/*阻塞或延时期间亲和性变了，或者推迟的SRP迁移还没做，就绪时挂到允许的核上；还是某个核的当前线程时等它被换下再挪*/
+	if (!(thread->affinity & ACORAL_CPU_MASK(thread->cpu)) && acoral_cur_threads[thread->cpu] != thread
+#if CFG_SRP
+		&& thread->srp_nesting == 0
+#endif
+	)
+	{
+		thread->cpu = acoral_select_cpu(thread->affinity);
+		thread->migrations++;
+	}
+#endif
+	rdyqueue_insert(thread);
 	thread->state &= ~ACORAL_THREAD_STATE_SUSPEND;
 	thread->state |= ACORAL_THREAD_STATE_READY;
+#ifdef CFG_SMP
+	smp_preempt_check(thread);
+#else
 	system_need_sched = true;
+#endif
 }
 
 void acoral_rdyqueue_del(acoral_thread_t *thread)
 {
-	 acoral_rdy_queue_t* rdy_queue = &(((thread_res_private_data*)(acoral_res_system.system_res_ctrl_container[ACORAL_RES_THREAD].type_private_data))->global_ready_queue);
-	acoral_prio_queue_del(rdy_queue, thread->prio, &thread->ready_hook);
+	acoral_prio_queue_del(acoral_rdy_queues + thread->cpu, thread->prio, &thread->ready_hook);
+#ifdef CFG_SMP
+	/*被挂起的线程正在另一个核上运行，通知那个核换线程*/
+	if ((thread->state & ACORAL_THREAD_STATE_RUNNING) && thread->cpu != acoral_current_cpu())
+	{
+		system_need_scheds[thread->cpu] = true;
+		HAL_IPI_SEND(thread->cpu);
+	}
+#endif
 	thread->state &= ~ACORAL_THREAD_STATE_READY;
 	thread->state &= ~ACORAL_THREAD_STATE_RUNNING;
 	thread->state |= ACORAL_THREAD_STATE_SUSPEND;
@@ -302,6 +914,88 @@ void acoral_rdyqueue_del(acoral_thread_t *thread)
 	system_need_sched = true;
 }
 
+void acoral_rdyqueue_migrate(acoral_thread_t *thread, unsigned int cpu)
+{
+	if (thread->cpu == cpu)
+		return;
+	thread->migrations++;
+	if (!(thread->state & ACORAL_THREAD_STATE_READY))
+	{
+		/*不在就绪队列上，下次就绪时直接挂到新核上*/
+		thread->cpu = cpu;
+		return;
+	}
+	acoral_prio_queue_del(acoral_rdy_queues + thread->cpu, thread->prio, &thread->ready_hook);
+	thread->cpu = cpu;
+	rdyqueue_insert(thread);
+#ifdef CFG_SMP
+	smp_preempt_check(thread);
+#else
+	system_need_sched = true;
+#endif
+}
+
+int acoral_thread_set_affinity(int thread_id, unsigned int mask)
+{
+	acoral_thread_t *thread = (acoral_thread_t *)acoral_get_res_by_id(thread_id);
+
+	mask &= ACORAL_CPU_MASK_ALL;
+	if (thread == NULL || mask == 0)
+		return -1;
+#if CFG_RESERVE
+	/*硬实时线程的准入是按所在核算的，不能挪*/
+	if (thread->reserve != NULL && thread->reserve->hard)
+		return -1;
+#endif
+
+	acoral_enter_critical();
+	thread->affinity = mask;
+	if (!(mask & ACORAL_CPU_MASK(thread->cpu)))
+	{
+		if (thread->state & ACORAL_THREAD_STATE_RUNNING)
+		{
+#ifdef CFG_SMP
+			/*正在运行的线程要等它被换下时才能挪走，让它所在的核重新调度一次*/
+			smp_kick_cpu(thread->cpu);
+#endif
+		}
+#if CFG_SRP
+		else if (thread->srp_nesting)
+			; //释放天花板互斥量之后被换下时由smp_affinity_check挪走
+#endif
+		else
+			acoral_rdyqueue_migrate(thread, acoral_select_cpu(mask));
+	}
+	acoral_exit_critical();
+	acoral_sched();
+	return 0;
+}
+
+void acoral_rdyqueue_rotate(acoral_thread_t *thread)
+{
+	acoral_list_t *head;
+	if (!(thread->state & ACORAL_THREAD_STATE_READY))
+		return;
+	head = acoral_rdy_queues[thread->cpu].queue + thread->prio;
+	/*同优先级只有这一个线程，不用轮转*/
+	if (head->next == &thread->ready_hook && head->prev == &thread->ready_hook)
+		return;
+#if CFG_THRD_EDF
+	/*EDF线程要保持按截止期排序，重新按截止期插入，只排到截止期相同的线程之后*/
+	if (thread->policy == ACORAL_SCHED_POLICY_EDF)
+	{
+		acoral_prio_queue_del(acoral_rdy_queues + thread->cpu, thread->prio, &thread->ready_hook);
+		edf_prio_queue_add(acoral_rdy_queues + thread->cpu, thread);
+	}
+	else
+#endif
+	{
+		acoral_list_del(&thread->ready_hook);
+		acoral_list_add2_tail(&thread->ready_hook, head);
+	}
+	system_need_scheds[thread->cpu] = true; //线程可能在别的核的队列上
+}
+
 void acoral_sched()
 {
 	/*如果不需要调度，则返回*/
@@ -318,33 +1012,71 @@ void acoral_sched()
     {
         return;
     }
+	if (acoral_sched_lock_nesting[acoral_current_cpu()])
+    {
+        return;
+    }
 		
 		
 	/*这个函数进行简单处理后会直接或间接调用acoral_real_sched,或者acoral_real_intr_sched*/
 	HAL_SCHED_BRIDGE();
 	return;
 }
+void acoral_sched_lock()
+{
+	/*关中断读核号再加，防止读完核号被中断切走、之后在另一个核上加错了计数*/
+	unsigned long mie = HAL_INTR_SAVE();
+	acoral_sched_lock_nesting[acoral_current_cpu()]++;
+	HAL_INTR_RESTORE(mie);
+}
+
+void acoral_sched_unlock()
+{
+	unsigned long mie = HAL_INTR_SAVE();
+	unsigned int *nesting = acoral_sched_lock_nesting + acoral_current_cpu();
+
+	if (*nesting == 0 || --*nesting != 0)
+	{
+		HAL_INTR_RESTORE(mie);
+		return;
+	}
+	HAL_INTR_RESTORE(mie);
+	/*锁住期间被推迟的调度在这里补上*/
+	acoral_sched();
+}
+
 void acoral_real_sched()
 {
 	acoral_thread_t *prev;
 	acoral_thread_t *next;
 	system_need_sched = false;
 	prev = acoral_cur_thread;
+	/*上一次调度换下的退出线程已经不在任何栈上了，趁这次调度回收*/
+	acoral_thread_reap();
+#ifdef CFG_SMP
+	smp_affinity_check(prev);
+#endif
 	/*选择最高优先级线程*/
 	next = acoral_select_thread();
 	if (prev != next)
 	{
 		system_set_running_thread(next);
+		/*临界区层数和内核锁跟着线程走：prev回来时还在这次调度所在的临界区里*/
+		prev->crit_nesting = HAL_CRIT_SAVE(&prev->crit_mie);
+		HAL_CRIT_RESTORE(next->crit_nesting, next->crit_mie);
 		
 		if (prev->state == ACORAL_THREAD_STATE_EXIT)
 		{
             ACORAL_LOG_TRACE("Switch to Thread: %s",acoral_cur_thread->name);
+			HAL_FPU_RELEASE(&prev->fpu_ctx);
+			HAL_FPU_SWITCH(NULL, &next->fpu_ctx, next->stack);
 			prev->state = ACORAL_THREAD_STATE_RELEASE;
 			HAL_SWITCH_TO(&next->stack);
 			return;
 		}
-		/*线程切换*/
+		/*线程切换，浮点寄存器只在prev改过时保存，next的在它第一次用浮点时才装载*/
         ACORAL_LOG_TRACE("Context Switch to Thread: %s",acoral_cur_thread->name);
+		HAL_FPU_SWITCH(&prev->fpu_ctx, &next->fpu_ctx, next->stack);
 		HAL_CONTEXT_SWITCH(&prev->stack, &next->stack);
 	}
 }
@@ -355,18 +1087,28 @@ unsigned long acoral_real_intr_sched(unsigned long old_sp)
 	acoral_thread_t *next;
 	system_need_sched = false;
 	prev = acoral_cur_thread;
+#ifdef CFG_SMP
+	smp_affinity_check(prev);
+#endif
 	/*选择最高优先级线程*/
 	next = acoral_select_thread();
 	if (prev != next)
 	{
 		system_set_running_thread(next);
+		/*被中断的线程不在临界区中；当前这一层是中断桥接函数的，退出桥接函数时才释放，
+		  所以换上的线程要在它自己的层数上再加一层*/
+		prev->crit_nesting = 0;
+		HAL_CRIT_RESTORE(next->crit_nesting + 1, next->crit_nesting ? next->crit_mie : 0);
         ACORAL_LOG_TRACE("After Intr , Switch to Thread: %s's Stack",next->name);
 		// ACORAL_LOG_TRACE("Switch to Thread: %s\n",acoral_cur_thread->name);
 		if (prev->state == ACORAL_THREAD_STATE_EXIT)
 		{
+			HAL_FPU_RELEASE(&prev->fpu_ctx);
+			HAL_FPU_SWITCH(NULL, &next->fpu_ctx, next->stack);
 			prev->state = ACORAL_THREAD_STATE_RELEASE;
 			return (unsigned long)next->stack;
 		}
+		HAL_FPU_SWITCH(&prev->fpu_ctx, &next->fpu_ctx, next->stack);
 		prev->stack = (unsigned int*)old_sp;
 		//需要在中断退出时切换线程，就返回新线程的栈指针
 		return (unsigned long)next->stack;
@@ -381,9 +1123,20 @@ acoral_thread_t* acoral_select_thread()
 	acoral_list_t *head;
 	acoral_thread_t *thread;
 	acoral_list_t *queue;
-	acoral_rdy_queue_t* rdy_queue = &(((thread_res_private_data*)(acoral_res_system.system_res_ctrl_container[ACORAL_RES_THREAD].type_private_data))->global_ready_queue);
-	/*找出就绪队列中优先级最高的线程的优先级*/
+	acoral_rdy_queue_t *rdy_queue = acoral_rdy_queues + acoral_current_cpu();
+	/*找出本核就绪队列中优先级最高的线程的优先级*/
 	index = acoral_get_highprio(rdy_queue);
+#if CFG_SRP
+	/*SRP抢占测试：优先级不高于本核系统天花板的线程不能开始运行，由最近占用天花板互斥量的线程继续运行*/
+	thread = acoral_srp_preempt_check(acoral_current_cpu(), index);
+	if (thread != NULL)
+		return thread;
+#endif
+#ifdef CFG_SMP
+	/*本核只剩idle可跑，先去别的核偷一个*/
+	if (index >= ACORAL_IDLE_PRIO && (thread = smp_steal_thread(acoral_current_cpu())) != NULL)
+		return thread;
+#endif
 	queue = rdy_queue->queue + index;
 	head = queue;
 	thread = list_entry(head->next, acoral_thread_t, ready_hook);
@@ -0,0 +1,585 @@
+/**
+ * @file tlsf.c
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief kernel层，任意大小内存分配系统，两级分离适配（TLSF）分配器
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ * @note 空闲块按大小分到fl（2的幂区间）和sl（区间再等分成TLSF_SL_COUNT份）两级链表里，两级位图各用一次
+ *       find-first-set就能找到够大的空闲块；每个块头记着物理上前一块的地址（前一块空闲时有效）和前一块是否空闲，
+ *       合并相邻空闲块不用遍历。分配、释放都是常数时间，所以直接用临界区保护，中断里也能用
+ */
+#include "autocfg.h"
+#include "mem.h"
+#include "int.h"
+#include "log.h"
+#include "bitops.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef CFG_MEM2
+
+#define TLSF_ALIGN          (sizeof(void *))                    ///<分配粒度，也是块头中每个成员的大小
+#define TLSF_ALIGN_LOG2     (sizeof(void *) == 8 ? 3 : 2)
+#define TLSF_SL_LOG2        (4)
+#define TLSF_SL_COUNT       (1 << TLSF_SL_LOG2)                 ///<每个fl区间等分的份数
+#define TLSF_FL_SHIFT       (TLSF_SL_LOG2 + TLSF_ALIGN_LOG2)    ///<小于1<<TLSF_FL_SHIFT的块都放在fl 0，按TLSF_ALIGN等分
+#define TLSF_SMALL_SIZE     (1 << TLSF_FL_SHIFT)
+#define TLSF_FL_MAX         (24)                                ///<支持的最大块为2^TLSF_FL_MAX
+#define TLSF_FL_COUNT       (TLSF_FL_MAX - TLSF_FL_SHIFT + 1)
+
+#if CFG_MEM2_SIZE >= (1 << TLSF_FL_MAX)
+#error "CFG_MEM2_SIZE is too large for TLSF_FL_MAX"
+#endif
+
+#define TLSF_BLOCK_FREE     (1ul)   ///<size的第0位：本块空闲
+#define TLSF_PREV_FREE      (2ul)   ///<size的第1位：物理上前一块空闲
+#define TLSF_FLAGS          (TLSF_BLOCK_FREE | TLSF_PREV_FREE)
+
+/**
+ * @brief 块头
+ * @note prev_phys其实放在前一块的最后一个字里，只有前一块空闲时才有效；已分配块的开销只有size一个字。
+ *       size是从用户指针到下一块size成员的字节数，即用户可用的大小
+ */
+typedef struct tlsf_block{
+	struct tlsf_block *prev_phys;   ///<物理上前一块
+	unsigned long size;             ///<块大小，低两位是标志
+	struct tlsf_block *next_free;   ///<同一空闲链表中的下一块，只在空闲块里有效
+	struct tlsf_block *prev_free;   ///<同一空闲链表中的上一块，只在空闲块里有效
+}tlsf_block_t;
+
+#define TLSF_OVERHEAD       (sizeof(unsigned long))                         ///<已分配块的开销
+#define TLSF_PTR_OFFSET     (offsetof(tlsf_block_t, size) + TLSF_OVERHEAD)  ///<块头到用户指针的距离
+#define TLSF_MIN_SIZE       (sizeof(tlsf_block_t) - sizeof(tlsf_block_t *)) ///<空闲时要放得下两个链表指针和下一块的prev_phys
+#define TLSF_MAX_SIZE       ((1ul << TLSF_FL_MAX) - 1)
+
+/**
+ * @brief TLSF控制块
+ *
+ */
+static struct{
+	unsigned int fl_bitmap;                                 ///<第i位为1表示fl i中有空闲块
+	unsigned int sl_bitmap[TLSF_FL_COUNT];                  ///<第j位为1表示fl i、sl j的链表不空
+	tlsf_block_t *blocks[TLSF_FL_COUNT][TLSF_SL_COUNT];     ///<空闲链表头
+	char *start;                                            ///<内存池起始地址
+	char *end;                                              ///<内存池结束地址
+	tlsf_block_t *first;                                    ///<物理上第一块
+	unsigned long free_bytes;                               ///<空闲块的总大小
+	unsigned char mem_state;                                ///<是否初始化成功
+}tlsf_ctrl;
+
+static inline unsigned long block_size(tlsf_block_t *block)
+{
+	return block->size & ~TLSF_FLAGS;
+}
+
+static inline void block_set_size(tlsf_block_t *block, unsigned long size)
+{
+	block->size = size | (block->size & TLSF_FLAGS);
+}
+
+static inline void *block_to_ptr(tlsf_block_t *block)
+{
+	return (char *)block + TLSF_PTR_OFFSET;
+}
+
+static inline tlsf_block_t *block_from_ptr(void *ptr)
+{
+	return (tlsf_block_t *)((char *)ptr - TLSF_PTR_OFFSET);
+}
+
+/**
+ * @brief 物理上的下一块，它的prev_phys和本块的最后一个字重叠
+ *
+ */
+static inline tlsf_block_t *block_next(tlsf_block_t *block)
+{
+	return (tlsf_block_t *)((char *)block_to_ptr(block) + block_size(block) - TLSF_OVERHEAD);
+}
+
+/**
+ * @brief 把本块的地址记到下一块的prev_phys里
+ *
+ * @return tlsf_block_t* 下一块
+ */
+static inline tlsf_block_t *block_link_next(tlsf_block_t *block)
+{
+	tlsf_block_t *next = block_next(block);
+	next->prev_phys = block;
+	return next;
+}
+
+static inline void block_mark_free(tlsf_block_t *block)
+{
+	tlsf_block_t *next = block_link_next(block);
+	next->size |= TLSF_PREV_FREE;
+	block->size |= TLSF_BLOCK_FREE;
+}
+
+static inline void block_mark_used(tlsf_block_t *block)
+{
+	tlsf_block_t *next = block_next(block);
+	next->size &= ~TLSF_PREV_FREE;
+	block->size &= ~TLSF_BLOCK_FREE;
+}
+
+/**
+ * @brief 最高位1的位置
+ *
+ */
+static inline int tlsf_fls(unsigned long word)
+{
+	return (int)(sizeof(unsigned long) * 8 - 1) - __builtin_clzl(word);
+}
+
+/**
+ * @brief 求大小所在的链表
+ *
+ */
+static void mapping_insert(unsigned long size, int *fl, int *sl)
+{
+	if (size < TLSF_SMALL_SIZE)
+	{
+		*fl = 0;
+		*sl = (int)(size / (TLSF_SMALL_SIZE / TLSF_SL_COUNT));
+	}
+	else
+	{
+		*fl = tlsf_fls(size);
+		*sl = (int)(size >> (*fl - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+		*fl -= TLSF_FL_SHIFT - 1;
+	}
+}
+
+/**
+ * @brief 求分配时从哪个链表开始找：先把大小向上取到所在sl区间的上界，这样链表里的任何一块都够大
+ *
+ */
+static void mapping_search(unsigned long size, int *fl, int *sl)
+{
+	if (size >= TLSF_SMALL_SIZE)
+		size += (1ul << (tlsf_fls(size) - TLSF_SL_LOG2)) - 1;
+	mapping_insert(size, fl, sl);
+}
+
+/**
+ * @brief 从(fl,sl)开始找第一个不空的链表，两级位图各一次find-first-set
+ *
+ * @return tlsf_block_t* 链表头的块，fl、sl改成它所在的链表；没有时返回NULL
+ */
+static tlsf_block_t *search_suitable_block(int *fl, int *sl)
+{
+	unsigned int sl_map, fl_map;
+
+	if (*fl >= TLSF_FL_COUNT)
+		return NULL;
+	sl_map = tlsf_ctrl.sl_bitmap[*fl] & (~0u << *sl);
+	if (!sl_map)
+	{
+		if (*fl + 1 >= TLSF_FL_COUNT)
+			return NULL;
+		fl_map = tlsf_ctrl.fl_bitmap & (~0u << (*fl + 1));
+		if (!fl_map)
+			return NULL;
+		*fl = acoral_ffs32(fl_map);
+		sl_map = tlsf_ctrl.sl_bitmap[*fl];
+	}
+	*sl = acoral_ffs32(sl_map);
+	return tlsf_ctrl.blocks[*fl][*sl];
+}
+
+static void remove_free_block(tlsf_block_t *block, int fl, int sl)
+{
+	tlsf_block_t *prev = block->prev_free;
+	tlsf_block_t *next = block->next_free;
+
+	if (next)
+		next->prev_free = prev;
+	if (prev)
+		prev->next_free = next;
+	if (tlsf_ctrl.blocks[fl][sl] == block)
+	{
+		tlsf_ctrl.blocks[fl][sl] = next;
+		if (next == NULL)
+		{
+			tlsf_ctrl.sl_bitmap[fl] &= ~(1u << sl);
+			if (!tlsf_ctrl.sl_bitmap[fl])
+				tlsf_ctrl.fl_bitmap &= ~(1u << fl);
+		}
+	}
+	tlsf_ctrl.free_bytes -= block_size(block);
+}
+
+static void insert_free_block(tlsf_block_t *block, int fl, int sl)
+{
+	tlsf_block_t *head = tlsf_ctrl.blocks[fl][sl];
+
+	block->next_free = head;
+	block->prev_free = NULL;
+	if (head)
+		head->prev_free = block;
+	tlsf_ctrl.blocks[fl][sl] = block;
+	tlsf_ctrl.fl_bitmap |= 1u << fl;
+	tlsf_ctrl.sl_bitmap[fl] |= 1u << sl;
+	tlsf_ctrl.free_bytes += block_size(block);
+}
+
+static void block_remove(tlsf_block_t *block)
+{
+	int fl, sl;
+	mapping_insert(block_size(block), &fl, &sl);
+	remove_free_block(block, fl, sl);
+}
+
+static void block_insert(tlsf_block_t *block)
+{
+	int fl, sl;
+	mapping_insert(block_size(block), &fl, &sl);
+	insert_free_block(block, fl, sl);
+}
+
+/**
+ * @brief 把块切成size和剩下的两块，剩下的一块标成空闲但还没放进链表
+ *
+ * @return tlsf_block_t* 剩下的一块；剩下的不够一个最小块时不切，返回NULL
+ */
+static tlsf_block_t *block_split(tlsf_block_t *block, unsigned long size)
+{
+	tlsf_block_t *rest;
+	unsigned long rest_size;
+
+	if (block_size(block) < sizeof(tlsf_block_t) + size)
+		return NULL;
+	rest = (tlsf_block_t *)((char *)block_to_ptr(block) + size - TLSF_OVERHEAD);
+	rest_size = block_size(block) - (size + TLSF_OVERHEAD);
+	rest->size = rest_size;
+	block_set_size(block, size);
+	block_mark_free(rest);
+	return rest;
+}
+
+/**
+ * @brief 把block并进物理上的前一块prev
+ *
+ */
+static tlsf_block_t *block_absorb(tlsf_block_t *prev, tlsf_block_t *block)
+{
+	prev->size += block_size(block) + TLSF_OVERHEAD;
+	block_link_next(prev);
+	return prev;
+}
+
+static tlsf_block_t *block_merge_prev(tlsf_block_t *block)
+{
+	tlsf_block_t *prev;
+	if (block->size & TLSF_PREV_FREE)
+	{
+		prev = block->prev_phys;
+		block_remove(prev);
+		block = block_absorb(prev, block);
+	}
+	return block;
+}
+
+static tlsf_block_t *block_merge_next(tlsf_block_t *block)
+{
+	tlsf_block_t *next = block_next(block);
+	if (next->size & TLSF_BLOCK_FREE)
+	{
+		block_remove(next);
+		block = block_absorb(block, next);
+	}
+	return block;
+}
+
+/**
+ * @brief 已分配块多出来的部分切下来放回空闲链表
+ *
+ */
+static void block_trim_used(tlsf_block_t *block, unsigned long size)
+{
+	tlsf_block_t *rest = block_split(block, size);
+	if (rest)
+	{
+		rest->size &= ~TLSF_PREV_FREE;
+		rest = block_merge_next(rest);
+		block_insert(rest);
+	}
+}
+
+/**
+ * @brief 用户请求的大小换算成块大小
+ *
+ * @return unsigned long 块大小，太大时返回0
+ */
+static unsigned long adjust_request_size(unsigned int size)
+{
+	unsigned long adjust;
+	if (size == 0 || size > TLSF_MAX_SIZE)
+		return 0;
+	adjust = ((unsigned long)size + TLSF_ALIGN - 1) & ~(TLSF_ALIGN - 1);
+	return adjust < TLSF_MIN_SIZE ? TLSF_MIN_SIZE : adjust;
+}
+
+/**
+ * @brief 分配，调用时已经在临界区里
+ *
+ */
+static void *tlsf_alloc_locked(unsigned long adjust)
+{
+	tlsf_block_t *block, *rest;
+	int fl, sl;
+
+	mapping_search(adjust, &fl, &sl);
+	block = search_suitable_block(&fl, &sl);
+	if (block == NULL)
+		return NULL;
+	remove_free_block(block, fl, sl);
+	rest = block_split(block, adjust);
+	if (rest)
+	{
+		block_link_next(block);
+		block_insert(rest);
+	}
+	block_mark_used(block);
+	return block_to_ptr(block);
+}
+
+void *tlsf_malloc(unsigned int size)
+{
+	unsigned long adjust = adjust_request_size(size);
+	void *ptr;
+
+	if (tlsf_ctrl.mem_state == 0 || adjust == 0)
+		return NULL;
+	acoral_enter_critical();
+	ptr = tlsf_alloc_locked(adjust);
+	acoral_exit_critical();
+	return ptr;
+}
+
+void *tlsf_malloc_isr(unsigned int size)
+{
+	if (size > CFG_MEM2_ISR_MAX_SIZE)
+		return NULL;
+	return tlsf_malloc(size);
+}
+
+/**
+ * @brief 检查要释放的指针是不是本分配器分出去、还没释放的块，需在临界区中调用，两个核同时释放同一个指针时只有一个能通过
+ *
+ * @return int 0：合法；-1：不是本分配器的地址；-2：已经释放过了
+ */
+static int tlsf_check_ptr(void *ptr)
+{
+	tlsf_block_t *block;
+	if ((char *)ptr < tlsf_ctrl.start + TLSF_OVERHEAD || (char *)ptr >= tlsf_ctrl.end || ((unsigned long)ptr & (TLSF_ALIGN - 1)))
+		return -1;
+	block = block_from_ptr(ptr);
+	if (block->size & TLSF_BLOCK_FREE)
+		return -2;
+	return 0;
+}
+
+/**
+ * @brief 打印tlsf_check_ptr查出的错误，在临界区外调用
+ *
+ */
+static void tlsf_check_report(void *ptr, int err)
+{
+	if (err == -1)
+		printf("Invalid Free Address:0x%lx\n", (unsigned long)ptr);
+	else
+		printf("Address:0x%lx have been freed\n", (unsigned long)ptr);
+}
+
+unsigned int tlsf_usable_size(void *ptr)
+{
+	tlsf_block_t *block;
+	if (tlsf_ctrl.mem_state == 0 || (char *)ptr < tlsf_ctrl.start + TLSF_OVERHEAD || (char *)ptr >= tlsf_ctrl.end)
+		return 0;
+	block = block_from_ptr(ptr);
+	if (block->size & TLSF_BLOCK_FREE)
+		return 0;
+	return block_size(block);
+}
+
+void tlsf_free(void *ptr)
+{
+	tlsf_block_t *block;
+	int err;
+
+	if (tlsf_ctrl.mem_state == 0 || ptr == NULL)
+		return;
+	acoral_enter_critical();
+	err = tlsf_check_ptr(ptr);
+	if (err == 0)
+	{
+		block = block_from_ptr(ptr);
+		block_mark_free(block);
+		block = block_merge_prev(block);
+		block = block_merge_next(block);
+		block_insert(block);
+	}
+	acoral_exit_critical();
+	if (err != 0)
+		tlsf_check_report(ptr, err);
+}
+
+void *tlsf_realloc(void *ptr, unsigned int size)
+{
+	tlsf_block_t *block, *next;
+	unsigned long cur, adjust;
+	void *new_ptr;
+	int err;
+
+	if (ptr == NULL)
+		return tlsf_malloc(size);
+	if (size == 0)
+	{
+		tlsf_free(ptr);
+		return NULL;
+	}
+	adjust = adjust_request_size(size);
+	if (tlsf_ctrl.mem_state == 0 || adjust == 0)
+		return NULL;
+
+	acoral_enter_critical();
+	err = tlsf_check_ptr(ptr);
+	if (err != 0)
+	{
+		acoral_exit_critical();
+		tlsf_check_report(ptr, err);
+		return NULL;
+	}
+	block = block_from_ptr(ptr);
+	cur = block_size(block);
+	next = block_next(block);
+	/*缩小，或者后面紧挨着的空闲块够大，原地完成*/
+	if (adjust <= cur || ((next->size & TLSF_BLOCK_FREE) && adjust <= cur + block_size(next) + TLSF_OVERHEAD))
+	{
+		if (adjust > cur)
+		{
+			block_merge_next(block);
+			block_mark_used(block);
+		}
+		block_trim_used(block, adjust);
+		acoral_exit_critical();
+		return ptr;
+	}
+	new_ptr = tlsf_alloc_locked(adjust);
+	acoral_exit_critical();
+	if (new_ptr == NULL)
+		return NULL; //原来的块不动
+	/*两块都归调用者所有，拷贝不用关中断*/
+	memcpy(new_ptr, ptr, cur);
+	tlsf_free(ptr);
+	return new_ptr;
+}
+
+void tlsf_mem_init(void)
+{
+	unsigned int size;
+	unsigned long pool;
+	tlsf_block_t *block, *sentinel;
+
+	size = acoral_malloc_adjust_size(CFG_MEM2_SIZE);
+	tlsf_ctrl.start = (char *)acoral_malloc(size);
+	if (tlsf_ctrl.start == NULL)
+	{
+		tlsf_ctrl.mem_state = 0;
+		ACORAL_LOG_ERROR("TLSF Pool Alloc Failed");
+		return;
+	}
+	tlsf_ctrl.end = tlsf_ctrl.start + size;
+	memset(tlsf_ctrl.blocks, 0, sizeof(tlsf_ctrl.blocks));
+	memset(tlsf_ctrl.sl_bitmap, 0, sizeof(tlsf_ctrl.sl_bitmap));
+	tlsf_ctrl.fl_bitmap = 0;
+	tlsf_ctrl.free_bytes = 0;
+
+	/*第一块的prev_phys落在池外，前一块永远不是空闲的，不会去读；最后放一个大小为0的已分配哨兵块*/
+	pool = (size - 2 * TLSF_OVERHEAD) & ~(TLSF_ALIGN - 1);
+	if (pool > TLSF_MAX_SIZE)
+		pool = TLSF_MAX_SIZE & ~(TLSF_ALIGN - 1);
+	block = (tlsf_block_t *)(tlsf_ctrl.start - TLSF_OVERHEAD);
+	block->size = pool | TLSF_BLOCK_FREE;
+	block_insert(block);
+	sentinel = block_link_next(block);
+	sentinel->size = TLSF_PREV_FREE;
+	tlsf_ctrl.first = block;
+	tlsf_ctrl.mem_state = 1;
+}
+
+void tlsf_stat(acoral_mem_stat_t *stat)
+{
+	int fl, sl;
+	tlsf_block_t *block;
+
+	stat->total_bytes = 0;
+	stat->free_bytes = 0;
+	stat->largest_free = 0;
+	if (tlsf_ctrl.mem_state == 0)
+		return;
+	stat->total_bytes = tlsf_ctrl.end - tlsf_ctrl.start;
+	acoral_enter_critical();
+	stat->free_bytes = tlsf_ctrl.free_bytes;
+	/*最大的空闲块在最高的不空链表里，只扫这一条*/
+	if (tlsf_ctrl.fl_bitmap)
+	{
+		fl = tlsf_fls(tlsf_ctrl.fl_bitmap);
+		sl = tlsf_fls(tlsf_ctrl.sl_bitmap[fl]);
+		for (block = tlsf_ctrl.blocks[fl][sl]; block; block = block->next_free)
+		{
+			if (block_size(block) > stat->largest_free)
+				stat->largest_free = block_size(block);
+		}
+	}
+	acoral_exit_critical();
+}
+
+#define TLSF_SCAN_MAX (32) ///<tlsf_scan最多列出的块数，多出来的只计数
+
+void tlsf_scan(void)
+{
+	tlsf_block_t *block;
+	acoral_mem_stat_t stat;
+	struct
+	{
+		unsigned long adr;
+		unsigned long size;
+		int free;
+	} blocks[TLSF_SCAN_MAX];
+	unsigned int i, n = 0, total = 0;
+
+	if (tlsf_ctrl.mem_state == 0)
+	{
+		printf("Mem Init Err ,so no mem space to malloc\r\n");
+		return;
+	}
+	/*临界区里只拷贝，别的核或中断同时分割、合并块时不会顺着过期的大小走到块外面去*/
+	acoral_enter_critical();
+	for (block = tlsf_ctrl.first; block_size(block) != 0; block = block_next(block))
+	{
+		if (n < TLSF_SCAN_MAX)
+		{
+			blocks[n].adr = (unsigned long)block_to_ptr(block);
+			blocks[n].size = block_size(block);
+			blocks[n].free = (block->size & TLSF_BLOCK_FREE) != 0;
+			n++;
+		}
+		total++;
+	}
+	acoral_exit_critical();
+	for (i = 0; i < n; i++)
+	{
+		printf("The address is 0x%lx,the block is %s and it's size is %lu\r\n", blocks[i].adr,
+		       blocks[i].free ? "unused" : "used", blocks[i].size);
+	}
+	if (total > n)
+		printf("... %u more blocks\r\n", total - n);
+	tlsf_stat(&stat);
+	printf("Free %lu bytes, largest free block %lu bytes\r\n", stat.free_bytes, stat.largest_free);
+}
+
+#endif
@@ -0,0 +1,158 @@
+/**
+ * @file workqueue.c
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief kernel层，工作队列（固定线程池）
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ */
+#include "workqueue.h"
+#include "thread.h"
+#include "sem.h"
+#include "mem.h"
+#include "int.h"
+#include "log.h"
+
+#include <stdio.h>
+
+#if CFG_WORKQUEUE
+
+/**
+ * @brief 工作线程：等任务、执行、归还描述符，任务全部执行完时唤醒acoral_work_wait的等待者
+ *
+ * @param args 所属的工作队列
+ */
+static void work_thread(void *args)
+{
+	acoral_workqueue_t *wq = (acoral_workqueue_t *)args;
+	acoral_work_t *work;
+	unsigned int wake;
+
+	while (1)
+	{
+		acoral_sem_pend(wq->job_sem, 0);
+
+		acoral_enter_critical();
+		work = list_entry(wq->jobs.next, acoral_work_t, hook);
+		acoral_list_del(&work->hook);
+		acoral_exit_critical();
+
+		work->route(work->args);
+
+		acoral_enter_critical();
+		acoral_release_res((acoral_res_t *)work);
+		wake = 0;
+		if (--wq->pending == 0)
+		{
+			wake = wq->waiters;
+			wq->waiters = 0;
+		}
+		acoral_exit_critical();
+
+		while (wake--)
+			acoral_sem_post(wq->idle_sem);
+	}
+}
+
+/**
+ * @brief 创建失败时回收工作队列和它的信号量
+ *
+ * @param wq 还没有任何工作线程的工作队列
+ */
+static void workqueue_destroy(acoral_workqueue_t *wq)
+{
+	acoral_enter_critical();
+	if (wq->job_sem != NULL)
+		acoral_release_res((acoral_res_t *)wq->job_sem);
+	if (wq->idle_sem != NULL)
+		acoral_release_res((acoral_res_t *)wq->idle_sem);
+	acoral_exit_critical();
+	acoral_free(wq);
+}
+
+acoral_workqueue_t *acoral_workqueue_create(unsigned int nthreads, unsigned char prio)
+{
+	acoral_workqueue_t *wq;
+	unsigned int i;
+	int id;
+
+	if (nthreads == 0)
+		return NULL;
+	wq = (acoral_workqueue_t *)acoral_malloc(sizeof(acoral_workqueue_t));
+	if (wq == NULL)
+		return NULL;
+	wq->job_sem = acoral_sem_create(0);
+	wq->idle_sem = acoral_sem_create(0);
+	if (wq->job_sem == NULL || wq->idle_sem == NULL)
+	{
+		ACORAL_LOG_ERROR("Workqueue Sem Alloc Failed");
+		workqueue_destroy(wq);
+		return NULL;
+	}
+	acoral_init_list(&wq->jobs);
+	wq->pending = 0;
+	wq->waiters = 0;
+	wq->nthreads = 0;
+	wq->prio = prio;
+
+	for (i = 0; i < nthreads; i++)
+	{
+		id = acoral_create_thread("kworker", work_thread, wq, 0, ACORAL_SCHED_POLICY_COMM, prio, ACORAL_HARD_PRIO, NULL);
+		if (id < 0)
+			break;
+#ifdef CFG_SMP
+		acoral_thread_set_affinity(id, ACORAL_CPU_MASK(i % CFG_MAX_CPU));
+#endif
+		wq->nthreads++;
+	}
+	if (wq->nthreads == 0)
+	{
+		/*一个工作线程都没建起来，队列没法用，也没有线程引用它*/
+		ACORAL_LOG_ERROR("Workqueue Thread Create Failed");
+		workqueue_destroy(wq);
+		return NULL;
+	}
+	if (wq->nthreads < nthreads)
+		ACORAL_LOG_WARN("Workqueue Created With %u/%u Threads", wq->nthreads, nthreads);
+	return wq;
+}
+
+int acoral_work_submit(acoral_workqueue_t *wq, void (*route)(void *args), void *args)
+{
+	acoral_work_t *work;
+
+	if (wq == NULL || route == NULL)
+		return -1;
+	work = (acoral_work_t *)acoral_get_res(ACORAL_RES_WORK);
+	if (work == NULL)
+		return -1;
+	work->route = route;
+	work->args = args;
+
+	acoral_enter_critical();
+	acoral_list_add2_tail(&work->hook, &wq->jobs);
+	wq->pending++;
+	acoral_exit_critical();
+
+	acoral_sem_post(wq->job_sem);
+	return 0;
+}
+
+int acoral_work_wait(acoral_workqueue_t *wq)
+{
+	if (wq == NULL)
+		return -1;
+	acoral_enter_critical();
+	if (wq->pending == 0)
+	{
+		acoral_exit_critical();
+		return 0;
+	}
+	wq->waiters++;
+	acoral_exit_critical();
+	/*最后一个任务可能在这之间完成，信号量会记住这次释放*/
+	acoral_sem_pend(wq->idle_sem, 0);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,554 @@
+/**
+ * @file bench.c
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief 用户层，Rhealstone风格的内核时延基准测试
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ * @note 每项测试重复BENCH_ROUNDS次（另有BENCH_WARMUP次预热不计入），结果以CSV输出：
+ *       test,samples,min,avg,p50,p90,p99,max，单位见开头的注释行（K210为mcycle周期，主机替身为纳秒）。
+ *       所有参与测试的线程都绑定在控制线程所在的核上
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "acoral.h"
+#include "hal.h"
+#include "user.h"
+
+#define BENCH_ROUNDS    1000    ///<每项测试记录的样本数
+#define BENCH_WARMUP    16      ///<每项测试开头丢弃的样本数
+#define BENCH_ITERS     (BENCH_ROUNDS + BENCH_WARMUP)
+
+#define BENCH_PRIO_HIGH 8       ///<被唤醒、抢占的一方
+#define BENCH_PRIO_CTRL 10      ///<控制线程，也是任务切换测试中的一方
+#define BENCH_PRIO_LOW  12      ///<死锁解除测试中持有互斥量的低优先级线程
+
+#define BENCH_MSG_ID    0xbe    ///<消息测试使用的消息标识
+
+static unsigned long bench_samples[BENCH_ROUNDS];
+static unsigned int bench_count;    ///<已记录的样本数
+static unsigned int bench_seen;     ///<包括预热在内见过的样本数
+static volatile unsigned long bench_stamp;      ///<计时起点，由发起方写、被唤醒方读
+static volatile unsigned long bench_isr_stamp;  ///<软件中断服务程序的进入时刻
+static volatile unsigned int bench_isr_seq;     ///<软件中断服务程序执行的次数
+static volatile int bench_isr_post;             ///<软件中断服务程序是否释放bench_sem
+static unsigned int bench_cpu;                  ///<测试所在的核
+static int bench_high_id;
+
+static acoral_evt_t *bench_sync;    ///<工作线程->控制线程：已就位/已结束
+static acoral_evt_t *bench_done;    ///<控制线程->acoral_bench调用者：全部测试结束
+static acoral_evt_t *bench_sem;
+static acoral_evt_t *bench_mutex;
+static acoral_msgctr_t *bench_msgctr;
+#if CFG_WORKQUEUE
+static acoral_workqueue_t *bench_wq;
+#endif
+
+static void bench_record(unsigned long v)
+{
+    if (bench_seen++ < BENCH_WARMUP)
+        return;
+    if (bench_count < BENCH_ROUNDS)
+        bench_samples[bench_count++] = v;
+}
+
+static int bench_cmp(const void *a, const void *b)
+{
+    unsigned long x = *(const unsigned long *)a, y = *(const unsigned long *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief 排序样本并输出一行统计结果，然后清空样本
+ *
+ * @param name 测试名
+ */
+static void bench_report(const char *name)
+{
+    unsigned long sum = 0;
+    unsigned int i, n = bench_count;
+
+    if (n == 0)
+    {
+        printf("%s,0,,,,,,\n", name);
+    }
+    else
+    {
+        qsort(bench_samples, n, sizeof(bench_samples[0]), bench_cmp);
+        for (i = 0; i < n; i++)
+            sum += bench_samples[i];
+        printf("%s,%u,%lu,%lu,%lu,%lu,%lu,%lu\n", name, n,
+               bench_samples[0], sum / n,
+               bench_samples[(n - 1) * 50 / 100],
+               bench_samples[(n - 1) * 90 / 100],
+               bench_samples[(n - 1) * 99 / 100],
+               bench_samples[n - 1]);
+    }
+    bench_count = 0;
+    bench_seen = 0;
+}
+
+/**
+ * @brief 工作线程入口：先绑到测试核上，通知控制线程已就位，跑完测试再通知一次
+ *
+ * @param args 测试函数
+ */
+static void bench_worker(void *args)
+{
+    void (*route)(void) = (void (*)(void))args;
+
+    acoral_thread_set_affinity(acoral_cur_thread->res.id, ACORAL_CPU_MASK(bench_cpu));
+    acoral_sem_post(bench_sync);
+    route();
+    acoral_sem_post(bench_sync);
+}
+
+/**
+ * @brief 创建工作线程，等它绑到测试核上之后返回
+ *
+ * @return int 线程id
+ */
+static int bench_spawn(char *name, void (*route)(void), unsigned char prio)
+{
+    int id = acoral_create_thread(name, bench_worker, (void *)route, 0, ACORAL_SCHED_POLICY_COMM, prio, ACORAL_HARD_PRIO, NULL);
+    if (id >= 0)
+        acoral_sem_pend(bench_sync, 0);
+    return id;
+}
+
+/*----------------------------------------------------------------------------*/
+/* 任务切换：两个同优先级线程轮流acoral_yield，记录从一方让出到另一方恢复      */
+/*----------------------------------------------------------------------------*/
+static void switch_loop(void)
+{
+    unsigned int i;
+    for (i = 0; i < BENCH_ITERS; i++)
+    {
+        bench_stamp = HAL_GET_CYCLES();
+        acoral_yield();
+        bench_record(HAL_GET_CYCLES() - bench_stamp);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/* 抢占：低优先级线程恢复被挂起的高优先级线程                                  */
+/*----------------------------------------------------------------------------*/
+static void preempt_high(void)
+{
+    unsigned int i;
+    for (i = 0; i < BENCH_ITERS; i++)
+    {
+        acoral_suspend_self();
+        bench_record(HAL_GET_CYCLES() - bench_stamp);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/* 信号量：post唤醒在pend上等待的高优先级线程                                  */
+/*----------------------------------------------------------------------------*/
+static void sem_high(void)
+{
+    unsigned int i;
+    for (i = 0; i < BENCH_ITERS; i++)
+    {
+        acoral_sem_pend(bench_sem, 0);
+        bench_record(HAL_GET_CYCLES() - bench_stamp);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/* 死锁解除：高优先级线程申请被低优先级线程持有的互斥量，                      */
+/* 记录从申请到经过优先级继承、低优先级线程释放后拿到互斥量                    */
+/*----------------------------------------------------------------------------*/
+static void deadlock_high(void)
+{
+    unsigned int i;
+    for (i = 0; i < BENCH_ITERS; i++)
+    {
+        acoral_suspend_self();
+        bench_stamp = HAL_GET_CYCLES();
+        acoral_mutex_pend(bench_mutex, 0);
+        bench_record(HAL_GET_CYCLES() - bench_stamp);
+        acoral_mutex_post(bench_mutex);
+    }
+}
+
+static void deadlock_low(void)
+{
+    unsigned int i;
+    for (i = 0; i < BENCH_ITERS; i++)
+    {
+        acoral_mutex_pend(bench_mutex, 0);
+        acoral_resume_thread_by_id(bench_high_id); //高优先级线程抢占后阻塞在互斥量上
+        acoral_mutex_post(bench_mutex);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/* 消息：send唤醒在recv上等待的高优先级线程                                    */
+/*----------------------------------------------------------------------------*/
+static void msg_high(void)
+{
+    unsigned int i, err;
+    for (i = 0; i < BENCH_ITERS; i++)
+    {
+        acoral_msg_recv(bench_msgctr, BENCH_MSG_ID, 0, &err);
+        bench_record(HAL_GET_CYCLES() - bench_stamp);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/* 线程创建/销毁：创建一个马上返回的高优先级线程，记录从开始创建到它退出、   */
+/* 控制线程恢复，其倒数就是每秒能创建销毁的线程数                             */
+/*----------------------------------------------------------------------------*/
+static void lifecycle_entry(void *args)
+{
+    (void)args;
+    acoral_sem_post(bench_sem);
+}
+
+/*----------------------------------------------------------------------------*/
+/* 工作队列：提交一个空任务并等它执行完，和上面的线程创建/销毁对比            */
+/*----------------------------------------------------------------------------*/
+static void work_entry(void *args)
+{
+    (void)args;
+}
+
+/*----------------------------------------------------------------------------*/
+/* 内存分配：BENCH_MEM_SLOTS个槽位随机分配、释放，分别记录分配和释放的时间。    */
+/* 伙伴系统用128B~8KB的块，任意大小分配用16B~2KB的块，对象缓存用64B的对象；     */
+/* 统一堆用16B~4KB的块，大约一半落在任意大小分配、一半落在伙伴系统；            */
+/* 任意大小分配最后看空闲总量和最大空闲块判断碎片                              */
+/*----------------------------------------------------------------------------*/
+#define BENCH_MEM_SLOTS 64
+#define BENCH_MEM_BUDDY 0
+#define BENCH_MEM_TLSF 1
+#define BENCH_MEM_CACHE 2
+#define BENCH_MEM_HEAP 3
+static void *bench_mem_slots[BENCH_MEM_SLOTS];
+static unsigned int bench_seed = 1;
+#if CFG_SLAB
+static acoral_cache_t *bench_cache;
+#endif
+
+static unsigned int bench_rand(void)
+{
+    bench_seed = bench_seed * 1103515245u + 12345u;
+    return bench_seed >> 16;
+}
+
+static void *bench_mem_alloc(int kind, unsigned int size)
+{
+    switch (kind)
+    {
+#ifdef CFG_MEM2
+    case BENCH_MEM_TLSF:
+        return acoral_malloc2(size);
+#endif
+#if CFG_SLAB
+    case BENCH_MEM_CACHE:
+        return acoral_cache_alloc(bench_cache);
+#endif
+    case BENCH_MEM_HEAP:
+        return acoral_heap_malloc(size);
+    default:
+        return acoral_malloc(size);
+    }
+}
+
+static void bench_mem_free(int kind, void *p)
+{
+    switch (kind)
+    {
+#ifdef CFG_MEM2
+    case BENCH_MEM_TLSF:
+        acoral_free2(p);
+        break;
+#endif
+#if CFG_SLAB
+    case BENCH_MEM_CACHE:
+        acoral_cache_free(bench_cache, p);
+        break;
+#endif
+    case BENCH_MEM_HEAP:
+        acoral_heap_free(p);
+        break;
+    default:
+        acoral_free(p);
+        break;
+    }
+}
+
+/**
+ * @brief 随机分配释放，直到记够样本
+ *
+ * @param kind 测哪个分配器，BENCH_MEM_*
+ * @param record_free 0记录分配时间，1记录释放时间
+ */
+static void bench_mem(int kind, int record_free)
+{
+    unsigned int i, slot, size;
+    unsigned long stamp, cost;
+    void *p;
+
+    for (i = 0; i < BENCH_ITERS * 8 && bench_count < BENCH_ROUNDS; i++)
+    {
+        slot = bench_rand() % BENCH_MEM_SLOTS;
+        if (bench_mem_slots[slot])
+        {
+            stamp = HAL_GET_CYCLES();
+            bench_mem_free(kind, bench_mem_slots[slot]);
+            cost = HAL_GET_CYCLES() - stamp;
+            bench_mem_slots[slot] = NULL;
+            if (record_free)
+                bench_record(cost);
+        }
+        else
+        {
+            if (kind == BENCH_MEM_TLSF)
+                size = 16 + bench_rand() % 2033;
+            else if (kind == BENCH_MEM_HEAP)
+                size = 16 << (bench_rand() % 9);
+            else
+                size = 128 << (bench_rand() % 7);
+            stamp = HAL_GET_CYCLES();
+            p = bench_mem_alloc(kind, size);
+            cost = HAL_GET_CYCLES() - stamp;
+            bench_mem_slots[slot] = p;
+            if (!record_free && p)
+                bench_record(cost);
+        }
+    }
+}
+
+/**
+ * @brief 释放bench_mem留下的块
+ *
+ */
+static void bench_mem_drain(int kind)
+{
+    unsigned int i;
+
+    for (i = 0; i < BENCH_MEM_SLOTS; i++)
+    {
+        if (bench_mem_slots[i])
+            bench_mem_free(kind, bench_mem_slots[i]);
+        bench_mem_slots[i] = NULL;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/* 中断：触发软件中断到进入服务程序，以及到服务程序唤醒的线程开始运行          */
+/*----------------------------------------------------------------------------*/
+static void bench_isr(void)
+{
+    bench_isr_stamp = HAL_GET_CYCLES();
+    bench_isr_seq++;
+    if (bench_isr_post)
+        acoral_sem_post(bench_sem);
+}
+
+static void bench_run(void)
+{
+    unsigned int i, seq;
+    acoral_msg_t *msg;
+
+    printf("# acoral_bench unit=%s rounds=%d cpu=%u\n", HAL_CYCLES_UNIT, BENCH_ROUNDS, bench_cpu);
+    printf("test,samples,min,avg,p50,p90,p99,max\n");
+
+    bench_spawn("bswitch", switch_loop, BENCH_PRIO_CTRL);
+    switch_loop();
+    acoral_sem_pend(bench_sync, 0);
+    bench_report("task_switch");
+
+    bench_high_id = bench_spawn("bpreempt", preempt_high, BENCH_PRIO_HIGH);
+    for (i = 0; i < BENCH_ITERS; i++)
+    {
+        bench_stamp = HAL_GET_CYCLES();
+        acoral_resume_thread_by_id(bench_high_id);
+    }
+    acoral_sem_pend(bench_sync, 0);
+    bench_report("preemption");
+
+    /*调度锁：锁住期间恢复高优先级线程，记录从最外层解锁到它开始运行，和上面的抢占对比*/
+    bench_high_id = bench_spawn("bslock", preempt_high, BENCH_PRIO_HIGH);
+    for (i = 0; i < BENCH_ITERS; i++)
+    {
+        acoral_sched_lock();
+        acoral_resume_thread_by_id(bench_high_id);
+        bench_stamp = HAL_GET_CYCLES();
+        acoral_sched_unlock();
+    }
+    acoral_sem_pend(bench_sync, 0);
+    bench_report("sched_lock_replay");
+
+    bench_spawn("bsem", sem_high, BENCH_PRIO_HIGH);
+    for (i = 0; i < BENCH_ITERS; i++)
+    {
+        bench_stamp = HAL_GET_CYCLES();
+        acoral_sem_post(bench_sem);
+    }
+    acoral_sem_pend(bench_sync, 0);
+    bench_report("sem_shuffle");
+
+    bench_high_id = bench_spawn("bdlhigh", deadlock_high, BENCH_PRIO_HIGH);
+    bench_spawn("bdllow", deadlock_low, BENCH_PRIO_LOW);
+    acoral_sem_pend(bench_sync, 0);
+    acoral_sem_pend(bench_sync, 0);
+    bench_report("deadlock_break");
+
+    bench_spawn("bmsg", msg_high, BENCH_PRIO_HIGH);
+    for (i = 0; i < BENCH_ITERS; i++)
+    {
+        msg = acoral_msg_create(1, BENCH_MSG_ID, 0, NULL);
+        bench_stamp = HAL_GET_CYCLES();
+        acoral_msg_send(bench_msgctr, msg);
+    }
+    acoral_sem_pend(bench_sync, 0);
+    bench_report("msg_latency");
+
+    for (i = 0; i < BENCH_ITERS; i++)
+    {
+        bench_stamp = HAL_GET_CYCLES();
+        if (acoral_create_thread("bhelper", lifecycle_entry, NULL, 0, ACORAL_SCHED_POLICY_COMM, BENCH_PRIO_HIGH, ACORAL_HARD_PRIO, NULL) < 0)
+            break;
+        acoral_sem_pend(bench_sem, 0);
+        bench_record(HAL_GET_CYCLES() - bench_stamp);
+    }
+    bench_report("thread_create_kill");
+
+#if CFG_WORKQUEUE
+    for (i = 0; i < BENCH_ITERS; i++)
+    {
+        bench_stamp = HAL_GET_CYCLES();
+        if (acoral_work_submit(bench_wq, work_entry, NULL) != 0)
+            break;
+        acoral_work_wait(bench_wq);
+        bench_record(HAL_GET_CYCLES() - bench_stamp);
+    }
+    bench_report("work_submit_wait");
+#endif
+
+    bench_mem(BENCH_MEM_BUDDY, 0);
+    bench_report("malloc");
+    bench_mem(BENCH_MEM_BUDDY, 1);
+    bench_report("free");
+    bench_mem_drain(BENCH_MEM_BUDDY);
+
+#ifdef CFG_MEM2
+    {
+        acoral_mem_stat_t stat;
+
+        bench_mem(BENCH_MEM_TLSF, 0);
+        bench_report("malloc2");
+        bench_mem(BENCH_MEM_TLSF, 1);
+        bench_report("free2");
+        /*还有一半左右的槽位占着，最大空闲块占空闲总量的比例越小碎片越多*/
+        acoral_mem_stat2(&stat);
+        printf("# malloc2 free=%lu largest=%lu\n", stat.free_bytes, stat.largest_free);
+        bench_mem_drain(BENCH_MEM_TLSF);
+    }
+#endif
+
+#if CFG_SLAB
+    bench_cache = acoral_cache_create("bench", 64, 0, NULL);
+    if (bench_cache)
+    {
+        bench_mem(BENCH_MEM_CACHE, 0);
+        bench_report("cache_alloc");
+        bench_mem(BENCH_MEM_CACHE, 1);
+        bench_report("cache_free");
+        bench_mem_drain(BENCH_MEM_CACHE);
+        acoral_cache_destroy(bench_cache);
+    }
+#endif
+
+    bench_mem(BENCH_MEM_HEAP, 0);
+    bench_report("heap_malloc");
+    bench_mem(BENCH_MEM_HEAP, 1);
+    bench_report("heap_free");
+    bench_mem_drain(BENCH_MEM_HEAP);
+
+    HAL_SOFT_INTR_ATTACH(bench_isr);
+    bench_isr_post = 0;
+    for (i = 0; i < BENCH_ITERS; i++)
+    {
+        seq = bench_isr_seq;
+        bench_stamp = HAL_GET_CYCLES();
+        HAL_SOFT_INTR_TRIGGER();
+        while (bench_isr_seq == seq)
+            ;
+        bench_record(bench_isr_stamp - bench_stamp);
+    }
+    bench_report("intr_latency");
+
+    bench_isr_post = 1;
+    bench_spawn("bintr", sem_high, BENCH_PRIO_HIGH);
+    for (i = 0; i < BENCH_ITERS; i++)
+    {
+        seq = bench_isr_seq;
+        bench_stamp = HAL_GET_CYCLES();
+        HAL_SOFT_INTR_TRIGGER();
+        while (bench_isr_seq == seq)
+            ;
+    }
+    acoral_sem_pend(bench_sync, 0);
+    bench_report("intr_to_thread");
+    HAL_SOFT_INTR_ATTACH(NULL);
+    bench_isr_post = 0;
+}
+
+static void bench_ctrl(void *args)
+{
+    (void)args;
+    bench_cpu = acoral_current_cpu();
+    acoral_thread_set_affinity(acoral_cur_thread->res.id, ACORAL_CPU_MASK(bench_cpu));
+    bench_run();
+    acoral_sem_post(bench_done);
+}
+
+void acoral_bench()
+{
+    unsigned int err;
+
+    if (bench_sync == NULL)
+    {
+        /*内核对象只建一次，sem_del并不回收资源*/
+        bench_sync = acoral_sem_create(0);
+        bench_done = acoral_sem_create(0);
+        bench_sem = acoral_sem_create(0);
+        bench_mutex = acoral_mutex_create(BENCH_PRIO_HIGH, &err);
+        bench_msgctr = acoral_msgctr_create();
+        if (!bench_sync || !bench_done || !bench_sem || !bench_mutex || !bench_msgctr)
+        {
+            ACORAL_LOG_ERROR("Bench Init Failed");
+            return;
+        }
+#if CFG_WORKQUEUE
+        bench_wq = acoral_workqueue_create(1, BENCH_PRIO_HIGH);
+        if (!bench_wq)
+        {
+            ACORAL_LOG_ERROR("Bench Init Failed");
+            return;
+        }
+#endif
+    }
+    if (acoral_create_thread("bench", bench_ctrl, NULL, 0, ACORAL_SCHED_POLICY_COMM, BENCH_PRIO_CTRL, ACORAL_HARD_PRIO, NULL) < 0)
+        return;
+    acoral_sem_pend(bench_done, 0);
+}
+
+static void bench_shell(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+    acoral_bench();
+}
+
+acoral_shell_cmd_t bench_cmd={
+    "bench",
+    (void*)bench_shell,
+    "Run the kernel latency benchmark suite",
+    NULL
+};
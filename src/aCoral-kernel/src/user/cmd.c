@@ -25,6 +25,30 @@ acoral_shell_cmd_t mem2_cmd={
 	NULL
 };
 
+void heap_scan(int argc,char **argv){
+	acoral_heap_scan();
+}
+
+acoral_shell_cmd_t heap_cmd={
+	"heap",
+	(void*)heap_scan,
+	"View the unified heap shared by the kernel and the C library",
+	NULL
+};
+
+#if CFG_SLAB
+void slab_scan(int argc,char **argv){
+	acoral_cache_scan();
+}
+
+acoral_shell_cmd_t slab_cmd={
+	"slabinfo",
+	(void*)slab_scan,
+	"View the object caches built on the resource pools",
+	NULL
+};
+#endif
+
 extern acoral_shell_cmd_t *head_cmd;
 void help(int argc,char **argv){
 	acoral_shell_cmd_t *curr;
@@ -54,11 +78,29 @@ acoral_shell_cmd_t spg_cmd={
 };
 
 extern acoral_shell_cmd_t dt_cmd;
+#if CFG_STACK_PAINT
+extern acoral_shell_cmd_t stack_cmd;
+#endif
+#if CFG_THREAD_STATS
+extern acoral_shell_cmd_t top_cmd;
+#endif
+extern acoral_shell_cmd_t bench_cmd;
 extern int fs_cmd_init(void);
 void cmd_init(void){
 	add_command(&mem_cmd);
 	//add_command(&mem2_cmd);
+	add_command(&heap_cmd);
+#if CFG_SLAB
+	add_command(&slab_cmd);
+#endif
 	add_command(&dt_cmd);
+#if CFG_STACK_PAINT
+	add_command(&stack_cmd);
+#endif
+#if CFG_THREAD_STATS
+	add_command(&top_cmd);
+#endif
+	add_command(&bench_cmd);
 	add_command(&spg_cmd);
 	add_command(&help_cmd);
 }
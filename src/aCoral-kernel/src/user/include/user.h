@@ -3,6 +3,17 @@
 
 void test_comm_thread();
 void test_period_thread();
+void test_dag();
+void test_edf_thread();
+void test_rr_thread();
+void test_sched_bench();
+void test_affinity();
+void test_workqueue();
+void test_mutex_pi();
+void test_srp();
+void test_reserve();
+void test_slab();
+void acoral_bench();
 int test_yolo2();
 int test_iris();
 int test_iris_2();
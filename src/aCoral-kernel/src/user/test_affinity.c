@@ -0,0 +1,25 @@
+#include <stdio.h>
+#include "acoral.h"
+#include "user.h"
+
+void affinity_worker(void *args){
+    unsigned int idx = (unsigned int)(unsigned long)args;
+    unsigned int count = 0;
+    while(1){
+        count++;
+        printf("aff%u run on core %u, count = %u\n", idx, acoral_current_cpu(), count);
+        acoral_delay_self(500);
+        if(count == 10){
+            acoral_thread_set_affinity(acoral_cur_thread->res.id, ACORAL_CPU_MASK_ALL); //之后允许在两个核之间迁移
+            printf("aff%u unpinned\n", idx);
+        }
+    }
+}
+
+void test_affinity(){
+    int id;
+    id = acoral_create_thread("aff0",affinity_worker,(void *)0,0,ACORAL_SCHED_POLICY_COMM,20,ACORAL_HARD_PRIO,NULL);
+    acoral_thread_set_affinity(id, ACORAL_CPU_MASK(0));
+    id = acoral_create_thread("aff1",affinity_worker,(void *)1,0,ACORAL_SCHED_POLICY_COMM,20,ACORAL_HARD_PRIO,NULL);
+    acoral_thread_set_affinity(id, ACORAL_CPU_MASK(CFG_MAX_CPU - 1));
+}
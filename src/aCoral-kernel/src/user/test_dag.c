@@ -1,102 +1,80 @@
 #include <stdio.h>
 #include "acoral.h"
+#include "user.h"
 
-void dag1(){
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG1");
-    printf("CPU0:DAG1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: P2");
-    printf("CPU1:P2 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: N1");
-    printf("CPU0:N1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG2");
-    printf("CPU1:DAG2 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG1");
-    printf("CPU0:DAG1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: P1");
-    printf("CPU0:P1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG2");
-    printf("CPU1:DAG2 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG1");
-    printf("CPU0:DAG1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: P1");
-    printf("CPU0:P1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG2");
-    printf("CPU1:DAG2 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG1");
-    printf("CPU0:DAG1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: P1");
-    printf("CPU0:P1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG2");
-    printf("CPU1:DAG2 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG1");
+/* capture -> preprocess -> kpu -> nms -> display，preprocess同时分出一路统计直方图给display */
+static int frame_in, frame_pre, frame_kpu, frame_nms, frame_hist;
 
-    printf("CPU0:DAG1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: P1");
-    printf("CPU0:P1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG2");
-    printf("CPU1:DAG2 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG1");
-    printf("CPU0:DAG1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: P2");
-    printf("CPU1:P2 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG2");
-    printf("CPU1:DAG2 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG1");
-    printf("CPU0:DAG1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG2");
-    printf("CPU1:DAG2 DONE\n");
+static void dag_capture(void *args){
+    frame_in++;
+    printf("CPU%ld:capture frame %d\n", read_csr(mhartid), frame_in);
+}
 
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG1");
-    printf("CPU0:DAG1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: P1");
-    printf("CPU0:P1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG2");
-    printf("CPU1:DAG2 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG1");
-    printf("CPU0:DAG1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: P1");
-    printf("CPU0:P1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG2");
-    printf("CPU1:DAG2 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG1");
-    printf("CPU0:DAG1 DONE\n");
+static void dag_preprocess(void *args){
+    frame_pre++;
+    printf("preprocess frame %d\n", frame_pre);
+}
 
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG1");
-    printf("CPU0:DAG1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG2");
-    printf("CPU1:DAG2 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG1");
-    printf("CPU0:DAG1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: P2");
-    printf("CPU1:P2 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG2");
-    printf("CPU1:DAG2 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG1");
-    printf("CPU0:DAG1 DONE\n");
+static void dag_kpu(void *args){
+    frame_kpu++;
+    acoral_delay_self(20); //模拟KPU推理耗时
+    printf("kpu frame %d\n", frame_kpu);
+}
 
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG1");
-    printf("CPU0:DAG1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: P1");
-    printf("CPU0:P1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG2");
-    printf("CPU1:DAG2 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG1");
-    printf("CPU0:DAG1 DONE\n");
+static void dag_nms(void *args){
+    frame_nms++;
+    printf("nms frame %d\n", frame_nms);
+}
 
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: P1");
-    printf("CPU0:P1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG2");
-    printf("CPU1:DAG2 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG1");
-    printf("CPU0:DAG1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG2");
-    printf("CPU1:DAG2 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG1");
-    printf("CPU0:DAG1 DONE\n");
-    printf("[\033[0;32mLOG_TRACE\033[0m] %s:%d -> %s","E:\\aCoral-riscv-cl\\src\\aCoral-kernel\\src\\kernel\\thread.c:341",341,"Switch to Thread: DAG2");
-    printf("CPU1:DAG2 DONE\n");
+static void dag_hist(void *args){
+    frame_hist++;
+    printf("hist frame %d\n", frame_hist);
+}
+
+static void dag_display(void *args){
+    printf("display frame done, nms %d hist %d\n", frame_nms, frame_hist);
+}
+
+/**
+ * @brief 驱动线程，每33ms触发一帧，流水线满时dag_trigger阻塞
+ */
+static void dag_driver(void *args){
+    for(int i = 0; i < 10; i++){
+        dag_trigger();
+        acoral_delay_self(33);
+    }
 }
 
 void test_dag(){
-    acoral_create_thread("d1",dag1,NULL,0,ACORAL_SCHED_POLICY_COMM,21,ACORAL_HARD_PRIO,NULL);
-}
\ No newline at end of file
+    int cap, pre, kpu, nms, hist, disp;
+    int ret;
+
+    cap  = dag_add_node(dag_capture, 0, NULL, NULL);
+    pre  = dag_add_node(dag_preprocess, ACORAL_DAG_ANY_CORE, NULL, NULL);
+    kpu  = dag_add_node(dag_kpu, ACORAL_DAG_ANY_CORE, NULL, NULL);
+    nms  = dag_add_node(dag_nms, ACORAL_DAG_ANY_CORE, NULL, NULL);
+    hist = dag_add_node(dag_hist, ACORAL_DAG_ANY_CORE, NULL, NULL);
+    disp = dag_add_node(dag_display, ACORAL_DAG_ANY_CORE, NULL, NULL);
+
+    /* 执行时间估计，决定关键路径优先级 */
+    dag_set_node_weight(cap, 5);
+    dag_set_node_weight(pre, 5);
+    dag_set_node_weight(kpu, 20);
+    dag_set_node_weight(nms, 3);
+    dag_set_node_weight(hist, 2);
+    dag_set_node_weight(disp, 4);
+
+    dag_add_edge(cap, pre);
+    dag_add_edge(pre, kpu);
+    dag_add_edge(kpu, nms);
+    dag_add_edge(nms, disp);
+    dag_add_edge(pre, hist);
+    dag_add_edge(hist, disp);
+
+    ret = dag_start();
+    if(ret != ACORAL_DAG_SUCCESS){
+        printf("dag start failed: %d\n", ret);
+        return;
+    }
+    acoral_create_thread("dagdrv",dag_driver,NULL,0,ACORAL_SCHED_POLICY_COMM,25,ACORAL_HARD_PRIO,NULL);
+}
@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include "acoral.h"
+#include "user.h"
+
+static acoral_evt_t *pi_mutex_a;
+static acoral_evt_t *pi_mutex_b;
+
+void pi_low(void *args){
+    while(1){
+        acoral_mutex_pend(pi_mutex_a, 0);
+        printf("low: hold A, prio %d\n", acoral_cur_thread->prio);
+        acoral_delay_self(300); //等mid和high依次阻塞
+        //high等B，B的占用者mid等A，high的优先级沿链传到low
+        printf("low: before post A, prio %d (base %d)\n", acoral_cur_thread->prio, acoral_cur_thread->base_prio);
+        acoral_mutex_post(pi_mutex_a);
+        printf("low: after post A, prio %d\n", acoral_cur_thread->prio);
+        acoral_delay_self(1000);
+    }
+}
+
+void pi_mid(void *args){
+    while(1){
+        acoral_delay_self(100);
+        acoral_mutex_pend(pi_mutex_b, 0);
+        acoral_mutex_pend(pi_mutex_a, 0);
+        printf("mid: got A, prio %d\n", acoral_cur_thread->prio);
+        acoral_mutex_post(pi_mutex_a);
+        acoral_mutex_post(pi_mutex_b);
+        printf("mid: released A B, prio %d\n", acoral_cur_thread->prio);
+        acoral_delay_self(1000);
+    }
+}
+
+void pi_high(void *args){
+    while(1){
+        acoral_delay_self(200);
+        acoral_mutex_pend(pi_mutex_b, 0);
+        printf("high: got B, prio %d\n", acoral_cur_thread->prio);
+        acoral_mutex_post(pi_mutex_b);
+        acoral_delay_self(1000);
+    }
+}
+
+void test_mutex_pi(){
+    unsigned int err;
+    pi_mutex_a = acoral_mutex_create(0, &err);
+    pi_mutex_b = acoral_mutex_create(0, &err);
+    if(pi_mutex_a == NULL || pi_mutex_b == NULL){
+        printf("mutex create failed\n");
+        return;
+    }
+    acoral_create_thread("pi_low",pi_low,NULL,0,ACORAL_SCHED_POLICY_COMM,30,ACORAL_HARD_PRIO,NULL);
+    acoral_create_thread("pi_mid",pi_mid,NULL,0,ACORAL_SCHED_POLICY_COMM,25,ACORAL_HARD_PRIO,NULL);
+    acoral_create_thread("pi_high",pi_high,NULL,0,ACORAL_SCHED_POLICY_COMM,20,ACORAL_HARD_PRIO,NULL);
+}
@@ -9,10 +9,73 @@ void p1(){
     return;
 }
 
+static int thread_p1;
+static int thread_p2;
+void p2(){
+    int frame = 0; //局部变量在周期之间保留
+    acoral_period_stat_t stat;
+    for(;;){
+        frame++;
+        if(frame % 30 == 0){
+            acoral_period_get_stat(thread_p2, &stat);
+            printf("p2 frame %d, jobs %u, overruns %u, jitter %lu/%lu, response %lu/%lu\n",
+                   frame, stat.jobs, stat.overruns,
+                   stat.jitter_last, stat.jitter_max,
+                   stat.response_last, stat.response_max);
+        }
+        if(frame == 90){
+            /* p1正睡着等下一次释放，杀掉后周期等待队列上不能再留着它 */
+            acoral_kill_thread_by_id(thread_p1);
+            printf("p1 killed\n");
+        }
+        acoral_period_wait();
+    }
+}
+
 void test_period_thread(){
     acoral_period_policy_data_t p1data={
         .period_time_mm = 2000
     };
+    acoral_period_policy_data_t p2data={
+        .period_time_mm = 33 //约30Hz，不是tick整数倍，按绝对时间释放不会漂移
+    };
+
+    thread_p1 = acoral_create_thread("p1",p1,NULL,0,ACORAL_SCHED_POLICY_PERIOD,21,ACORAL_HARD_PRIO,&p1data);
+    thread_p2 = acoral_create_thread("p2",p2,NULL,0,ACORAL_SCHED_POLICY_PERIOD,22,ACORAL_HARD_PRIO,&p2data);
+}
+
+void e1(){
+    static int n = 0;
+    n++;
+    printf("e1 job %d, ticks = %u\n", n, acoral_get_ticks());
+}
+
+void e2(){
+    static int n = 0;
+    n++;
+    printf("e2 job %d, ticks = %u, util = %u\n", n, acoral_get_ticks(), acoral_edf_get_util());
+}
+
+void test_edf_thread(){
+    acoral_period_policy_data_t e1data={
+        .period_time_mm = 500,
+        .deadline_mm = 300,
+        .wcet_mm = 100
+    };
+    acoral_period_policy_data_t e2data={
+        .period_time_mm = 1000,
+        .wcet_mm = 400
+    };
+    acoral_period_policy_data_t e3data={
+        .period_time_mm = 1000,
+        .wcet_mm = 500
+    };
 
-    acoral_create_thread("p1",p1,NULL,0,ACORAL_SCHED_POLICY_PERIOD,21,ACORAL_HARD_PRIO,&p1data);
-}
\ No newline at end of file
+    /* EDF线程共用同一个优先级，同优先级内按绝对截止期排序 */
+    acoral_create_thread("e1",e1,NULL,0,ACORAL_SCHED_POLICY_EDF,24,ACORAL_HARD_PRIO,&e1data);
+    acoral_create_thread("e2",e2,NULL,0,ACORAL_SCHED_POLICY_EDF,24,ACORAL_HARD_PRIO,&e2data);
+    /* 333+400+500 > 1000，会被准入控制拒绝 */
+    if(acoral_create_thread("e3",e1,NULL,0,ACORAL_SCHED_POLICY_EDF,24,ACORAL_HARD_PRIO,&e3data) < 0){
+        printf("e3 rejected by EDF admission\n");
+    }
+}
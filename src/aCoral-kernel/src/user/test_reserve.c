@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include "acoral.h"
+#include "user.h"
+
+static volatile unsigned int frames;        //硬实时帧循环完成的帧数
+static volatile unsigned int analytics_loops;
+static volatile unsigned int logger_loops;
+static int analytics_id;
+
+//忙等n个tick，模拟一段计算
+static void busy_ticks(unsigned int n){
+    unsigned int start = acoral_get_ticks();
+    while(acoral_get_ticks() - start < n)
+        ;
+}
+
+void reserve_frame(void *args){
+    while(1){
+        busy_ticks(1);          //每帧算10ms左右，预算按tick扣，跨过一次tick就记一整个tick，留出余量
+        frames++;
+        acoral_delay_self(20);
+    }
+}
+
+//失控的分析线程，不预留的话比它低的线程一点CPU都拿不到
+void reserve_analytics(void *args){
+    while(1){
+        analytics_loops++;
+    }
+}
+
+void reserve_logger(void *args){
+    while(1){
+        logger_loops++;
+    }
+}
+
+void reserve_report(void *args){
+    acoral_reserve_param_t greedy = {200, 1000, ACORAL_RESERVE_SUSPEND};
+    //帧循环已经占了606‰，再要200‰超过了CFG_HARD_RT_UTIL_BOUND
+    if(acoral_create_hard_rt_thread("greedy", reserve_logger, NULL, 0, 1, 0, &greedy) < 0)
+        printf("greedy hard rt thread rejected, cpu0 util %u\n", acoral_hard_rt_get_util(0));
+    while(1){
+        acoral_delay_self(1000);
+        printf("frames %u, analytics overruns %d, logger %s\n", frames,
+               acoral_thread_reserve_overruns(analytics_id), logger_loops ? "running" : "starved");
+        logger_loops = 0;
+    }
+}
+
+void test_reserve(){
+    acoral_reserve_param_t frame = {20, 33, ACORAL_RESERVE_SUSPEND};
+    acoral_reserve_param_t analytics = {50, 100, ACORAL_RESERVE_DEMOTE};
+    int id;
+
+    if(acoral_create_hard_rt_thread("frame", reserve_frame, NULL, 0, 0, 0, &frame) < 0){
+        printf("frame thread rejected\n");
+        return;
+    }
+    analytics_id = acoral_create_thread("analytics",reserve_analytics,NULL,0,ACORAL_SCHED_POLICY_COMM,20,ACORAL_HARD_PRIO,NULL);
+    acoral_thread_set_affinity(analytics_id, ACORAL_CPU_MASK(0));
+    acoral_thread_set_reserve(analytics_id, &analytics);
+    id = acoral_create_thread("logger",reserve_logger,NULL,0,ACORAL_SCHED_POLICY_COMM,25,ACORAL_HARD_PRIO,NULL);
+    acoral_thread_set_affinity(id, ACORAL_CPU_MASK(0));
+    acoral_create_thread("rsv_rpt",reserve_report,NULL,0,ACORAL_SCHED_POLICY_COMM,15,ACORAL_HARD_PRIO,NULL);
+}
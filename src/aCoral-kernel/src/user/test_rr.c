@@ -0,0 +1,28 @@
+#include <stdio.h>
+#include "acoral.h"
+#include "user.h"
+
+static volatile unsigned int rr_count[3];
+
+void rr_worker(void *args){
+    unsigned int idx = (unsigned int)(unsigned long)args;
+    printf("in rr worker %u..\n", idx);
+    while(1){
+        rr_count[idx]++;
+        if((rr_count[idx] & 0xfffff) == 0){
+            printf("rr%u = %u\n", idx, rr_count[idx]);
+        }
+        if(idx == 2 && (rr_count[idx] & 0x3ffff) == 0){
+            acoral_yield(); //主动让出，剩余时间片保留到下次运行
+        }
+    }
+}
+
+void test_rr_thread(){
+    acoral_rr_policy_data_t rrdata={
+        .slice_mm = 20
+    };
+    acoral_create_thread("rr0",rr_worker,(void *)0,0,ACORAL_SCHED_POLICY_RR,30,ACORAL_HARD_PRIO,&rrdata);
+    acoral_create_thread("rr1",rr_worker,(void *)1,0,ACORAL_SCHED_POLICY_RR,30,ACORAL_HARD_PRIO,&rrdata);
+    acoral_create_thread("rr2",rr_worker,(void *)2,0,ACORAL_SCHED_POLICY_RR,30,ACORAL_HARD_PRIO,NULL);
+}
@@ -0,0 +1,76 @@
+/**
+ * @file test_sched_bench.c
+ * @author 王彬浩 (SPGGOGOGO@outlook.com)
+ * @brief 用户层，就绪队列入队/选取/出队开销的微基准测试
+ * @version 1.0
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026
+ */
+#include <stdio.h>
+#include "acoral.h"
+#include "hal.h"
+#include "user.h"
+
+#define SCHED_BENCH_ROUNDS 16 ///<每个线程数下重复测量的轮数
+
+/// 私有的就绪队列，不干扰系统调度
+static acoral_rdy_queue_t bench_queue;
+/// 充当线程ready_hook的链表节点
+static acoral_list_t bench_hooks[CFG_MAX_THREAD];
+static unsigned char bench_prios[CFG_MAX_THREAD];
+
+/**
+ * @brief 测量n个就绪线程时，每次入队、选取最高优先级、出队的平均周期数
+ *
+ * @param n 就绪线程数
+ */
+static void sched_bench_run(unsigned int n)
+{
+    unsigned long add_cycles = 0, sel_cycles = 0, del_cycles = 0;
+    unsigned long start;
+    unsigned int i, r, prio;
+
+    for (i = 0; i < n; i++)
+    {
+        /*把n个线程打散到整个优先级空间，覆盖多个位图字*/
+        bench_prios[i] = (unsigned char)(i * ACORAL_MAX_PRIO_NUM / n);
+    }
+    /*测量期间关中断，避免ticks中断计入开销*/
+    acoral_enter_critical();
+    for (r = 0; r < SCHED_BENCH_ROUNDS; r++)
+    {
+        start = HAL_GET_CYCLES();
+        for (i = 0; i < n; i++)
+            acoral_prio_queue_add(&bench_queue, bench_prios[i], &bench_hooks[i]);
+        add_cycles += HAL_GET_CYCLES() - start;
+
+        start = HAL_GET_CYCLES();
+        for (i = 0; i < n; i++)
+            prio = acoral_get_highprio(&bench_queue);
+        sel_cycles += HAL_GET_CYCLES() - start;
+        (void)prio;
+
+        start = HAL_GET_CYCLES();
+        for (i = 0; i < n; i++)
+            acoral_prio_queue_del(&bench_queue, bench_prios[i], &bench_hooks[i]);
+        del_cycles += HAL_GET_CYCLES() - start;
+    }
+    acoral_exit_critical();
+    printf("%u\t%lu\t%lu\t%lu\n", n,
+           add_cycles / (n * SCHED_BENCH_ROUNDS),
+           sel_cycles / (n * SCHED_BENCH_ROUNDS),
+           del_cycles / (n * SCHED_BENCH_ROUNDS));
+}
+
+void test_sched_bench()
+{
+    unsigned int n;
+
+    acoral_prio_queue_init(&bench_queue);
+    printf("sched bench (cycles/op), prio num = %d\n", ACORAL_MAX_PRIO_NUM);
+    printf("threads\tadd\tselect\tdel\n");
+    for (n = 1; n <= CFG_MAX_THREAD; n++)
+    {
+        sched_bench_run(n);
+    }
+}
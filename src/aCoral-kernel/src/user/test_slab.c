@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include "acoral.h"
+#include "user.h"
+
+typedef struct slab_box{
+    struct slab_box *next;
+    short x, y, w, h;
+    float prob;
+    unsigned int cls;
+}slab_box_t;
+
+typedef struct{
+    unsigned int seq;
+    unsigned int nbox;
+    slab_box_t *boxes;
+}slab_frame_t;
+
+static acoral_cache_t *frame_cache;
+static acoral_cache_t *box_cache;
+static volatile unsigned int boxes_done;
+
+static void box_ctor(void *obj){
+    ((slab_box_t *)obj)->next = NULL;
+}
+
+//后处理在工作线程里做，可能在另一个核上，框和帧描述符也在那里释放
+void slab_post(void *args){
+    slab_frame_t *frame = (slab_frame_t *)args;
+    slab_box_t *box, *next;
+    for(box = frame->boxes; box != NULL; box = next){
+        next = box->next;
+        box->next = NULL; //释放时保持构造后的状态
+        boxes_done++;
+        acoral_cache_free(box_cache, box);
+    }
+    acoral_cache_free(frame_cache, frame);
+}
+
+void slab_detect(void *args){
+    acoral_workqueue_t *wq = (acoral_workqueue_t *)args;
+    slab_frame_t *frame;
+    slab_box_t *box;
+    unsigned int seq = 0, i;
+    while(1){
+        frame = acoral_cache_alloc(frame_cache);
+        if(frame == NULL){
+            acoral_delay_self(33);
+            continue;
+        }
+        frame->seq = seq;
+        frame->nbox = (seq * 7) % 20; //每帧检测到的目标数不一样
+        frame->boxes = NULL;
+        for(i = 0; i < frame->nbox; i++){
+            box = acoral_cache_alloc(box_cache);
+            if(box == NULL)
+                break;
+            box->x = i * 10;
+            box->y = i * 5;
+            box->w = 32;
+            box->h = 32;
+            box->prob = 0.5f;
+            box->cls = i % 3;
+            box->next = frame->boxes;
+            frame->boxes = box;
+        }
+        if(acoral_work_submit(wq, slab_post, frame) != 0)
+            slab_post(frame);
+        if(++seq % 100 == 0){
+            printf("frame %u, boxes %u\n", seq, boxes_done);
+            acoral_cache_scan();
+        }
+        acoral_delay_self(33);
+    }
+}
+
+void test_slab(){
+    acoral_workqueue_t *wq;
+    frame_cache = acoral_cache_create("frame", sizeof(slab_frame_t), 0, NULL);
+    box_cache = acoral_cache_create("box", sizeof(slab_box_t), 16, box_ctor);
+    wq = acoral_workqueue_create(CFG_MAX_CPU, 25);
+    if(frame_cache == NULL || box_cache == NULL || wq == NULL){
+        printf("slab test init failed\n");
+        return;
+    }
+    acoral_create_thread("detect",slab_detect,wq,0,ACORAL_SCHED_POLICY_COMM,20,ACORAL_HARD_PRIO,NULL);
+}
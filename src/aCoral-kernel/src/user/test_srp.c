@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include "acoral.h"
+#include "user.h"
+
+#define SRP_CTRL_TASKS 8
+
+static acoral_evt_t *srp_bus;               //天花板为10，level 10和level 12的任务都会用
+static acoral_srp_task_t *srp_ctrl[SRP_CTRL_TASKS];
+static acoral_srp_task_t *srp_urgent;
+static volatile unsigned int srp_bus_value;
+
+void srp_ctrl_task(void *args){
+    unsigned int idx = (unsigned int)(unsigned long)args;
+    acoral_mutex_pend2(srp_bus, 0); //SRP下一定能马上拿到
+    srp_bus_value += idx;
+    if(idx == 0){
+        //占用期间urgent（level 10）被激活也要等到释放，level比天花板高的才能抢占
+        acoral_srp_task_activate(srp_urgent);
+        printf("ctrl0: ceiling %d, prio %d\n", acoral_srp_ceiling(acoral_current_cpu()), acoral_cur_thread->prio);
+    }
+    acoral_mutex_post(srp_bus);
+}
+
+void srp_urgent_task(void *args){
+    acoral_mutex_pend2(srp_bus, 0);
+    printf("urgent: bus %u\n", srp_bus_value);
+    acoral_mutex_post(srp_bus);
+}
+
+void srp_driver(void *args){
+    unsigned int i;
+    while(1){
+        srp_bus_value = 0; //urgent在ctrl0释放后马上运行，看到的是0
+        for(i = 0; i < SRP_CTRL_TASKS; i++)
+            acoral_srp_task_activate(srp_ctrl[i]);
+        acoral_delay_self(500);
+        printf("ctrl runs %u, level %d stack used %d/%u\n", srp_ctrl[0]->runs, srp_ctrl[0]->level->prio,
+            acoral_thread_stack_hwm(srp_ctrl[0]->level->thread->res.id), srp_ctrl[0]->level->thread->stack_size);
+    }
+}
+
+void test_srp(){
+    unsigned int err, i;
+    srp_bus = acoral_mutex_create(10, &err);
+    if(srp_bus == NULL){
+        printf("mutex create failed\n");
+        return;
+    }
+    //8个控制任务共用level 12的一个栈
+    for(i = 0; i < SRP_CTRL_TASKS; i++)
+        srp_ctrl[i] = acoral_srp_task_create("ctrl", srp_ctrl_task, (void *)(unsigned long)i, 12, 0);
+    srp_urgent = acoral_srp_task_create("urgent", srp_urgent_task, NULL, 10, 0);
+    if(srp_ctrl[SRP_CTRL_TASKS - 1] == NULL || srp_urgent == NULL){
+        printf("srp task create failed\n");
+        return;
+    }
+    acoral_create_thread("srp_drv",srp_driver,NULL,0,ACORAL_SCHED_POLICY_COMM,20,ACORAL_HARD_PRIO,NULL);
+}
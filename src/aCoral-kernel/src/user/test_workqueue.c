@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include "acoral.h"
+#include "user.h"
+
+#define WQ_JOBS 8
+
+static volatile unsigned int wq_result[WQ_JOBS];
+
+void wq_job(void *args){
+    unsigned int idx = (unsigned int)(unsigned long)args;
+    unsigned int i, sum = 0;
+    for(i = 0; i <= idx * 100000; i++){
+        sum += i;
+    }
+    wq_result[idx] = sum;
+    printf("job%u done on core %u\n", idx, acoral_current_cpu());
+}
+
+void wq_master(void *args){
+    acoral_workqueue_t *wq = (acoral_workqueue_t *)args;
+    unsigned int i, round = 0;
+    while(1){
+        for(i = 0; i < WQ_JOBS; i++){
+            if(acoral_work_submit(wq, wq_job, (void *)(unsigned long)i) != 0){
+                wq_job((void *)(unsigned long)i); //描述符用完了就自己做
+            }
+        }
+        acoral_work_wait(wq);
+        printf("round %u: all %u jobs done\n", round++, WQ_JOBS);
+        acoral_delay_self(1000);
+    }
+}
+
+void test_workqueue(){
+    acoral_workqueue_t *wq = acoral_workqueue_create(CFG_MAX_CPU * 2, 25);
+    if(wq == NULL){
+        printf("workqueue create failed\n");
+        return;
+    }
+    acoral_create_thread("wqmaster",wq_master,wq,0,ACORAL_SCHED_POLICY_COMM,20,ACORAL_HARD_PRIO,NULL);
+}
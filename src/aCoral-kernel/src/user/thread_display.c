@@ -1,69 +1,98 @@
 #include "thread.h"
 #include "policy.h"
 #include "hal.h"
+#include "int.h"
 #include "shell.h"
 #include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * @brief dt命令显示的一个线程
+ *
+ */
+typedef struct{
+    char *name;                 ///<线程名
+    int id;                     ///<线程id
+    unsigned char policy;       ///<调度策略
+    unsigned char prio;         ///<优先级
+    unsigned int state;         ///<状态
+    unsigned int cpu;           ///<所在的核
+    unsigned int affinity;      ///<亲和性掩码
+    unsigned int migrations;    ///<迁移次数
+}dt_entry_t;
+
+static dt_entry_t dt_entries[CFG_MAX_THREAD];
 
 void display_thread_new(int argc,char **argv){	
-	acoral_list_t *head;
-    acoral_list_t *list;
+    unsigned int pos, i, num = 0;
     acoral_res_t *res;
-    acoral_pool_t* pool;
     acoral_thread_t * thread;
-	head = &acoral_res_system.system_res_ctrl_container[ACORAL_RES_THREAD].pools;
-	if (acoral_list_empty(head))
+    dt_entry_t *e;
+    
+	/*另一个核可能同时释放线程，遍历要在临界区里；打印很慢，先拷出来再打印*/
+	acoral_enter_critical();
+	acoral_for_each_res(ACORAL_RES_THREAD, pos, res)
 	{
-        return;
+        if(num>=CFG_MAX_THREAD)
+            break;
+        thread=list_entry(res,acoral_thread_t,res);
+        e=&dt_entries[num++];
+        e->name=thread->name;
+        e->id=thread->res.id;
+        e->policy=thread->policy;
+        e->prio=thread->prio;
+        e->state=thread->state;
+        e->cpu=thread->cpu;
+        e->affinity=thread->affinity;
+        e->migrations=thread->migrations;
     }
-    
-    printf("\t\tSystem Thread Information\r\n");
-	printf("----------------------------------------------------------------\r\n");
-	printf("Name\t\tid\t\tType\t\tState\t\tPrio\r\n");
-	HAL_ENTER_CRITICAL();
+	acoral_exit_critical();
 
-	for (list = head->next; list != head; list = list->next)
+    printf("\t\tSystem Thread Information\r\n");
+	printf("--------------------------------------------------------------------------------------------------------\r\n");
+	printf("Name\t\tid\t\tType\t\tState\t\tPrio\t\tCPU\tAffinity\tMigrations\r\n");
+	for(i=0;i<num;i++)
 	{
-        pool = list_entry(list,acoral_pool_t,ctrl_list);
-        for(int i =0 ; i<pool->num ; i++){
-            res = (acoral_res_t*)(pool->base_adr + pool->size * i);
-            if(ACORAL_RES_TYPE(res->id) == ACORAL_RES_THREAD){ //表示资源被分配了，而不是free的资源
-                thread=list_entry(res,acoral_thread_t,res);
-                printf("%s\t\t",thread->name);
-		        printf("%d\t\t",thread->res.id);
-		        switch(thread->policy){
-			        case ACORAL_SCHED_POLICY_COMM:
-				        printf("Common\t\t");
-				        break;
-			        case ACORAL_SCHED_POLICY_PERIOD:
-				        printf("Period\t\t");
-				        break;
-			        default:
-				        break;
-		        }
-		        if(thread->state&ACORAL_THREAD_STATE_RUNNING)
-				    printf("Running\t\t");
-		        else if(thread->state&ACORAL_THREAD_STATE_READY)
-				    printf("Ready\t\t");
-		        else if(thread->state&ACORAL_THREAD_STATE_DELAY)
-				    printf("Delay\t\t");
-		        else if(thread->state&ACORAL_THREAD_STATE_SUSPEND)
-				    printf("Sleep\t\t");
-		        else if(thread->state==ACORAL_THREAD_STATE_EXIT)
-				    printf("Exit\t\t");
-                else if(thread->state==ACORAL_THREAD_STATE_RELEASE)
-				    printf("Release\t\t");
-		        else
-				    printf("Error\t\t");
+        e=&dt_entries[i];
+        printf("%s\t\t",e->name);
+		printf("%d\t\t",e->id);
+		switch(e->policy){
+			case ACORAL_SCHED_POLICY_COMM:
+				printf("Common\t\t");
+				break;
+			case ACORAL_SCHED_POLICY_PERIOD:
+				printf("Period\t\t");
+				break;
+			case ACORAL_SCHED_POLICY_EDF:
+				printf("EDF\t\t");
+				break;
+			case ACORAL_SCHED_POLICY_RR:
+				printf("RR\t\t");
+				break;
+			default:
+				break;
+		}
+		if(e->state&ACORAL_THREAD_STATE_RUNNING)
+			printf("Running\t\t");
+		else if(e->state&ACORAL_THREAD_STATE_READY)
+			printf("Ready\t\t");
+		else if(e->state&ACORAL_THREAD_STATE_DELAY)
+			printf("Delay\t\t");
+		else if(e->state&ACORAL_THREAD_STATE_SUSPEND)
+			printf("Sleep\t\t");
+		else if(e->state==ACORAL_THREAD_STATE_EXIT)
+			printf("Exit\t\t");
+		else if(e->state==ACORAL_THREAD_STATE_RELEASE)
+			printf("Release\t\t");
+		else
+			printf("Error\t\t");
 		
-		        printf("%d\t\t",thread->prio);
-		        printf("\r\n");
-            }
-        }
+		printf("%d\t\t",e->prio);
+		printf("%u\t0x%x\t\t%u",e->cpu,e->affinity,e->migrations);
+		printf("\r\n");
     }
 	
-	printf("----------------------------------------------------------------\r\n");
-
-	HAL_EXIT_CRITICAL();
+	printf("--------------------------------------------------------------------------------------------------------\r\n");
 }
 
 acoral_shell_cmd_t dt_cmd={
@@ -72,3 +101,200 @@ acoral_shell_cmd_t dt_cmd={
 	"View all thread info",
 	NULL
 };
+
+#if CFG_STACK_PAINT
+void display_thread_stack(int argc,char **argv){
+    unsigned int pos, i, num = 0;
+    acoral_res_t *res;
+    acoral_thread_t * thread;
+    unsigned int size, used, total = 0, recommend = 0;
+
+	/*先在临界区里记下线程id，每个线程再单独进临界区量栈，关中断的时间只有扫一个栈那么长*/
+	acoral_enter_critical();
+	acoral_for_each_res(ACORAL_RES_THREAD, pos, res)
+	{
+        if(num>=CFG_MAX_THREAD)
+            break;
+        thread=list_entry(res,acoral_thread_t,res);
+        if(thread->state!=ACORAL_THREAD_STATE_RELEASE)
+            dt_entries[num++].id=thread->res.id;
+    }
+	acoral_exit_critical();
+
+    printf("\t\tThread Stack Usage\r\n");
+	printf("------------------------------------------------------------------------\r\n");
+	printf("Name\t\tid\t\tSize\tUsed\tFree\tRecommend\r\n");
+	for(i=0;i<num;i++)
+	{
+        acoral_enter_critical();
+        thread=(acoral_thread_t *)acoral_get_res_by_id(dt_entries[i].id);
+        if(thread==NULL||thread->state==ACORAL_THREAD_STATE_RELEASE){
+            acoral_exit_critical(); //已经退出并释放了
+            continue;
+        }
+        dt_entries[i].name=thread->name;
+        size=thread->stack_size;
+        used=acoral_thread_stack_used(thread);
+        acoral_exit_critical();
+        printf("%s\t\t%d\t\t%u\t%u\t%u\t%u%s\r\n",dt_entries[i].name,dt_entries[i].id,
+               size,used,size-used,acoral_stack_recommend(used),
+               used>=size?"\tOVERFLOW?":"");
+        total += size;
+        recommend += acoral_stack_recommend(used);
+    }
+
+	printf("------------------------------------------------------------------------\r\n");
+	printf("Total %u bytes, %u bytes with recommended sizes\r\n",total,recommend);
+}
+
+acoral_shell_cmd_t stack_cmd={
+	"stack",
+	(void*)display_thread_stack,
+	"View thread stack high-water marks and recommended sizes",
+	NULL
+};
+#endif
+
+#if CFG_THREAD_STATS
+#define TOP_DEFAULT_WINDOW_MS 1000 ///<top命令默认的统计窗口
+
+/**
+ * @brief top命令的一次快照
+ *
+ */
+typedef struct{
+    int ids[CFG_MAX_THREAD];                        ///<快照时存在的线程id
+    acoral_thread_stat_t threads[CFG_MAX_THREAD];   ///<与ids一一对应
+    char *names[CFG_MAX_THREAD];                    ///<线程名，与ids一一对应
+    unsigned char prios[CFG_MAX_THREAD];            ///<优先级，与ids一一对应
+    unsigned char thread_cpus[CFG_MAX_THREAD];          ///<所在的核，与ids一一对应
+    unsigned int num;                               ///<线程个数
+    acoral_cpu_stat_t cpus[CFG_MAX_CPU];            ///<各核的统计
+}top_snapshot_t;
+
+static top_snapshot_t top_snaps[2];
+
+/**
+ * @brief 记录所有线程和所有核的累计统计
+ *
+ * @param snap 快照
+ */
+static void top_snapshot(top_snapshot_t *snap){
+    unsigned int pos;
+    acoral_res_t *res;
+    acoral_thread_t * thread;
+    unsigned int cpu;
+
+    snap->num = 0;
+	/*另一个核可能同时释放线程，遍历要在临界区里*/
+	acoral_enter_critical();
+	acoral_for_each_res(ACORAL_RES_THREAD, pos, res)
+	{
+        if(snap->num>=CFG_MAX_THREAD)
+            break;
+        thread=list_entry(res,acoral_thread_t,res);
+        if(acoral_thread_get_stat(thread->res.id,&snap->threads[snap->num])==0)
+        {
+            snap->names[snap->num] = thread->name;
+            snap->prios[snap->num] = thread->prio;
+            snap->thread_cpus[snap->num] = thread->cpu;
+            snap->ids[snap->num++] = thread->res.id;
+        }
+    }
+	for (cpu = 0; cpu < CFG_MAX_CPU; cpu++)
+		acoral_cpu_get_stat(cpu, &snap->cpus[cpu]);
+	acoral_exit_critical();
+}
+
+/**
+ * @brief 千分比
+ *
+ */
+static unsigned int top_permille(unsigned long part, unsigned long whole){
+    if (whole == 0)
+        return 0;
+    return (unsigned int)((unsigned long long)part * 1000 / whole);
+}
+
+/**
+ * @brief 打印两次快照之间各线程和各核的CPU占用
+ *
+ * @param old 窗口开始时的快照
+ * @param now 窗口结束时的快照
+ */
+static void top_print(top_snapshot_t *old, top_snapshot_t *now){
+    unsigned long window = now->cpus[0].cycles - old->cpus[0].cycles;
+    unsigned long run, idle, isr;
+    unsigned int i, j, cpu, pm;
+
+    printf("\t\tTop, window %lu %s\r\n", window, HAL_CYCLES_UNIT);
+	printf("------------------------------------------------------------------------\r\n");
+    for (cpu = 0; cpu < CFG_MAX_CPU; cpu++)
+    {
+        window = now->cpus[cpu].cycles - old->cpus[cpu].cycles;
+        idle = now->cpus[cpu].idle_cycles - old->cpus[cpu].idle_cycles;
+        isr = now->cpus[cpu].isr_cycles - old->cpus[cpu].isr_cycles;
+        pm = top_permille(idle + isr, window);
+        pm = pm > 1000 ? 0 : 1000 - pm;
+        printf("Hart%u: busy %u.%u%%, isr %u.%u%%, idle %u.%u%%, %lu switches\r\n", cpu,
+               pm / 10, pm % 10, top_permille(isr, window) / 10, top_permille(isr, window) % 10,
+               top_permille(idle, window) / 10, top_permille(idle, window) % 10,
+               now->cpus[cpu].switches - old->cpus[cpu].switches);
+    }
+	printf("------------------------------------------------------------------------\r\n");
+	printf("Name\t\tid\tCPU\tPrio\tCPU%%\tVol\tInvol\r\n");
+    window = now->cpus[0].cycles - old->cpus[0].cycles;
+    for (i = 0; i < now->num; i++)
+    {
+        if (acoral_get_res_by_id(now->ids[i]) == NULL) //窗口结束之后退出并释放了的线程，id已经失效
+            continue;
+        run = now->threads[i].run_cycles;
+        /*窗口里新建的线程没有旧快照，从0算起*/
+        for (j = 0; j < old->num && old->ids[j] != now->ids[i]; j++)
+            ;
+        if (j < old->num && old->threads[j].run_cycles <= run)
+        {
+            run -= old->threads[j].run_cycles;
+            pm = top_permille(run, window);
+            printf("%s\t\t%d\t%d\t%d\t%u.%u\t%u\t%u\r\n", now->names[i], now->ids[i], now->thread_cpus[i], now->prios[i],
+                   pm / 10, pm % 10, now->threads[i].nvcsw - old->threads[j].nvcsw,
+                   now->threads[i].nivcsw - old->threads[j].nivcsw);
+        }
+        else
+        {
+            pm = top_permille(run, window);
+            printf("%s\t\t%d\t%d\t%d\t%u.%u\t%u\t%u\r\n", now->names[i], now->ids[i], now->thread_cpus[i], now->prios[i],
+                   pm / 10, pm % 10, now->threads[i].nvcsw, now->threads[i].nivcsw);
+        }
+    }
+	printf("------------------------------------------------------------------------\r\n");
+}
+
+/**
+ * @brief top [窗口毫秒数] [刷新次数]，按窗口统计各线程、各核的CPU占用，线程的CPU%相对一个核
+ *
+ */
+void display_top(int argc,char **argv){
+    unsigned int window = TOP_DEFAULT_WINDOW_MS;
+    int rounds = 1;
+
+    if (argc > 1 && atoi(argv[1]) > 0)
+        window = atoi(argv[1]);
+    if (argc > 2 && atoi(argv[2]) > 0)
+        rounds = atoi(argv[2]);
+    while (rounds--)
+    {
+        top_snapshot(&top_snaps[0]);
+        acoral_delay_self(window);
+        top_snapshot(&top_snaps[1]);
+        top_print(&top_snaps[0], &top_snaps[1]);
+    }
+}
+
+acoral_shell_cmd_t top_cmd={
+	"top",
+	(void*)display_top,
+	"top [window_ms] [rounds]: per-thread and per-hart CPU usage",
+	NULL
+};
+#endif
@@ -9,6 +9,16 @@ void user_main(){
     ACORAL_LOG_TRACE("Init Thread -> user_main");
     // test_comm_thread();
     // test_period_thread();
+    // test_edf_thread();
+    // test_rr_thread();
+    // test_sched_bench();
+    // test_affinity();
+    // test_workqueue();
+    // test_mutex_pi();
+    // test_srp();
+    // test_reserve();
+    // test_slab();
+    // acoral_bench();
     // test_iris();
     // test_iris_2();
     // test_yolo2();
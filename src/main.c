@@ -21,6 +21,9 @@
 {	
     uint64_t core = current_coreid();	
     ACORAL_LOG_TRACE("Core %ld Hello world\n", core);	
+#ifdef CFG_SMP
+    acoral_secondary_cpu_start();
+#endif
     while(1);
 }	
 
@@ -29,6 +32,6 @@
 {	
     uint64_t core = current_coreid();	
     ACORAL_LOG_TRACE("Core %ld Hello world\n", core);	
-    // register_core1(core1_function, NULL);	
+    register_core1(core1_function, NULL);	
     system_start();	
 }
\ No newline at end of file